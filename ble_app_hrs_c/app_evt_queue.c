@@ -0,0 +1,356 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#include <string.h>
+#include "app_evt_queue.h"
+#include "app_util_platform.h"
+
+#define NRF_LOG_MODULE_NAME app_evt_queue
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+STATIC_ASSERT(APP_EVT_QUEUE_SIZE > 0);
+
+static app_evt_t               m_queue[APP_EVT_QUEUE_SIZE];     /**< Event ring buffer. */
+static uint16_t                m_head;                          /**< Index of the oldest entry. */
+static uint16_t                m_count;                         /**< Number of entries in the queue. */
+static bool                    m_drain_pending;                 /**< True if a drain is scheduled, or missed and left to the main loop. */
+static volatile bool           m_drain_missed;                  /**< True if the scheduler queue had no room for the drain, see @ref app_evt_queue_process. */
+static app_evt_queue_handler_t m_handler;                       /**< Handler for dequeued events. */
+static app_evt_queue_stats_t   m_stats;                         /**< Queue statistics. */
+static app_evt_queue_stats_t   m_stats_reported;                /**< Statistics at the time of the last report. */
+
+
+static void queue_drain(void * p_event_data, uint16_t event_size);
+
+
+/**@brief Function for getting the most recently queued entry if it can take a merge.
+ *
+ * @details Must be called inside a critical region.
+ */
+static app_evt_t * tail_get(uint8_t type, uint8_t slot)
+{
+        if (m_count == 0)
+        {
+                return NULL;
+        }
+
+        app_evt_t * p_tail = &m_queue[(m_head + m_count - 1) % APP_EVT_QUEUE_SIZE];
+
+        return ((p_tail->type == type) && (p_tail->slot == slot)) ? p_tail : NULL;
+}
+
+
+/**@brief Function for reserving a new entry at the tail of the queue.
+ *
+ * @details Must be called inside a critical region. Schedules a drain if none is pending.
+ *
+ * @return Pointer to the entry, or NULL if the queue is full.
+ */
+static app_evt_t * tail_alloc(uint8_t type, uint8_t slot)
+{
+        if (m_count >= APP_EVT_QUEUE_SIZE)
+        {
+                m_stats.drops++;
+                return NULL;
+        }
+
+        app_evt_t * p_evt = &m_queue[(m_head + m_count) % APP_EVT_QUEUE_SIZE];
+
+        m_count++;
+        m_stats.high_water = MAX(m_stats.high_water, m_count);
+
+        p_evt->type   = type;
+        p_evt->slot   = slot;
+        p_evt->merged = 1;
+
+        // Without a slot in the scheduler the main loop drains, like it polls the SoftDevice.
+        if (!m_drain_pending)
+        {
+                m_drain_pending = true;
+                m_drain_missed  = (app_evt_queue_sched_put(queue_drain, NULL, 0) != NRF_SUCCESS);
+        }
+
+        return p_evt;
+}
+
+
+/**@brief Function for handling all queued entries in one batch from the main loop. */
+static void queue_drain(void * p_event_data, uint16_t event_size)
+{
+        static app_evt_t evt;
+
+        UNUSED_PARAMETER(p_event_data);
+        UNUSED_PARAMETER(event_size);
+
+        for (;;)
+        {
+                bool empty;
+
+                CRITICAL_REGION_ENTER();
+                empty = (m_count == 0);
+                if (empty)
+                {
+                        m_drain_pending = false;
+                }
+                else
+                {
+                        // Copy out, so producers can keep merging into the tail meanwhile.
+                        memcpy(&evt, &m_queue[m_head], sizeof(evt));
+                        m_head = (m_head + 1) % APP_EVT_QUEUE_SIZE;
+                        m_count--;
+                }
+                CRITICAL_REGION_EXIT();
+
+                if (empty)
+                {
+                        break;
+                }
+
+                m_handler(&evt);
+        }
+
+        m_stats.batches++;
+
+        // Report overload as it happens rather than waiting for someone to ask.
+        if ((m_stats.drops != m_stats_reported.drops) ||
+            (m_stats.sched_drops != m_stats_reported.sched_drops) ||
+            (m_stats.high_water != m_stats_reported.high_water))
+        {
+                if (m_stats.drops != m_stats_reported.drops)
+                {
+                        NRF_LOG_WARNING("%d events dropped, queue full.",
+                                        m_stats.drops - m_stats_reported.drops);
+                }
+                if (m_stats.sched_drops != m_stats_reported.sched_drops)
+                {
+                        NRF_LOG_WARNING("%d scheduler events dropped, queue full.",
+                                        m_stats.sched_drops - m_stats_reported.sched_drops);
+                }
+                app_evt_queue_stats_log();
+                m_stats_reported = m_stats;
+        }
+}
+
+
+void app_evt_queue_init(app_evt_queue_handler_t handler)
+{
+        m_handler       = handler;
+        m_head          = 0;
+        m_count         = 0;
+        m_drain_pending = false;
+        m_drain_missed  = false;
+        memset(&m_stats, 0, sizeof(m_stats));
+        memset(&m_stats_reported, 0, sizeof(m_stats_reported));
+}
+
+
+ret_code_t app_evt_queue_nus_put(uint8_t slot, uint8_t const * p_data, uint16_t len)
+{
+        ret_code_t  err_code = NRF_SUCCESS;
+        app_evt_t * p_evt;
+
+        len = MIN(len, BLE_NUS_MAX_DATA_LEN);
+
+        CRITICAL_REGION_ENTER();
+        m_stats.puts++;
+
+        p_evt = tail_get(APP_EVT_NUS_RX, slot);
+        if ((p_evt != NULL) && (p_evt->params.nus.len + len <= BLE_NUS_MAX_DATA_LEN))
+        {
+                p_evt->merged++;
+                m_stats.merged++;
+        }
+        else
+        {
+                p_evt = tail_alloc(APP_EVT_NUS_RX, slot);
+                if (p_evt != NULL)
+                {
+                        p_evt->params.nus.len = 0;
+                }
+        }
+
+        if (p_evt != NULL)
+        {
+                memcpy(&p_evt->params.nus.data[p_evt->params.nus.len], p_data, len);
+                p_evt->params.nus.len += len;
+        }
+        else
+        {
+                err_code = NRF_ERROR_NO_MEM;
+        }
+        CRITICAL_REGION_EXIT();
+
+        return err_code;
+}
+
+
+ret_code_t app_evt_queue_hrm_put(uint8_t slot, ble_hrm_t const * p_hrm)
+{
+        ret_code_t  err_code = NRF_SUCCESS;
+        app_evt_t * p_evt;
+
+        CRITICAL_REGION_ENTER();
+        m_stats.puts++;
+
+        p_evt = tail_get(APP_EVT_HRM, slot);
+        if ((p_evt != NULL) && (p_evt->params.hrm.rr_cnt + p_hrm->rr_intervals_cnt <= APP_EVT_RR_MAX))
+        {
+                p_evt->merged++;
+                m_stats.merged++;
+        }
+        else
+        {
+                p_evt = tail_alloc(APP_EVT_HRM, slot);
+                if (p_evt != NULL)
+                {
+                        p_evt->params.hrm.rr_cnt = 0;
+                }
+        }
+
+        if (p_evt != NULL)
+        {
+                uint16_t rr_cnt = MIN(p_hrm->rr_intervals_cnt, APP_EVT_RR_MAX - p_evt->params.hrm.rr_cnt);
+
+                p_evt->params.hrm.hr_value = p_hrm->hr_value;
+                memcpy(&p_evt->params.hrm.rr[p_evt->params.hrm.rr_cnt],
+                       p_hrm->rr_intervals,
+                       rr_cnt * sizeof(uint16_t));
+                p_evt->params.hrm.rr_cnt += rr_cnt;
+        }
+        else
+        {
+                err_code = NRF_ERROR_NO_MEM;
+        }
+        CRITICAL_REGION_EXIT();
+
+        return err_code;
+}
+
+
+ret_code_t app_evt_queue_batt_put(uint8_t slot, uint8_t batt_level)
+{
+        ret_code_t  err_code = NRF_SUCCESS;
+        app_evt_t * p_evt;
+
+        CRITICAL_REGION_ENTER();
+        m_stats.puts++;
+
+        p_evt = tail_get(APP_EVT_BATT_LEVEL, slot);
+        if (p_evt != NULL)
+        {
+                p_evt->merged++;
+                m_stats.merged++;
+        }
+        else
+        {
+                p_evt = tail_alloc(APP_EVT_BATT_LEVEL, slot);
+        }
+
+        if (p_evt != NULL)
+        {
+                p_evt->params.batt_level = batt_level;
+        }
+        else
+        {
+                err_code = NRF_ERROR_NO_MEM;
+        }
+        CRITICAL_REGION_EXIT();
+
+        return err_code;
+}
+
+
+void app_evt_queue_process(void)
+{
+        // Set again only once the drain has emptied the queue and a put finds no room.
+        if (m_drain_missed)
+        {
+                m_drain_missed = false;
+                queue_drain(NULL, 0);
+        }
+}
+
+
+ret_code_t app_evt_queue_sched_put(app_sched_event_handler_t handler, void const * p_data, uint16_t size)
+{
+        ret_code_t err_code = app_sched_event_put(p_data, size, handler);
+
+        if (err_code != NRF_SUCCESS)
+        {
+                CRITICAL_REGION_ENTER();
+                m_stats.sched_drops++;
+                CRITICAL_REGION_EXIT();
+                err_code = NRF_ERROR_NO_MEM;
+        }
+
+        return err_code;
+}
+
+
+void app_evt_queue_stats_get(app_evt_queue_stats_t * p_stats)
+{
+        CRITICAL_REGION_ENTER();
+        *p_stats = m_stats;
+        CRITICAL_REGION_EXIT();
+}
+
+
+void app_evt_queue_stats_log(void)
+{
+        app_evt_queue_stats_t stats;
+
+        app_evt_queue_stats_get(&stats);
+
+        NRF_LOG_INFO("Event queue: %d puts, %d merged, %d dropped, %d batches, high water %d/%d.",
+                     stats.puts,
+                     stats.merged,
+                     stats.drops,
+                     stats.batches,
+                     stats.high_water,
+                     APP_EVT_QUEUE_SIZE);
+#if APP_SCHEDULER_WITH_PROFILER
+        NRF_LOG_INFO("Scheduler queue: %d dropped, high water %d.",
+                     stats.sched_drops, app_sched_queue_utilization_get());
+#else
+        NRF_LOG_INFO("Scheduler queue: %d dropped.", stats.sched_drops);
+#endif
+}
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup app_evt_queue Typed application event queue
+ * @{
+ * @brief    Coalescing queue for application work triggered by BLE events.
+ *
+ * @details  The service client handlers only decode the event and put it in this queue. The
+ *           queue registers a single app_scheduler event when it becomes non-empty and then
+ *           drains every queued entry in one batch from the main loop, so a burst of events from
+ *           several links costs one scheduler slot instead of one per event.
+ *
+ *           Consecutive events of the same type on the same link are merged into the entry at
+ *           the tail of the queue:
+ *           - NUS data is appended while it fits in one entry.
+ *           - Heart rate measurements keep the latest heart rate and append the RR intervals.
+ *           - Battery levels keep the latest value.
+ *
+ *           If the scheduler queue has no room for the drain, the main loop drains the queue
+ *           instead, see @ref app_evt_queue_process.
+ *
+ *           When the queue is full, new events are dropped and counted. The high-water mark and
+ *           the drop count are reported by @ref app_evt_queue_stats_log.
+ *
+ *           The application puts its other scheduler events through @ref app_evt_queue_sched_put,
+ *           which counts a full scheduler queue as a drop instead of a fault.
+ */
+
+#ifndef APP_EVT_QUEUE_H__
+#define APP_EVT_QUEUE_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "sdk_config.h"
+#include "app_scheduler.h"
+#include "ble_hrs_c.h"
+#include "ble_nus_c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_EVT_RR_MAX      BLE_HRS_C_RR_INTERVALS_MAX_CNT      /**< Maximum number of RR intervals held by one entry. */
+
+/**@brief Application event types. */
+typedef enum
+{
+        APP_EVT_NUS_RX,             /**< Data received from the peer's NUS TX characteristic. */
+        APP_EVT_HRM,                /**< Heart rate measurement notification. */
+        APP_EVT_BATT_LEVEL,         /**< Battery level notification or read response. */
+        APP_EVT_TYPE_COUNT
+} app_evt_type_t;
+
+/**@brief Application event. */
+typedef struct
+{
+        uint8_t  type;              /**< Event type, see @ref app_evt_type_t. */
+        uint8_t  slot;              /**< Link context slot the event belongs to. */
+        uint16_t merged;            /**< Number of source events merged into this entry. */
+        union
+        {
+                struct
+                {
+                        uint16_t len;                           /**< Number of valid bytes in data. */
+                        uint8_t  data[BLE_NUS_MAX_DATA_LEN];    /**< Received data. */
+                } nus;
+                struct
+                {
+                        uint16_t hr_value;                      /**< Latest heart rate. */
+                        uint16_t rr_cnt;                        /**< Number of RR intervals. */
+                        uint16_t rr[APP_EVT_RR_MAX];            /**< RR intervals of all merged measurements. */
+                } hrm;
+                uint8_t batt_level;                             /**< Latest battery level. */
+        } params;
+} app_evt_t;
+
+/**@brief Queue statistics. */
+typedef struct
+{
+        uint32_t puts;              /**< Number of events offered to the queue. */
+        uint32_t merged;            /**< Number of events merged into an existing entry. */
+        uint32_t drops;             /**< Number of events dropped because the queue was full. */
+        uint32_t batches;           /**< Number of times the queue was drained. */
+        uint16_t high_water;        /**< Highest number of entries in the queue. */
+        uint32_t sched_drops;       /**< Number of scheduler events dropped because its queue was full. */
+} app_evt_queue_stats_t;
+
+/**@brief Handler called from the main loop for every queued entry. */
+typedef void (* app_evt_queue_handler_t)(app_evt_t const * p_evt);
+
+
+/**@brief Function for initializing the queue.
+ *
+ * @param[in] handler  Handler for dequeued events.
+ */
+void app_evt_queue_init(app_evt_queue_handler_t handler);
+
+
+/**@brief Function for queueing received NUS data.
+ *
+ * @retval NRF_SUCCESS       If the data was queued or merged.
+ * @retval NRF_ERROR_NO_MEM  If the queue was full and the data was dropped.
+ */
+ret_code_t app_evt_queue_nus_put(uint8_t slot, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for queueing a heart rate measurement.
+ *
+ * @retval NRF_SUCCESS       If the measurement was queued or merged.
+ * @retval NRF_ERROR_NO_MEM  If the queue was full and the measurement was dropped.
+ */
+ret_code_t app_evt_queue_hrm_put(uint8_t slot, ble_hrm_t const * p_hrm);
+
+
+/**@brief Function for queueing a battery level.
+ *
+ * @retval NRF_SUCCESS       If the level was queued or merged.
+ * @retval NRF_ERROR_NO_MEM  If the queue was full and the level was dropped.
+ */
+ret_code_t app_evt_queue_batt_put(uint8_t slot, uint8_t batt_level);
+
+
+/**@brief Function for draining the queue if the scheduler queue had no room for the drain.
+ *
+ * @details Call from the main loop after app_sched_execute().
+ */
+void app_evt_queue_process(void);
+
+
+/**@brief Function for putting an event in the scheduler queue, counting it if the queue is full.
+ *
+ * @details Safe from any context. The caller handles a dropped event, the scheduler does not
+ *          retry it.
+ *
+ * @param[in] handler  Handler to call from the main loop.
+ * @param[in] p_data   Event data, copied into the queue. Can be NULL if size is 0.
+ * @param[in] size     Size of the event data, at most the one given to APP_SCHED_INIT.
+ *
+ * @retval NRF_SUCCESS       If the event was scheduled.
+ * @retval NRF_ERROR_NO_MEM  If the scheduler queue was full and the event was dropped.
+ */
+ret_code_t app_evt_queue_sched_put(app_sched_event_handler_t handler, void const * p_data, uint16_t size);
+
+
+/**@brief Function for getting the queue statistics.
+ *
+ * @param[out] p_stats  Copy of the statistics.
+ */
+void app_evt_queue_stats_get(app_evt_queue_stats_t * p_stats);
+
+
+/**@brief Function for writing the queue and scheduler statistics to the log. */
+void app_evt_queue_stats_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // APP_EVT_QUEUE_H__
+
+/** @} */
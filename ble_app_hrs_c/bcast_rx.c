@@ -0,0 +1,521 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BCAST_RX)
+#include <string.h>
+#include "bcast_rx.h"
+#include "hrs_bcast.h"
+#include "app_timer.h"
+#include "app_evt_queue.h"
+#include "app_error.h"
+#include "nrf.h"
+
+#define NRF_LOG_MODULE_NAME bcast_rx
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define REPORT_INTERVAL         APP_TIMER_TICKS(BCAST_RX_REPORT_INTERVAL_MS)
+#define TIMEOUT                 APP_TIMER_TICKS(BCAST_RX_TIMEOUT_MS)
+#define TICKS_TO_MS(_ticks)     ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+#define TABLE_SIZE              (1UL << BCAST_RX_TABLE_BITS)    /**< Slots in the table. */
+#define TABLE_MASK              (TABLE_SIZE - 1)
+#define PEERS_MAX               (TABLE_SIZE * 3 / 4)            /**< Sensors followed at most, keeps the probe sequences short. */
+#define AGE_STEP                2                               /**< Slots checked for silent sensors per report. */
+
+#define TYPE_EMPTY              0xFF    /**< Address type of an empty slot. */
+#define SEQ_RESTART             128     /**< A sequence number this far ahead is a restarted sensor, not lost measurements. */
+
+#define BENCH_SEED              0x2545F491UL    /**< Seed of the synthetic report streams. */
+#define BENCH_REPEAT            4               /**< Reports per measurement of a synthetic sensor. */
+#define BENCH_LOSS_PERCENT      5               /**< Reports of the synthetic streams lost on the air. */
+#define BENCH_CHUNK             256             /**< Synthetic reports handled per scheduler event. */
+
+STATIC_ASSERT((BCAST_RX_TABLE_BITS >= 2) && (BCAST_RX_TABLE_BITS <= 10));
+
+/**@brief Sensor followed by the receiver. */
+typedef struct
+{
+        uint8_t          addr[BLE_GAP_ADDR_LEN];        /**< Address of the sensor. */
+        uint8_t          addr_type;                     /**< Address type, TYPE_EMPTY if the slot is free. */
+        int8_t           rssi;                          /**< Signal strength of the latest report. */
+        uint32_t         last_tick;                     /**< Time of the latest report. */
+        hrs_bcast_meas_t meas;                          /**< Latest measurement. */
+        uint16_t         meas_cnt;                      /**< New measurements since the last log. */
+        uint16_t         dup_cnt;                       /**< Reports repeating a measurement since the last log. */
+        uint16_t         lost_cnt;                      /**< Measurements missing from the sequence since the last log. */
+} bcast_peer_t;
+
+/**@brief Counters of the receiver since the last log. */
+typedef struct
+{
+        uint32_t reports;       /**< Advertising reports checked. */
+        uint32_t meas;          /**< Reports holding a measurement. */
+        uint32_t full;          /**< Measurements of new sensors not followed for lack of room. */
+        uint32_t aged;          /**< Sensors dropped for silence. */
+        uint32_t probes_max;    /**< Longest probe sequence. */
+} bcast_stats_t;
+
+/**@brief Table of sensors. */
+typedef struct
+{
+        bcast_peer_t  peers[TABLE_SIZE];        /**< Open-addressed table, linear probing. */
+        uint32_t      count;                    /**< Sensors in the table. */
+        uint32_t      age_cursor;               /**< Next slot checked for a silent sensor. */
+        bcast_stats_t stats;                    /**< Counters since the last log. */
+} bcast_table_t;
+
+/**@brief State of a running ingest benchmark. */
+typedef struct
+{
+        bool            running;                                /**< A benchmark is scheduled. */
+        uint32_t        sensors;                                /**< Synthetic sensors. */
+        uint32_t        left;                                   /**< Reports still to generate. */
+        uint32_t        step;                                   /**< Ticks between two reports. */
+        uint32_t        now;                                    /**< Clock of the synthetic reports. */
+        uint32_t        rand;                                   /**< State of the pseudo-random generator. */
+        uint32_t        cyc_max;                                /**< Most cycles taken by a report. */
+        uint64_t        cyc_sum;                                /**< Cycles taken by all reports. */
+        hrs_bcast_enc_t enc;                                    /**< Encoder of the measurements. */
+        uint8_t         seqs[BCAST_RX_BENCH_SENSORS_MAX];       /**< Sequence number of each sensor. */
+} bcast_bench_t;
+
+APP_TIMER_DEF(m_report_timer);                                  /**< Periodic report timer. */
+
+static bcast_table_t m_table;                                   /**< Sensors heard on the air. */
+static bcast_table_t m_bench_table;                             /**< Synthetic sensors of the benchmark, kept apart from the live ones. */
+static bcast_bench_t m_bench;                                   /**< Benchmark state. */
+
+
+/**@brief Function for computing the home slot of an address.
+ *
+ * @details Public addresses share their upper half within a vendor, so all six bytes are mixed.
+ */
+static uint32_t slot_home(uint8_t const * p_addr)
+{
+        uint32_t h = uint32_decode(p_addr) ^ (uint16_decode(&p_addr[4]) * 0x85EBCA6BUL);
+
+        h *= 0x9E3779B1UL;
+        return h >> (32 - BCAST_RX_TABLE_BITS);
+}
+
+
+/**@brief Function for emptying a table and its counters. */
+static void table_clear(bcast_table_t * p_table)
+{
+        for (uint32_t i = 0; i < TABLE_SIZE; i++)
+        {
+                p_table->peers[i].addr_type = TYPE_EMPTY;
+        }
+        p_table->count      = 0;
+        p_table->age_cursor = 0;
+        memset(&p_table->stats, 0, sizeof(p_table->stats));
+}
+
+
+/**@brief Function for removing the sensor in a slot.
+ *
+ * @details Later entries of the same probe sequence are shifted back into the hole, so lookups
+ *          never need tombstones and stay as short as the load allows.
+ *
+ * @param[in] p_table  Table.
+ * @param[in] hole     Slot to empty.
+ */
+static void peer_remove(bcast_table_t * p_table, uint32_t hole)
+{
+        bcast_peer_t * p_peers = p_table->peers;
+        uint32_t       next    = (hole + 1) & TABLE_MASK;
+
+        while (p_peers[next].addr_type != TYPE_EMPTY)
+        {
+                uint32_t home = slot_home(p_peers[next].addr);
+
+                // The entry may fill the hole unless its home lies cyclically in (hole, next].
+                if (((next - home) & TABLE_MASK) >= ((next - hole) & TABLE_MASK))
+                {
+                        p_peers[hole] = p_peers[next];
+                        hole          = next;
+                }
+                next = (next + 1) & TABLE_MASK;
+        }
+
+        p_peers[hole].addr_type = TYPE_EMPTY;
+        p_table->count--;
+}
+
+
+/**@brief Function for dropping silent sensors from a few slots, so that ageing costs the same
+ *        small amount on every report.
+ *
+ * @param[in] p_table  Table.
+ * @param[in] now      Current time.
+ */
+static void peers_age(bcast_table_t * p_table, uint32_t now)
+{
+        for (uint32_t i = 0; i < AGE_STEP; i++)
+        {
+                bcast_peer_t * p_peer = &p_table->peers[p_table->age_cursor];
+
+                if ((p_peer->addr_type != TYPE_EMPTY) &&
+                    (app_timer_cnt_diff_compute(now, p_peer->last_tick) > TIMEOUT))
+                {
+                        // The slot is refilled by the shift, check it again.
+                        peer_remove(p_table, p_table->age_cursor);
+                        p_table->stats.aged++;
+                        continue;
+                }
+                p_table->age_cursor = (p_table->age_cursor + 1) & TABLE_MASK;
+        }
+}
+
+
+/**@brief Function for finding the slot of a sensor, or the free slot where it goes.
+ *
+ * @param[in]  p_table    Table.
+ * @param[in]  p_addr     Address of the sensor.
+ * @param[in]  addr_type  Address type.
+ * @param[out] p_found    True if the sensor is in the table.
+ *
+ * @return The slot.
+ */
+static uint32_t peer_find(bcast_table_t * p_table, uint8_t const * p_addr, uint8_t addr_type, bool * p_found)
+{
+        bcast_peer_t const * p_peers = p_table->peers;
+        uint32_t             slot    = slot_home(p_addr);
+        uint32_t             probes  = 1;
+
+        // The load cap leaves free slots, the loop ends at one of them at the latest.
+        while (p_peers[slot].addr_type != TYPE_EMPTY)
+        {
+                if ((p_peers[slot].addr_type == addr_type) &&
+                    (memcmp(p_peers[slot].addr, p_addr, BLE_GAP_ADDR_LEN) == 0))
+                {
+                        break;
+                }
+                slot = (slot + 1) & TABLE_MASK;
+                probes++;
+        }
+
+        p_table->stats.probes_max = MAX(p_table->stats.probes_max, probes);
+        *p_found                  = (p_peers[slot].addr_type != TYPE_EMPTY);
+
+        return slot;
+}
+
+
+/**@brief Function for handling the advertising data of a report.
+ *
+ * @param[in] p_table  Table updated.
+ * @param[in] p_addr   Address of the advertiser.
+ * @param[in] rssi     Signal strength.
+ * @param[in] p_data   Advertising data.
+ * @param[in] len      Length of the advertising data.
+ * @param[in] now      Time of the report.
+ */
+static void report_handle(bcast_table_t        * p_table,
+                          ble_gap_addr_t const * p_addr,
+                          int8_t                 rssi,
+                          uint8_t const        * p_data,
+                          uint16_t               len,
+                          uint32_t               now)
+{
+        hrs_bcast_meas_t meas;
+        bcast_peer_t   * p_peer;
+        uint32_t         slot;
+        bool             found;
+        uint8_t          seq_diff;
+
+        p_table->stats.reports++;
+        peers_age(p_table, now);
+
+        if (hrs_bcast_decode(p_data, len, &meas) != NRF_SUCCESS)
+        {
+                return;
+        }
+        p_table->stats.meas++;
+
+        slot   = peer_find(p_table, p_addr->addr, p_addr->addr_type, &found);
+        p_peer = &p_table->peers[slot];
+
+        if (found)
+        {
+                // Every measurement is advertised several times.
+                seq_diff = (uint8_t)(meas.seq - p_peer->meas.seq);
+                if (seq_diff == 0)
+                {
+                        p_peer->dup_cnt++;
+                        p_peer->rssi      = rssi;
+                        p_peer->last_tick = now;
+                        return;
+                }
+                if (seq_diff < SEQ_RESTART)
+                {
+                        p_peer->lost_cnt += seq_diff - 1;
+                }
+        }
+        else
+        {
+                if (p_table->count >= PEERS_MAX)
+                {
+                        p_table->stats.full++;
+                        return;
+                }
+
+                memset(p_peer, 0, sizeof(*p_peer));
+                memcpy(p_peer->addr, p_addr->addr, BLE_GAP_ADDR_LEN);
+                p_peer->addr_type = p_addr->addr_type;
+                p_table->count++;
+        }
+
+        p_peer->meas      = meas;
+        p_peer->rssi      = rssi;
+        p_peer->last_tick = now;
+        p_peer->meas_cnt++;
+}
+
+
+void bcast_rx_on_adv_report(ble_gap_evt_adv_report_t const * p_report)
+{
+        report_handle(&m_table,
+                      &p_report->peer_addr,
+                      p_report->rssi,
+                      p_report->data.p_data,
+                      p_report->data.len,
+                      app_timer_cnt_get());
+}
+
+
+void bcast_rx_report(void)
+{
+        uint32_t now = app_timer_cnt_get();
+
+        for (uint32_t i = 0; i < TABLE_SIZE; i++)
+        {
+                bcast_peer_t * p_peer = &m_table.peers[i];
+
+                if (p_peer->addr_type == TYPE_EMPTY)
+                {
+                        continue;
+                }
+
+                NRF_LOG_INFO("  ..%02x%02x%02x HR=%-3d rssi=%-4d seen %d ms ago",
+                             p_peer->addr[2], p_peer->addr[1], p_peer->addr[0],
+                             p_peer->meas.hr_value, p_peer->rssi,
+                             TICKS_TO_MS(app_timer_cnt_diff_compute(now, p_peer->last_tick)));
+                NRF_LOG_INFO("            RR n=%d mean=%d batt=%d%% rcvd=%d dup=%d lost=%d",
+                             p_peer->meas.rr_cnt, p_peer->meas.rr_mean, p_peer->meas.batt_level,
+                             p_peer->meas_cnt, p_peer->dup_cnt, p_peer->lost_cnt);
+
+                p_peer->meas_cnt = 0;
+                p_peer->dup_cnt  = 0;
+                p_peer->lost_cnt = 0;
+        }
+
+        NRF_LOG_INFO("%d sensors broadcasting, %d of %d reports with a measurement.",
+                     m_table.count, m_table.stats.meas, m_table.stats.reports);
+        NRF_LOG_INFO("%d dropped for silence, %d measurements refused, table full, longest probe %d.",
+                     m_table.stats.aged, m_table.stats.full, m_table.stats.probes_max);
+
+        memset(&m_table.stats, 0, sizeof(m_table.stats));
+}
+
+
+/**@brief Function for drawing a pseudo-random number for the synthetic report streams. */
+static uint32_t bench_rand(uint32_t * p_state)
+{
+        uint32_t x = *p_state;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        *p_state = x;
+        return x;
+}
+
+
+/**@brief Function for handling a chunk of the synthetic report stream from the main loop.
+ *
+ * @details Each chunk schedules the next, so that the benchmark shares the main loop with the
+ *          links instead of holding it for the whole stream.
+ */
+static void bench_run(void * p_event_data, uint16_t event_size)
+{
+        ble_gap_addr_t addr;
+        uint8_t        adv[3 + 4 + HRS_BCAST_DATA_LEN];
+        uint32_t       chunk = MIN(m_bench.left, BENCH_CHUNK);
+
+        UNUSED_PARAMETER(p_event_data);
+        UNUSED_PARAMETER(event_size);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+
+        // Flags, then the manufacturer specific data.
+        adv[0] = 2;
+        adv[1] = BLE_GAP_AD_TYPE_FLAGS;
+        adv[2] = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
+        adv[3] = 1 + 2 + HRS_BCAST_DATA_LEN;
+        adv[4] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+        (void)uint16_encode(HRS_BCAST_COMPANY_ID, &adv[5]);
+
+        for (uint32_t i = 0; i < chunk; i++)
+        {
+                uint32_t r      = bench_rand(&m_bench.rand);
+                uint32_t sensor = r % m_bench.sensors;
+                uint32_t start;
+
+                // Sensor addresses follow from their index, the measurement from the report count.
+                (void)uint32_encode(sensor * 0x9E3779B1UL, addr.addr);
+                (void)uint16_encode((uint16_t)(0xC000 | sensor), &addr.addr[4]);
+
+                if ((r >> 16) % BENCH_REPEAT == 0)
+                {
+                        m_bench.seqs[sensor]++;
+                }
+                m_bench.enc.seq = m_bench.seqs[sensor];
+                hrs_bcast_enc_meas(&m_bench.enc, 60 + (r >> 24) % 60, &adv[7]);
+
+                m_bench.now = (m_bench.now + m_bench.step) & APP_TIMER_MAX_CNT_VAL;
+
+                if ((r >> 8) % 100 < BENCH_LOSS_PERCENT)
+                {
+                        continue;
+                }
+
+                start = DWT->CYCCNT;
+                report_handle(&m_bench_table, &addr, -60, adv, sizeof(adv), m_bench.now);
+                start = DWT->CYCCNT - start;
+
+                m_bench.cyc_sum += start;
+                m_bench.cyc_max  = MAX(m_bench.cyc_max, start);
+        }
+        m_bench.left -= chunk;
+
+        if (m_bench.left != 0)
+        {
+                if (app_evt_queue_sched_put(bench_run, NULL, 0) == NRF_SUCCESS)
+                {
+                        return;
+                }
+                NRF_LOG_WARNING("Ingest benchmark stopped, scheduler queue full.");
+        }
+
+        NRF_LOG_INFO("%d cycles per report on average, %d at most, %d sensors in the table.",
+                     (uint32_t)(m_bench.cyc_sum / MAX(1, m_bench_table.stats.reports)),
+                     m_bench.cyc_max, m_bench_table.count);
+        NRF_LOG_INFO("%d aged out, %d refused, longest probe %d.",
+                     m_bench_table.stats.aged, m_bench_table.stats.full, m_bench_table.stats.probes_max);
+
+        m_bench.running = false;
+}
+
+
+ret_code_t bcast_rx_bench(uint32_t sensors, uint32_t reports, uint32_t rate)
+{
+        ret_code_t err_code;
+
+        if ((sensors == 0) || (sensors > BCAST_RX_BENCH_SENSORS_MAX) ||
+            (reports == 0) || (reports > BCAST_RX_BENCH_REPORTS_MAX) || (rate == 0))
+        {
+                return NRF_ERROR_INVALID_PARAM;
+        }
+        if (m_bench.running)
+        {
+                return NRF_ERROR_BUSY;
+        }
+
+        memset(&m_bench, 0, sizeof(m_bench));
+        m_bench.sensors = sensors;
+        m_bench.left    = reports;
+        m_bench.step    = MAX(1, APP_TIMER_TICKS(1000) / rate);
+        m_bench.now     = app_timer_cnt_get();
+        m_bench.rand    = BENCH_SEED;
+        hrs_bcast_enc_init(&m_bench.enc);
+        table_clear(&m_bench_table);
+
+        err_code = app_evt_queue_sched_put(bench_run, NULL, 0);
+        VERIFY_SUCCESS(err_code);
+
+        NRF_LOG_INFO("Ingest benchmark: %d sensors, %d reports at %d/s, table of %d.",
+                     sensors, reports, rate, TABLE_SIZE);
+
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+        m_bench.running = true;
+        return NRF_SUCCESS;
+}
+
+
+/**@brief Function for writing the report from the main loop, where the table is updated. */
+static void report_sched(void * p_event_data, uint16_t event_size)
+{
+        UNUSED_PARAMETER(p_event_data);
+        UNUSED_PARAMETER(event_size);
+
+        bcast_rx_report();
+}
+
+
+static void report_timeout_handler(void * p_context)
+{
+        UNUSED_PARAMETER(p_context);
+
+        // A report that finds the scheduler queue full is skipped, and counted there.
+        UNUSED_RETURN_VALUE(app_evt_queue_sched_put(report_sched, NULL, 0));
+}
+
+
+void bcast_rx_init(void)
+{
+        ret_code_t err_code;
+
+        table_clear(&m_table);
+
+        err_code = app_timer_create(&m_report_timer, APP_TIMER_MODE_REPEATED, report_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = app_timer_start(m_report_timer, REPORT_INTERVAL, NULL);
+        APP_ERROR_CHECK(err_code);
+}
+
+#endif // NRF_MODULE_ENABLED(BCAST_RX)
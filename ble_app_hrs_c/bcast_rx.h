@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup bcast_rx Broadcast receiver
+ * @{
+ * @brief    Follows sensors in broadcast mode from the advertising reports of the scanner.
+ *
+ * @details  Sensors built with HRS_BCAST_ENABLED advertise their measurements, see
+ *           @ref hrs_bcast, and take no connection. Every advertising report that the scan
+ *           filters do not match is checked for a measurement. An open-addressed table of
+ *           2^BCAST_RX_TABLE_BITS slots, keyed by address, keeps the latest measurement, signal
+ *           strength and time of the latest report of each sensor, together with the number of
+ *           measurements received, repeated and missed. Repeated reports of a measurement are
+ *           recognized by its sequence number and only refresh the sensor.
+ *
+ *           Handling a report takes a bounded amount of time whatever the number of sensors: the
+ *           table is filled to three quarters at most, measurements of further sensors are
+ *           refused, and each report checks two slots for sensors not heard from for
+ *           BCAST_RX_TIMEOUT_MS, which are dropped.
+ *
+ *           While the receiver is enabled the scan accepts all advertisers: the whitelist only
+ *           decides which of them the central connects to. Scanning goes on without connecting
+ *           when all central links are up, and the scan interval does not back off.
+ *
+ *           Every BCAST_RX_REPORT_INTERVAL_MS the table is written to the log.
+ *
+ * @note     Compiles to nothing unless BCAST_RX_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef BCAST_RX_H__
+#define BCAST_RX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NRF_MODULE_ENABLED(BCAST_RX)
+
+/**@brief Function for initializing the receiver. */
+void bcast_rx_init(void);
+
+
+/**@brief Function for handling an advertising report, from the main loop.
+ *
+ * @param[in] p_report  Advertising report not matched by the scan filters.
+ */
+void bcast_rx_on_adv_report(ble_gap_evt_adv_report_t const * p_report);
+
+
+/**@brief Function for writing the sensor table to the log. */
+void bcast_rx_report(void);
+
+
+/**@brief Function for measuring the time taken by the handling of advertising reports.
+ *
+ * @details Feeds a stream of synthetic reports, each sensor repeating every measurement a few
+ *          times and some reports lost, through a table of the same size as the receiver's but
+ *          apart from it, and logs the CPU cycles taken per report. The stream is handled from
+ *          the main loop in chunks, the sensors on the air are followed meanwhile.
+ *
+ * @param[in] sensors  Synthetic sensors, at most BCAST_RX_BENCH_SENSORS_MAX.
+ * @param[in] reports  Reports in the stream, at most BCAST_RX_BENCH_REPORTS_MAX.
+ * @param[in] rate     Reports per second, sets the clock seen by the ageing of the table.
+ *
+ * @retval NRF_SUCCESS              If the benchmark was scheduled.
+ * @retval NRF_ERROR_INVALID_PARAM  If a parameter is out of range.
+ * @retval NRF_ERROR_BUSY           If a benchmark is running.
+ * @retval NRF_ERROR_NO_MEM         If the scheduler queue is full.
+ */
+ret_code_t bcast_rx_bench(uint32_t sensors, uint32_t reports, uint32_t rate);
+
+#else
+
+#define bcast_rx_init()
+#define bcast_rx_on_adv_report(_p_report)
+#define bcast_rx_report()
+#define bcast_rx_bench(_sensors, _reports, _rate) NRF_ERROR_NOT_SUPPORTED
+
+#endif // NRF_MODULE_ENABLED(BCAST_RX)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BCAST_RX_H__
+
+/** @} */
@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(EVT_PROF)
+#include <string.h>
+#include "evt_prof.h"
+#include "link_ctx.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+
+#define NRF_LOG_MODULE_NAME evt_prof
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define CYCLES_PER_US           (SystemCoreClock / 1000000)     /**< CPU cycles per microsecond. */
+#define REPORT_INTERVAL         APP_TIMER_TICKS(EVT_PROF_REPORT_INTERVAL_MS)
+
+/**@brief Statistics of one event source. */
+typedef struct
+{
+        uint32_t count;                         /**< Number of handler invocations. */
+        uint32_t max_cyc;                       /**< Longest invocation in cycles. */
+        uint64_t total_cyc;                     /**< Total cycles spent in the handler, nested handlers excluded. */
+        uint32_t hist[EVT_PROF_HIST_BUCKETS];   /**< Latency histogram. */
+} src_stats_t;
+
+/**@brief Statistics of one link slot. */
+typedef struct
+{
+        uint32_t count;                         /**< Number of events handled for the link. */
+        uint64_t total_cyc;                     /**< Total cycles spent on the link. */
+} link_stats_t;
+
+static char const * const m_src_names[EVT_PROF_SRC_COUNT] =
+{
+        "ble", "db_disc", "hrs_c", "bas_c", "nus_c", "uart", "l2cap", "hrt_c"
+};
+
+APP_TIMER_DEF(m_report_timer);                                  /**< Periodic report timer. */
+
+static src_stats_t  m_src_stats[EVT_PROF_SRC_COUNT];            /**< Per-source statistics. */
+static link_stats_t m_link_stats[LINK_CTX_MAX + 1];             /**< Per-slot statistics. The last entry collects events without a link. */
+static uint32_t     m_window_start_cyc;                         /**< Cycle counter at the start of the current window. */
+static uint32_t     m_depth;                                    /**< Handlers running, nested or preempted. */
+static uint32_t     m_child_cyc[EVT_PROF_DEPTH_MAX];            /**< Cycles of the handlers nested in each running handler. */
+
+
+/**@brief Function for mapping a cycle count to a histogram bucket. */
+static uint32_t bucket_get(uint32_t cycles)
+{
+        // Bucket n covers [2^(n+5), 2^(n+6)), bucket 0 everything below 64 cycles.
+        uint32_t log2 = (cycles == 0) ? 0 : (31 - __CLZ(cycles));
+
+        if (log2 < 6)
+        {
+                return 0;
+        }
+        return MIN(log2 - 5, EVT_PROF_HIST_BUCKETS - 1);
+}
+
+
+/**@brief Function for finding the upper bound in cycles of the bucket holding a percentile. */
+static uint32_t percentile_get(src_stats_t const * p_stats, uint32_t permille)
+{
+        uint32_t target = (uint32_t)(((uint64_t)p_stats->count * permille + 999) / 1000);
+        uint32_t seen   = 0;
+
+        for (uint32_t i = 0; i < EVT_PROF_HIST_BUCKETS; i++)
+        {
+                seen += p_stats->hist[i];
+                if (seen >= target)
+                {
+                        return MIN(1UL << (i + 6), p_stats->max_cyc);
+                }
+        }
+        return p_stats->max_cyc;
+}
+
+
+static void report_timeout_handler(void * p_context)
+{
+        UNUSED_PARAMETER(p_context);
+        evt_prof_report();
+}
+
+
+void evt_prof_init(void)
+{
+        ret_code_t err_code;
+
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT       = 0;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+        memset(m_src_stats, 0, sizeof(m_src_stats));
+        memset(m_link_stats, 0, sizeof(m_link_stats));
+        m_window_start_cyc = DWT->CYCCNT;
+        m_depth            = 0;
+
+        err_code = app_timer_create(&m_report_timer, APP_TIMER_MODE_REPEATED, report_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = app_timer_start(m_report_timer, REPORT_INTERVAL, NULL);
+        APP_ERROR_CHECK(err_code);
+}
+
+
+uint32_t evt_prof_enter(void)
+{
+        uint32_t start_cyc;
+
+        CRITICAL_REGION_ENTER();
+
+        if (m_depth < EVT_PROF_DEPTH_MAX)
+        {
+                m_child_cyc[m_depth] = 0;
+        }
+        m_depth++;
+        start_cyc = DWT->CYCCNT;
+
+        CRITICAL_REGION_EXIT();
+
+        return start_cyc;
+}
+
+
+void evt_prof_record(evt_prof_src_t src, uint8_t slot, uint32_t start_cyc)
+{
+        uint32_t link = (slot < LINK_CTX_MAX) ? slot : LINK_CTX_MAX;
+        uint32_t cycles;
+
+        CRITICAL_REGION_ENTER();
+
+        // A handler returns before the one it nests in or preempts, the stack unwinds in order.
+        cycles = DWT->CYCCNT - start_cyc;
+        m_depth--;
+        if ((m_depth > 0) && (m_depth <= EVT_PROF_DEPTH_MAX))
+        {
+                m_child_cyc[m_depth - 1] += cycles;
+        }
+        if (m_depth < EVT_PROF_DEPTH_MAX)
+        {
+                cycles -= MIN(m_child_cyc[m_depth], cycles);
+        }
+
+        src_stats_t * p_stats = &m_src_stats[src];
+
+        p_stats->count++;
+        p_stats->total_cyc += cycles;
+        p_stats->max_cyc    = MAX(p_stats->max_cyc, cycles);
+        p_stats->hist[bucket_get(cycles)]++;
+
+        m_link_stats[link].count++;
+        m_link_stats[link].total_cyc += cycles;
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+void evt_prof_report(void)
+{
+        src_stats_t  src_stats[EVT_PROF_SRC_COUNT];
+        link_stats_t link_stats[LINK_CTX_MAX + 1];
+        uint32_t     window_cyc;
+        uint32_t     links_in_use = 0;
+        uint64_t     link_cyc     = 0;
+
+        // Take a snapshot and start a new window.
+        CRITICAL_REGION_ENTER();
+        memcpy(src_stats, m_src_stats, sizeof(src_stats));
+        memcpy(link_stats, m_link_stats, sizeof(link_stats));
+        memset(m_src_stats, 0, sizeof(m_src_stats));
+        memset(m_link_stats, 0, sizeof(m_link_stats));
+        window_cyc         = DWT->CYCCNT - m_window_start_cyc;
+        m_window_start_cyc = DWT->CYCCNT;
+        CRITICAL_REGION_EXIT();
+
+        if (window_cyc == 0)
+        {
+                return;
+        }
+
+        NRF_LOG_INFO("Event profile over %d ms:", window_cyc / CYCLES_PER_US / 1000);
+
+        for (uint32_t i = 0; i < EVT_PROF_SRC_COUNT; i++)
+        {
+                src_stats_t const * p_stats = &src_stats[i];
+
+                if (p_stats->count == 0)
+                {
+                        continue;
+                }
+
+                NRF_LOG_INFO("  %-8s n=%-6d avg=%d p50<=%d p99<=%d max=%d cyc",
+                             m_src_names[i],
+                             p_stats->count,
+                             (uint32_t)(p_stats->total_cyc / p_stats->count),
+                             percentile_get(p_stats, 500),
+                             percentile_get(p_stats, 990),
+                             p_stats->max_cyc);
+                NRF_LOG_HEXDUMP_DEBUG(p_stats->hist, sizeof(p_stats->hist));
+        }
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                if (link_ctx_in_use(link_ctx_at(i)))
+                {
+                        links_in_use++;
+                }
+                if (link_stats[i].count == 0)
+                {
+                        continue;
+                }
+
+                link_cyc += link_stats[i].total_cyc;
+                NRF_LOG_INFO("  slot %-2d n=%-6d cpu=%d.%02d%%",
+                             i,
+                             link_stats[i].count,
+                             (uint32_t)(link_stats[i].total_cyc * 100 / window_cyc),
+                             (uint32_t)(link_stats[i].total_cyc * 10000 / window_cyc) % 100);
+        }
+
+        NRF_LOG_INFO("  no link  n=%-6d cpu=%d.%02d%%",
+                     link_stats[LINK_CTX_MAX].count,
+                     (uint32_t)(link_stats[LINK_CTX_MAX].total_cyc * 100 / window_cyc),
+                     (uint32_t)(link_stats[LINK_CTX_MAX].total_cyc * 10000 / window_cyc) % 100);
+
+        if (links_in_use != 0)
+        {
+                NRF_LOG_INFO("  %d links, %d us CPU per link per second.",
+                             links_in_use,
+                             (uint32_t)(link_cyc * 1000000 / window_cyc / links_in_use / CYCLES_PER_US));
+        }
+}
+
+#endif // NRF_MODULE_ENABLED(EVT_PROF)
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup evt_prof Event handler profiler
+ * @{
+ * @brief    Cycle-accurate profiling of the collector's event handlers.
+ *
+ * @details  Measures how long each application event handler runs, using the DWT cycle counter,
+ *           and attributes the time to the link the event belongs to. For every event source the
+ *           module keeps a log2 latency histogram, and for every link slot the number of events
+ *           and cycles spent. A report is written to the log periodically, so the CPU time per
+ *           link can be compared between builds with different link counts to catch handlers
+ *           whose cost grows with the number of links.
+ *
+ *           Handlers nest, db_disc_handler calls the collector handlers of the services it
+ *           discovered, and handlers at a lower interrupt priority can be preempted by others.
+ *           The profiler keeps a stack of the handlers running, every handler is charged its own
+ *           cycles only and the cycles of the profiled handlers it calls or that preempt it go
+ *           to those. Interrupts without profiling are charged to the handler they preempt.
+ *
+ * @note     Compiles to nothing unless EVT_PROF_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef EVT_PROF_H__
+#define EVT_PROF_H__
+
+#include <stdint.h>
+#include "nordic_common.h"
+#include "sdk_config.h"
+#include "nrf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVT_PROF_HIST_BUCKETS   16  /**< Number of histogram buckets. Bucket 0 holds events below 64 cycles, bucket n events below 2^(n+6) cycles. */
+#define EVT_PROF_NO_LINK        0xFF /**< Slot value for events that do not belong to a link. */
+#define EVT_PROF_DEPTH_MAX      8    /**< Deepest nesting of handlers whose children are subtracted. */
+
+/**@brief Profiled event sources. */
+typedef enum
+{
+        EVT_PROF_SRC_BLE,           /**< ble_evt_handler. */
+        EVT_PROF_SRC_DB_DISC,       /**< db_disc_handler. */
+        EVT_PROF_SRC_HRS_C,         /**< hrs_c_evt_handler. */
+        EVT_PROF_SRC_BAS_C,         /**< bas_c_evt_handler. */
+        EVT_PROF_SRC_NUS_C,         /**< ble_nus_c_evt_handler. */
+        EVT_PROF_SRC_UART,          /**< uart_line_run. */
+        EVT_PROF_SRC_L2CAP,         /**< l2cap_coc_evt_handler. */
+        EVT_PROF_SRC_HRT_C,         /**< hrt_c_evt_handler. */
+        EVT_PROF_SRC_COUNT
+} evt_prof_src_t;
+
+
+#if NRF_MODULE_ENABLED(EVT_PROF)
+
+/**@brief Function for initializing the profiler and starting the report timer. */
+void evt_prof_init(void);
+
+
+/**@brief Function for entering a handler, one level deeper on the handler stack.
+ *
+ * @return Value of the cycle counter.
+ */
+uint32_t evt_prof_enter(void);
+
+
+/**@brief Function for leaving a handler and recording the invocation.
+ *
+ * @details The cycles of the profiled handlers called or preempting since @ref evt_prof_enter
+ *          are not charged to this one, its whole time is charged as a child to the handler
+ *          below it on the stack.
+ *
+ * @param[in] src         Event source.
+ * @param[in] slot        Link context slot, or @ref EVT_PROF_NO_LINK.
+ * @param[in] start_cyc   Value returned by @ref evt_prof_enter.
+ */
+void evt_prof_record(evt_prof_src_t src, uint8_t slot, uint32_t start_cyc);
+
+
+/**@brief Function for writing the collected statistics to the log and starting a new window. */
+void evt_prof_report(void);
+
+
+/**@brief Macro for taking the handler entry timestamp. */
+#define EVT_PROF_BEGIN()            uint32_t evt_prof_start_cyc__ = evt_prof_enter()
+
+/**@brief Macro for recording the handler invocation started with @ref EVT_PROF_BEGIN. */
+#define EVT_PROF_END(_src, _slot)   evt_prof_record((_src), (_slot), evt_prof_start_cyc__)
+
+#else
+
+#define evt_prof_init()
+#define evt_prof_report()
+#define EVT_PROF_BEGIN()
+#define EVT_PROF_END(_src, _slot)
+
+#endif // NRF_MODULE_ENABLED(EVT_PROF)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVT_PROF_H__
+
+/** @} */
@@ -0,0 +1,582 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(HRV)
+#include <stdlib.h>
+#include <string.h>
+#include "hrv.h"
+#include "nrf.h"
+
+#define NRF_LOG_MODULE_NAME hrv
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RR_MIN              ((300 * 1024) / 1000)                       /**< Shortest RR interval kept, in 1/1024 seconds. */
+#define RR_MAX              ((2000 * 1024) / 1000)                      /**< Longest RR interval kept, in 1/1024 seconds. */
+#define STEP                (1024 / HRV_FS_HZ)                          /**< Resampling period in 1/1024 seconds. */
+#define TABLE_LEN           512                                         /**< Angle steps per turn of the sine table. */
+
+/**@brief First FFT bin at or above a frequency given in mHz. */
+#define BIN(_mhz)           (((_mhz) * HRV_FFT_LEN + HRV_FS_HZ * 1000 - 1) / (HRV_FS_HZ * 1000))
+
+#define LF_FIRST            BIN(40)                                     /**< First bin of the LF band. */
+#define HF_FIRST            BIN(150)                                    /**< First bin of the HF band, one past the LF band. */
+#define HF_END              BIN(400)                                    /**< One past the HF band. */
+
+/**@brief Packs two 16-bit values into a word, the first one in the low half. */
+#define PACK(_lo, _hi)      (((uint32_t)(uint16_t)(_lo)) | ((uint32_t)(uint16_t)(_hi) << 16))
+#define RE(_x)              ((int16_t)((_x) & 0xFFFF))                  /**< Real part of a packed complex sample. */
+#define IM(_x)              ((int16_t)((_x) >> 16))                     /**< Imaginary part of a packed complex sample. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(HRV_FFT_LEN) && (HRV_FFT_LEN <= TABLE_LEN));
+STATIC_ASSERT((HRV_WINDOW >= 2) && (HRV_WINDOW <= 1024));
+
+/**@brief Statistics shared by all links. */
+typedef struct
+{
+        uint32_t rr_count;          /**< RR intervals added. */
+        uint32_t rr_cycles;         /**< CPU cycles spent adding them, spectra excluded. */
+        uint32_t spectra;           /**< Spectra computed. */
+        uint32_t spectrum_cycles;   /**< CPU cycles spent on the last spectrum. */
+        uint32_t spectrum_max;      /**< Most CPU cycles spent on one spectrum. */
+} hrv_stats_t;
+
+/* sin(pi / 2 * i / 128) in Q15, a quarter turn of the TABLE_LEN steps. */
+static const int16_t m_sin_q15[TABLE_LEN / 4 + 1] =
+{
+            0,   402,   804,  1206,  1608,  2009,  2410,  2811,  3212,  3612,  4011,  4410,
+         4808,  5205,  5602,  5998,  6393,  6786,  7179,  7571,  7962,  8351,  8739,  9126,
+         9512,  9896, 10278, 10659, 11039, 11417, 11793, 12167, 12539, 12910, 13279, 13645,
+        14010, 14372, 14732, 15090, 15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+        18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475, 20787, 21096, 21403, 21705,
+        22005, 22301, 22594, 22884, 23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+        25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019, 27245, 27466, 27683, 27896,
+        28105, 28310, 28510, 28706, 28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+        30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237, 31356, 31470, 31580, 31685,
+        31785, 31880, 31971, 32057, 32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+        32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765, 32767,
+};
+
+static uint32_t    m_fft[HRV_FFT_LEN];  /**< FFT buffer, complex samples packed with the real part in the low half. */
+static hrv_stats_t m_stats;             /**< Statistics. */
+
+
+/**@brief Function for the sine of an angle.
+ *
+ * @param[in] k  Angle in 1/TABLE_LEN turns.
+ *
+ * @return Sine in Q15.
+ */
+static int16_t sin_q15(uint32_t k)
+{
+        uint32_t r = k % (TABLE_LEN / 4);
+
+        switch ((k / (TABLE_LEN / 4)) % 4)
+        {
+                case 0:
+                        return m_sin_q15[r];
+                case 1:
+                        return m_sin_q15[TABLE_LEN / 4 - r];
+                case 2:
+                        return -m_sin_q15[r];
+                default:
+                        return -m_sin_q15[TABLE_LEN / 4 - r];
+        }
+}
+
+
+/**@brief Function for the cosine of an angle.
+ *
+ * @param[in] k  Angle in 1/TABLE_LEN turns.
+ *
+ * @return Cosine in Q15.
+ */
+static __INLINE int16_t cos_q15(uint32_t k)
+{
+        return sin_q15(k + TABLE_LEN / 4);
+}
+
+
+/**@brief Function for multiplying two packed complex Q15 samples.
+ *
+ * @param[in] w  First factor.
+ * @param[in] x  Second factor.
+ *
+ * @return Product, packed.
+ */
+static __INLINE uint32_t cmul_q15(uint32_t w, uint32_t x)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        int32_t re = (int32_t)__SMUSD(w, x) >> 15;
+        int32_t im = (int32_t)__SMUADX(w, x) >> 15;
+
+        return __PKHBT((uint32_t)re, (uint32_t)im, 16);
+#else
+        int32_t re = ((int32_t)RE(w) * RE(x) - (int32_t)IM(w) * IM(x)) >> 15;
+        int32_t im = ((int32_t)RE(w) * IM(x) + (int32_t)IM(w) * RE(x)) >> 15;
+
+        return PACK(re, im);
+#endif
+}
+
+
+/**@brief Function for the halved sum of two packed complex samples. */
+static __INLINE uint32_t hadd(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return __SHADD16(a, b);
+#else
+        return PACK(((int32_t)RE(a) + RE(b)) >> 1, ((int32_t)IM(a) + IM(b)) >> 1);
+#endif
+}
+
+
+/**@brief Function for the halved difference of two packed complex samples. */
+static __INLINE uint32_t hsub(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return __SHSUB16(a, b);
+#else
+        return PACK(((int32_t)RE(a) - RE(b)) >> 1, ((int32_t)IM(a) - IM(b)) >> 1);
+#endif
+}
+
+
+/**@brief Function for accumulating the squared magnitude of a packed complex sample.
+ *
+ * @param[in] x    Sample.
+ * @param[in] acc  Accumulator.
+ *
+ * @return acc + re^2 + im^2.
+ */
+static __INLINE uint64_t mag_sq_acc(uint32_t x, uint64_t acc)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return (uint64_t)__SMLALD(x, x, (int64_t)acc);
+#else
+        return acc + (uint64_t)((int32_t)RE(x) * RE(x)) + (uint64_t)((int32_t)IM(x) * IM(x));
+#endif
+}
+
+
+/**@brief Function for the integer square root, rounded to the nearest.
+ *
+ * @param[in] v  Value.
+ *
+ * @return sqrt(v), rounded.
+ */
+static uint32_t isqrt(uint64_t v)
+{
+        uint64_t root = 0;
+        uint64_t bit  = 1ULL << 62;
+
+        while (bit > v)
+        {
+                bit >>= 2;
+        }
+        while (bit != 0)
+        {
+                if (v >= root + bit)
+                {
+                        v    -= root + bit;
+                        root  = (root >> 1) + bit;
+                }
+                else
+                {
+                        root >>= 1;
+                }
+                bit >>= 2;
+        }
+
+        // v is now v - root^2, above root means sqrt(v) >= root + 1/2.
+        return (uint32_t)((v > root) ? root + 1 : root);
+}
+
+
+/**@brief Function for the in-place FFT of the buffer, scaled by 1 / HRV_FFT_LEN.
+ *
+ * @details Radix-2, decimation in time. Every stage halves its outputs, so the magnitudes never
+ *          grow and the input can use the full Q15 range but one bit.
+ */
+static void fft(void)
+{
+        // Bit reversed order.
+        for (uint32_t i = 1, j = 0; i < HRV_FFT_LEN; i++)
+        {
+                uint32_t bit = HRV_FFT_LEN >> 1;
+
+                for (; (j & bit) != 0; bit >>= 1)
+                {
+                        j ^= bit;
+                }
+                j ^= bit;
+
+                if (i < j)
+                {
+                        uint32_t tmp = m_fft[i];
+
+                        m_fft[i] = m_fft[j];
+                        m_fft[j] = tmp;
+                }
+        }
+
+        for (uint32_t size = 2; size <= HRV_FFT_LEN; size <<= 1)
+        {
+                uint32_t half = size / 2;
+                uint32_t step = TABLE_LEN / size;
+
+                for (uint32_t k = 0; k < half; k++)
+                {
+                        // exp(-2 pi j k / size)
+                        uint32_t w = PACK(cos_q15(k * step), -sin_q15(k * step));
+
+                        for (uint32_t i = k; i < HRV_FFT_LEN; i += size)
+                        {
+                                uint32_t a = m_fft[i];
+                                uint32_t t = cmul_q15(w, m_fft[i + half]);
+
+                                m_fft[i]        = hadd(a, t);
+                                m_fft[i + half] = hsub(a, t);
+                        }
+                }
+        }
+}
+
+
+/**@brief Function for getting an RR interval of the ring, counting back from the newest.
+ *
+ * @param[in] p_hrv  Link state.
+ * @param[in] back   0 for the newest.
+ *
+ * @return RR interval.
+ */
+static __INLINE int32_t rr_back(hrv_t const * p_hrv, uint32_t back)
+{
+        return p_hrv->rr[(p_hrv->head + HRV_WINDOW - 1 - back) % HRV_WINDOW];
+}
+
+
+/**@brief Function for resampling the tachogram at HRV_FS_HZ into the FFT buffer.
+ *
+ * @details The samples go back in time from the newest beat and are stored at the end of the
+ *          buffer. The rest of the buffer is zeroed.
+ *
+ * @param[in] p_hrv  Link state.
+ *
+ * @return Number of samples.
+ */
+static uint32_t resample(hrv_t const * p_hrv)
+{
+        uint32_t b   = 0;           // Beat ending the interval the sample falls in.
+        int32_t  t_b = 0;           // Time of beat b, relative to the newest.
+        uint32_t n;
+
+        memset(m_fft, 0, sizeof(m_fft));
+
+        for (n = 0; n < HRV_FFT_LEN; n++)
+        {
+                int32_t t = -(int32_t)(n * STEP);
+                int32_t len;
+                int32_t v;
+
+                while (t < t_b - rr_back(p_hrv, b))
+                {
+                        t_b -= rr_back(p_hrv, b);
+                        b++;
+                        if (b + 1 >= p_hrv->count)
+                        {
+                                return n;
+                        }
+                }
+
+                // Between beat b + 1, whose RR interval ends at t_b - len, and beat b at t_b.
+                len = rr_back(p_hrv, b);
+                v   = rr_back(p_hrv, b + 1)
+                      + ((rr_back(p_hrv, b) - rr_back(p_hrv, b + 1)) * (t - (t_b - len))) / len;
+
+                m_fft[HRV_FFT_LEN - 1 - n] = PACK(v, 0);
+        }
+
+        return n;
+}
+
+
+/**@brief Function for computing the LF and HF powers of a link.
+ *
+ * @param[in] p_hrv  Link state.
+ */
+static void spectrum_compute(hrv_t * p_hrv)
+{
+        uint32_t n     = resample(p_hrv);
+        uint32_t first = HRV_FFT_LEN - n;
+        int32_t  sum   = 0;
+        int32_t  mean;
+        int32_t  peak  = 0;
+        uint32_t shift = 0;
+        uint64_t w_sq  = 0;
+        uint64_t lf    = 0;
+        uint64_t hf    = 0;
+        float    scale;
+
+        if (n < HRV_FFT_LEN / 2)
+        {
+                p_hrv->spectrum_valid = false;
+                return;
+        }
+
+        for (uint32_t i = first; i < HRV_FFT_LEN; i++)
+        {
+                sum += RE(m_fft[i]);
+        }
+        mean = sum / (int32_t)n;
+
+        for (uint32_t i = first; i < HRV_FFT_LEN; i++)
+        {
+                int32_t v = RE(m_fft[i]) - mean;
+
+                m_fft[i] = PACK(v, 0);
+                peak     = MAX(peak, (v < 0) ? -v : v);
+        }
+
+        // Scale up to just below 2^14, the FFT halves every stage.
+        while ((peak != 0) && ((peak << (shift + 1)) < (1 << 14)))
+        {
+                shift++;
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+                // Hann window over the n samples.
+                int32_t w = (32767 - cos_q15((i * TABLE_LEN) / (n - 1))) >> 1;
+                int32_t v = (int32_t)RE(m_fft[first + i]) << shift;
+
+                m_fft[first + i] = PACK((v * w) >> 15, 0);
+                w_sq            += (uint64_t)(w * w);
+        }
+
+        fft();
+
+        for (uint32_t k = LF_FIRST; k < HF_FIRST; k++)
+        {
+                lf = mag_sq_acc(m_fft[k], lf);
+        }
+        for (uint32_t k = HF_FIRST; k < HF_END; k++)
+        {
+                hf = mag_sq_acc(m_fft[k], hf);
+        }
+
+        // One-sided band power of the windowed periodogram, 2 N sum|X/N|^2 / sum(w^2), back from
+        // the scaled Q15 input to 1/1024 seconds and then to milliseconds.
+        scale = (2.0f * HRV_FFT_LEN * (float)(1UL << 30)) / (float)w_sq
+                / (float)(1UL << (2 * shift))
+                * (1000.0f / 1024.0f) * (1000.0f / 1024.0f);
+
+        p_hrv->lf             = (uint32_t)((float)lf * scale + 0.5f);
+        p_hrv->hf             = (uint32_t)((float)hf * scale + 0.5f);
+        p_hrv->spectrum_valid = true;
+}
+
+
+/**@brief Function for adding a squared successive difference to the window, or removing it.
+ *
+ * @param[in] p_hrv  Link state.
+ * @param[in] d      Difference in 1/1024 seconds.
+ * @param[in] add    True to add, false to remove.
+ */
+static void diff_update(hrv_t * p_hrv, int32_t d, bool add)
+{
+        uint32_t d_sq  = (uint32_t)(d * d);
+        bool     nn50  = ((uint32_t)abs(d) * 1000 > 50 * 1024);
+
+        if (add)
+        {
+                p_hrv->diff_sq += d_sq;
+                p_hrv->nn50    += nn50 ? 1 : 0;
+        }
+        else
+        {
+                p_hrv->diff_sq -= d_sq;
+                p_hrv->nn50    -= nn50 ? 1 : 0;
+        }
+}
+
+
+/**@brief Function for adding one RR interval to the window.
+ *
+ * @param[in] p_hrv  Link state.
+ * @param[in] rr     RR interval in 1/1024 seconds.
+ */
+static void rr_push(hrv_t * p_hrv, uint16_t rr)
+{
+        if (p_hrv->count == HRV_WINDOW)
+        {
+                // The oldest goes, with its difference to the next one.
+                uint16_t oldest = p_hrv->rr[p_hrv->head];
+                uint16_t next   = p_hrv->rr[(p_hrv->head + 1) % HRV_WINDOW];
+
+                p_hrv->sum    -= oldest;
+                p_hrv->sum_sq -= (uint32_t)oldest * oldest;
+                diff_update(p_hrv, (int32_t)next - oldest, false);
+                p_hrv->count--;
+        }
+
+        if (p_hrv->count != 0)
+        {
+                diff_update(p_hrv, (int32_t)rr - rr_back(p_hrv, 0), true);
+        }
+
+        p_hrv->rr[p_hrv->head] = rr;
+        p_hrv->head            = (p_hrv->head + 1) % HRV_WINDOW;
+        p_hrv->count++;
+        p_hrv->sum            += rr;
+        p_hrv->sum_sq         += (uint32_t)rr * rr;
+}
+
+
+void hrv_init(void)
+{
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+        memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+void hrv_reset(hrv_t * p_hrv)
+{
+        memset(p_hrv, 0, sizeof(hrv_t));
+}
+
+
+bool hrv_rr_add(hrv_t * p_hrv, uint16_t const * p_rr, uint16_t count)
+{
+        uint32_t start_cyc = DWT->CYCCNT;
+
+        for (uint16_t i = 0; i < count; i++)
+        {
+                if ((p_rr[i] < RR_MIN) || (p_rr[i] > RR_MAX))
+                {
+                        p_hrv->rejected++;
+                        continue;
+                }
+
+                rr_push(p_hrv, p_rr[i]);
+                p_hrv->since_spectrum++;
+        }
+
+        m_stats.rr_count  += count;
+        m_stats.rr_cycles += DWT->CYCCNT - start_cyc;
+
+        if (p_hrv->since_spectrum < HRV_SPECTRUM_INTERVAL)
+        {
+                return false;
+        }
+
+        start_cyc = DWT->CYCCNT;
+
+        spectrum_compute(p_hrv);
+        p_hrv->since_spectrum = 0;
+
+        m_stats.spectra++;
+        m_stats.spectrum_cycles = DWT->CYCCNT - start_cyc;
+        m_stats.spectrum_max    = MAX(m_stats.spectrum_max, m_stats.spectrum_cycles);
+
+        return true;
+}
+
+
+void hrv_metrics_get(hrv_t const * p_hrv, hrv_metrics_t * p_metrics)
+{
+        uint32_t n = p_hrv->count;
+
+        memset(p_metrics, 0, sizeof(hrv_metrics_t));
+
+        p_metrics->count          = (uint16_t)n;
+        p_metrics->spectrum_valid = p_hrv->spectrum_valid;
+        p_metrics->lf_ms2         = p_hrv->lf;
+        p_metrics->hf_ms2         = p_hrv->hf;
+
+        if (n < 2)
+        {
+                return;
+        }
+
+        // Sample variance and mean squared difference, from (1/1024 s)^2 to (1/16 ms)^2 with a
+        // single rounded division each, so that only the last step rounds to milliseconds. The
+        // products stay below 2^63 up to the largest window.
+        uint64_t var_den = 16384ULL * n * (n - 1);
+        uint64_t msd_den = 16384ULL * (n - 1);
+        uint64_t var     = ((((uint64_t)n * p_hrv->sum_sq - (uint64_t)p_hrv->sum * p_hrv->sum) * 15625 << 8)
+                            + var_den / 2) / var_den;
+        uint64_t msd     = (((p_hrv->diff_sq * 15625) << 8) + msd_den / 2) / msd_den;
+
+        p_metrics->sdnn_ms  = (uint16_t)((isqrt(var) + 8) >> 4);
+        p_metrics->rmssd_ms = (uint16_t)((isqrt(msd) + 8) >> 4);
+        p_metrics->pnn50_pm = (uint16_t)((p_hrv->nn50 * 1000 + (n - 1) / 2) / (n - 1));
+}
+
+
+void hrv_log(hrv_t const * p_hrv, uint8_t slot)
+{
+        hrv_metrics_t metrics;
+
+        hrv_metrics_get(p_hrv, &metrics);
+
+        NRF_LOG_INFO("HRV slot %d: %d RR, SDNN %d ms, RMSSD %d ms, pNN50 %d.%d %%.",
+                     slot, metrics.count, metrics.sdnn_ms, metrics.rmssd_ms,
+                     metrics.pnn50_pm / 10, metrics.pnn50_pm % 10);
+        if (metrics.spectrum_valid)
+        {
+                uint32_t ratio = (metrics.hf_ms2 == 0) ? 0 : (100 * metrics.lf_ms2 / metrics.hf_ms2);
+
+                NRF_LOG_INFO("HRV slot %d: LF %d ms2, HF %d ms2, LF/HF %d.%02d.",
+                             slot, metrics.lf_ms2, metrics.hf_ms2, ratio / 100, ratio % 100);
+        }
+        else
+        {
+                NRF_LOG_INFO("HRV slot %d: spectrum needs %d s of RR intervals.",
+                             slot, HRV_FFT_LEN / HRV_FS_HZ / 2);
+        }
+        NRF_LOG_INFO("HRV cost: %d cycles per RR interval, %d cycles per spectrum (max %d), %d rejected.",
+                     (m_stats.rr_count == 0) ? 0 : (m_stats.rr_cycles / m_stats.rr_count),
+                     m_stats.spectrum_cycles, m_stats.spectrum_max, p_hrv->rejected);
+}
+
+#endif // NRF_MODULE_ENABLED(HRV)
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup hrv Heart rate variability
+ * @{
+ * @brief    Streaming heart rate variability metrics of one link.
+ *
+ * @details  Every link keeps its last HRV_WINDOW RR intervals. The time domain metrics are kept
+ *           over that window with exact integer running sums, updated in constant time per RR
+ *           interval:
+ *           - SDNN, the standard deviation of the RR intervals.
+ *           - RMSSD, the root mean square of the successive differences.
+ *           - pNN50, the share of successive differences above 50 ms.
+ *
+ *           Every HRV_SPECTRUM_INTERVAL RR intervals the frequency domain metrics are computed
+ *           again:
+ *           1. The tachogram is resampled at @ref HRV_FS_HZ by linear interpolation, over the
+ *              last @ref HRV_FFT_LEN / HRV_FS_HZ seconds.
+ *           2. Its mean is removed and a Hann window is applied.
+ *           3. A Q15 radix-2 FFT follows, with a halving of every stage.
+ *           4. The power is summed over the LF band, 0.04 to 0.15 Hz, and over the HF band, 0.15
+ *              to 0.4 Hz.
+ *
+ *           The spectrum needs at least half of the window covered. With fewer beats the
+ *           frequency domain metrics are not valid.
+ *
+ *           The FFT works on complex samples packed in one word. On a Cortex-M4 the butterflies
+ *           and the band sums use its dual 16-bit instructions. Other targets use the same
+ *           arithmetic in plain C.
+ *
+ *           RR intervals outside 300 to 2000 ms are dropped.
+ *
+ *           RAM cost: 2 * HRV_WINDOW + 48 bytes per link, plus 4 * HRV_FFT_LEN bytes of shared
+ *           FFT buffer.
+ *
+ * @note     Compiles to nothing unless HRV_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef HRV_H__
+#define HRV_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HRV_FS_HZ               4       /**< Resampling rate of the tachogram. */
+#define HRV_FFT_LEN             512     /**< FFT length, 128 seconds at HRV_FS_HZ. */
+
+/**@brief Metrics of one link. */
+typedef struct
+{
+        uint16_t count;             /**< RR intervals in the window. */
+        uint16_t sdnn_ms;           /**< SDNN in milliseconds. */
+        uint16_t rmssd_ms;          /**< RMSSD in milliseconds. */
+        uint16_t pnn50_pm;          /**< pNN50 in per mille. */
+        bool     spectrum_valid;    /**< True once the window covers enough time for the spectrum. */
+        uint32_t lf_ms2;            /**< LF power in ms^2. */
+        uint32_t hf_ms2;            /**< HF power in ms^2. */
+} hrv_metrics_t;
+
+/**@brief State of one link. */
+typedef struct
+{
+        uint16_t rr[HRV_WINDOW];    /**< RR intervals in 1/1024 seconds, ring. */
+        uint16_t head;              /**< Ring index of the next RR interval. */
+        uint16_t count;             /**< RR intervals in the ring. */
+        uint16_t nn50;              /**< Successive differences above 50 ms in the window. */
+        uint16_t since_spectrum;    /**< RR intervals added since the spectrum was computed. */
+        uint32_t sum;               /**< Sum of the RR intervals in the window. */
+        uint64_t sum_sq;            /**< Sum of their squares. */
+        uint64_t diff_sq;           /**< Sum of the squared successive differences. */
+        uint32_t lf;                /**< LF power in ms^2, from the last spectrum. */
+        uint32_t hf;                /**< HF power in ms^2, from the last spectrum. */
+        bool     spectrum_valid;    /**< True if lf and hf are valid. */
+        uint32_t rejected;          /**< RR intervals out of range. */
+} hrv_t;
+
+
+#if NRF_MODULE_ENABLED(HRV)
+
+/**@brief Function for initializing the module. Enables the DWT cycle counter used for the
+ *        statistics.
+ */
+void hrv_init(void);
+
+
+/**@brief Function for clearing the state of a link, when it is established.
+ *
+ * @param[out] p_hrv  Link state.
+ */
+void hrv_reset(hrv_t * p_hrv);
+
+
+/**@brief Function for adding RR intervals.
+ *
+ * @details Computes the spectrum again once HRV_SPECTRUM_INTERVAL intervals have been added
+ *          since the last time.
+ *
+ * @param[in] p_hrv  Link state.
+ * @param[in] p_rr   RR intervals in 1/1024 seconds.
+ * @param[in] count  Number of RR intervals.
+ *
+ * @return True if the spectrum was computed.
+ */
+bool hrv_rr_add(hrv_t * p_hrv, uint16_t const * p_rr, uint16_t count);
+
+
+/**@brief Function for getting the metrics of a link.
+ *
+ * @param[in]  p_hrv      Link state.
+ * @param[out] p_metrics  Metrics.
+ */
+void hrv_metrics_get(hrv_t const * p_hrv, hrv_metrics_t * p_metrics);
+
+
+/**@brief Function for logging the metrics of a link and the cycles spent on them.
+ *
+ * @param[in] p_hrv  Link state.
+ * @param[in] slot   Link context slot, for the log.
+ */
+void hrv_log(hrv_t const * p_hrv, uint8_t slot);
+
+#endif // NRF_MODULE_ENABLED(HRV)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HRV_H__
+
+/** @} */
@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(LAT_PROBE)
+#include <string.h>
+#include "lat_probe.h"
+#include "link_ctx.h"
+#include "nus_mux.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+
+#define NRF_LOG_MODULE_NAME lat_probe
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define PROBE_INTERVAL          APP_TIMER_TICKS(LAT_PROBE_INTERVAL_MS)
+#define PROBES_PER_REPORT       MAX(1, LAT_PROBE_REPORT_INTERVAL_MS / LAT_PROBE_INTERVAL_MS)
+
+#define TICKS_TO_US(_ticks)     ((uint32_t)(((uint64_t)(_ticks) * 1000000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+#define OCTAVE_MIN              8       /**< Bucket 1 starts at 2^OCTAVE_MIN us. */
+#define SUB_BUCKETS_LOG2        2       /**< Four buckets per octave. */
+
+// A probe fits the smallest packet, 20 bytes at the default ATT MTU.
+STATIC_ASSERT(LAT_PROBE_HDR_LEN + NUS_MUX_HDR_LEN <= BLE_GATT_ATT_MTU_DEFAULT - 3);
+
+/**@brief Statistics of one link slot. */
+typedef struct
+{
+        uint32_t sent;                          /**< Probes queued. */
+        uint32_t rcvd;                          /**< Echoes received. */
+        uint32_t max_us;                        /**< Longest round trip. */
+        uint32_t min_us;                        /**< Shortest round trip. */
+        uint64_t total_us;                      /**< Sum of the round trips. */
+        uint16_t hist[LAT_PROBE_HIST_BUCKETS];  /**< Round trip histogram. */
+} link_stats_t;
+
+APP_TIMER_DEF(m_probe_timer);                                   /**< Probe timer. */
+
+static link_stats_t m_link_stats[LINK_CTX_MAX];                 /**< Per-slot statistics. */
+static uint16_t     m_seq[LINK_CTX_MAX];                        /**< Next sequence number per slot. */
+static uint16_t     m_size;                                     /**< Length of the probes. */
+static uint8_t      m_session;                                  /**< Changed on every start, echoes of older sessions are ignored. */
+static uint32_t     m_probes_left;                              /**< Probe rounds left until the next report. */
+static bool         m_running;                                  /**< True while probes are sent. */
+
+
+/**@brief Function for mapping a round trip to a histogram bucket. */
+static uint32_t bucket_get(uint32_t us)
+{
+        uint32_t log2;
+        uint32_t sub;
+
+        if (us < (1UL << OCTAVE_MIN))
+        {
+                return 0;
+        }
+
+        // The two bits below the leading one select the bucket within the octave.
+        log2 = 31 - __CLZ(us);
+        sub  = (us >> (log2 - SUB_BUCKETS_LOG2)) & ((1UL << SUB_BUCKETS_LOG2) - 1);
+
+        return MIN(1 + ((log2 - OCTAVE_MIN) << SUB_BUCKETS_LOG2) + sub, LAT_PROBE_HIST_BUCKETS - 1);
+}
+
+
+/**@brief Function for getting the upper bound in microseconds of a histogram bucket. */
+static uint32_t bucket_limit_get(uint32_t bucket)
+{
+        uint32_t octave;
+        uint32_t sub;
+
+        if (bucket == 0)
+        {
+                return 1UL << OCTAVE_MIN;
+        }
+
+        octave = OCTAVE_MIN + ((bucket - 1) >> SUB_BUCKETS_LOG2);
+        sub    = (bucket - 1) & ((1UL << SUB_BUCKETS_LOG2) - 1);
+
+        return ((1UL << SUB_BUCKETS_LOG2) + sub + 1) << (octave - SUB_BUCKETS_LOG2);
+}
+
+
+/**@brief Function for finding the upper bound in microseconds of the bucket holding a percentile. */
+static uint32_t percentile_get(link_stats_t const * p_stats, uint32_t permille)
+{
+        uint32_t target = (uint32_t)(((uint64_t)p_stats->rcvd * permille + 999) / 1000);
+        uint32_t seen   = 0;
+
+        for (uint32_t i = 0; i < LAT_PROBE_HIST_BUCKETS; i++)
+        {
+                seen += p_stats->hist[i];
+                if (seen >= target)
+                {
+                        return MIN(bucket_limit_get(i), p_stats->max_us);
+                }
+        }
+        return p_stats->max_us;
+}
+
+
+/**@brief Function for clearing the statistics of a slot. Call with interrupts masked. */
+static void link_stats_clear(uint8_t slot)
+{
+        memset(&m_link_stats[slot], 0, sizeof(m_link_stats[slot]));
+        m_link_stats[slot].min_us = UINT32_MAX;
+}
+
+
+/**@brief Function for sending a probe to a link.
+ *
+ * @param[in] p_link  Link to send to.
+ */
+static void probe_send(link_ctx_t * p_link)
+{
+        uint8_t    probe[NUS_MUX_PACKET_MAX];
+        uint16_t   len;
+        uint32_t   now = app_timer_cnt_get();
+        ret_code_t err_code;
+
+        // The receiver does not reassemble, a probe must fit one packet.
+        len = MIN(m_size, p_link->mux.payload_max - NUS_MUX_HDR_LEN);
+
+        memset(probe, 0, len);
+        probe[0] = NUS_MUX_OP_PING;
+        probe[1] = m_session;
+        (void)uint16_encode(m_seq[p_link->slot], &probe[2]);
+        (void)uint32_encode(now, &probe[4]);
+
+        err_code = nus_mux_send(&p_link->mux, NUS_MUX_CH_CTRL, probe, len, true);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_DEBUG("Probe to link 0x%x not queued: 0x%x.", p_link->conn_handle, err_code);
+                return;
+        }
+
+        CRITICAL_REGION_ENTER();
+        m_seq[p_link->slot]++;
+        m_link_stats[p_link->slot].sent++;
+        CRITICAL_REGION_EXIT();
+}
+
+
+static void probe_timeout_handler(void * p_context)
+{
+        UNUSED_PARAMETER(p_context);
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_ctx_t * p_link = link_ctx_at(i);
+
+                // Only links that have found the service can echo.
+                if (link_ctx_in_use(p_link) &&
+                    (p_link->nus_c.handles.nus_rx_handle != BLE_GATT_HANDLE_INVALID))
+                {
+                        probe_send(p_link);
+                }
+        }
+
+        if (--m_probes_left == 0)
+        {
+                m_probes_left = PROBES_PER_REPORT;
+                lat_probe_report();
+        }
+}
+
+
+void lat_probe_init(void)
+{
+        ret_code_t err_code;
+
+        for (uint8_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_stats_clear(i);
+                m_seq[i] = 0;
+        }
+        m_size    = LAT_PROBE_HDR_LEN;
+        m_session = 0;
+        m_running = false;
+
+        err_code = app_timer_create(&m_probe_timer, APP_TIMER_MODE_REPEATED, probe_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+}
+
+
+ret_code_t lat_probe_start(uint16_t size)
+{
+        ret_code_t err_code;
+
+        if ((size < LAT_PROBE_HDR_LEN) || (size > NUS_MUX_PACKET_MAX - NUS_MUX_HDR_LEN))
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        if (m_running)
+        {
+                lat_probe_stop();
+        }
+
+        CRITICAL_REGION_ENTER();
+        for (uint8_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_stats_clear(i);
+        }
+        m_size        = size;
+        m_session++;
+        m_probes_left = PROBES_PER_REPORT;
+        m_running     = true;
+        CRITICAL_REGION_EXIT();
+
+        err_code = app_timer_start(m_probe_timer, PROBE_INTERVAL, NULL);
+        APP_ERROR_CHECK(err_code);
+
+        NRF_LOG_INFO("Latency probe started, %d byte probes every %d ms.", size, LAT_PROBE_INTERVAL_MS);
+
+        return NRF_SUCCESS;
+}
+
+
+void lat_probe_stop(void)
+{
+        ret_code_t err_code;
+
+        if (!m_running)
+        {
+                return;
+        }
+
+        err_code = app_timer_stop(m_probe_timer);
+        APP_ERROR_CHECK(err_code);
+
+        m_running = false;
+        lat_probe_report();
+
+        NRF_LOG_INFO("Latency probe stopped.");
+}
+
+
+bool lat_probe_is_running(void)
+{
+        return m_running;
+}
+
+
+void lat_probe_link_reset(uint8_t slot)
+{
+        if (slot >= LINK_CTX_MAX)
+        {
+                return;
+        }
+
+        CRITICAL_REGION_ENTER();
+        link_stats_clear(slot);
+        m_seq[slot] = 0;
+        CRITICAL_REGION_EXIT();
+}
+
+
+void lat_probe_on_pong(uint8_t slot, uint8_t const * p_data, uint16_t len)
+{
+        uint32_t rtt_us;
+
+        if ((slot >= LINK_CTX_MAX) || (len < LAT_PROBE_HDR_LEN) || (p_data[1] != m_session))
+        {
+                return;
+        }
+
+        rtt_us = TICKS_TO_US(app_timer_cnt_diff_compute(app_timer_cnt_get(), uint32_decode(&p_data[4])));
+
+        CRITICAL_REGION_ENTER();
+
+        link_stats_t * p_stats = &m_link_stats[slot];
+
+        // The window may have been restarted after the probe was sent.
+        if (p_stats->rcvd < p_stats->sent)
+        {
+                p_stats->rcvd++;
+                p_stats->total_us += rtt_us;
+                p_stats->max_us    = MAX(p_stats->max_us, rtt_us);
+                p_stats->min_us    = MIN(p_stats->min_us, rtt_us);
+                if (p_stats->hist[bucket_get(rtt_us)] < UINT16_MAX)
+                {
+                        p_stats->hist[bucket_get(rtt_us)]++;
+                }
+        }
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+void lat_probe_report(void)
+{
+        link_stats_t stats[LINK_CTX_MAX];
+
+        // Take a snapshot and start a new window. Probes in flight are carried over.
+        CRITICAL_REGION_ENTER();
+        memcpy(stats, m_link_stats, sizeof(stats));
+        for (uint8_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_stats_clear(i);
+                m_link_stats[i].sent = stats[i].sent - stats[i].rcvd;
+        }
+        CRITICAL_REGION_EXIT();
+
+        NRF_LOG_INFO("Round trip latency, %d byte probes:", m_size);
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_stats_t const * p_stats = &stats[i];
+
+                if (p_stats->sent == 0)
+                {
+                        continue;
+                }
+                if (p_stats->rcvd == 0)
+                {
+                        NRF_LOG_INFO("  slot %-2d sent=%-5d no echo", i, p_stats->sent);
+                        continue;
+                }
+
+                NRF_LOG_INFO("  slot %-2d n=%-5d/%-5d min=%d avg=%d us",
+                             i,
+                             p_stats->rcvd,
+                             p_stats->sent,
+                             p_stats->min_us,
+                             (uint32_t)(p_stats->total_us / p_stats->rcvd));
+                NRF_LOG_INFO("          p50<=%d p99<=%d max=%d us",
+                             percentile_get(p_stats, 500),
+                             percentile_get(p_stats, 990),
+                             p_stats->max_us);
+                NRF_LOG_HEXDUMP_DEBUG(p_stats->hist, sizeof(p_stats->hist));
+        }
+}
+
+#endif // NRF_MODULE_ENABLED(LAT_PROBE)
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup lat_probe Round trip latency probe
+ * @{
+ * @brief    Measures the round trip time of every link through the NUS transport.
+ *
+ * @details  While running, the module sends a probe to every link that has found the Nordic UART
+ *           Service, every LAT_PROBE_INTERVAL_MS. A probe is a @ref NUS_MUX_OP_PING message on the
+ *           control channel of the multiplexer, carrying a session number, a sequence number and
+ *           the app_timer counter at sending:
+ *
+ *           @code
+ *           | op | session | seq (2, LE) | t_tx (4, LE) | padding |
+ *           @endcode
+ *
+ *           The peripheral echoes it unchanged as @ref NUS_MUX_OP_PONG. The probe goes the way of
+ *           a UART line, through the multiplexer, ble_nus_c_string_send() or the L2CAP channel,
+ *           the peer's NUS or L2CAP handler and its multiplexer, and back, but not through the
+ *           reliable transfer and compression of the data channel. It does not wait behind data
+ *           already queued, the control channel goes first.
+ *
+ *           Every link slot has a log-linear histogram of the round trip times with four buckets
+ *           per octave, from 256 us to 16 s. A report with the median, 99th percentile and maximum
+ *           of every link is written to the log every LAT_PROBE_REPORT_INTERVAL_MS and when the
+ *           probe is stopped, and a new window is started.
+ *
+ *           RAM cost: about 150 bytes per link slot. The resolution is one app_timer tick,
+ *           30.5 us with the RTC prescaler at 0.
+ *
+ * @note     Compiles to nothing unless LAT_PROBE_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef LAT_PROBE_H__
+#define LAT_PROBE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LAT_PROBE_HDR_LEN       8   /**< Length of a probe without padding. */
+#define LAT_PROBE_HIST_BUCKETS  65  /**< Number of histogram buckets. Bucket 0 holds round trips below 256 us, the last one also everything above 16 s. */
+
+
+#if NRF_MODULE_ENABLED(LAT_PROBE)
+
+/**@brief Function for initializing the probe. It does not start it. */
+void lat_probe_init(void);
+
+
+/**@brief Function for starting the probe, or changing the probe size while it runs.
+ *
+ * @details Starts a new report window for every link.
+ *
+ * @param[in] size  Length of the probe messages, from @ref LAT_PROBE_HDR_LEN. Probes are cut to
+ *                  the packet size of the link so that they are never split.
+ *
+ * @retval NRF_SUCCESS              If the probe was started.
+ * @retval NRF_ERROR_INVALID_LENGTH If @p size is out of range.
+ */
+ret_code_t lat_probe_start(uint16_t size);
+
+
+/**@brief Function for stopping the probe and writing the last report. */
+void lat_probe_stop(void);
+
+
+/**@brief Function for checking whether the probe is running.
+ *
+ * @return True if probes are being sent.
+ */
+bool lat_probe_is_running(void);
+
+
+/**@brief Function for clearing the statistics of a link slot, when a link is established.
+ *
+ * @param[in] slot  Link context slot.
+ */
+void lat_probe_link_reset(uint8_t slot);
+
+
+/**@brief Function for handling a @ref NUS_MUX_OP_PONG message from a link.
+ *
+ * @param[in] slot    Link context slot the message was received on.
+ * @param[in] p_data  Message, starting with its opcode.
+ * @param[in] len     Length of the message.
+ */
+void lat_probe_on_pong(uint8_t slot, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for writing the statistics of every link to the log and starting a new window. */
+void lat_probe_report(void);
+
+#else
+
+#define lat_probe_init()
+#define lat_probe_link_reset(_slot)
+
+#endif // NRF_MODULE_ENABLED(LAT_PROBE)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAT_PROBE_H__
+
+/** @} */
@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#include <string.h>
+#include "link_ctx.h"
+#include "ble_hci.h"
+#include "nrf_sdh_ble.h"
+
+#define NRF_LOG_MODULE_NAME link_ctx
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define LINK_CTX_HANDLE_MAP_SIZE    NRF_SDH_BLE_TOTAL_LINK_COUNT    /**< Connection handles below this value are resolved with a direct lookup. */
+
+STATIC_ASSERT(LINK_CTX_MAX <= LINK_CTX_SD_MAX_CENTRAL_LINKS);
+STATIC_ASSERT(LINK_CTX_MAX < LINK_CTX_SLOT_INVALID);
+STATIC_ASSERT(sizeof(link_ctx_t) * LINK_CTX_MAX <= LINK_CTX_RAM_BUDGET);
+
+static link_ctx_t m_links[LINK_CTX_MAX];                            /**< Link context table. */
+static uint8_t    m_slot_by_handle[LINK_CTX_HANDLE_MAP_SIZE];       /**< Slot index for each connection handle, or LINK_CTX_SLOT_INVALID. */
+
+
+void link_ctx_init(void)
+{
+        memset(m_links, 0, sizeof(m_links));
+        memset(m_slot_by_handle, LINK_CTX_SLOT_INVALID, sizeof(m_slot_by_handle));
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                m_links[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+                m_links[i].slot        = (uint8_t)i;
+        }
+
+        NRF_LOG_INFO("Link context table: %d slots, %d bytes per link, %d bytes total.",
+                     LINK_CTX_MAX, sizeof(link_ctx_t), sizeof(m_links));
+}
+
+
+link_ctx_t * link_ctx_at(uint32_t slot)
+{
+        return (slot < LINK_CTX_MAX) ? &m_links[slot] : NULL;
+}
+
+
+link_ctx_t * link_ctx_get(uint16_t conn_handle)
+{
+        if (conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+                return NULL;
+        }
+
+        if (conn_handle < LINK_CTX_HANDLE_MAP_SIZE)
+        {
+                uint8_t slot = m_slot_by_handle[conn_handle];
+                return (slot == LINK_CTX_SLOT_INVALID) ? NULL : &m_links[slot];
+        }
+
+        // The SoftDevice is not required to hand out dense handles. Fall back to a search.
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                if (m_links[i].conn_handle == conn_handle)
+                {
+                        return &m_links[i];
+                }
+        }
+
+        return NULL;
+}
+
+
+uint8_t link_ctx_slot_get(uint16_t conn_handle)
+{
+        link_ctx_t const * p_link = link_ctx_get(conn_handle);
+
+        return (p_link != NULL) ? p_link->slot : LINK_CTX_SLOT_INVALID;
+}
+
+
+link_ctx_t * link_ctx_alloc(uint16_t conn_handle)
+{
+        link_ctx_t * p_link = link_ctx_get(conn_handle);
+
+        if (p_link != NULL)
+        {
+                return p_link;
+        }
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                if (!link_ctx_in_use(&m_links[i]))
+                {
+                        m_links[i].conn_handle = conn_handle;
+                        if (conn_handle < LINK_CTX_HANDLE_MAP_SIZE)
+                        {
+                                m_slot_by_handle[conn_handle] = (uint8_t)i;
+                        }
+
+                        NRF_LOG_DEBUG("Link 0x%x assigned to slot %d.", conn_handle, i);
+                        return &m_links[i];
+                }
+        }
+
+        NRF_LOG_WARNING("No free link context for connection 0x%x.", conn_handle);
+        return NULL;
+}
+
+
+void link_ctx_free(link_ctx_t * p_link)
+{
+        if ((p_link == NULL) || !link_ctx_in_use(p_link))
+        {
+                return;
+        }
+
+        if (p_link->conn_handle < LINK_CTX_HANDLE_MAP_SIZE)
+        {
+                m_slot_by_handle[p_link->conn_handle] = LINK_CTX_SLOT_INVALID;
+        }
+
+        NRF_LOG_DEBUG("Slot %d released by link 0x%x.", p_link->slot, p_link->conn_handle);
+        p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+}
+
+
+/**@brief Function for dispatching BLE events to the database discovery instance of a link.
+ *
+ * @details Runs at the database discovery observer priority, ahead of the service clients and
+ *          the application, so the slot is assigned before anyone else sees the connection.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ * @param[in] p_context  Unused.
+ */
+static void link_ctx_on_ble_evt_disc(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
+        link_ctx_t          * p_link;
+
+        UNUSED_PARAMETER(p_context);
+
+        if ((p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED) &&
+            (p_gap_evt->params.connected.role == BLE_GAP_ROLE_CENTRAL))
+        {
+                p_link = link_ctx_alloc(p_gap_evt->conn_handle);
+        }
+        else
+        {
+                // All connection-oriented events carry the connection handle in the same place.
+                p_link = link_ctx_get(p_gap_evt->conn_handle);
+        }
+
+        if (p_link == NULL)
+        {
+                return;
+        }
+
+        switch (p_ble_evt->header.evt_id)
+        {
+        case BLE_GAP_EVT_CONNECTED:
+                p_link->conn_interval = p_gap_evt->params.connected.conn_params.max_conn_interval;
+                p_link->tx_phy        = BLE_GAP_PHY_1MBPS;
+                p_link->tx_octets     = BLE_GAP_DATA_LENGTH_DEFAULT;
+                break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+                p_link->conn_interval = p_gap_evt->params.conn_param_update.conn_params.max_conn_interval;
+                break;
+
+        case BLE_GAP_EVT_PHY_UPDATE:
+                if (p_gap_evt->params.phy_update.status == BLE_HCI_STATUS_CODE_SUCCESS)
+                {
+                        p_link->tx_phy = p_gap_evt->params.phy_update.tx_phy;
+                }
+                break;
+
+        case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
+                p_link->tx_octets = (uint8_t)p_gap_evt->params.data_length_update.effective_params.max_tx_octets;
+                break;
+
+        default:
+                break;
+        }
+
+        ble_db_discovery_on_ble_evt(p_ble_evt, &p_link->db_disc);
+}
+
+
+/**@brief Function for dispatching BLE events to the service clients of a link.
+ *
+ * @param[in] p_ble_evt  Bluetooth stack event.
+ * @param[in] p_context  Unused.
+ */
+static void link_ctx_on_ble_evt_clients(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        link_ctx_t * p_link = link_ctx_get(p_ble_evt->evt.gap_evt.conn_handle);
+
+        UNUSED_PARAMETER(p_context);
+
+        if (p_link == NULL)
+        {
+                return;
+        }
+
+        ble_hrs_c_on_ble_evt(p_ble_evt, &p_link->hrs_c);
+        ble_bas_c_on_ble_evt(p_ble_evt, &p_link->bas_c);
+        ble_nus_c_on_ble_evt(p_ble_evt, &p_link->nus_c);
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        ble_l2cap_coc_on_ble_evt(p_ble_evt, &p_link->coc);
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        ble_hrt_c_on_ble_evt(p_ble_evt, &p_link->hrt_c);
+#endif
+}
+
+
+NRF_SDH_BLE_OBSERVER(m_link_ctx_disc_obs, BLE_DB_DISC_BLE_OBSERVER_PRIO, link_ctx_on_ble_evt_disc, NULL);
+NRF_SDH_BLE_OBSERVER(m_link_ctx_clients_obs, BLE_HRS_C_BLE_OBSERVER_PRIO, link_ctx_on_ble_evt_clients, NULL);
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup link_ctx Per-link context table
+ * @{
+ * @brief    Table of per-link client state for the Heart Rate collector.
+ *
+ * @details  Every central link gets one slot holding all client instances used on that link
+ *           (HRS, BAS, NUS and database discovery). Slots are allocated on
+ *           @ref BLE_GAP_EVT_CONNECTED and mapped from the connection handle, so the application
+ *           no longer assumes that connection handles are dense and smaller than the link count.
+ *
+ *           The module registers its own BLE observers and forwards each event only to the
+ *           client instances of the slot the event belongs to. The client modules must therefore
+ *           not be defined with their own *_DEF or *_ARRAY_DEF macros.
+ *
+ *           RAM cost per link (SDK 15.2 defaults, BLE_DB_DISCOVERY_MAX_SRV = 6 and
+ *           BLE_GATT_DB_MAX_CHARS = 6):
+ *           - ble_db_discovery_t  ~ 800 bytes
+ *           - ble_hrs_c_t         ~  12 bytes
+ *           - ble_bas_c_t         ~  12 bytes
+ *           - ble_nus_c_t         ~  16 bytes
+ *           - slot bookkeeping        6 bytes
+ *           - link_fsm_t          ~  36 bytes
+ *
+ *           The NUS stream multiplexer adds NUS_MUX_CH_COUNT * NUS_MUX_TX_BUF_SIZE + NUS_MUX_PACKET_MAX
+ *           bytes, 1.3 kB with the defaults.
+ *
+ *           With BLE_L2CAP_COC_ENABLED each link also holds the L2CAP channel buffers,
+ *           (1 + BLE_L2CAP_COC_TX_QUEUE_SIZE) * BLE_L2CAP_COC_MTU bytes, 1.5 kB with the defaults.
+ *
+ *           With NUS_ARQ_ENABLED each link holds a send and a reorder window,
+ *           2 * NUS_ARQ_WINDOW * (NUS_ARQ_PAYLOAD_MAX + 1) bytes plus the frame being reassembled,
+ *           4.1 kB with the defaults.
+ *
+ *           With NUS_LZ_ENABLED each link holds the compression history and match table,
+ *           3.1 kB with the defaults.
+ *
+ *           With BLE_HRT_C_ENABLED each link holds the telemetry client and decoder, about
+ *           50 bytes.
+ *
+ *           With NUS_TPUT_ENABLED each link holds the throughput test state, a few bytes next to
+ *           the queue of the test channel that the multiplexer always has.
+ *
+ *           With HRV_ENABLED each link holds its RR interval window, 2 * HRV_WINDOW + 48 bytes,
+ *           0.55 kB with the defaults.
+ *
+ *           With PEER_CACHE_ENABLED each link holds the cached handles of its peer, about 28 bytes.
+ *
+ *           That is about 10 kB of application RAM per link with the default configuration, and
+ *           about 3 kB without NUS_ARQ and NUS_LZ. The table must fit in LINK_CTX_RAM_BUDGET,
+ *           which is checked at build time: with the defaults that caps the central at 2 links,
+ *           far below the SoftDevice maximum of 20. The exact value is printed by
+ *           @ref link_ctx_init. The SoftDevice reserves its own per-link RAM on top of this, see
+ *           @c ram_start in ble_stack_init().
+ */
+
+#ifndef LINK_CTX_H__
+#define LINK_CTX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_db_discovery.h"
+#include "ble_hrs_c.h"
+#include "ble_bas_c.h"
+#include "ble_nus_c.h"
+#include "nus_mux.h"
+#include "link_fsm.h"
+#include "sdk_config.h"
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+#include "ble_l2cap_coc.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+#include "nus_arq.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+#include "nus_lz.h"
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+#include "ble_hrt_c.h"
+#include "hrt_codec.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+#include "nus_tput.h"
+#endif
+#if NRF_MODULE_ENABLED(HRV)
+#include "hrv.h"
+#endif
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+#include "peer_cache.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LINK_CTX_SD_MAX_CENTRAL_LINKS   20                              /**< Maximum number of central links supported by the SoftDevice. */
+#define LINK_CTX_MAX                    NRF_SDH_BLE_CENTRAL_LINK_COUNT  /**< Number of slots in the link context table. */
+#define LINK_CTX_SLOT_INVALID           0xFF                            /**< Slot index used to mark an unmapped connection handle. */
+
+/**@brief Per-link client state. */
+typedef struct
+{
+        uint16_t           conn_handle;     /**< Connection handle owning this slot, or BLE_CONN_HANDLE_INVALID if the slot is free. */
+        uint8_t            slot;            /**< Index of this slot in the table. */
+        uint16_t           conn_interval;   /**< Current connection interval in 1.25 ms units. */
+        uint8_t            tx_phy;          /**< Current transmit PHY, BLE_GAP_PHY_1MBPS or BLE_GAP_PHY_2MBPS. */
+        uint8_t            tx_octets;       /**< Current largest Link Layer payload sent, 27 to 251 bytes. */
+        link_fsm_t         fsm;             /**< Bring-up stages of the link. */
+        bool               cccd_encrypt;    /**< CCCD writes wait for the link to be encrypted. */
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        peer_cache_t       cache;           /**< Handles of the peer, loaded on the connection or being stored. */
+        bool               cache_valid;     /**< The handles of the link are those stored with the bond of the peer. */
+        bool               cccd_read_busy;  /**< The CCCD read back found another client procedure running, tried again when it ends. */
+#endif
+        ble_hrs_c_t        hrs_c;           /**< Heart Rate Service client instance. */
+        ble_bas_c_t        bas_c;           /**< Battery Service client instance. */
+        ble_nus_c_t        nus_c;           /**< Nordic UART Service client instance. */
+        nus_mux_t          mux;             /**< Logical channels carried over NUS or the L2CAP channel. */
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        nus_arq_t          arq;             /**< Reliable transfer on the data channel of the multiplexer. */
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        nus_lz_t           lz;              /**< Compression of the data carried by the reliable transfer. */
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        nus_tput_t         tput;            /**< Throughput test on the test channel of the multiplexer. */
+#endif
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        ble_l2cap_coc_t    coc;             /**< L2CAP channel carrying the UART data instead of NUS. */
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        ble_hrt_c_t        hrt_c;           /**< Heart Rate Telemetry Service client instance. */
+        hrt_dec_t          hrt_dec;         /**< Decoder of the telemetry blocks. */
+        uint32_t           hrm_bytes;       /**< Bytes of Heart Rate Measurement notifications, ATT header included. */
+        uint32_t           hrm_samples;     /**< Heart rate samples and RR intervals carried by them. */
+#endif
+#if NRF_MODULE_ENABLED(HRV)
+        hrv_t              hrv;             /**< Heart rate variability of the RR intervals received. */
+#endif
+        ble_db_discovery_t db_disc;         /**< Database discovery instance. */
+} link_ctx_t;
+
+
+/**@brief Function for initializing the link context table.
+ *
+ * @details Marks all slots as free. Must be called before any client module is initialized on
+ *          the slots returned by @ref link_ctx_at.
+ */
+void link_ctx_init(void);
+
+
+/**@brief Function for getting a slot by index, used or not.
+ *
+ * @param[in] slot  Slot index, smaller than @ref LINK_CTX_MAX.
+ *
+ * @return Pointer to the slot, or NULL if @p slot is out of range.
+ */
+link_ctx_t * link_ctx_at(uint32_t slot);
+
+
+/**@brief Function for looking up the slot assigned to a connection.
+ *
+ * @param[in] conn_handle  Connection handle.
+ *
+ * @return Pointer to the slot, or NULL if no slot is assigned to @p conn_handle.
+ */
+link_ctx_t * link_ctx_get(uint16_t conn_handle);
+
+
+/**@brief Function for looking up the slot index assigned to a connection.
+ *
+ * @param[in] conn_handle  Connection handle.
+ *
+ * @return Slot index, or @ref LINK_CTX_SLOT_INVALID if no slot is assigned to @p conn_handle.
+ */
+uint8_t link_ctx_slot_get(uint16_t conn_handle);
+
+
+/**@brief Function for assigning a free slot to a new connection.
+ *
+ * @details Called by the module itself on @ref BLE_GAP_EVT_CONNECTED for central links.
+ *
+ * @param[in] conn_handle  Connection handle.
+ *
+ * @return Pointer to the slot, or NULL if the table is full.
+ */
+link_ctx_t * link_ctx_alloc(uint16_t conn_handle);
+
+
+/**@brief Function for releasing the slot of a connection.
+ *
+ * @details Must be called by the application once it has finished handling
+ *          @ref BLE_GAP_EVT_DISCONNECTED, so that all observers see the slot for the last event.
+ *
+ * @param[in] p_link  Slot to release.
+ */
+void link_ctx_free(link_ctx_t * p_link);
+
+
+/**@brief Function for checking whether a slot is assigned to a connection.
+ *
+ * @param[in] p_link  Slot.
+ *
+ * @retval true  If the slot is in use.
+ */
+static __INLINE bool link_ctx_in_use(link_ctx_t const * p_link)
+{
+        return (p_link->conn_handle != BLE_CONN_HANDLE_INVALID);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_CTX_H__
+
+/** @} */
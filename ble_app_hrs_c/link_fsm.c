@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#include <string.h>
+#include "link_fsm.h"
+#include "app_timer.h"
+
+#define NRF_LOG_MODULE_NAME link_fsm
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define TICKS_TO_MS(_ticks)     ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+static link_fsm_stage_t const * m_p_stages;                     /**< Stage table given to link_fsm_init(). */
+static link_fsm_stats_t         m_stats[LINK_FSM_STAGE_CNT];    /**< Statistics per stage. */
+
+
+/**@brief Function for starting the stages whose dependencies are reached, in table order.
+ *
+ * @details Stages are only reached through link_fsm_reach(), which comes back here, so one pass
+ *          is enough even if an action reaches a stage right away.
+ */
+static void stages_start(link_fsm_t * p_fsm)
+{
+        for (uint32_t i = 0; i < LINK_FSM_STAGE_CNT; i++)
+        {
+                uint32_t bit = LINK_FSM_BIT(i);
+
+                if ((((p_fsm->started | p_fsm->reached) & bit) != 0) ||
+                    ((m_p_stages[i].deps & ~p_fsm->reached) != 0))
+                {
+                        continue;
+                }
+
+                // Marked first, the action may reach stages itself.
+                p_fsm->started   |= bit;
+                p_fsm->t_start[i] = app_timer_cnt_get();
+
+                if ((m_p_stages[i].start != NULL) && !m_p_stages[i].start(p_fsm))
+                {
+                        p_fsm->started &= ~bit;
+                }
+        }
+}
+
+
+void link_fsm_init(link_fsm_stage_t const * p_stages)
+{
+        m_p_stages = p_stages;
+        link_fsm_stats_reset();
+}
+
+
+void link_fsm_start(link_fsm_t * p_fsm)
+{
+        memset(p_fsm, 0, sizeof(*p_fsm));
+        link_fsm_reach(p_fsm, LINK_FSM_STAGE_CONNECTED);
+}
+
+
+void link_fsm_reach(link_fsm_t * p_fsm, link_fsm_stage_id_t stage)
+{
+        uint32_t           bit     = LINK_FSM_BIT(stage);
+        uint32_t           now     = app_timer_cnt_get();
+        link_fsm_stats_t * p_stats = &m_stats[stage];
+        uint32_t           conn_ms;
+        uint32_t           stage_ms;
+
+        if ((p_fsm->reached & bit) != 0)
+        {
+                return;
+        }
+
+        if ((p_fsm->started & bit) == 0)
+        {
+                // Reached ahead of its dependencies, it must not be started any more.
+                p_fsm->started       |= bit;
+                p_fsm->t_start[stage] = now;
+        }
+        p_fsm->reached |= bit;
+
+        conn_ms  = TICKS_TO_MS(app_timer_cnt_diff_compute(now, p_fsm->t_start[LINK_FSM_STAGE_CONNECTED]));
+        stage_ms = TICKS_TO_MS(app_timer_cnt_diff_compute(now, p_fsm->t_start[stage]));
+
+        p_stats->count++;
+        p_stats->conn_sum_ms  += conn_ms;
+        p_stats->conn_max_ms   = MAX(p_stats->conn_max_ms, conn_ms);
+        p_stats->stage_sum_ms += stage_ms;
+        p_stats->stage_min_ms  = MIN(p_stats->stage_min_ms, stage_ms);
+        p_stats->stage_max_ms  = MAX(p_stats->stage_max_ms, stage_ms);
+
+        NRF_LOG_DEBUG("Reached %s after %d ms, %d ms from the connection.",
+                      m_p_stages[stage].p_name, stage_ms, conn_ms);
+
+        if (stage == LINK_FSM_STAGE_STREAMING)
+        {
+                NRF_LOG_INFO("Link streaming %d ms after the connection.", conn_ms);
+        }
+
+        stages_start(p_fsm);
+}
+
+
+void link_fsm_restart(link_fsm_t * p_fsm, link_fsm_stage_id_t stage)
+{
+        if ((p_fsm->reached & LINK_FSM_BIT(stage)) != 0)
+        {
+                return;
+        }
+
+        NRF_LOG_DEBUG("Restarting %s.", m_p_stages[stage].p_name);
+
+        p_fsm->started &= ~LINK_FSM_BIT(stage);
+        stages_start(p_fsm);
+}
+
+
+void link_fsm_stop(link_fsm_t * p_fsm)
+{
+        uint32_t pending = p_fsm->started & ~p_fsm->reached;
+
+        for (uint32_t i = 0; i < LINK_FSM_STAGE_CNT; i++)
+        {
+                if ((pending & LINK_FSM_BIT(i)) != 0)
+                {
+                        NRF_LOG_DEBUG("Link lost before %s.", m_p_stages[i].p_name);
+                        m_stats[i].lost++;
+                }
+        }
+
+        // Late events of the link must not start anything.
+        p_fsm->started = UINT32_MAX;
+        p_fsm->reached = UINT32_MAX;
+}
+
+
+link_fsm_stats_t const * link_fsm_stats_get(link_fsm_stage_id_t stage)
+{
+        return &m_stats[stage];
+}
+
+
+void link_fsm_stats_log(void)
+{
+        for (uint32_t i = 1; i < LINK_FSM_STAGE_CNT; i++)
+        {
+                link_fsm_stats_t const * p_stats = &m_stats[i];
+
+                if (p_stats->count == 0)
+                {
+                        NRF_LOG_INFO("%-10s never reached, %d links lost before.", m_p_stages[i].p_name, p_stats->lost);
+                        continue;
+                }
+
+                NRF_LOG_INFO("%-10s %d links, %d lost before, from connection avg %d max %d ms,",
+                             m_p_stages[i].p_name, p_stats->count, p_stats->lost,
+                             p_stats->conn_sum_ms / p_stats->count, p_stats->conn_max_ms);
+                NRF_LOG_INFO("           from start avg %d min %d max %d ms.",
+                             p_stats->stage_sum_ms / p_stats->count, p_stats->stage_min_ms, p_stats->stage_max_ms);
+        }
+}
+
+
+void link_fsm_stats_reset(void)
+{
+        memset(m_stats, 0, sizeof(m_stats));
+
+        for (uint32_t i = 0; i < LINK_FSM_STAGE_CNT; i++)
+        {
+                m_stats[i].stage_min_ms = UINT32_MAX;
+        }
+}
@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup link_fsm Link lifecycle state machine
+ * @{
+ * @brief    Orders and times the bring-up stages of every central link.
+ *
+ * @details  A link goes through the stages of @ref link_fsm_stage_id_t, from the connection to
+ *           the first Heart Rate Measurement. The application describes them in a table: each
+ *           stage lists the stages it depends on and the action that starts it. A stage is started
+ *           as soon as all its dependencies are reached, so stages that do not depend on each
+ *           other, like the ATT MTU exchange and the service discovery, run at the same time.
+ *           A stage reached before it was started, for instance encryption asked for by the
+ *           peer, is never started. An action may also hold its stage back, for conditions that
+ *           differ from link to link; it is then called again whenever the link reaches a stage.
+ *
+ *           The state of a link is the set of stages reached. The time each stage is started and
+ *           reached is recorded, and kept in per-stage statistics across links: time from the
+ *           connection, time from the start of the stage, and links lost before the stage was
+ *           reached. See @ref link_fsm_stats_log.
+ */
+
+#ifndef LINK_FSM_H__
+#define LINK_FSM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Bring-up stages of a link. */
+typedef enum
+{
+        LINK_FSM_STAGE_CONNECTED,       /**< Link established. */
+        LINK_FSM_STAGE_MTU,             /**< ATT MTU exchanged. */
+        LINK_FSM_STAGE_DLE,             /**< Data length updated, not reached with peers that keep the default. */
+        LINK_FSM_STAGE_ENCRYPTED,       /**< Link encrypted. */
+        LINK_FSM_STAGE_DISCOVERED,      /**< Service discovery complete. */
+        LINK_FSM_STAGE_SUBSCRIBED,      /**< Heart Rate Measurement notifications enabled. */
+        LINK_FSM_STAGE_STREAMING,       /**< First Heart Rate Measurement received. */
+        LINK_FSM_STAGE_CNT
+} link_fsm_stage_id_t;
+
+/**@brief Bit of a stage in the stage masks. */
+#define LINK_FSM_BIT(_stage)    (1UL << (_stage))
+
+/**@brief State of a link. */
+typedef struct
+{
+        uint32_t reached;                       /**< Mask of the stages reached. */
+        uint32_t started;                       /**< Mask of the stages started. */
+        uint32_t t_start[LINK_FSM_STAGE_CNT];   /**< Time each stage was started, in app_timer ticks. */
+} link_fsm_t;
+
+/**@brief Function starting a stage.
+ *
+ * @param[in] p_fsm  State of the link, embedded in the link context.
+ *
+ * @retval true   If the stage is started.
+ * @retval false  If the stage waits, the function is called again when the link reaches a stage.
+ */
+typedef bool (*link_fsm_start_t)(link_fsm_t * p_fsm);
+
+/**@brief Description of a stage. */
+typedef struct
+{
+        char const     * p_name;        /**< Name in the log. */
+        uint32_t         deps;          /**< Mask of the stages to reach before the stage is started. */
+        link_fsm_start_t start;         /**< Action starting the stage, NULL if the stack or the peer starts it. */
+} link_fsm_stage_t;
+
+/**@brief Statistics of a stage. */
+typedef struct
+{
+        uint32_t count;                 /**< Links that reached the stage. */
+        uint32_t lost;                  /**< Links lost after the stage was started and before it was reached. */
+        uint32_t conn_sum_ms;           /**< Sum of the times from the connection to the stage. */
+        uint32_t conn_max_ms;           /**< Longest time from the connection to the stage. */
+        uint32_t stage_sum_ms;          /**< Sum of the times from the start of the stage to the stage. */
+        uint32_t stage_min_ms;          /**< Shortest time from the start of the stage to the stage. */
+        uint32_t stage_max_ms;          /**< Longest time from the start of the stage to the stage. */
+} link_fsm_stats_t;
+
+
+/**@brief Function for initializing the state machine.
+ *
+ * @param[in] p_stages  Table of LINK_FSM_STAGE_CNT stages, indexed by @ref link_fsm_stage_id_t.
+ *                      Must stay valid. Stages ready at the same time are started in table order.
+ */
+void link_fsm_init(link_fsm_stage_t const * p_stages);
+
+
+/**@brief Function for starting the bring-up of a new link.
+ *
+ * @details Reaches @ref LINK_FSM_STAGE_CONNECTED, which starts the stages depending only on it.
+ *
+ * @param[in] p_fsm  State of the link.
+ */
+void link_fsm_start(link_fsm_t * p_fsm);
+
+
+/**@brief Function for reaching a stage.
+ *
+ * @details Starts the stages whose dependencies are now all reached. Reaching a stage twice has
+ *          no effect.
+ *
+ * @param[in] p_fsm  State of the link.
+ * @param[in] stage  Stage reached.
+ */
+void link_fsm_reach(link_fsm_t * p_fsm, link_fsm_stage_id_t stage);
+
+
+/**@brief Function for starting a stage again that has failed.
+ *
+ * @details Has no effect on a stage already reached. The action of the stage is called again
+ *          right away if its dependencies are reached.
+ *
+ * @param[in] p_fsm  State of the link.
+ * @param[in] stage  Stage to start again.
+ */
+void link_fsm_restart(link_fsm_t * p_fsm, link_fsm_stage_id_t stage);
+
+
+/**@brief Function for ending the bring-up of a lost link.
+ *
+ * @param[in] p_fsm  State of the link.
+ */
+void link_fsm_stop(link_fsm_t * p_fsm);
+
+
+/**@brief Function for checking whether a link has reached a stage.
+ *
+ * @param[in] p_fsm  State of the link.
+ * @param[in] stage  Stage.
+ *
+ * @retval true  If the stage is reached.
+ */
+static __INLINE bool link_fsm_is_reached(link_fsm_t const * p_fsm, link_fsm_stage_id_t stage)
+{
+        return ((p_fsm->reached & LINK_FSM_BIT(stage)) != 0);
+}
+
+
+/**@brief Function for getting the statistics of a stage.
+ *
+ * @param[in] stage  Stage.
+ *
+ * @return Statistics since the last reset.
+ */
+link_fsm_stats_t const * link_fsm_stats_get(link_fsm_stage_id_t stage);
+
+
+/**@brief Function for writing the statistics of all stages to the log. */
+void link_fsm_stats_log(void);
+
+
+/**@brief Function for clearing the statistics. */
+void link_fsm_stats_reset(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LINK_FSM_H__
+
+/** @} */
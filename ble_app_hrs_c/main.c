@@ -45,6 +45,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "nrf_sdm.h"
@@ -79,20 +80,34 @@
 
 #include "ble_conn_state.h"
 #include "app_scheduler.h"
+#include "link_ctx.h"
+#include "evt_prof.h"
+#include "app_evt_queue.h"
+#include "scan_sched.h"
+#include "lat_probe.h"
+#include "hrv.h"
+#include "relay.h"
+#include "bcast_rx.h"
+#include "scan_filter.h"
+#include "link_fsm.h"
+#include "peer_cache.h"
+#include "lesc_prof.h"
+#include "ble_ram_cfg.h"
 
 #define APP_BLE_CONN_CFG_TAG        1                                   /**< A tag identifying the SoftDevice BLE configuration. */
+#define RELAY_BLE_CONN_CFG_TAG      2                                   /**< A tag identifying the SoftDevice configuration of the upstream link, see @ref relay. */
 
 #define APP_BLE_OBSERVER_PRIO       3                                   /**< Application's BLE observer priority. You shouldn't need to modify this value. */
 #define APP_SOC_OBSERVER_PRIO       1                                   /**< Applications' SoC observer priority. You shouldn't need to modify this value. */
 
-#define UART_TX_BUF_SIZE        256                                     /**< UART TX buffer size. */
+#define UART_TX_BUF_SIZE        1024                                    /**< UART TX buffer size, room for the data of a few links printed in a row. */
 #define UART_RX_BUF_SIZE        256                                     /**< UART RX buffer size. */
 
 #define LESC_DEBUG_MODE             0                                   /**< Set to 1 to use LESC debug keys, allows you to use a sniffer to inspect traffic. */
 
 #define SEC_PARAM_BOND              1                                   /**< Perform bonding. */
 #define SEC_PARAM_MITM              0                                   /**< Man In The Middle protection not required. */
-#define SEC_PARAM_LESC              0                                   /**< LE Secure Connections enabled. */
+#define SEC_PARAM_LESC              1                                   /**< LE Secure Connections enabled. */
 #define SEC_PARAM_KEYPRESS          0                                   /**< Keypress notifications not enabled. */
 #define SEC_PARAM_IO_CAPABILITIES   BLE_GAP_IO_CAPS_NONE                /**< No I/O capabilities. */
 #define SEC_PARAM_OOB               0                                   /**< Out Of Band data not available. */
@@ -103,15 +118,43 @@
 
 #define TARGET_UUID                 BLE_UUID_HEART_RATE_SERVICE         /**< Target device uuid that application is looking for. */
 
+#define WHITELIST_PEERS_MAX         MIN(BLE_GAP_WHITELIST_ADDR_MAX_COUNT, \
+                                        BLE_GAP_DEVICE_IDENTITIES_MAX_COUNT) /**< Number of bonded peers the SoftDevice can whitelist. */
+
+// Every producer keeps at most one event in the scheduler queue, so the queue is sized by the
+// producers, not by the traffic. The SoftDevice interrupt schedules one poll for all the pending
+// events (see SD_EVT_IRQHandler), so a burst of links x events per connection event still takes
+// one slot, and app_evt_queue schedules one drain for all the work they trigger. app_timer runs
+// its handlers in the RTC interrupt and does not use the queue, the broadcast report timer and
+// the ingest benchmark put one event each and the UART one per line waiting in m_uart_lines. A
+// full queue is counted by app_evt_queue_sched_put(). The SoftDevice poll and the event queue
+// drain are then run by idle_state_handle(), a UART line is dropped, the ingest benchmark stops
+// and the broadcast report waits for its next period.
+#define SCHED_PRODUCERS                     (4 + UART_LINES)                           /**< SoftDevice poll, event queue drain, broadcast report, ingest benchmark, UART lines. */
 #define SCHED_MAX_EVENT_DATA_SIZE           APP_TIMER_SCHED_EVENT_DATA_SIZE            /**< Maximum size of scheduler events. */
-#ifdef SVCALL_AS_NORMAL_FUNCTION
-#define SCHED_QUEUE_SIZE                    40                                         /**< Maximum number of events in the scheduler queue. More is needed in case of Serialization. */
-#else
-#define SCHED_QUEUE_SIZE                    20                                         /**< Maximum number of events in the scheduler queue. */
-#endif
+#define SCHED_QUEUE_SIZE                    (2 * SCHED_PRODUCERS)                      /**< Maximum number of events in the scheduler queue, with room for a producer that retries before its event ran. */
 
 #define ECHOBACK_BLE_UART_DATA  0                                       /**< Echo the UART data that is received over the Nordic UART Service (NUS) back to the sender. */
 
+#define UART_CMD_PREFIX         '#'                                     /**< UART lines starting with this character are local commands, they are not sent to the links. */
+#define UART_CMD_ARGS_MAX       4                                       /**< Largest number of words in a UART command, the command name included. */
+#define UART_LINES              2                                       /**< UART lines waiting for the main loop, more received meanwhile are dropped. */
+
+#define TPUT_TIME_DEFAULT_S     10                                      /**< Duration of a throughput test when none is given, in seconds. */
+#define TPUT_TIME_MAX_S         300                                     /**< Longest throughput test in seconds, within the app_timer range. */
+
+#define ADVBENCH_SENSORS_DEFAULT 40                                     /**< Synthetic sensors of the broadcast ingest benchmark when none are given. */
+#define ADVBENCH_REPORTS_DEFAULT 20000                                  /**< Reports of the broadcast ingest benchmark when none are given. */
+#define ADVBENCH_RATE_DEFAULT    400                                    /**< Reports per second of the broadcast ingest benchmark when none are given. */
+
+#if NRF_MODULE_ENABLED(NUS_LZ) && !NRF_MODULE_ENABLED(NUS_ARQ)
+#error "NUS_LZ needs the in-order delivery of NUS_ARQ."
+#endif
+
+#define HRM_ATT_HDR_LEN         3                                       /**< ATT opcode and handle in front of every notification. */
+#define HRM_LEN(P_HRM)          (HRM_ATT_HDR_LEN + 1 + (((P_HRM)->hr_value > UINT8_MAX) ? 2 : 1) + \
+                                 2 * (P_HRM)->rr_intervals_cnt)          /**< Length of a Heart Rate Measurement notification: header, flags, heart rate and RR intervals. */
+
 
 /**@brief Macro to unpack 16bit unsigned UUID from octet stream. */
 #define UUID16_EXTRACT(DST, SRC) \
@@ -123,25 +166,41 @@
         } while (0)
 
 
-// BLE_HRS_C_DEF(m_hrs_c);                                             /**< Structure used to identify the heart rate client module. */
-// BLE_BAS_C_DEF(m_bas_c);                                             /**< Structure used to identify the Battery Service client module. */
-
-//BLE_BAS_C_ARRAY_DEF(m_bas_c, )
-BLE_HRS_C_ARRAY_DEF(m_ble_hrs_c, NRF_SDH_BLE_CENTRAL_LINK_COUNT);          /**< BLE Nordic Image Transfer Service (ITS) client instance. */
-BLE_BAS_C_ARRAY_DEF(m_ble_bas_c, NRF_SDH_BLE_CENTRAL_LINK_COUNT);          /**< BLE Nordic Image Transfer Service (ITS) client instance. */
-BLE_NUS_C_ARRAY_DEF(m_ble_nus_c, NRF_SDH_BLE_CENTRAL_LINK_COUNT);            /**< BLE Nordic UART Service (NUS) client instance. */                                          /**< BLE Nordic UART Service (NUS) client instance. */
+/**@brief State of the SoftDevice event poll, see @ref SD_EVT_IRQHandler. */
+typedef enum
+{
+        SDH_POLL_IDLE,                  /**< No poll due. */
+        SDH_POLL_SCHEDULED,             /**< A poll is in the scheduler queue. */
+        SDH_POLL_MISSED,                /**< The scheduler queue was full, the main loop polls. */
+} sdh_poll_state_t;
 
+static volatile sdh_poll_state_t m_sdh_poll_state;                  /**< State of the SoftDevice event poll. */
 
-BLE_DB_DISCOVERY_ARRAY_DEF(m_db_disc, NRF_SDH_BLE_CENTRAL_LINK_COUNT);  /**< Database discovery module instances. */
+// The HRS, BAS, NUS client and database discovery instances of each link live in the
+// link context table (link_ctx.h), which also dispatches their BLE events.
 
 NRF_BLE_GATT_DEF(m_gatt);                                           /**< GATT module instance. */
-//BLE_DB_DISCOVERY_DEF(m_db_disc);                                    /**< DB discovery module instance. */
 NRF_BLE_SCAN_DEF(m_scan);                                           /**< Scanning module instance. */
 
 static uint16_t m_conn_handle;                                      /**< Current connection handle. */
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+APP_TIMER_DEF(m_tput_timer);                                        /**< Ends the throughput test. */
+static uint32_t m_tput_slots;                                       /**< Bitmask of the link slots in the running throughput test. */
+#endif
 static bool m_whitelist_disabled;                                   /**< True if whitelist has been temporarily disabled. */
 static bool m_memory_access_in_progress;                            /**< Flag to keep track of ongoing operations on persistent memory. */
 
+static pm_peer_id_t m_whitelist_peers[WHITELIST_PEERS_MAX];         /**< Bonded peers to whitelist, least recently bonded first, see whitelist_peer_add. */
+static uint32_t     m_whitelist_peer_cnt;                           /**< Number of valid entries in m_whitelist_peers. */
+static bool         m_whitelist_dirty;                              /**< True if m_whitelist_peers has changed since it was last given to the Peer Manager. */
+#if NRF_MODULE_ENABLED(BCAST_RX)
+static ble_gap_id_key_t m_whitelist_ids[WHITELIST_PEERS_MAX];       /**< Identities of m_whitelist_peers, checked by the application while the scan accepts all advertisers. */
+static bool             m_whitelist_only;                           /**< True if the current scan connects to whitelisted peers only. */
+static bool             m_scan_connect;                             /**< True if the current scan connects to a matching advertiser, false with all links up. */
+#endif
+
+static bool m_secure_early = true;                                  /**< Encrypt links to bonded peers on the connection rather than after the discovery. */
+
 /**< Scan parameters requested for scanning and connection. */
 static ble_gap_scan_params_t const m_scan_param =
 {
@@ -159,7 +218,6 @@ static ble_gap_scan_params_t const m_scan_param =
 static char const m_target_periph_name[] = "Nordic_HRM";      /**< If you want to connect to a peripheral using a given advertising name, type its name here. */
 static bool is_connect_per_addr = false;            /**< If you want to connect to a peripheral with a given address, set this to true and put the correct address in the variable below. */
 
-static uint16_t m_ble_nus_max_data_len = BLE_GATT_ATT_MTU_DEFAULT - OPCODE_LENGTH - HANDLE_LENGTH; /**< Maximum length of data (in bytes) that can be transmitted to the peer by the Nordic UART service module. */
 
 static ble_gap_addr_t const m_target_periph_addr =
 {
@@ -172,8 +230,21 @@ static ble_gap_addr_t const m_target_periph_addr =
         .addr      = {0x8D, 0xFE, 0xA3, 0x86, 0x77, 0xD9}
 };
 
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+/**@brief Peripherals to connect to when scanning without the whitelist, see @ref scan_filter. */
+static scan_filter_target_t const m_scan_targets[] =
+{
+        {SCAN_FILTER_NAME_PREFIX, m_target_periph_name},
+        // {SCAN_FILTER_ADDR,        m_target_periph_addr.addr},
+};
+#endif
+
 
 static void scan_start(void);
+static void whitelist_peer_add(pm_peer_id_t peer_id);
+static void whitelist_peer_remove(pm_peer_id_t peer_id);
+static void whitelist_clear(void);
+static void link_nus_start(link_ctx_t * p_link);
 
 
 /**@brief Function for asserts in the SoftDevice.
@@ -193,6 +264,319 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
 }
 
 
+/**@brief Function for checking whether the peer of a link is bonded. */
+static bool link_is_bonded(link_ctx_t const * p_link)
+{
+        pm_peer_id_t peer_id;
+
+        return (pm_peer_id_get(p_link->conn_handle, &peer_id) == NRF_SUCCESS) &&
+               (peer_id != PM_PEER_ID_INVALID);
+}
+
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+/**@brief Function for giving the handles loaded from the cache to the clients of a link. */
+static void link_cache_assign(link_ctx_t * p_link)
+{
+        ret_code_t err_code;
+
+        err_code = ble_hrs_c_handles_assign(&p_link->hrs_c, p_link->conn_handle, &p_link->cache.hrs);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = ble_bas_c_handles_assign(&p_link->bas_c, p_link->conn_handle, &p_link->cache.bas);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = ble_nus_c_handles_assign(&p_link->nus_c, p_link->conn_handle, &p_link->cache.nus);
+        APP_ERROR_CHECK(err_code);
+
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        err_code = ble_hrt_c_handles_assign(&p_link->hrt_c, p_link->conn_handle, &p_link->cache.hrt);
+        APP_ERROR_CHECK(err_code);
+#endif
+
+        if (p_link->cache.nus.nus_tx_cccd_handle != BLE_GATT_HANDLE_INVALID)
+        {
+                link_nus_start(p_link);
+        }
+}
+#endif // NRF_MODULE_ENABLED(PEER_CACHE)
+
+
+/**@brief Function for storing the handles of a subscribed link with the bond of its peer.
+ *
+ * @details Called when the notifications are enabled and when the bond is stored, the later of
+ *          the two finds both done.
+ */
+static void link_cache_store(link_ctx_t * p_link)
+{
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        ret_code_t err_code;
+
+        if (p_link->cache_valid ||
+            !link_fsm_is_reached(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED) ||
+            !link_is_bonded(p_link))
+        {
+                return;
+        }
+
+        p_link->cache.hrs = p_link->hrs_c.peer_hrs_db;
+        p_link->cache.bas = p_link->bas_c.peer_bas_db;
+        p_link->cache.nus = p_link->nus_c.handles;
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        p_link->cache.hrt = p_link->hrt_c.handles;
+#endif
+
+        err_code = peer_cache_store(p_link->conn_handle, &p_link->cache);
+        if (err_code == NRF_SUCCESS)
+        {
+                p_link->cache_valid = true;
+        }
+        else
+        {
+                NRF_LOG_WARNING("Handles of link 0x%x not stored: 0x%x.", p_link->conn_handle, err_code);
+        }
+#else
+        UNUSED_PARAMETER(p_link);
+#endif
+}
+
+
+/**@brief Function for starting the service discovery of a link.
+ *
+ * @details A bonded peer whose handles are cached is not discovered again.
+ */
+static bool link_disc_start(link_fsm_t * p_fsm)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_fsm, link_ctx_t, fsm);
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        if (p_link->cache_valid)
+        {
+                link_cache_assign(p_link);
+                link_fsm_reach(p_fsm, LINK_FSM_STAGE_DISCOVERED);
+                return true;
+        }
+#endif
+
+        ret_code_t err_code = ble_db_discovery_start(&p_link->db_disc, p_link->conn_handle);
+        APP_ERROR_CHECK(err_code);
+
+        return true;
+}
+
+
+/**@brief Function for starting the encryption of a link.
+ *
+ * @details Bonded peers are encrypted right away, alongside the MTU exchange and the discovery.
+ *          New peers are only bonded once the discovery has shown what they are.
+ */
+static bool link_secure_start(link_fsm_t * p_fsm)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_fsm, link_ctx_t, fsm);
+        ret_code_t   err_code;
+
+        if (!link_fsm_is_reached(p_fsm, LINK_FSM_STAGE_DISCOVERED) &&
+            !(m_secure_early && link_is_bonded(p_link)))
+        {
+                return false;
+        }
+
+        err_code = pm_conn_secure(p_link->conn_handle, false);
+        if (err_code != NRF_ERROR_BUSY)
+        {
+                APP_ERROR_CHECK(err_code);
+        }
+
+        return true;
+}
+
+
+/**@brief Function for writing the CCCDs of all services found on a link.
+ *
+ * @details Services not found keep the invalid handles assigned on the connection.
+ */
+static void link_cccds_write(link_ctx_t * p_link)
+{
+        ret_code_t err_code;
+
+        if (p_link->hrs_c.peer_hrs_db.hrm_cccd_handle != BLE_GATT_HANDLE_INVALID)
+        {
+                err_code = ble_hrs_c_hrm_notif_enable(&p_link->hrs_c);
+                APP_ERROR_CHECK(err_code);
+        }
+        else
+        {
+                NRF_LOG_WARNING("No Heart Rate Service on link 0x%x.", p_link->conn_handle);
+        }
+
+        if (p_link->bas_c.peer_bas_db.bl_cccd_handle != BLE_GATT_HANDLE_INVALID)
+        {
+                err_code = ble_bas_c_bl_read(&p_link->bas_c);
+                APP_ERROR_CHECK(err_code);
+
+                err_code = ble_bas_c_bl_notif_enable(&p_link->bas_c);
+                APP_ERROR_CHECK(err_code);
+        }
+
+        if (p_link->nus_c.handles.nus_tx_cccd_handle != BLE_GATT_HANDLE_INVALID)
+        {
+                err_code = ble_nus_c_tx_notif_enable(&p_link->nus_c);
+                APP_ERROR_CHECK(err_code);
+        }
+
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        if (p_link->hrt_c.handles.block_cccd_handle != BLE_GATT_HANDLE_INVALID)
+        {
+                err_code = ble_hrt_c_notif_enable(&p_link->hrt_c);
+                APP_ERROR_CHECK(err_code);
+        }
+#endif
+}
+
+
+/**@brief Function for enabling the notifications of all services found on a link.
+ *
+ * @details Waits for the encryption when the peer needs it for its CCCDs, see cccd_encrypt.
+ *          A bonded peer with cached handles restored its CCCDs with its bond, the notifications
+ *          flow already. Only the Heart Rate Measurement CCCD is read back, to catch a peer that
+ *          lost its bond.
+ */
+static bool link_subscribe_start(link_fsm_t * p_fsm)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_fsm, link_ctx_t, fsm);
+
+        if (p_link->cccd_encrypt && !link_fsm_is_reached(p_fsm, LINK_FSM_STAGE_ENCRYPTED))
+        {
+                return false;
+        }
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        if (p_link->cache_valid)
+        {
+                ret_code_t err_code = sd_ble_gattc_read(p_link->conn_handle,
+                                                        p_link->hrs_c.peer_hrs_db.hrm_cccd_handle,
+                                                        0);
+                if (err_code == NRF_ERROR_BUSY)
+                {
+                        // Another GATT client procedure of the link is running, tried again on its
+                        // response.
+                        p_link->cccd_read_busy = true;
+                        return false;
+                }
+                APP_ERROR_CHECK(err_code);
+
+                return true;
+        }
+#endif
+
+        link_cccds_write(p_link);
+
+        return true;
+}
+
+
+/**@brief Function for handling the answer to the Heart Rate Measurement CCCD write of a link.
+ *
+ * @details A peer that needs encryption for its CCCDs refuses the write, all of them are written
+ *          again once the link is encrypted.
+ */
+static void link_subscribe_rsp(link_ctx_t * p_link, uint16_t gatt_status)
+{
+        switch (gatt_status)
+        {
+        case BLE_GATT_STATUS_SUCCESS:
+                link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+                link_cache_store(p_link);
+                break;
+
+        case BLE_GATT_STATUS_ATTERR_INSUF_AUTHENTICATION:
+        case BLE_GATT_STATUS_ATTERR_INSUF_ENCRYPTION:
+                NRF_LOG_INFO("Link 0x%x needs encryption to subscribe.", p_link->conn_handle);
+                p_link->cccd_encrypt = true;
+                link_fsm_restart(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+                break;
+
+        default:
+                NRF_LOG_WARNING("Heart Rate Measurement subscription refused: 0x%x.", gatt_status);
+                break;
+        }
+}
+
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+/**@brief Function for checking the Heart Rate Measurement CCCD read back from a peer with cached
+ *        handles.
+ *
+ * @details A peer that lost its CCCDs gets them written again. A read refused for another reason
+ *          than security means the handles are stale, the record is deleted and the link dropped
+ *          so that the peer is discovered again on the next connection.
+ */
+static void link_subscribe_check(link_ctx_t * p_link, ble_gattc_evt_t const * p_gattc_evt)
+{
+        ble_gattc_evt_read_rsp_t const * p_rsp = &p_gattc_evt->params.read_rsp;
+        ret_code_t                       err_code;
+
+        switch (p_gattc_evt->gatt_status)
+        {
+        case BLE_GATT_STATUS_SUCCESS:
+                if ((p_rsp->len == BLE_CCCD_VALUE_LEN) && ble_srv_is_notification_enabled(p_rsp->data))
+                {
+                        link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+                }
+                else
+                {
+                        NRF_LOG_INFO("Link 0x%x lost its subscriptions, enabling them again.",
+                                     p_link->conn_handle);
+                        link_cccds_write(p_link);
+                }
+                break;
+
+        case BLE_GATT_STATUS_ATTERR_INSUF_AUTHENTICATION:
+        case BLE_GATT_STATUS_ATTERR_INSUF_ENCRYPTION:
+                p_link->cccd_encrypt = true;
+                link_fsm_restart(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+                break;
+
+        default:
+                err_code = peer_cache_delete(p_link->conn_handle);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Stale handles not deleted: 0x%x.", err_code);
+                }
+
+                err_code = sd_ble_gap_disconnect(p_link->conn_handle,
+                                                 BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+                if (err_code != NRF_ERROR_INVALID_STATE)
+                {
+                        APP_ERROR_CHECK(err_code);
+                }
+                break;
+        }
+}
+#endif // NRF_MODULE_ENABLED(PEER_CACHE)
+
+
+/**@brief Bring-up stages of the central links, see @ref link_fsm.
+ *
+ * @details The ATT MTU exchange and data length update are started by the GATT module on the
+ *          connection. Discovery and, for bonded peers, encryption start on the connection too,
+ *          so all four run at the same time. New peers are bonded after the discovery.
+ *          Notifications are enabled after the discovery, and after the encryption when the
+ *          peer needs it. A bonded peer with cached handles is neither discovered nor written to,
+ *          see @ref peer_cache.
+ */
+static link_fsm_stage_t const m_link_stages[LINK_FSM_STAGE_CNT] =
+{
+        [LINK_FSM_STAGE_CONNECTED]  = {"connected",  0,                                         NULL},
+        [LINK_FSM_STAGE_MTU]        = {"mtu",        LINK_FSM_BIT(LINK_FSM_STAGE_CONNECTED),    NULL},
+        [LINK_FSM_STAGE_DLE]        = {"dle",        LINK_FSM_BIT(LINK_FSM_STAGE_CONNECTED),    NULL},
+        [LINK_FSM_STAGE_ENCRYPTED]  = {"encrypted",  LINK_FSM_BIT(LINK_FSM_STAGE_CONNECTED),    link_secure_start},
+        [LINK_FSM_STAGE_DISCOVERED] = {"discovered", LINK_FSM_BIT(LINK_FSM_STAGE_CONNECTED),    link_disc_start},
+        [LINK_FSM_STAGE_SUBSCRIBED] = {"subscribed", LINK_FSM_BIT(LINK_FSM_STAGE_DISCOVERED),   link_subscribe_start},
+        [LINK_FSM_STAGE_STREAMING]  = {"streaming",  LINK_FSM_BIT(LINK_FSM_STAGE_SUBSCRIBED),   NULL},
+};
+
+
 /**@brief Function for handling database discovery events.
  *
  * @details This function is callback function to handle events from the database discovery module.
@@ -203,14 +587,32 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
  */
 static void db_disc_handler(ble_db_discovery_evt_t * p_evt)
 {
-        // ble_hrs_on_db_disc_evt(&m_hrs_c, p_evt);
-        // ble_bas_on_db_disc_evt(&m_bas_c, p_evt);
+        link_ctx_t * p_link = link_ctx_get(p_evt->conn_handle);
+
+        if (p_link == NULL)
+        {
+                return;
+        }
+
+        EVT_PROF_BEGIN();
+
         NRF_LOG_DEBUG("call to ble_bas_on_db_disc_evt for instance %d and link 0x%x!",
-                      p_evt->conn_handle,
+                      p_link->slot,
                       p_evt->conn_handle);
-        ble_nus_c_on_db_disc_evt(&m_ble_nus_c[p_evt->conn_handle], p_evt);
-        ble_hrs_on_db_disc_evt(&m_ble_hrs_c[p_evt->conn_handle], p_evt);
-        ble_bas_on_db_disc_evt(&m_ble_bas_c[p_evt->conn_handle], p_evt);
+        ble_nus_c_on_db_disc_evt(&p_link->nus_c, p_evt);
+        ble_hrs_on_db_disc_evt(&p_link->hrs_c, p_evt);
+        ble_bas_on_db_disc_evt(&p_link->bas_c, p_evt);
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        ble_hrt_c_on_db_disc_evt(&p_link->hrt_c, p_evt);
+#endif
+
+        if (p_evt->evt_type == BLE_DB_DISCOVERY_AVAILABLE)
+        {
+                // All services are discovered and their clients have their handles.
+                link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_DISCOVERED);
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_DB_DISC, p_link->slot);
 }
 
 
@@ -220,6 +622,8 @@ static void db_disc_handler(ble_db_discovery_evt_t * p_evt)
  */
 static void pm_evt_handler(pm_evt_t const * p_evt)
 {
+        ret_code_t err_code;
+
         pm_handler_on_pm_evt(p_evt);
         pm_handler_flash_clean(p_evt);
 
@@ -227,8 +631,51 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
 
         switch (p_evt->evt_id)
         {
+        case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
+                // A new or updated bond has been written to flash, it can be whitelisted now.
+                // A phone bonded over the upstream link is not scanned for.
+                if ((p_evt->params.peer_data_update_succeeded.data_id == PM_PEER_DATA_ID_BONDING) &&
+                    (p_evt->params.peer_data_update_succeeded.action == PM_PEER_DATA_OP_UPDATE) &&
+                    !relay_is_upstream(p_evt->conn_handle))
+                {
+                        link_ctx_t * p_link = link_ctx_get(p_evt->conn_handle);
+
+                        // The rank orders the bonds across resets, see whitelist_init.
+                        err_code = pm_peer_rank_highest(p_evt->peer_id);
+                        if (err_code != NRF_SUCCESS)
+                        {
+                                NRF_LOG_WARNING("Rank of peer %d not raised: 0x%x.", p_evt->peer_id, err_code);
+                        }
+
+                        whitelist_peer_add(p_evt->peer_id);
+
+                        // A new peer subscribed before its bond was stored.
+                        if (p_link != NULL)
+                        {
+                                link_cache_store(p_link);
+                        }
+                }
+                break;
+
+        case PM_EVT_PEER_DELETE_SUCCEEDED:
+                whitelist_peer_remove(p_evt->peer_id);
+                break;
+
+        case PM_EVT_CONN_SEC_FAILED:
+        {
+                link_ctx_t * p_link = link_ctx_get(p_evt->conn_handle);
+
+                // Notifications waiting for the encryption are enabled anyway, the peer decides.
+                if ((p_link != NULL) && p_link->cccd_encrypt)
+                {
+                        p_link->cccd_encrypt = false;
+                        link_fsm_restart(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+                }
+        } break;
+
         case PM_EVT_PEERS_DELETE_SUCCEEDED:
                 // Bonds are deleted. Start scanning.
+                whitelist_clear();
                 scan_start();
                 break;
 
@@ -276,50 +723,171 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
 {
         ret_code_t err_code;
         ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
+        link_ctx_t          * p_link    = link_ctx_get(p_gap_evt->conn_handle);
+
+        EVT_PROF_BEGIN();
 
         switch (p_ble_evt->header.evt_id)
         {
         case BLE_GAP_EVT_CONNECTED:
         {
-                NRF_LOG_INFO("Connection 0x%x established, starting DB discovery.",
-                             p_gap_evt->conn_handle);
+                if (p_gap_evt->params.connected.role == BLE_GAP_ROLE_PERIPH)
+                {
+                        // The upstream link is handled by the relay.
+                        break;
+                }
 
-                err_code = ble_bas_c_handles_assign(&m_ble_bas_c[p_gap_evt->conn_handle], p_gap_evt->conn_handle, NULL);
-                APP_ERROR_CHECK(err_code);
+                NRF_LOG_INFO("Connection 0x%x established.",
+                             p_gap_evt->conn_handle);
 
-                err_code = ble_hrs_c_handles_assign(&m_ble_hrs_c[p_gap_evt->conn_handle], p_gap_evt->conn_handle, NULL);
-                APP_ERROR_CHECK(err_code);
+                if (p_link == NULL)
+                {
+                        // Slot table full. Should not happen as it is sized to the central link count.
+                        err_code = sd_ble_gap_disconnect(p_gap_evt->conn_handle,
+                                                         BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+                        APP_ERROR_CHECK(err_code);
+                        break;
+                }
 
-                err_code = ble_nus_c_handles_assign(&m_ble_nus_c[p_gap_evt->conn_handle], p_gap_evt->conn_handle, NULL);
-                APP_ERROR_CHECK(err_code);
+                // The handles of the previous link of the slot must not be written to. The
+                // discovery assigns those of this link.
+                {
+                        bas_c_db_t bas_none =
+                        {
+                                .bl_cccd_handle = BLE_GATT_HANDLE_INVALID,
+                                .bl_handle      = BLE_GATT_HANDLE_INVALID,
+                        };
+                        hrs_db_t hrs_none =
+                        {
+                                .hrm_cccd_handle = BLE_GATT_HANDLE_INVALID,
+                                .hrm_handle      = BLE_GATT_HANDLE_INVALID,
+                        };
+                        ble_nus_c_handles_t nus_none =
+                        {
+                                .nus_tx_handle      = BLE_GATT_HANDLE_INVALID,
+                                .nus_tx_cccd_handle = BLE_GATT_HANDLE_INVALID,
+                                .nus_rx_handle      = BLE_GATT_HANDLE_INVALID,
+                        };
 
-                // Discover peer's services.
-                err_code = ble_db_discovery_start(&m_db_disc, p_ble_evt->evt.gap_evt.conn_handle);
-                NRF_LOG_INFO("db_discovery_start = error_code = %x", err_code);
-                APP_ERROR_CHECK(err_code);
+                        err_code = ble_bas_c_handles_assign(&p_link->bas_c, p_gap_evt->conn_handle, &bas_none);
+                        APP_ERROR_CHECK(err_code);
 
-                err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
-                APP_ERROR_CHECK(err_code);
+                        err_code = ble_hrs_c_handles_assign(&p_link->hrs_c, p_gap_evt->conn_handle, &hrs_none);
+                        APP_ERROR_CHECK(err_code);
 
-                if (ble_conn_state_central_conn_count() < NRF_SDH_BLE_CENTRAL_LINK_COUNT)
-                {
-                        scan_start();
+                        err_code = ble_nus_c_handles_assign(&p_link->nus_c, p_gap_evt->conn_handle, &nus_none);
+                        APP_ERROR_CHECK(err_code);
                 }
-        } break;
 
-        case BLE_GAP_EVT_DISCONNECTED:
-        {
-                NRF_LOG_INFO("HRS central link 0x%x disconnected (reason: 0x%x)",
-                             p_gap_evt->conn_handle,
-                             p_gap_evt->params.disconnected.reason);
+                // A bonded peer may keep its CCCDs for encrypted links, it is encrypted right away.
+                p_link->cccd_encrypt = m_secure_early && link_is_bonded(p_link);
 
-                // err_code = bsp_indication_set(BSP_INDICATE_IDLE);
-                // APP_ERROR_CHECK(err_code);
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+                // The handles of a bonded peer are given to the clients instead of discovered.
+                p_link->cache_valid    = (peer_cache_load(p_gap_evt->conn_handle, &p_link->cache) == NRF_SUCCESS);
+                p_link->cccd_read_busy = false;
+#endif
 
-                if (ble_conn_state_central_conn_count() < NRF_SDH_BLE_CENTRAL_LINK_COUNT)
-                {
-                        err_code = app_button_disable();
-                        APP_ERROR_CHECK(err_code);
+                nus_mux_reset(&p_link->mux);
+                lat_probe_link_reset(p_link->slot);
+#if NRF_MODULE_ENABLED(HRV)
+                hrv_reset(&p_link->hrv);
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+                nus_tput_reset(&p_link->tput);
+#endif
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                nus_arq_reset(&p_link->arq);
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                nus_lz_reset(&p_link->lz);
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+                {
+                        ble_hrt_c_handles_t hrt_none =
+                        {
+                                .block_handle      = BLE_GATT_HANDLE_INVALID,
+                                .block_cccd_handle = BLE_GATT_HANDLE_INVALID,
+                        };
+
+                        err_code = ble_hrt_c_handles_assign(&p_link->hrt_c, p_gap_evt->conn_handle, &hrt_none);
+                        APP_ERROR_CHECK(err_code);
+                }
+
+                hrt_dec_reset(&p_link->hrt_dec);
+                p_link->hrm_bytes   = 0;
+                p_link->hrm_samples = 0;
+#endif
+
+                // Starts the discovery, the other stages follow from the events of the link.
+                link_fsm_start(&p_link->fsm);
+
+                err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
+                APP_ERROR_CHECK(err_code);
+
+                relay_link(p_link->slot, true);
+
+                scan_sched_on_connected();
+                scan_sched_stats_log();
+
+#if NRF_MODULE_ENABLED(BCAST_RX)
+                // Broadcasting sensors are followed with all links up too.
+                scan_start();
+#else
+                if (ble_conn_state_central_conn_count() < NRF_SDH_BLE_CENTRAL_LINK_COUNT)
+                {
+                        scan_start();
+                }
+#endif
+        } break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+        {
+                if (ble_conn_state_role(p_gap_evt->conn_handle) == BLE_GAP_ROLE_PERIPH)
+                {
+                        // The upstream link is handled by the relay.
+                        break;
+                }
+
+                NRF_LOG_INFO("HRS central link 0x%x disconnected (reason: 0x%x)",
+                             p_gap_evt->conn_handle,
+                             p_gap_evt->params.disconnected.reason);
+
+                // err_code = bsp_indication_set(BSP_INDICATE_IDLE);
+                // APP_ERROR_CHECK(err_code);
+
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                if (p_link != NULL)
+                {
+                        nus_arq_stats_log(&p_link->arq);
+                        nus_arq_reset(&p_link->arq);
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                        nus_lz_stats_log(&p_link->lz);
+#endif
+                }
+#endif
+
+#if NRF_MODULE_ENABLED(HRV)
+                if (p_link != NULL)
+                {
+                        hrv_log(&p_link->hrv, p_link->slot);
+                }
+#endif
+
+                if (p_link != NULL)
+                {
+                        link_fsm_stop(&p_link->fsm);
+                        relay_link(p_link->slot, false);
+                }
+
+                // All observers have seen the disconnection, the slot can be reused.
+                link_ctx_free(p_link);
+                scan_sched_on_disconnected();
+
+                if (ble_conn_state_central_conn_count() < NRF_SDH_BLE_CENTRAL_LINK_COUNT)
+                {
+                        err_code = app_button_disable();
+                        APP_ERROR_CHECK(err_code);
                         scan_start();
                 }
         } break;
@@ -351,6 +919,41 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
                 APP_ERROR_CHECK(err_code);
         } break;
 
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:
+                if ((p_link != NULL) && (p_gap_evt->params.conn_sec_update.conn_sec.sec_mode.lv >= 2))
+                {
+                        link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_ENCRYPTED);
+                }
+                break;
+
+        case BLE_GATTC_EVT_WRITE_RSP:
+        {
+                ble_gattc_evt_t const * p_gattc_evt = &p_ble_evt->evt.gattc_evt;
+
+                if ((p_link != NULL) &&
+                    (p_gattc_evt->params.write_rsp.handle == p_link->hrs_c.peer_hrs_db.hrm_cccd_handle))
+                {
+                        link_subscribe_rsp(p_link, p_gattc_evt->gatt_status);
+                }
+        } break;
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        case BLE_GATTC_EVT_READ_RSP:
+                if ((p_link != NULL) && p_link->cache_valid &&
+                    (p_ble_evt->evt.gattc_evt.params.read_rsp.handle == p_link->hrs_c.peer_hrs_db.hrm_cccd_handle))
+                {
+                        link_subscribe_check(p_link, &p_ble_evt->evt.gattc_evt);
+                }
+                break;
+#endif
+
+        case BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE:
+                if (p_link != NULL)
+                {
+                        nus_mux_tx_process(&p_link->mux);
+                }
+                break;
+
         case BLE_GATTC_EVT_TIMEOUT:
                 // Disconnect on GATT Client timeout event.
                 NRF_LOG_DEBUG("GATT Client Timeout.");
@@ -376,7 +979,9 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
                 break;
 
         case BLE_GAP_EVT_LESC_DHKEY_REQUEST:
+                // The key is computed by the main loop, see idle_state_handle().
                 NRF_LOG_INFO("BLE_GAP_EVT_LESC_DHKEY_REQUEST");
+                lesc_prof_dhkey_request();
                 break;
 
         case BLE_GAP_EVT_AUTH_STATUS:
@@ -391,6 +996,21 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
         default:
                 break;
         }
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+        // A CCCD read back refused while another client procedure ran is tried again once one
+        // ends. Waiting for the next stage is not enough, the link may have no stage left to reach.
+        if ((p_link != NULL) && p_link->cccd_read_busy &&
+            (p_ble_evt->header.evt_id >= BLE_GATTC_EVT_BASE) &&
+            (p_ble_evt->header.evt_id <= BLE_GATTC_EVT_LAST) &&
+            (p_ble_evt->header.evt_id != BLE_GATTC_EVT_TIMEOUT))
+        {
+                p_link->cccd_read_busy = false;
+                link_fsm_restart(&p_link->fsm, LINK_FSM_STAGE_SUBSCRIBED);
+        }
+#endif
+
+        EVT_PROF_END(EVT_PROF_SRC_BLE, (p_link != NULL) ? p_link->slot : EVT_PROF_NO_LINK);
 }
 
 
@@ -438,6 +1058,8 @@ static void ble_stack_init(void)
         err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
         APP_ERROR_CHECK(err_code);
 
+        ble_ram_cfg_init(ram_start);
+
         ble_cfg_t ble_cfg;
         // Configure the GATTS attribute table.
         memset(&ble_cfg, 0x00, sizeof(ble_cfg));
@@ -445,17 +1067,49 @@ static void ble_stack_init(void)
         ble_cfg.gap_cfg.role_count_cfg.central_role_count = NRF_SDH_BLE_CENTRAL_LINK_COUNT;
 
 //        ble_cfg.gap_cfg.role_count_cfg.qos_channel_survey_role_available = true; /* Enable channel survey role */
-        err_code = sd_ble_cfg_set(BLE_GAP_CFG_ROLE_COUNT, &ble_cfg, &ram_start);
+        err_code = sd_ble_cfg_set(BLE_GAP_CFG_ROLE_COUNT, &ble_cfg, ram_start);
         if (err_code != NRF_SUCCESS)
         {
                 NRF_LOG_ERROR("sd_ble_cfg_set() returned %s when attempting to set BLE_GAP_CFG_ROLE_COUNT.",
                               nrf_strerror_get(err_code));
         }
+        else
+        {
+                ble_ram_cfg_probe("GAP role count", ram_start);
+        }
+
+        err_code = ble_ram_cfg_conn_queues_set(APP_BLE_CONN_CFG_TAG, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+#if NRF_MODULE_ENABLED(RELAY)
+        // The default configuration counts every link, leave the peripheral link to the relay's own.
+        memset(&ble_cfg, 0x00, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                     = APP_BLE_CONN_CFG_TAG;
+        ble_cfg.conn_cfg.params.gap_conn_cfg.conn_count   = NRF_SDH_BLE_CENTRAL_LINK_COUNT;
+        ble_cfg.conn_cfg.params.gap_conn_cfg.event_length = NRF_SDH_BLE_GAP_EVENT_LENGTH;
+        err_code = sd_ble_cfg_set(BLE_CONN_CFG_GAP, &ble_cfg, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = relay_cfg_set(RELAY_BLE_CONN_CFG_TAG, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+        ble_ram_cfg_probe("relay link", ram_start);
+#endif
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        err_code = ble_l2cap_coc_cfg_set(APP_BLE_CONN_CFG_TAG, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+        ble_ram_cfg_probe("L2CAP CoC", ram_start);
+#endif
 
         // Enable BLE stack.
+        uint32_t const ram_start_link = ram_start;
         err_code = nrf_sdh_ble_enable(&ram_start);
         APP_ERROR_CHECK(err_code);
 
+        ble_ram_cfg_log(ram_start_link, ram_start);
+
         err_code = sd_power_mode_set(NRF_POWER_MODE_LOWPWR);
         APP_ERROR_CHECK(err_code);
 
@@ -477,8 +1131,11 @@ static void peer_manager_init(void)
         ble_gap_sec_params_t sec_param;
         ret_code_t err_code;
 
+        // Generates the LESC key pair, used for all pairings.
+        LESC_PROF_KEYGEN_BEGIN();
         err_code = pm_init();
         APP_ERROR_CHECK(err_code);
+        LESC_PROF_KEYGEN_END();
 
         memset(&sec_param, 0, sizeof(ble_gap_sec_params_t));
 
@@ -565,210 +1222,1109 @@ void bsp_event_handler(bsp_event_t event)
 /**@brief Function for handling characters received by the Nordic UART Service (NUS).
  *
  * @details This function takes a list of characters of length data_len and prints the characters out on UART.
- *          If @ref ECHOBACK_BLE_UART_DATA is set, the data is sent back to sender.
+ *          It runs from the main loop and does not wait for the UART: what does not fit in the TX
+ *          FIFO is dropped and counted, so that the scheduled SoftDevice events never wait behind
+ *          the 115200 baud line.
  */
 static void ble_nus_chars_received_uart_print(uint8_t * p_data, uint16_t data_len)
 {
-        ret_code_t ret_val;
+        static uint32_t dropped;                                /**< Bytes dropped since the start. */
+        uint16_t        sent = 0;
 
         NRF_LOG_DEBUG("Receiving data.");
         NRF_LOG_HEXDUMP_DEBUG(p_data, data_len);
 
-        for (uint32_t i = 0; i < data_len; i++)
+        while ((sent < data_len) && (app_uart_put(p_data[sent]) == NRF_SUCCESS))
         {
-                do
-                {
-                        ret_val = app_uart_put(p_data[i]);
-                        if ((ret_val != NRF_SUCCESS) && (ret_val != NRF_ERROR_BUSY))
-                        {
-                                NRF_LOG_ERROR("app_uart_put failed for index 0x%04x.", i);
-                                APP_ERROR_CHECK(ret_val);
-                        }
-                } while (ret_val == NRF_ERROR_BUSY);
+                sent++;
+        }
+        if ((sent == data_len) && (data_len > 0) && (p_data[data_len - 1] == '\r'))
+        {
+                UNUSED_RETURN_VALUE(app_uart_put('\n'));
         }
-        if (p_data[data_len-1] == '\r')
+
+        if (sent < data_len)
         {
-                while (app_uart_put('\n') == NRF_ERROR_BUSY);
+                dropped += data_len - sent;
+                NRF_LOG_WARNING("UART TX FIFO full, %d bytes dropped, %d in total.",
+                                data_len - sent, dropped);
         }
 }
 
 
-/**@brief   Function for handling app_uart events.
+/**@brief Function for sending a multiplexer packet to a link.
  *
- * @details This function receives a single character from the app_uart module and appends it to
- *          a string. The string is sent over BLE when the last character received is a
- *          'new line' '\n' (hex 0x0A) or if the string reaches the maximum data length.
+ * @details The packet goes over the L2CAP channel of the link once it is set up, and over the
+ *          Nordic UART Service otherwise. Busy transports return NRF_ERROR_RESOURCES and the
+ *          multiplexer retries on the next TX complete event.
+ *
+ * @param[in] p_context  Link to send to.
+ * @param[in] p_data     Packet to send.
+ * @param[in] length     Length of the packet.
+ *
+ * @return The result of the transport used.
  */
-void uart_event_handle(app_uart_evt_t * p_event)
+static ret_code_t link_mux_send(void * p_context, uint8_t * p_data, uint16_t length)
 {
-        static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
-        static uint16_t index = 0;
-        uint32_t ret_val;
+        link_ctx_t * p_link = (link_ctx_t *)p_context;
 
-        switch (p_event->evt_type)
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        if (ble_l2cap_coc_is_connected(&p_link->coc))
         {
-        /**@snippet [Handling data from UART] */
-        case APP_UART_DATA_READY:
-                UNUSED_VARIABLE(app_uart_get(&data_array[index]));
-                index++;
+                return ble_l2cap_coc_data_send(&p_link->coc, p_data, length);
+        }
+#endif
 
-                if ((data_array[index - 1] == '\n') || (index >= (m_ble_nus_max_data_len)))
-                {
-                        NRF_LOG_DEBUG("Ready to send data over BLE NUS");
-                        NRF_LOG_HEXDUMP_DEBUG(data_array, index);
+        return ble_nus_c_string_send(&p_link->nus_c, p_data, length);
+}
 
-                        do
-                        {
-                                for (uint32_t i = 0; i < NRF_SDH_BLE_CENTRAL_LINK_COUNT; i++)
-                                {
-                                        ret_val = ble_nus_c_string_send(&m_ble_nus_c[i], data_array, index);
-//                                        if ( (ret_val != NRF_ERROR_INVALID_STATE) && (ret_val != NRF_ERROR_RESOURCES) )
-//                                        {
-//                                                APP_ERROR_CHECK(ret_val);
-//                                        }
-                                }
-                        } while (ret_val == NRF_ERROR_RESOURCES);
 
-                        index = 0;
-                }
-                break;
+/**@brief Function for passing data received from a link to the main loop.
+ *
+ * @param[in] p_link  Link the data was received from.
+ * @param[in] p_data  Received data.
+ * @param[in] len     Length of the data.
+ */
+static void link_data_put(link_ctx_t const * p_link, uint8_t const * p_data, uint16_t len)
+{
+        // Printed from the main loop, see app_evt_handler().
+        for (uint16_t offset = 0; offset < len; offset += BLE_NUS_MAX_DATA_LEN)
+        {
+                UNUSED_RETURN_VALUE(app_evt_queue_nus_put(p_link->slot,
+                                                          &p_data[offset],
+                                                          MIN(len - offset, BLE_NUS_MAX_DATA_LEN)));
+        }
+}
 
-        /**@snippet [Handling data from UART] */
-        case APP_UART_COMMUNICATION_ERROR:
-                NRF_LOG_ERROR("Communication error occurred while handling UART.");
-                APP_ERROR_HANDLER(p_event->data.error_communication);
-                break;
 
-        case APP_UART_FIFO_ERROR:
-                NRF_LOG_ERROR("Error occurred in FIFO module used by UART.");
-                APP_ERROR_HANDLER(p_event->data.error_code);
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+/**@brief Function for handling events from the reliable transfer of a link.
+ *
+ * @param[in] p_arq  Reliable transfer instance of the link.
+ * @param[in] p_evt  Event.
+ */
+static void arq_evt_handler(nus_arq_t * p_arq, nus_arq_evt_t const * p_evt)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_arq, link_ctx_t, arq);
+
+        switch (p_evt->type)
+        {
+        case NUS_ARQ_EVT_RX_DATA:
+        {
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                uint8_t const * p_data;
+                uint16_t        len;
+
+                if (nus_lz_decode(&p_link->lz, p_evt->p_data, p_evt->len, &p_data, &len) == NRF_SUCCESS)
+                {
+                        link_data_put(p_link, p_data, len);
+                }
+#else
+                link_data_put(p_link, p_evt->p_data, p_evt->len);
+#endif
+        } break;
+
+        case NUS_ARQ_EVT_TX_RDY:
+                NRF_LOG_DEBUG("Link 0x%x accepts data again.", p_link->conn_handle);
                 break;
 
         default:
                 break;
         }
 }
+#endif // NRF_MODULE_ENABLED(NUS_ARQ)
 
-/**@snippet [Handling events from the ble_nus_c module] */
-static void ble_nus_c_evt_handler(ble_nus_c_t * p_ble_nus_c, ble_nus_c_evt_t const * p_ble_nus_c_evt)
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+/**@brief Function for logging the throughput of one direction of a link.
+ *
+ * @param[in] p_dir          Name of the direction.
+ * @param[in] p_stats        Statistics of the receiver.
+ * @param[in] conn_interval  Connection interval in 1.25 ms units.
+ */
+static void tput_dir_log(char const * p_dir, nus_tput_rx_stats_t const * p_stats, uint16_t conn_interval)
 {
-        ret_code_t err_code;
+        uint32_t per_event;
 
-        switch (p_ble_nus_c_evt->evt_type)
+        if (p_stats->ms == 0)
         {
-        case BLE_NUS_C_EVT_DISCOVERY_COMPLETE:
-                NRF_LOG_INFO("NUS Service discovered on conn_handle 0x%x",
-                             p_ble_nus_c_evt->conn_handle);
+                NRF_LOG_INFO("  %s: %d bytes, too few packets to time.", p_dir, p_stats->bytes);
+                return;
+        }
 
-                err_code = ble_nus_c_handles_assign(p_ble_nus_c, p_ble_nus_c_evt->conn_handle, &p_ble_nus_c_evt->handles);
-                APP_ERROR_CHECK(err_code);
+        // Packets per connection event, in hundredths.
+        per_event = (uint32_t)((uint64_t)p_stats->chunks * conn_interval * 125 / p_stats->ms);
+
+        NRF_LOG_INFO("  %s: %d kbps, %d bytes in %d ms.",
+                     p_dir,
+                     (uint32_t)((uint64_t)p_stats->bytes * 8 / p_stats->ms),
+                     p_stats->bytes,
+                     p_stats->ms);
+        NRF_LOG_INFO("  %s: %d.%02d packets per connection event, %d out of sequence.",
+                     p_dir,
+                     per_event / 100,
+                     per_event % 100,
+                     p_stats->errors);
+}
 
 
-                NRF_LOG_INFO("Before enable the tx notification");
-                NRF_LOG_HEXDUMP_DEBUG(p_ble_nus_c, sizeof(ble_nus_c_t));
-                err_code = ble_nus_c_tx_notif_enable(p_ble_nus_c);
-                APP_ERROR_CHECK(err_code);
+/**@brief Function for handling events from the throughput test of a link.
+ *
+ * @param[in] p_tput  Throughput test instance of the link.
+ * @param[in] p_evt   Event.
+ */
+static void tput_evt_handler(nus_tput_t * p_tput, nus_tput_evt_t const * p_evt)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_tput, link_ctx_t, tput);
+        char const * p_transport = "NUS";
 
-                NRF_LOG_INFO("Connected to device with Nordic UART Service.\n\n");
-                break;
+        if (p_evt->type != NUS_TPUT_EVT_RESULT)
+        {
+                return;
+        }
 
-        case BLE_NUS_C_EVT_NUS_TX_EVT:
-                ble_nus_chars_received_uart_print(p_ble_nus_c_evt->p_data, p_ble_nus_c_evt->data_len);
-                break;
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        if (ble_l2cap_coc_is_connected(&p_link->coc))
+        {
+                p_transport = "L2CAP";
+        }
+#endif
 
-        case BLE_NUS_C_EVT_DISCONNECTED:
-                NRF_LOG_INFO("Disconnected.");
-                scan_start();
-                break;
+        NRF_LOG_INFO("Throughput of link 0x%x over %s, %d byte packets, ATT MTU %d:",
+                     p_link->conn_handle,
+                     p_transport,
+                     p_link->mux.payload_max,
+                     nrf_ble_gatt_eff_mtu_get(&m_gatt, p_link->conn_handle));
+        NRF_LOG_INFO("  %s PHY, %d byte Link Layer payload, %d.%02d ms connection interval.",
+                     (p_link->tx_phy == BLE_GAP_PHY_2MBPS) ? "2M" :
+                     (p_link->tx_phy == BLE_GAP_PHY_CODED) ? "Coded" : "1M",
+                     p_link->tx_octets,
+                     p_link->conn_interval * 125 / 100,
+                     p_link->conn_interval * 125 % 100);
+
+        tput_dir_log("to central", p_evt->p_local, p_link->conn_interval);
+        tput_dir_log("to peripheral", p_evt->p_peer, p_link->conn_interval);
+}
+
+
+/**@brief Function for ending the throughput test on every link in it. */
+static void tput_stop(void)
+{
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_ctx_t * p_link = link_ctx_at(i);
+
+                if (!(m_tput_slots & (1UL << i)) || !link_ctx_in_use(p_link))
+                {
+                        continue;
+                }
+
+                if (nus_tput_stop(&p_link->tput) != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Throughput test of link 0x%x not stopped.", p_link->conn_handle);
+                }
         }
+
+        m_tput_slots = 0;
 }
 
-/**@brief Heart Rate Collector Handler.
+
+static void tput_timeout_handler(void * p_context)
+{
+        UNUSED_PARAMETER(p_context);
+        tput_stop();
+}
+
+
+/**@brief Function for starting a throughput test on every link that has found the service.
+ *
+ * @param[in] seconds     Duration of the test.
+ * @param[in] central_tx  True if the central sends test data.
+ * @param[in] periph_tx   True if the peripherals send test data.
  */
-static void hrs_c_evt_handler(ble_hrs_c_t * p_hrs_c, ble_hrs_c_evt_t * p_hrs_c_evt)
+static void tput_start(uint32_t seconds, bool central_tx, bool periph_tx)
 {
         ret_code_t err_code;
 
-        switch (p_hrs_c_evt->evt_type)
+        if (m_tput_slots != 0)
         {
-        case BLE_HRS_C_EVT_DISCOVERY_COMPLETE:
+                NRF_LOG_WARNING("Throughput test already running.");
+                return;
+        }
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
         {
-                //NRF_LOG_DEBUG("Heart rate service discovered.");
-                NRF_LOG_INFO("Heart Rate Service discovered on conn_handle 0x%x",
-                             p_hrs_c_evt->conn_handle);
+                link_ctx_t * p_link = link_ctx_at(i);
 
-                err_code = ble_hrs_c_handles_assign(p_hrs_c,
-                                                    p_hrs_c_evt->conn_handle,
-                                                    &p_hrs_c_evt->params.peer_db);
-                APP_ERROR_CHECK(err_code);
+                if (!link_ctx_in_use(p_link) ||
+                    (p_link->nus_c.handles.nus_rx_handle == BLE_GATT_HANDLE_INVALID))
+                {
+                        continue;
+                }
 
-                // Initiate bonding.
-                err_code = pm_conn_secure(p_hrs_c_evt->conn_handle, false);
-                if (err_code != NRF_ERROR_BUSY)
+                if (nus_tput_start(&p_link->tput, central_tx, periph_tx) == NRF_SUCCESS)
                 {
-                        APP_ERROR_CHECK(err_code);
+                        m_tput_slots |= (1UL << i);
                 }
+        }
 
-                // Heart rate service discovered. Enable notification of Heart Rate Measurement.
-                err_code = ble_hrs_c_hrm_notif_enable(p_hrs_c);
-                APP_ERROR_CHECK(err_code);
-        } break;
+        if (m_tput_slots == 0)
+        {
+                NRF_LOG_WARNING("No link to test.");
+                return;
+        }
 
-        case BLE_HRS_C_EVT_HRM_NOTIFICATION:
+        err_code = app_timer_start(m_tput_timer, APP_TIMER_TICKS(seconds * 1000), NULL);
+        APP_ERROR_CHECK(err_code);
+
+        NRF_LOG_INFO("Throughput test for %d s.", seconds);
+}
+#endif // NRF_MODULE_ENABLED(NUS_TPUT)
+
+
+/**@brief Function for handling a message received on the control channel of a link.
+ *
+ * @param[in] p_link  Link the message was received from.
+ * @param[in] p_data  Message, starting with its @ref nus_mux_op_t opcode.
+ * @param[in] len     Length of the message, at least 1.
+ */
+static void link_ctrl_handle(link_ctx_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+        switch (p_data[0])
         {
-                NRF_LOG_INFO("Heart Rate = %d.", p_hrs_c_evt->params.hrm.hr_value);
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        case NUS_MUX_OP_ARQ_ACK:
+                nus_arq_on_ack(&p_link->arq, p_data, len);
+                break;
+#endif
 
-                if (p_hrs_c_evt->params.hrm.rr_intervals_cnt != 0)
-                {
-                        uint32_t rr_avg = 0;
-                        for (uint32_t i = 0; i < p_hrs_c_evt->params.hrm.rr_intervals_cnt; i++)
-                        {
-                                rr_avg += p_hrs_c_evt->params.hrm.rr_intervals[i];
-                        }
-                        rr_avg = rr_avg / p_hrs_c_evt->params.hrm.rr_intervals_cnt;
-                        NRF_LOG_DEBUG("rr_interval (avg) = %d.", rr_avg);
-                }
-        } break;
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        case NUS_MUX_OP_LZ_HELLO:
+                nus_lz_on_hello(&p_link->lz, p_data, len);
+                break;
+#endif
+
+#if NRF_MODULE_ENABLED(LAT_PROBE)
+        case NUS_MUX_OP_PONG:
+                lat_probe_on_pong(p_link->slot, p_data, len);
+                break;
+#endif
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        case NUS_MUX_OP_TPUT_START:
+        case NUS_MUX_OP_TPUT_STOP:
+        case NUS_MUX_OP_TPUT_RESULT:
+                nus_tput_on_ctrl(&p_link->tput, p_data, len);
+                break;
+#endif
 
         default:
+                NRF_LOG_DEBUG("Control opcode 0x%x from link 0x%x ignored.", p_data[0], p_link->conn_handle);
                 break;
         }
 }
 
 
-/**@brief Battery level Collector Handler.
+/**@brief Function for sending a UART line to a link.
+ *
+ * @param[in] p_link  Link to send to.
+ * @param[in] p_data  Data to send.
+ * @param[in] len     Length of the data.
+ *
+ * @return The result of the layer the data is queued in.
  */
-static void bas_c_evt_handler(ble_bas_c_t * p_bas_c, ble_bas_c_evt_t * p_bas_c_evt)
+static ret_code_t link_data_send(link_ctx_t * p_link, uint8_t const * p_data, uint16_t len)
+{
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        uint8_t    coded[NUS_LZ_ENC_MAX];
+        uint16_t   coded_len;
+        ret_code_t err_code;
+
+        err_code = nus_lz_encode(&p_link->lz, p_data, len, coded, &coded_len);
+        VERIFY_SUCCESS(err_code);
+
+        // The peer only sees the line if it was queued, keep the histories in step.
+        err_code = nus_arq_send(&p_link->arq, coded, coded_len);
+        if (err_code == NRF_SUCCESS)
+        {
+                nus_lz_encode_commit(&p_link->lz);
+        }
+
+        return err_code;
+#elif NRF_MODULE_ENABLED(NUS_ARQ)
+        return nus_arq_send(&p_link->arq, p_data, len);
+#else
+        return nus_mux_send(&p_link->mux, NUS_MUX_CH_DATA, p_data, len, true);
+#endif
+}
+
+
+/**@brief Function for handling events from the multiplexer of a link.
+ *
+ * @param[in] p_mux  Multiplexer of the link.
+ * @param[in] p_evt  Event.
+ */
+static void mux_evt_handler(nus_mux_t * p_mux, nus_mux_evt_t const * p_evt)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_mux, link_ctx_t, mux);
+
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        if ((p_evt->type == NUS_MUX_EVT_TX_RDY) && (p_evt->ch == NUS_MUX_CH_DATA))
+        {
+                nus_arq_on_tx_rdy(&p_link->arq);
+        }
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        if ((p_evt->type == NUS_MUX_EVT_TX_RDY) && (p_evt->ch == NUS_MUX_CH_TEST))
+        {
+                nus_tput_on_tx_rdy(&p_link->tput);
+        }
+#endif
+
+        if (p_evt->type != NUS_MUX_EVT_RX_DATA)
+        {
+                return;
+        }
+
+        switch (p_evt->ch)
+        {
+        case NUS_MUX_CH_DATA:
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                nus_arq_on_data(&p_link->arq, p_evt->p_data, p_evt->len, p_evt->eom);
+#else
+                link_data_put(p_link, p_evt->p_data, p_evt->len);
+#endif
+                break;
+
+        case NUS_MUX_CH_CTRL:
+                if (p_evt->len > 0)
+                {
+                        link_ctrl_handle(p_link, p_evt->p_data, p_evt->len);
+                }
+                break;
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        case NUS_MUX_CH_TEST:
+                nus_tput_on_data(&p_link->tput, p_evt->p_data, p_evt->len);
+                break;
+#endif
+
+        default:
+                NRF_LOG_DEBUG("%d bytes on channel %d of link 0x%x ignored.",
+                              p_evt->len, p_evt->ch, p_link->conn_handle);
+                break;
+        }
+}
+
+
+/**@brief UART command handler type.
+ *
+ * @param[in] argc  Number of words in the command, the command name included.
+ * @param[in] argv  Words of the command.
+ */
+typedef void (* uart_cmd_handler_t)(uint32_t argc, char * const * argv);
+
+/**@brief UART command. */
+typedef struct
+{
+        char const       * p_name;  /**< Name of the command, without @ref UART_CMD_PREFIX. */
+        char const       * p_usage; /**< Arguments, printed by the help command. */
+        uart_cmd_handler_t handler; /**< Handler of the command. */
+} uart_cmd_t;
+
+static void uart_cmd_help(uint32_t argc, char * const * argv);
+
+
+#if NRF_MODULE_ENABLED(LAT_PROBE)
+/**@brief Function for handling the latency probe command.
+ *
+ * @details "on [size]" starts the probe, "off" stops it, no argument reports the current window.
+ */
+static void uart_cmd_lat(uint32_t argc, char * const * argv)
+{
+        if ((argc >= 2) && (strcmp(argv[1], "on") == 0))
+        {
+                uint32_t size = (argc >= 3) ? strtoul(argv[2], NULL, 10) : LAT_PROBE_HDR_LEN;
+
+                if ((size > UINT16_MAX) || (lat_probe_start((uint16_t)size) != NRF_SUCCESS))
+                {
+                        NRF_LOG_WARNING("Probe size must be %d to %d bytes.",
+                                        LAT_PROBE_HDR_LEN, NUS_MUX_PACKET_MAX - NUS_MUX_HDR_LEN);
+                }
+        }
+        else if ((argc >= 2) && (strcmp(argv[1], "off") == 0))
+        {
+                lat_probe_stop();
+        }
+        else if ((argc == 1) && lat_probe_is_running())
+        {
+                lat_probe_report();
+        }
+        else
+        {
+                uart_cmd_help(0, NULL);
+        }
+}
+#endif // NRF_MODULE_ENABLED(LAT_PROBE)
+
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+/**@brief Function for handling the throughput test command.
+ *
+ * @details "[seconds] [rx | tx | both]" runs a test, rx has the peripherals send and tx the
+ *          central. "off" ends the test early.
+ */
+static void uart_cmd_tput(uint32_t argc, char * const * argv)
+{
+        uint32_t seconds    = TPUT_TIME_DEFAULT_S;
+        bool     central_tx = false;
+        bool     periph_tx  = true;
+
+        if ((argc >= 2) && (strcmp(argv[1], "off") == 0))
+        {
+                ret_code_t err_code = app_timer_stop(m_tput_timer);
+                APP_ERROR_CHECK(err_code);
+
+                tput_stop();
+                return;
+        }
+
+        if (argc >= 2)
+        {
+                seconds = strtoul(argv[1], NULL, 10);
+        }
+        if (argc >= 3)
+        {
+                central_tx = (strcmp(argv[2], "tx") == 0) || (strcmp(argv[2], "both") == 0);
+                periph_tx  = (strcmp(argv[2], "rx") == 0) || (strcmp(argv[2], "both") == 0);
+        }
+
+        if ((seconds == 0) || (seconds > TPUT_TIME_MAX_S) || (!central_tx && !periph_tx))
+        {
+                uart_cmd_help(0, NULL);
+                return;
+        }
+
+        tput_start(seconds, central_tx, periph_tx);
+}
+#endif // NRF_MODULE_ENABLED(NUS_TPUT)
+
+
+/**@brief Function for handling the link bring-up statistics command.
+ *
+ * @details No argument logs the time taken by each stage of the link bring-up, the use of the
+ *          peer cache and the cost of the LESC key computations, "reset" clears them.
+ *          "early" encrypts links to bonded peers on the connection, "late" after the discovery,
+ *          both clear the statistics so that the two can be compared.
+ */
+static void uart_cmd_fsm(uint32_t argc, char * const * argv)
+{
+        if ((argc >= 2) && (strcmp(argv[1], "reset") == 0))
+        {
+                link_fsm_stats_reset();
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+                peer_cache_stats_reset();
+#endif
+                lesc_prof_stats_reset();
+        }
+        else if ((argc >= 2) && ((strcmp(argv[1], "early") == 0) || (strcmp(argv[1], "late") == 0)))
+        {
+                m_secure_early = (strcmp(argv[1], "early") == 0);
+                link_fsm_stats_reset();
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+                peer_cache_stats_reset();
+#endif
+                lesc_prof_stats_reset();
+
+                NRF_LOG_INFO("Bonded peers encrypted %s.",
+                             m_secure_early ? "on the connection" : "after the discovery");
+        }
+        else if (argc == 1)
+        {
+                link_fsm_stats_log();
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+                peer_cache_stats_log();
+#endif
+                lesc_prof_stats_log();
+        }
+        else
+        {
+                uart_cmd_help(0, NULL);
+        }
+}
+
+
+#if NRF_MODULE_ENABLED(BCAST_RX)
+/**@brief Function for handling the broadcast ingest benchmark command.
+ *
+ * @details "[sensors] [reports] [rate]" feeds synthetic advertising reports through a table of
+ *          the broadcast receiver kept apart from the sensors it follows.
+ */
+static void uart_cmd_advbench(uint32_t argc, char * const * argv)
+{
+        uint32_t sensors = (argc >= 2) ? strtoul(argv[1], NULL, 10) : ADVBENCH_SENSORS_DEFAULT;
+        uint32_t reports = (argc >= 3) ? strtoul(argv[2], NULL, 10) : ADVBENCH_REPORTS_DEFAULT;
+        uint32_t rate    = (argc >= 4) ? strtoul(argv[3], NULL, 10) : ADVBENCH_RATE_DEFAULT;
+
+        switch (bcast_rx_bench(sensors, reports, rate))
+        {
+        case NRF_SUCCESS:
+                break;
+
+        case NRF_ERROR_BUSY:
+                NRF_LOG_INFO("Ingest benchmark already running.");
+                break;
+
+        case NRF_ERROR_NO_MEM:
+                NRF_LOG_WARNING("Ingest benchmark not started, scheduler queue full.");
+                break;
+
+        default:
+                NRF_LOG_INFO("At most %d sensors and %d reports.",
+                             BCAST_RX_BENCH_SENSORS_MAX, BCAST_RX_BENCH_REPORTS_MAX);
+                uart_cmd_help(0, NULL);
+                break;
+        }
+}
+#endif // NRF_MODULE_ENABLED(BCAST_RX)
+
+
+static uart_cmd_t const m_uart_cmds[] =
+{
+        {"help", "",                 uart_cmd_help},
+        {"fsm",  "[reset | early | late]", uart_cmd_fsm},
+#if NRF_MODULE_ENABLED(LAT_PROBE)
+        {"lat",  "[on [size] | off]", uart_cmd_lat},
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        {"tput", "[seconds [rx | tx | both] | off]", uart_cmd_tput},
+#endif
+#if NRF_MODULE_ENABLED(BCAST_RX)
+        {"advbench", "[sensors [reports [rate]]]", uart_cmd_advbench},
+#endif
+};
+
+
+/**@brief Function for listing the UART commands. */
+static void uart_cmd_help(uint32_t argc, char * const * argv)
+{
+        UNUSED_PARAMETER(argc);
+        UNUSED_PARAMETER(argv);
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(m_uart_cmds); i++)
+        {
+                NRF_LOG_INFO("%c%s %s", UART_CMD_PREFIX, m_uart_cmds[i].p_name, m_uart_cmds[i].p_usage);
+        }
+}
+
+
+/**@brief Function for running a command line received on the UART.
+ *
+ * @param[in] p_line  Line, starting with @ref UART_CMD_PREFIX.
+ * @param[in] len     Length of the line.
+ */
+static void uart_cmd_handle(uint8_t const * p_line, uint16_t len)
+{
+        char     line[BLE_NUS_MAX_DATA_LEN + 1];
+        char   * argv[UART_CMD_ARGS_MAX];
+        uint32_t argc = 0;
+        char   * p_word;
+
+        len = MIN(len, sizeof(line) - 1);
+        memcpy(line, p_line + 1, len - 1);
+        line[len - 1] = '\0';
+
+        for (p_word = strtok(line, " \t\r\n");
+             (p_word != NULL) && (argc < UART_CMD_ARGS_MAX);
+             p_word = strtok(NULL, " \t\r\n"))
+        {
+                argv[argc++] = p_word;
+        }
+
+        if (argc == 0)
+        {
+                return;
+        }
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(m_uart_cmds); i++)
+        {
+                if (strcmp(argv[0], m_uart_cmds[i].p_name) == 0)
+                {
+                        m_uart_cmds[i].handler(argc, argv);
+                        return;
+                }
+        }
+
+        NRF_LOG_WARNING("Unknown command, %chelp lists them.", UART_CMD_PREFIX);
+}
+
+
+/**@brief UART line waiting for the main loop. */
+typedef struct
+{
+        uint16_t len;                           /**< Length of the line, 0 if the entry is free. */
+        uint8_t  data[BLE_NUS_MAX_DATA_LEN];    /**< Line. */
+} uart_line_t;
+
+static uart_line_t m_uart_lines[UART_LINES];                        /**< Lines received by the UART interrupt, run by uart_line_run(). */
+static uint32_t    m_uart_lines_dropped;                            /**< Lines dropped because none of m_uart_lines was free. */
+
+
+/**@brief Function for running a UART line from the main loop.
+ *
+ * @details Commands and data for the links run in the same context as the BLE events, so they
+ *          can use the state of the links, their multiplexers and reliable transfers without
+ *          critical regions.
+ *
+ * @param[in] p_event_data  Index of the line in m_uart_lines.
+ * @param[in] event_size    Size of the index.
+ */
+static void uart_line_run(void * p_event_data, uint16_t event_size)
+{
+        uart_line_t * p_line = &m_uart_lines[*(uint8_t *)p_event_data];
+        ret_code_t    ret_val;
+
+        UNUSED_PARAMETER(event_size);
+
+        EVT_PROF_BEGIN();
+
+        if (p_line->data[0] == UART_CMD_PREFIX)
+        {
+                uart_cmd_handle(p_line->data, p_line->len);
+        }
+        else
+        {
+                NRF_LOG_DEBUG("Ready to send data over BLE NUS");
+                NRF_LOG_HEXDUMP_DEBUG(p_line->data, p_line->len);
+
+                for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+                {
+                        link_ctx_t * p_link = link_ctx_at(i);
+
+                        if (!link_ctx_in_use(p_link))
+                        {
+                                continue;
+                        }
+
+                        ret_val = link_data_send(p_link, p_line->data, p_line->len);
+                        if (ret_val != NRF_SUCCESS)
+                        {
+                                NRF_LOG_DEBUG("Data to link 0x%x dropped: 0x%x.",
+                                              p_link->conn_handle, ret_val);
+                        }
+                }
+        }
+
+        // Last, the UART interrupt may take the entry as soon as it is free.
+        p_line->len = 0;
+
+        EVT_PROF_END(EVT_PROF_SRC_UART, EVT_PROF_NO_LINK);
+}
+
+
+/**@brief Function for passing a line received on the UART to the main loop.
+ *
+ * @details Called from the UART interrupt. The line is copied to a free entry of m_uart_lines,
+ *          if there is none or the scheduler queue is full the line is dropped and counted.
+ */
+static void uart_line_put(uint8_t const * p_data, uint16_t len)
+{
+        for (uint8_t i = 0; i < UART_LINES; i++)
+        {
+                if (m_uart_lines[i].len != 0)
+                {
+                        continue;
+                }
+
+                memcpy(m_uart_lines[i].data, p_data, len);
+                m_uart_lines[i].len = len;
+                if (app_evt_queue_sched_put(uart_line_run, &i, sizeof(i)) != NRF_SUCCESS)
+                {
+                        m_uart_lines[i].len = 0;
+                        break;
+                }
+                return;
+        }
+
+        m_uart_lines_dropped++;
+        NRF_LOG_WARNING("UART line dropped, %d in total.", m_uart_lines_dropped);
+}
+
+
+/**@brief   Function for handling app_uart events.
+ *
+ * @details This function receives a single character from the app_uart module and appends it to
+ *          a string. The string is passed to the main loop when the last character received is a
+ *          'new line' '\n' (hex 0x0A) or if the string reaches the maximum data length. There it
+ *          is sent over BLE, or run as a local command if it starts with @ref UART_CMD_PREFIX.
+ */
+void uart_event_handle(app_uart_evt_t * p_event)
+{
+        static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
+        static uint16_t index = 0;
+
+        switch (p_event->evt_type)
+        {
+        /**@snippet [Handling data from UART] */
+        case APP_UART_DATA_READY:
+                UNUSED_VARIABLE(app_uart_get(&data_array[index]));
+                index++;
+
+                // The multiplexer splits the line to fit the link, only the buffer size matters.
+                if ((data_array[index - 1] == '\n') || (index >= sizeof(data_array)))
+                {
+                        uart_line_put(data_array, index);
+                        index = 0;
+                }
+                break;
+
+        /**@snippet [Handling data from UART] */
+        case APP_UART_COMMUNICATION_ERROR:
+                NRF_LOG_ERROR("Communication error occurred while handling UART.");
+                APP_ERROR_HANDLER(p_event->data.error_communication);
+                break;
+
+        case APP_UART_FIFO_ERROR:
+                NRF_LOG_ERROR("Error occurred in FIFO module used by UART.");
+                APP_ERROR_HANDLER(p_event->data.error_code);
+                break;
+
+        default:
+                break;
+        }
+}
+
+
+/**@brief Function for starting the use of the Nordic UART Service of a link, once its handles
+ *        are known.
+ *
+ * @param[in] p_link  Link.
+ */
+static void link_nus_start(link_ctx_t * p_link)
+{
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC) || NRF_MODULE_ENABLED(NUS_LZ)
+        ret_code_t err_code;
+#endif
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        // The peer runs our firmware, offer it the L2CAP channel for the UART data.
+        err_code = ble_l2cap_coc_connect(&p_link->coc);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("L2CAP channel request failed: 0x%x.", err_code);
+        }
+#endif
+
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        // Tell the peer it may compress what it sends to us.
+        {
+                uint8_t hello[NUS_LZ_HELLO_LEN];
+
+                nus_lz_hello_get(hello);
+                err_code = nus_mux_send(&p_link->mux, NUS_MUX_CH_CTRL, hello, sizeof(hello), true);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Compression announcement failed: 0x%x.", err_code);
+                }
+        }
+#endif
+
+        UNUSED_PARAMETER(p_link);
+}
+
+/**@snippet [Handling events from the ble_nus_c module] */
+static void ble_nus_c_evt_handler(ble_nus_c_t * p_ble_nus_c, ble_nus_c_evt_t const * p_ble_nus_c_evt)
+{
+        ret_code_t err_code;
+
+        EVT_PROF_BEGIN();
+
+        switch (p_ble_nus_c_evt->evt_type)
+        {
+        case BLE_NUS_C_EVT_DISCOVERY_COMPLETE:
+                NRF_LOG_INFO("NUS Service discovered on conn_handle 0x%x",
+                             p_ble_nus_c_evt->conn_handle);
+
+                err_code = ble_nus_c_handles_assign(p_ble_nus_c, p_ble_nus_c_evt->conn_handle, &p_ble_nus_c_evt->handles);
+                APP_ERROR_CHECK(err_code);
+
+                // Notifications are enabled with the other services, see m_link_stages.
+                link_nus_start(CONTAINER_OF(p_ble_nus_c, link_ctx_t, nus_c));
+
+                NRF_LOG_INFO("Connected to device with Nordic UART Service.\n\n");
+                break;
+
+        case BLE_NUS_C_EVT_NUS_TX_EVT:
+                nus_mux_on_data(&CONTAINER_OF(p_ble_nus_c, link_ctx_t, nus_c)->mux,
+                                p_ble_nus_c_evt->p_data,
+                                p_ble_nus_c_evt->data_len);
+                break;
+
+        case BLE_NUS_C_EVT_DISCONNECTED:
+                NRF_LOG_INFO("Disconnected.");
+                scan_start();
+                break;
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_NUS_C, link_ctx_slot_get(p_ble_nus_c->conn_handle));
+}
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+/**@brief Function for handling events from the L2CAP channel transport.
+ *
+ * @param[in] p_coc  L2CAP channel instance of the link.
+ * @param[in] p_evt  Event.
+ */
+static void l2cap_coc_evt_handler(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_evt_t const * p_evt)
+{
+        link_ctx_t * p_link = CONTAINER_OF(p_coc, link_ctx_t, coc);
+
+        EVT_PROF_BEGIN();
+
+        switch (p_evt->evt_type)
+        {
+        case BLE_L2CAP_COC_EVT_CONNECTED:
+                NRF_LOG_INFO("UART data of link 0x%x moved to the L2CAP channel.", p_evt->conn_handle);
+                nus_mux_payload_max_set(&p_link->mux, p_coc->tx_mtu);
+                break;
+
+        case BLE_L2CAP_COC_EVT_REFUSED:
+                NRF_LOG_INFO("UART data of link 0x%x stays on NUS.", p_evt->conn_handle);
+                break;
+
+        case BLE_L2CAP_COC_EVT_DISCONNECTED:
+                nus_mux_payload_max_set(&p_link->mux,
+                                        nrf_ble_gatt_eff_mtu_get(&m_gatt, p_evt->conn_handle)
+                                        - OPCODE_LENGTH - HANDLE_LENGTH);
+                break;
+
+        case BLE_L2CAP_COC_EVT_RX_DATA:
+                nus_mux_on_data(&p_link->mux, p_evt->p_data, p_evt->data_len);
+                break;
+
+        case BLE_L2CAP_COC_EVT_TX_RDY:
+                nus_mux_tx_process(&p_link->mux);
+                break;
+
+        default:
+                break;
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_L2CAP, p_link->slot);
+}
+#endif // NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+
+/**@brief Heart Rate Collector Handler.
+ */
+static void hrs_c_evt_handler(ble_hrs_c_t * p_hrs_c, ble_hrs_c_evt_t * p_hrs_c_evt)
+{
+        ret_code_t err_code;
+
+        EVT_PROF_BEGIN();
+
+        switch (p_hrs_c_evt->evt_type)
+        {
+        case BLE_HRS_C_EVT_DISCOVERY_COMPLETE:
+        {
+                //NRF_LOG_DEBUG("Heart rate service discovered.");
+                NRF_LOG_INFO("Heart Rate Service discovered on conn_handle 0x%x",
+                             p_hrs_c_evt->conn_handle);
+
+                err_code = ble_hrs_c_handles_assign(p_hrs_c,
+                                                    p_hrs_c_evt->conn_handle,
+                                                    &p_hrs_c_evt->params.peer_db);
+                APP_ERROR_CHECK(err_code);
+
+                // Notifications wait for the end of the discovery, see m_link_stages.
+        } break;
+
+        case BLE_HRS_C_EVT_HRM_NOTIFICATION:
+        {
+                link_ctx_t * p_link = link_ctx_get(p_hrs_c_evt->conn_handle);
+
+                if (p_link != NULL)
+                {
+                        link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_STREAMING);
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+                        p_link->hrm_bytes   += HRM_LEN(&p_hrs_c_evt->params.hrm);
+                        p_link->hrm_samples += 1 + p_hrs_c_evt->params.hrm.rr_intervals_cnt;
+#endif
+                }
+
+                UNUSED_RETURN_VALUE(app_evt_queue_hrm_put(link_ctx_slot_get(p_hrs_c_evt->conn_handle),
+                                                          &p_hrs_c_evt->params.hrm));
+        } break;
+
+        default:
+                break;
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_HRS_C, link_ctx_slot_get(p_hrs_c_evt->conn_handle));
+}
+
+
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+/**@brief Function for handling a sample decoded from a telemetry block.
+ *
+ * @param[in] p_context  Link the block was received on.
+ * @param[in] type       Sample type.
+ * @param[in] t_ms       Time of the sample on the peer.
+ * @param[in] value      Sample value.
+ */
+static void hrt_sample_handler(void * p_context, hrt_sample_type_t type, uint32_t t_ms, uint16_t value)
+{
+        link_ctx_t const * p_link = (link_ctx_t const *)p_context;
+
+        NRF_LOG_DEBUG("%s %d at %d ms (slot %d).",
+                      (type == HRT_SAMPLE_HR) ? "HR" : "RR", value, t_ms, p_link->slot);
+}
+
+
+/**@brief Function for logging the telemetry statistics of a link.
+ *
+ * @details Compares the air cost of a sample in the telemetry blocks with the cost in the Heart
+ *          Rate Measurement notifications received on the same link, both with the ATT header.
+ *
+ * @param[in] p_link  Link.
+ */
+static void hrt_stats_log(link_ctx_t const * p_link)
+{
+        hrt_dec_stats_t const * p_stats  = &p_link->hrt_dec.stats;
+        uint32_t                hrt_cost = p_stats->bytes + HRM_ATT_HDR_LEN * p_stats->blocks;
+
+        NRF_LOG_INFO("HRT slot %d: %d blocks, %d samples, %d lost, %d malformed.",
+                     p_link->slot, p_stats->blocks, p_stats->samples, p_stats->lost, p_stats->errors);
+        NRF_LOG_INFO("Bytes per 100 samples: HRT %d, HRM %d.",
+                     (p_stats->samples == 0) ? 0 : (100 * hrt_cost / p_stats->samples),
+                     (p_link->hrm_samples == 0) ? 0 : (100 * p_link->hrm_bytes / p_link->hrm_samples));
+}
+
+
+/**@brief Heart Rate Telemetry Collector Handler.
+ */
+static void hrt_c_evt_handler(ble_hrt_c_t * p_hrt_c, ble_hrt_c_evt_t const * p_evt)
+{
+        ret_code_t   err_code;
+        link_ctx_t * p_link = CONTAINER_OF(p_hrt_c, link_ctx_t, hrt_c);
+
+        EVT_PROF_BEGIN();
+
+        switch (p_evt->evt_type)
+        {
+        case BLE_HRT_C_EVT_DISCOVERY_COMPLETE:
+                NRF_LOG_INFO("Heart Rate Telemetry Service discovered on conn_handle 0x%x",
+                             p_evt->conn_handle);
+
+                err_code = ble_hrt_c_handles_assign(p_hrt_c, p_evt->conn_handle, &p_evt->handles);
+                APP_ERROR_CHECK(err_code);
+                break;
+
+        case BLE_HRT_C_EVT_BLOCK:
+                err_code = hrt_dec_block(&p_link->hrt_dec, p_evt->p_data, p_evt->data_len);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Malformed telemetry block (slot %d).", p_link->slot);
+                }
+                break;
+
+        case BLE_HRT_C_EVT_DISCONNECTED:
+                hrt_stats_log(p_link);
+                break;
+
+        default:
+                break;
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_HRT_C, p_link->slot);
+}
+#endif // NRF_MODULE_ENABLED(BLE_HRT_C)
+
+
+/**@brief Battery level Collector Handler.
+ */
+static void bas_c_evt_handler(ble_bas_c_t * p_bas_c, ble_bas_c_evt_t * p_bas_c_evt)
+{
+        ret_code_t err_code;
+
+        EVT_PROF_BEGIN();
+
+        switch (p_bas_c_evt->evt_type)
+        {
+        case BLE_BAS_C_EVT_DISCOVERY_COMPLETE:
+        {
+                err_code = ble_bas_c_handles_assign(p_bas_c,
+                                                    p_bas_c_evt->conn_handle,
+                                                    &p_bas_c_evt->params.bas_db);
+                APP_ERROR_CHECK(err_code);
+
+                // The battery level is read and subscribed to with the other services.
+                NRF_LOG_INFO("Battery Service discovered.");
+        } break;
+
+        case BLE_BAS_C_EVT_BATT_NOTIFICATION:
+        case BLE_BAS_C_EVT_BATT_READ_RESP:
+                UNUSED_RETURN_VALUE(app_evt_queue_batt_put(link_ctx_slot_get(p_bas_c_evt->conn_handle),
+                                                           p_bas_c_evt->params.battery_level));
+                break;
+
+        default:
+                break;
+        }
+
+        EVT_PROF_END(EVT_PROF_SRC_BAS_C, link_ctx_slot_get(p_bas_c_evt->conn_handle));
+}
+
+
+/**@brief Function for handling application events drained from the event queue.
+ *
+ * @details Called from the main loop for every entry of @ref app_evt_queue. An entry can hold
+ *          several merged events of the same type from the same link.
+ *
+ * @param[in] p_evt  Application event.
+ */
+static void app_evt_handler(app_evt_t const * p_evt)
 {
-        ret_code_t err_code;
-
-        switch (p_bas_c_evt->evt_type)
-        {
-        case BLE_BAS_C_EVT_DISCOVERY_COMPLETE:
+        switch (p_evt->type)
         {
-                err_code = ble_bas_c_handles_assign(p_bas_c,
-                                                    p_bas_c_evt->conn_handle,
-                                                    &p_bas_c_evt->params.bas_db);
-                APP_ERROR_CHECK(err_code);
+        case APP_EVT_NUS_RX:
+                ble_nus_chars_received_uart_print((uint8_t *)p_evt->params.nus.data, p_evt->params.nus.len);
+                relay_data(p_evt->slot, p_evt->params.nus.data, p_evt->params.nus.len);
+                break;
 
-                // Battery service discovered. Enable notification of Battery Level.
-                NRF_LOG_INFO("Battery Service discovered. Reading battery level.");
+        case APP_EVT_HRM:
+        {
+                NRF_LOG_INFO("Heart Rate = %d (slot %d).", p_evt->params.hrm.hr_value, p_evt->slot);
 
-                err_code = ble_bas_c_bl_read(p_bas_c);
-                APP_ERROR_CHECK(err_code);
+                relay_hrm(p_evt->slot, p_evt->params.hrm.hr_value, p_evt->params.hrm.rr, p_evt->params.hrm.rr_cnt);
 
-                NRF_LOG_DEBUG("Enabling Battery Level Notification.");
-                err_code = ble_bas_c_bl_notif_enable(p_bas_c);
-                APP_ERROR_CHECK(err_code);
+#if NRF_MODULE_ENABLED(HRV)
+                link_ctx_t * p_link = link_ctx_at(p_evt->slot);
 
+                // The link may have gone while the event was queued.
+                if ((p_link != NULL) && (p_link->conn_handle != BLE_CONN_HANDLE_INVALID))
+                {
+                        if (hrv_rr_add(&p_link->hrv, p_evt->params.hrm.rr, p_evt->params.hrm.rr_cnt))
+                        {
+                                hrv_log(&p_link->hrv, p_evt->slot);
+                        }
+                }
+#else
+                if (p_evt->params.hrm.rr_cnt != 0)
+                {
+                        uint32_t rr_avg = 0;
+                        for (uint32_t i = 0; i < p_evt->params.hrm.rr_cnt; i++)
+                        {
+                                rr_avg += p_evt->params.hrm.rr[i];
+                        }
+                        rr_avg = rr_avg / p_evt->params.hrm.rr_cnt;
+                        NRF_LOG_DEBUG("rr_interval (avg) = %d.", rr_avg);
+                }
+#endif
         } break;
 
-        case BLE_BAS_C_EVT_BATT_NOTIFICATION:
-                NRF_LOG_INFO("Battery Level received %d %%.", p_bas_c_evt->params.battery_level);
-                break;
-
-        case BLE_BAS_C_EVT_BATT_READ_RESP:
-                NRF_LOG_INFO("Battery Level Read as %d %%.", p_bas_c_evt->params.battery_level);
+        case APP_EVT_BATT_LEVEL:
+                NRF_LOG_INFO("Battery Level %d %% (slot %d).", p_evt->params.batt_level, p_evt->slot);
+                relay_batt(p_evt->slot, p_evt->params.batt_level);
                 break;
 
         default:
@@ -787,13 +2343,10 @@ static void hrs_c_init(void)
 
         hrs_c_init_obj.evt_handler = hrs_c_evt_handler;
 
-        for (uint32_t i = 0; i < NRF_SDH_BLE_CENTRAL_LINK_COUNT; i++)
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
         {
-                // ret_code_t err_code = ble_hrs_c_init(&m_hrs_c, &hrs_c_init_obj);
-                // APP_ERROR_CHECK(err_code);
-                ret_code_t err_code = ble_hrs_c_init(&m_ble_hrs_c[i], &hrs_c_init_obj);
+                err_code = ble_hrs_c_init(&link_ctx_at(i)->hrs_c, &hrs_c_init_obj);
                 APP_ERROR_CHECK(err_code);
-
         }
 }
 
@@ -808,9 +2361,9 @@ static void bas_c_init(void)
 
         bas_c_init_obj.evt_handler = bas_c_evt_handler;
 
-        for (uint32_t i = 0; i < NRF_SDH_BLE_CENTRAL_LINK_COUNT; i++)
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
         {
-                ret_code_t err_code = ble_bas_c_init(&m_ble_bas_c[i], &bas_c_init_obj);
+                err_code = ble_bas_c_init(&link_ctx_at(i)->bas_c, &bas_c_init_obj);
                 APP_ERROR_CHECK(err_code);
         }
 }
@@ -849,12 +2402,120 @@ static void nus_c_init(void)
 
         init.evt_handler = ble_nus_c_evt_handler;
 
-        for (uint32_t i = 0; i < NRF_SDH_BLE_CENTRAL_LINK_COUNT; i++)
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                err_code = ble_nus_c_init(&link_ctx_at(i)->nus_c, &init);
+                APP_ERROR_CHECK(err_code);
+        }
+}
+
+
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+/**@brief Function for initializing the Heart Rate Telemetry Service client and decoder of every link.
+ */
+static void hrt_c_init(void)
+{
+        ret_code_t       err_code;
+        ble_hrt_c_init_t init;
+
+        init.evt_handler = hrt_c_evt_handler;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                err_code = ble_hrt_c_init(&link_ctx_at(i)->hrt_c, &init);
+                APP_ERROR_CHECK(err_code);
+
+                hrt_dec_init(&link_ctx_at(i)->hrt_dec, hrt_sample_handler, link_ctx_at(i));
+        }
+}
+#endif // NRF_MODULE_ENABLED(BLE_HRT_C)
+
+
+/**@brief Function for initializing the multiplexer of every link.
+ */
+static void mux_init(void)
+{
+        ret_code_t     err_code;
+        nus_mux_init_t init;
+
+        init.send        = link_mux_send;
+        init.evt_handler = mux_evt_handler;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                init.p_context = link_ctx_at(i);
+
+                err_code = nus_mux_init(&link_ctx_at(i)->mux, &init);
+                APP_ERROR_CHECK(err_code);
+        }
+}
+
+
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+/**@brief Function for initializing the reliable transfer and the compression of every link.
+ */
+static void arq_init(void)
+{
+        ret_code_t     err_code;
+        nus_arq_init_t init;
+
+        init.evt_handler = arq_evt_handler;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                init.p_mux = &link_ctx_at(i)->mux;
+
+                err_code = nus_arq_init(&link_ctx_at(i)->arq, &init);
+                APP_ERROR_CHECK(err_code);
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                nus_lz_init(&link_ctx_at(i)->lz);
+#endif
+        }
+}
+#endif // NRF_MODULE_ENABLED(NUS_ARQ)
+
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+/**@brief Function for initializing the throughput test of every link.
+ */
+static void tput_init(void)
+{
+        ret_code_t      err_code;
+        nus_tput_init_t init;
+
+        init.evt_handler = tput_evt_handler;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                init.p_mux = &link_ctx_at(i)->mux;
+
+                err_code = nus_tput_init(&link_ctx_at(i)->tput, &init);
+                APP_ERROR_CHECK(err_code);
+        }
+
+        err_code = app_timer_create(&m_tput_timer, APP_TIMER_MODE_SINGLE_SHOT, tput_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+}
+#endif // NRF_MODULE_ENABLED(NUS_TPUT)
+
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+/**@brief Function for initializing the L2CAP channel transport of every link.
+ */
+static void l2cap_coc_init(void)
+{
+        ret_code_t           err_code;
+        ble_l2cap_coc_init_t init;
+
+        init.evt_handler = l2cap_coc_evt_handler;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
         {
-                err_code = ble_nus_c_init(&m_ble_nus_c[i], &init);
+                err_code = ble_l2cap_coc_init(&link_ctx_at(i)->coc, &init);
                 APP_ERROR_CHECK(err_code);
         }
 }
+#endif
 
 
 /**
@@ -867,82 +2528,218 @@ static void db_discovery_init(void)
 }
 
 
-/**@brief Retrieve a list of peer manager peer IDs.
+/**@brief Function for loading the whitelist from the bonds in flash.
  *
- * @param[inout] p_peers   The buffer where to store the list of peer IDs.
- * @param[inout] p_size    In: The size of the @p p_peers buffer.
- *                         Out: The number of peers copied in the buffer.
+ * @details This is the only walk over the stored peers. The peer IDs come in flash order, the
+ *          peers are sorted by rank instead, which is raised every time a bond is stored. The
+ *          most recently bonded peers are kept if there are more than fit. From here on the
+ *          whitelist is kept up to date from Peer Manager events, see @ref pm_evt_handler.
  */
-static void peer_list_get(pm_peer_id_t * p_peers, uint32_t * p_size)
+static void whitelist_init(void)
 {
-        pm_peer_id_t peer_id;
-        uint32_t peers_to_copy;
+        pm_peer_id_t peer_id = pm_next_peer_id_get(PM_PEER_ID_INVALID);
+        pm_peer_id_t peers[WHITELIST_PEERS_MAX];
+        uint32_t     ranks[WHITELIST_PEERS_MAX];
+        uint32_t     cnt     = 0;
 
-        peers_to_copy = (*p_size < BLE_GAP_WHITELIST_ADDR_MAX_COUNT) ?
-                        *p_size : BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+        whitelist_clear();
 
-        peer_id = pm_next_peer_id_get(PM_PEER_ID_INVALID);
-        *p_size = 0;
-
-        while ((peer_id != PM_PEER_ID_INVALID) && (peers_to_copy--))
+        while (peer_id != PM_PEER_ID_INVALID)
         {
-                p_peers[(*p_size)++] = peer_id;
+                uint32_t rank     = 0;
+                uint32_t rank_len = sizeof(rank);
+                uint32_t i;
+
+                // A peer never ranked counts as the oldest.
+                if (pm_peer_data_load(peer_id, PM_PEER_DATA_ID_PEER_RANK, &rank, &rank_len) != NRF_SUCCESS)
+                {
+                        rank = 0;
+                }
+
+                // Insertion into the newest peers so far, lowest rank first.
+                if ((cnt < WHITELIST_PEERS_MAX) || (rank > ranks[0]))
+                {
+                        if (cnt == WHITELIST_PEERS_MAX)
+                        {
+                                memmove(&peers[0], &peers[1], (cnt - 1) * sizeof(peers[0]));
+                                memmove(&ranks[0], &ranks[1], (cnt - 1) * sizeof(ranks[0]));
+                                cnt--;
+                        }
+
+                        for (i = cnt; (i > 0) && (ranks[i - 1] > rank); i--)
+                        {
+                                peers[i] = peers[i - 1];
+                                ranks[i] = ranks[i - 1];
+                        }
+
+                        peers[i] = peer_id;
+                        ranks[i] = rank;
+                        cnt++;
+                }
+
                 peer_id = pm_next_peer_id_get(peer_id);
         }
+
+        for (uint32_t i = 0; i < cnt; i++)
+        {
+                whitelist_peer_add(peers[i]);
+        }
+
+        NRF_LOG_INFO("Whitelist loaded with %d of %d peers.", m_whitelist_peer_cnt, pm_peer_count());
 }
 
 
-static void whitelist_load()
+/**@brief Function for removing all peers from the whitelist. */
+static void whitelist_clear(void)
 {
-        ret_code_t ret;
-        pm_peer_id_t peers[8];
-        uint32_t peer_cnt;
+        m_whitelist_peer_cnt = 0;
+        m_whitelist_dirty    = true;
+}
+
+
+/**@brief Function for adding a bonded peer to the whitelist, as the most recently bonded.
+ *
+ * @details A peer already in the whitelist bonded again and moves to the end. If the whitelist is
+ *          full, the least recently bonded peer is evicted to make room, so the most recently
+ *          bonded peers can always reconnect. This is the order of the peer ranks.
+ *
+ * @param[in] peer_id  Peer to add.
+ */
+static void whitelist_peer_add(pm_peer_id_t peer_id)
+{
+        whitelist_peer_remove(peer_id);
+
+        if (m_whitelist_peer_cnt == WHITELIST_PEERS_MAX)
+        {
+                NRF_LOG_INFO("Whitelist full, evicting peer %d.", m_whitelist_peers[0]);
+                memmove(&m_whitelist_peers[0],
+                        &m_whitelist_peers[1],
+                        (WHITELIST_PEERS_MAX - 1) * sizeof(pm_peer_id_t));
+                m_whitelist_peer_cnt--;
+        }
+
+        m_whitelist_peers[m_whitelist_peer_cnt++] = peer_id;
+        m_whitelist_dirty                         = true;
+}
+
+
+/**@brief Function for removing a deleted peer from the whitelist.
+ *
+ * @param[in] peer_id  Peer to remove.
+ */
+static void whitelist_peer_remove(pm_peer_id_t peer_id)
+{
+        for (uint32_t i = 0; i < m_whitelist_peer_cnt; i++)
+        {
+                if (m_whitelist_peers[i] == peer_id)
+                {
+                        memmove(&m_whitelist_peers[i],
+                                &m_whitelist_peers[i + 1],
+                                (m_whitelist_peer_cnt - i - 1) * sizeof(pm_peer_id_t));
+                        m_whitelist_peer_cnt--;
+                        m_whitelist_dirty = true;
+                        return;
+                }
+        }
+}
+
 
-        memset(peers, PM_PEER_ID_INVALID, sizeof(peers));
-        peer_cnt = (sizeof(peers) / sizeof(pm_peer_id_t));
+/**@brief Function for giving the whitelist to the SoftDevice, if it has changed.
+ *
+ * @details Must be called while the whitelist is not in use, that is before the scan starts.
+ */
+static void whitelist_apply(void)
+{
+        ret_code_t ret;
 
-        // Load all peers from flash and whitelist them.
-        peer_list_get(peers, &peer_cnt);
+        if (!m_whitelist_dirty)
+        {
+                return;
+        }
 
-        ret = pm_whitelist_set(peers, peer_cnt);
+        ret = pm_whitelist_set(m_whitelist_peers, m_whitelist_peer_cnt);
         APP_ERROR_CHECK(ret);
 
         // Setup the device identies list.
         // Some SoftDevices do not support this feature.
-        ret = pm_device_identities_list_set(peers, peer_cnt);
+        ret = pm_device_identities_list_set(m_whitelist_peers, m_whitelist_peer_cnt);
         if (ret != NRF_ERROR_NOT_SUPPORTED)
         {
                 APP_ERROR_CHECK(ret);
         }
+
+#if NRF_MODULE_ENABLED(BCAST_RX)
+        for (uint32_t i = 0; i < m_whitelist_peer_cnt; i++)
+        {
+                pm_peer_data_bonding_t bonding;
+
+                ret = pm_peer_data_bonding_load(m_whitelist_peers[i], &bonding);
+                if (ret == NRF_SUCCESS)
+                {
+                        m_whitelist_ids[i] = bonding.peer_ble_id;
+                }
+                else
+                {
+                        // Deleted meanwhile, its removal from the whitelist follows.
+                        memset(&m_whitelist_ids[i], 0, sizeof(m_whitelist_ids[i]));
+                }
+        }
+#endif
+
+        m_whitelist_dirty = false;
 }
 
 
-static void on_whitelist_req(void)
+#if NRF_MODULE_ENABLED(BCAST_RX)
+/**@brief Function for checking an advertiser against the whitelist.
+ *
+ * @details Broadcasting sensors are never whitelisted, so the scan accepts all advertisers and
+ *          the whitelist only decides which of them are connected to. Resolvable private
+ *          addresses are resolved with the IRK of each peer.
+ *
+ * @param[in] p_addr  Address of the advertiser.
+ *
+ * @retval true  If the advertiser may be connected to.
+ */
+static bool whitelist_allows(ble_gap_addr_t const * p_addr)
 {
-        ret_code_t err_code;
+        if (!m_whitelist_only)
+        {
+                return true;
+        }
+
+        for (uint32_t i = 0; i < m_whitelist_peer_cnt; i++)
+        {
+                ble_gap_id_key_t const * p_id = &m_whitelist_ids[i];
+
+                if ((p_addr->addr_type == p_id->id_addr_info.addr_type) &&
+                    (memcmp(p_addr->addr, p_id->id_addr_info.addr, BLE_GAP_ADDR_LEN) == 0))
+                {
+                        return true;
+                }
 
-        // Whitelist buffers.
-        ble_gap_addr_t whitelist_addrs[8];
-        ble_gap_irk_t whitelist_irks[8];
+                if ((p_addr->addr_type == BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE) &&
+                    pm_address_resolve(p_addr, &p_id->id_info))
+                {
+                        return true;
+                }
+        }
 
-        memset(whitelist_addrs, 0x00, sizeof(whitelist_addrs));
-        memset(whitelist_irks,  0x00, sizeof(whitelist_irks));
+        return false;
+}
+#endif
 
-        uint32_t addr_cnt = (sizeof(whitelist_addrs) / sizeof(ble_gap_addr_t));
-        uint32_t irk_cnt  = (sizeof(whitelist_irks)  / sizeof(ble_gap_irk_t));
 
-        // Reload the whitelist and whitelist all peers.
-        whitelist_load();
+static void on_whitelist_req(void)
+{
+        ret_code_t err_code;
 
-        // Get the whitelist previously set using pm_whitelist_set().
-        err_code = pm_whitelist_get(whitelist_addrs, &addr_cnt,
-                                    whitelist_irks,  &irk_cnt);
+        whitelist_apply();
 
-        if (((addr_cnt == 0) && (irk_cnt == 0)) ||
-            (m_whitelist_disabled))
+        if ((m_whitelist_peer_cnt == 0) || (m_whitelist_disabled))
         {
                 // Don't use whitelist.
-                err_code = nrf_ble_scan_params_set(&m_scan, NULL);
+                err_code = nrf_ble_scan_params_set(&m_scan, scan_sched_params_get(false));
                 APP_ERROR_CHECK(err_code);
         }
 }
@@ -953,6 +2750,7 @@ static void on_whitelist_req(void)
 static void scan_start(void)
 {
         ret_code_t err_code;
+        bool       searching = (ble_conn_state_central_conn_count() < NRF_SDH_BLE_CENTRAL_LINK_COUNT);
 
         if (nrf_fstorage_is_busy(NULL))
         {
@@ -962,9 +2760,30 @@ static void scan_start(void)
 
         NRF_LOG_INFO("Starting scan.");
 
+#if NRF_MODULE_ENABLED(BCAST_RX)
+        // Broadcasting sensors are never whitelisted, the scan accepts all advertisers and the
+        // application applies the whitelist to the connections, see whitelist_allows(). Like
+        // on_whitelist_req(), a disabled whitelist is skipped for this scan only. Once all links
+        // are up, advertisers are only checked for broadcasts.
+        whitelist_apply();
+        m_whitelist_only        = (m_whitelist_peer_cnt > 0) && !m_whitelist_disabled;
+        m_whitelist_disabled    = false;
+        m_scan_connect          = searching;
+        m_scan.connect_if_match = false;
+        err_code = nrf_ble_scan_params_set(&m_scan, scan_sched_params_get(false));
+        APP_ERROR_CHECK(err_code);
+#else
+        // Start out with the whitelist, on_whitelist_req() falls back to accepting all advertisers
+        // if there is nothing to whitelist. Window and interval follow the established links.
+        err_code = nrf_ble_scan_params_set(&m_scan, scan_sched_params_get(true));
+        APP_ERROR_CHECK(err_code);
+#endif
+
         err_code = nrf_ble_scan_start(&m_scan);
         APP_ERROR_CHECK(err_code);
 
+        scan_sched_on_scan_start(searching);
+
         err_code = bsp_indication_set(BSP_INDICATE_SCANNING);
         APP_ERROR_CHECK(err_code);
 }
@@ -1017,16 +2836,42 @@ static void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t const *
         {
         case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
         {
+                link_ctx_t * p_link = link_ctx_get(p_evt->conn_handle);
+
                 NRF_LOG_INFO("GATT ATT MTU on connection 0x%x changed to %d.",
                              p_evt->conn_handle,
                              p_evt->params.att_mtu_effective);
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+                if ((p_link != NULL) && !ble_l2cap_coc_is_connected(&p_link->coc))
+#else
+                if (p_link != NULL)
+#endif
+                {
+                        nus_mux_payload_max_set(&p_link->mux,
+                                                p_evt->params.att_mtu_effective - OPCODE_LENGTH - HANDLE_LENGTH);
+                }
+
+                if (p_link != NULL)
+                {
+                        link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_MTU);
+                }
+
+                relay_on_att_mtu(p_evt->conn_handle, p_evt->params.att_mtu_effective);
         } break;
 
         case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
         {
+                link_ctx_t * p_link = link_ctx_get(p_evt->conn_handle);
+
                 NRF_LOG_INFO("Data length for connection 0x%x updated to %d.",
                              p_evt->conn_handle,
                              p_evt->params.data_length);
+
+                if (p_link != NULL)
+                {
+                        link_fsm_reach(&p_link->fsm, LINK_FSM_STAGE_DLE);
+                }
         } break;
 
         default:
@@ -1035,6 +2880,59 @@ static void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t const *
 }
 
 
+#if NRF_MODULE_ENABLED(SCAN_FILTER) || NRF_MODULE_ENABLED(BCAST_RX)
+/**@brief Function for connecting to an advertiser that matched the scan filters.
+ *
+ * @details Used when the scanning module leaves the connection to the application. With
+ *          @ref bcast_rx, the advertiser must also pass the whitelist.
+ *
+ * @param[in] p_report  Advertising report of the advertiser.
+ */
+static void scan_connect(ble_gap_evt_adv_report_t const * p_report)
+{
+        ret_code_t err_code;
+
+#if NRF_MODULE_ENABLED(BCAST_RX)
+        if (!m_scan_connect || !whitelist_allows(&p_report->peer_addr))
+        {
+                return;
+        }
+#else
+        if (!m_scan.connect_if_match)
+        {
+                return;
+        }
+#endif
+
+        nrf_ble_scan_stop();
+
+        err_code = sd_ble_gap_connect(&p_report->peer_addr,
+                                      &m_scan.scan_params,
+                                      &m_scan.conn_params,
+                                      m_scan.conn_cfg_tag);
+        APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+/**@brief Function for connecting to an advertiser that matches a target.
+ *
+ * @details The filters of the scanning module are all disabled, so it reports every advertiser
+ *          as not found and leaves the connection to the application.
+ *
+ * @param[in] p_report  Advertising report of the target.
+ * @param[in] target    Index of the matching target in m_scan_targets.
+ */
+static void scan_target_connect(ble_gap_evt_adv_report_t const * p_report, uint32_t target)
+{
+        NRF_LOG_DEBUG("Advertiser matches target %d.", target);
+
+        scan_connect(p_report);
+}
+#endif // NRF_MODULE_ENABLED(SCAN_FILTER)
+
+
 static void scan_evt_handler(scan_evt_t const * p_scan_evt)
 {
         ret_code_t err_code;
@@ -1070,12 +2968,31 @@ static void scan_evt_handler(scan_evt_t const * p_scan_evt)
         case NRF_BLE_SCAN_EVT_SCAN_TIMEOUT:
         {
                 NRF_LOG_INFO("Scan timed out.");
+                scan_sched_on_scan_timeout();
                 scan_start();
         } break;
 
         case NRF_BLE_SCAN_EVT_FILTER_MATCH:
+#if NRF_MODULE_ENABLED(BCAST_RX)
+                // The scanning module leaves the connection to the application, see scan_start().
+                scan_connect(p_scan_evt->params.filter_match.p_adv_report);
+#endif
                 break;
 
+        case NRF_BLE_SCAN_EVT_NOT_FOUND:
+        {
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+                uint32_t target;
+
+                if (scan_filter_match(p_scan_evt->params.p_not_found, &target))
+                {
+                        scan_target_connect(p_scan_evt->params.p_not_found, target);
+                        break;
+                }
+#endif
+                bcast_rx_on_adv_report(p_scan_evt->params.p_not_found);
+        } break;
+
 
         case NRF_BLE_SCAN_EVT_WHITELIST_ADV_REPORT:
                 break;
@@ -1131,12 +3048,18 @@ static void scan_init(void)
         err_code = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
         APP_ERROR_CHECK(err_code);
 
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+        // The targets are matched by scan_filter, no filter of the scanning module is enabled.
+        err_code = scan_filter_init(m_scan_targets, ARRAY_SIZE(m_scan_targets));
+        APP_ERROR_CHECK(err_code);
+#else
         // Setting filters for scanning.
         err_code = nrf_ble_scan_filters_enable(&m_scan, NRF_BLE_SCAN_NAME_FILTER, false);
         APP_ERROR_CHECK(err_code);
 
         err_code = nrf_ble_scan_filter_set(&m_scan, SCAN_NAME_FILTER, m_target_periph_name);
         APP_ERROR_CHECK(err_code);
+#endif
 
         // ble_uuid_t uuid =
         // {
@@ -1173,17 +3096,56 @@ static void scan_init(void)
 }
 
 
+/**@brief Function for polling the SoftDevice events from the main loop.
+ *
+ * @note This function is compatible with @ref app_sched_event_handler_t.
+ */
+static void sdh_evts_poll(void * p_event_data, uint16_t event_size)
+{
+        UNUSED_PARAMETER(p_event_data);
+        UNUSED_PARAMETER(event_size);
+
+        // Cleared first, events raised during the poll schedule the next one.
+        m_sdh_poll_state = SDH_POLL_IDLE;
+        nrf_sdh_evts_poll();
+}
+
+
+/**@brief SoftDevice event interrupt handler (NRF_SDH_DISPATCH_MODEL_POLLING).
+ *
+ * @details Schedules one poll for all the events pending, unlike NRF_SDH_DISPATCH_MODEL_APPSH
+ *          which puts one scheduler event per interrupt and faults when the queue is full. If the
+ *          queue is full anyway, the main loop polls after the scheduled events.
+ */
+void SD_EVT_IRQHandler(void)
+{
+        if (m_sdh_poll_state == SDH_POLL_IDLE)
+        {
+                m_sdh_poll_state = (app_evt_queue_sched_put(sdh_evts_poll, NULL, 0) == NRF_SUCCESS) ?
+                                   SDH_POLL_SCHEDULED : SDH_POLL_MISSED;
+        }
+}
+
+
 /**@brief Function for handling the idle state (main loop).
  *
- * @details Handle any pending log operation(s), then sleep until the next event occurs.
+ * @details Run the scheduled SoftDevice and application events, compute the LESC keys they
+ *          requested, handle any pending log operation(s), then sleep until the next event occurs.
+ *          A key takes milliseconds, computing it here at the lowest priority leaves the SoftDevice
+ *          and the interrupt handlers free to preempt it.
  */
 static void idle_state_handle(void)
 {
         ret_code_t err_code;
 
-        // err_code = nrf_ble_lesc_request_handler();
-        // APP_ERROR_CHECK(err_code);
         app_sched_execute();
+        if (m_sdh_poll_state == SDH_POLL_MISSED)
+        {
+                sdh_evts_poll(NULL, 0);
+        }
+        app_evt_queue_process();
+        err_code = lesc_prof_request_handler();
+        APP_ERROR_CHECK(err_code);
         if (NRF_LOG_PROCESS() == false)
         {
                 nrf_pwr_mgmt_run();
@@ -1228,20 +3190,47 @@ int main(void)
         uart_init();
         power_management_init();
         buttons_leds_init(&erase_bonds);
-        ble_stack_init();
         scheduler_init();
+        app_evt_queue_init(app_evt_handler);
+        ble_stack_init();
         gatt_init();
+        lesc_prof_init();
         peer_manager_init();
+        whitelist_init();
         db_discovery_init();
         ble_conn_state_init();
+        link_ctx_init();
+        link_fsm_init(m_link_stages);
+        evt_prof_init();
+        lat_probe_init();
+#if NRF_MODULE_ENABLED(HRV)
+        hrv_init();
+#endif
         hrs_c_init();
         bas_c_init();
         nus_c_init();
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        hrt_c_init();
+#endif
+        mux_init();
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        arq_init();
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        tput_init();
+#endif
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        l2cap_coc_init();
+#endif
+        relay_init();
+        bcast_rx_init();
+        scan_sched_init(&m_scan_param);
         scan_init();
 
         // Start execution.
         NRF_LOG_INFO("Heart Rate collector example started.");
         scanning_start(&erase_bonds);
+        relay_adv_start();
 
         // Enter main loop.
         for (;;)
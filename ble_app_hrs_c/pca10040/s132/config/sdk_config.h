@@ -54,6 +54,356 @@
 #define APP_SHUTDOWN_HANDLER_PRIORITY 1
 #endif
 
+// <e> EVT_PROF_ENABLED - evt_prof - Event handler cycle profiler
+//==========================================================
+#ifndef EVT_PROF_ENABLED
+#define EVT_PROF_ENABLED 0
+#endif
+// <o> EVT_PROF_REPORT_INTERVAL_MS - Interval between profiler reports in milliseconds.
+// <i> Must stay below the 67 s wrap-around of the 64 MHz cycle counter.
+#ifndef EVT_PROF_REPORT_INTERVAL_MS
+#define EVT_PROF_REPORT_INTERVAL_MS 10000
+#endif
+
+// </e>
+
+// <e> LAT_PROBE_ENABLED - lat_probe - Round trip latency probe
+// <i> Started and stopped with the #lat UART command.
+//==========================================================
+#ifndef LAT_PROBE_ENABLED
+#define LAT_PROBE_ENABLED 1
+#endif
+// <o> LAT_PROBE_INTERVAL_MS - Interval between probes to every link in milliseconds.
+#ifndef LAT_PROBE_INTERVAL_MS
+#define LAT_PROBE_INTERVAL_MS 100
+#endif
+
+// <o> LAT_PROBE_REPORT_INTERVAL_MS - Interval between latency reports in milliseconds.
+#ifndef LAT_PROBE_REPORT_INTERVAL_MS
+#define LAT_PROBE_REPORT_INTERVAL_MS 10000
+#endif
+
+// </e>
+
+// <o> APP_EVT_QUEUE_SIZE - Number of entries in the application event queue.
+// <i> Each entry holds up to one NUS payload, 20 RR intervals or a battery level, and merges
+// <i> consecutive events of the same type from the same link.
+#ifndef APP_EVT_QUEUE_SIZE
+#define APP_EVT_QUEUE_SIZE 8
+#endif
+
+// <o> LINK_CTX_RAM_BUDGET - Application RAM set aside for the link context table in bytes.
+// <i> The build fails if NRF_SDH_BLE_CENTRAL_LINK_COUNT links do not fit. A link takes about
+// <i> 10 kB with the default modules, most of it in NUS_ARQ (4.1 kB) and NUS_LZ (3.1 kB), and
+// <i> about 3 kB without these two. The rest of the application needs about 18 kB of RAM_SIZE.
+#ifndef LINK_CTX_RAM_BUDGET
+#define LINK_CTX_RAM_BUDGET 24576
+#endif
+
+// <e> BLE_RAM_CFG_ENABLED - ble_ram_cfg - SoftDevice queues and the RAM of each BLE setting
+// <i> Sizes the per-link TX queues and logs at startup the SoftDevice RAM every BLE setting takes.
+// <i> When disabled, the queues keep the SoftDevice default of one entry.
+//==========================================================
+#ifndef BLE_RAM_CFG_ENABLED
+#define BLE_RAM_CFG_ENABLED 1
+#endif
+// <o> APP_HVN_TX_QUEUE_SIZE - Handle Value Notification TX queue size per link.
+// <i> Number of notifications that can be queued in the SoftDevice for one connection
+// <i> before sd_ble_gatts_hvx() returns NRF_ERROR_RESOURCES. The SoftDevice default is 1.
+// <i> The RAM needed by the SoftDevice grows with every entry, check the RAM start logged at
+// <i> startup and move RAM_START in the linker settings accordingly.
+#ifndef APP_HVN_TX_QUEUE_SIZE
+#define APP_HVN_TX_QUEUE_SIZE 1
+#endif
+
+// <o> APP_WRITE_CMD_TX_QUEUE_SIZE - Write Command TX queue size per link.
+// <i> Number of Write Commands that can be queued in the SoftDevice for one connection
+// <i> before sd_ble_gattc_write() returns NRF_ERROR_RESOURCES. The SoftDevice default is 1.
+// <i> The RAM needed by the SoftDevice grows with every entry, check the RAM start logged at
+// <i> startup and move RAM_START in the linker settings accordingly.
+#ifndef APP_WRITE_CMD_TX_QUEUE_SIZE
+#define APP_WRITE_CMD_TX_QUEUE_SIZE 4
+#endif
+
+// </e>
+//==========================================================
+
+// <e> BLE_L2CAP_COC_ENABLED - ble_l2cap_coc - L2CAP connection-oriented channel transport
+// <i> Carries the UART data over an LE credit-based L2CAP channel instead of the Nordic UART
+// <i> Service when both sides enable it. Must be set the same on the central and the peripheral.
+//==========================================================
+#ifndef BLE_L2CAP_COC_ENABLED
+#define BLE_L2CAP_COC_ENABLED 0
+#endif
+// <o> BLE_L2CAP_COC_PSM - LE Protocol/Service Multiplexer of the channel. <0x80-0xFF>
+#ifndef BLE_L2CAP_COC_PSM
+#define BLE_L2CAP_COC_PSM 0x80
+#endif
+
+// <o> BLE_L2CAP_COC_MTU - Largest SDU in bytes. <23-65535>
+// <i> Every link holds one receive and BLE_L2CAP_COC_TX_QUEUE_SIZE transmit buffers of this size.
+#ifndef BLE_L2CAP_COC_MTU
+#define BLE_L2CAP_COC_MTU 512
+#endif
+
+// <o> BLE_L2CAP_COC_MPS - Largest PDU payload in bytes. <23-65535>
+// <i> Best set so that one PDU fills one Link Layer packet, that is NRF_SDH_BLE_GAP_DATA_LENGTH - 4.
+#ifndef BLE_L2CAP_COC_MPS
+#define BLE_L2CAP_COC_MPS 247
+#endif
+
+// <o> BLE_L2CAP_COC_TX_QUEUE_SIZE - Number of SDUs that can be queued for transmission per link.
+#ifndef BLE_L2CAP_COC_TX_QUEUE_SIZE
+#define BLE_L2CAP_COC_TX_QUEUE_SIZE 2
+#endif
+
+// <o> BLE_L2CAP_COC_BLE_OBSERVER_PRIO
+// <i> Priority with which BLE events are dispatched to the L2CAP channel transport.
+#ifndef BLE_L2CAP_COC_BLE_OBSERVER_PRIO
+#define BLE_L2CAP_COC_BLE_OBSERVER_PRIO 2
+#endif
+
+// </e>
+
+// <e> NUS_MUX_ENABLED - nus_mux - NUS stream multiplexer
+// <i> Frames the UART data into prioritized logical channels. Must be set the same on the central
+// <i> and the peripheral.
+//==========================================================
+#ifndef NUS_MUX_ENABLED
+#define NUS_MUX_ENABLED 1
+#endif
+// <o> NUS_MUX_TX_BUF_SIZE - Transmit queue size per channel in bytes.
+// <i> Every link holds one queue per channel. Bounds the largest message queued in one call.
+#ifndef NUS_MUX_TX_BUF_SIZE
+#define NUS_MUX_TX_BUF_SIZE 256
+#endif
+
+// <o> NUS_MUX_PACKET_MAX - Largest packet handed to NUS or the L2CAP channel in bytes.
+#ifndef NUS_MUX_PACKET_MAX
+#define NUS_MUX_PACKET_MAX 244
+#endif
+
+// </e>
+
+// <e> NUS_ARQ_ENABLED - nus_arq - Reliable transfer over the NUS multiplexer
+// <i> Numbers the frames on the data channel and retransmits the lost ones. Must be set the same
+// <i> on the central and the peripheral.
+//==========================================================
+#ifndef NUS_ARQ_ENABLED
+#define NUS_ARQ_ENABLED 1
+#endif
+// <o> NUS_ARQ_WINDOW - Frames in flight per link. <2-32>
+// <i> Every link holds two windows of frames, one to send and one to reorder.
+#ifndef NUS_ARQ_WINDOW
+#define NUS_ARQ_WINDOW 8
+#endif
+
+// <o> NUS_ARQ_PAYLOAD_MAX - Largest payload of one frame in bytes.
+// <i> The multiplexer splits frames into packets. A frame must fit NUS_MUX_TX_BUF_SIZE.
+#ifndef NUS_ARQ_PAYLOAD_MAX
+#define NUS_ARQ_PAYLOAD_MAX 240
+#endif
+
+// <o> NUS_ARQ_RTO_MS - Retransmission timeout in milliseconds.
+// <i> Should cover a few connection intervals of the slowest link.
+#ifndef NUS_ARQ_RTO_MS
+#define NUS_ARQ_RTO_MS 200
+#endif
+
+// <o> NUS_ARQ_ACK_DELAY_MS - Longest delay of an acknowledgement in milliseconds.
+#ifndef NUS_ARQ_ACK_DELAY_MS
+#define NUS_ARQ_ACK_DELAY_MS 10
+#endif
+
+// <o> NUS_ARQ_LOSS_PERMILLE - Received frames dropped on purpose, per thousand. <0-999>
+// <i> Test aid for the retransmission. Keep at 0 in production.
+#ifndef NUS_ARQ_LOSS_PERMILLE
+#define NUS_ARQ_LOSS_PERMILLE 0
+#endif
+
+// </e>
+
+// <e> NUS_LZ_ENABLED - nus_lz - NUS stream compression
+// <i> Compresses the UART data sent over the reliable transfer, once the peer has announced that
+// <i> it can decompress. Needs NUS_ARQ_ENABLED. Must be set the same on the central and the peripheral.
+//==========================================================
+#ifndef NUS_LZ_ENABLED
+#define NUS_LZ_ENABLED 1
+#endif
+// <o> NUS_LZ_WINDOW - History window in bytes, a power of two.
+// <256=> 256
+// <512=> 512
+// <1024=> 1024
+// <2048=> 2048
+// <4096=> 4096
+// <i> Every link holds two windows, one to compress and one to decompress.
+#ifndef NUS_LZ_WINDOW
+#define NUS_LZ_WINDOW 1024
+#endif
+
+// <o> NUS_LZ_HASH_BITS - log2 of the match table size. <6-12>
+// <i> Every link holds 2 << NUS_LZ_HASH_BITS bytes of table.
+#ifndef NUS_LZ_HASH_BITS
+#define NUS_LZ_HASH_BITS 8
+#endif
+
+// <o> NUS_LZ_MSG_MAX - Largest message in bytes before compression.
+// <i> Must hold one UART line, BLE_NUS_MAX_DATA_LEN bytes.
+#ifndef NUS_LZ_MSG_MAX
+#define NUS_LZ_MSG_MAX 256
+#endif
+
+// </e>
+
+// <q> NUS_TPUT_ENABLED  - nus_tput - NUS throughput test
+// <i> Adds the test channel to the multiplexer. Must be set the same on the central and the
+// <i> peripheral. The central runs the test with the #tput UART command.
+#ifndef NUS_TPUT_ENABLED
+#define NUS_TPUT_ENABLED 1
+#endif
+
+// <e> BLE_HRT_C_ENABLED - ble_hrt_c - Heart Rate Telemetry Service client
+// <i> Receives the compact heart rate and RR interval blocks of the peripheral and decodes them.
+// <i> The service uses a vendor specific UUID, count it in NRF_SDH_BLE_VS_UUID_COUNT.
+//==========================================================
+#ifndef BLE_HRT_C_ENABLED
+#define BLE_HRT_C_ENABLED 1
+#endif
+// <o> BLE_HRT_C_BLE_OBSERVER_PRIO
+// <i> Priority with which BLE events are dispatched to the Heart Rate Telemetry Service client.
+#ifndef BLE_HRT_C_BLE_OBSERVER_PRIO
+#define BLE_HRT_C_BLE_OBSERVER_PRIO 2
+#endif
+
+// </e>
+
+// <e> HRV_ENABLED - hrv - Heart rate variability of the received RR intervals
+//==========================================================
+#ifndef HRV_ENABLED
+#define HRV_ENABLED 1
+#endif
+// <o> HRV_WINDOW - RR intervals kept per link for the metrics.
+// <i> The spectrum needs 64 seconds of them, the time domain metrics use all of them. At most 1024.
+#ifndef HRV_WINDOW
+#define HRV_WINDOW 256
+#endif
+
+// <o> HRV_SPECTRUM_INTERVAL - RR intervals between two computations of the spectrum.
+#ifndef HRV_SPECTRUM_INTERVAL
+#define HRV_SPECTRUM_INTERVAL 32
+#endif
+
+// </e>
+
+// <e> RELAY_ENABLED - relay - Serve the downstream data to an upstream central over NUS
+// <i> Off by default, the collector then neither advertises nor forwards anything. Needs
+// <i> NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 1, NRF_SDH_BLE_TOTAL_LINK_COUNT one above the central
+// <i> links, BLE_NUS_ENABLED, BLE_ADVERTISING_ENABLED and about 4 kB more SoftDevice RAM: raise
+// <i> the RAM start of the project to the one logged by ble_ram_cfg.
+//==========================================================
+#ifndef RELAY_ENABLED
+#define RELAY_ENABLED 0
+#endif
+// <s> RELAY_DEVICE_NAME - Name advertised to the upstream central.
+#ifndef RELAY_DEVICE_NAME
+#define RELAY_DEVICE_NAME "Nordic_Relay"
+#endif
+
+// <o> RELAY_MIN_CONN_INTERVAL_MS - Shortest connection interval asked of the upstream central.
+// <i> Longer than the downstream intervals, so the upstream link seldom takes their radio time.
+#ifndef RELAY_MIN_CONN_INTERVAL_MS
+#define RELAY_MIN_CONN_INTERVAL_MS 50
+#endif
+
+// <o> RELAY_MAX_CONN_INTERVAL_MS - Longest connection interval asked of the upstream central.
+#ifndef RELAY_MAX_CONN_INTERVAL_MS
+#define RELAY_MAX_CONN_INTERVAL_MS 100
+#endif
+
+// <o> RELAY_GAP_EVENT_LENGTH - Connection event length of the upstream link in 1.25 ms units.
+#ifndef RELAY_GAP_EVENT_LENGTH
+#define RELAY_GAP_EVENT_LENGTH 2
+#endif
+
+// <o> RELAY_HVN_TX_QUEUE_SIZE - Notifications the SoftDevice queues for the upstream link.
+#ifndef RELAY_HVN_TX_QUEUE_SIZE
+#define RELAY_HVN_TX_QUEUE_SIZE 2
+#endif
+
+// <o> RELAY_REPORT_INTERVAL_MS - Interval between two throughput and latency reports.
+#ifndef RELAY_REPORT_INTERVAL_MS
+#define RELAY_REPORT_INTERVAL_MS 10000
+#endif
+
+// </e>
+
+// <e> BCAST_RX_ENABLED - bcast_rx - Follow sensors that broadcast their measurements
+// <i> Decodes the measurements of sensors built with HRS_BCAST_ENABLED from the advertising
+// <i> reports. Off by default. When set, the scan accepts all advertisers and the whitelist only
+// <i> decides the connections, scanning goes on with all links up and does not back off.
+//==========================================================
+#ifndef BCAST_RX_ENABLED
+#define BCAST_RX_ENABLED 0
+#endif
+// <o> BCAST_RX_TABLE_BITS - Size of the sensor table, as a power of two.
+// <i> Three quarters of the slots are used at most, 6 follows up to 48 sensors.
+// <i> Each slot takes 32 bytes of RAM.
+#ifndef BCAST_RX_TABLE_BITS
+#define BCAST_RX_TABLE_BITS 6
+#endif
+
+// <o> BCAST_RX_BENCH_SENSORS_MAX - Synthetic sensors of the #advbench command at most.
+#ifndef BCAST_RX_BENCH_SENSORS_MAX
+#define BCAST_RX_BENCH_SENSORS_MAX 256
+#endif
+
+// <o> BCAST_RX_BENCH_REPORTS_MAX - Reports of the #advbench command at most.
+// <i> The benchmark has a sensor table of its own, as large as the receiver's.
+#ifndef BCAST_RX_BENCH_REPORTS_MAX
+#define BCAST_RX_BENCH_REPORTS_MAX 100000
+#endif
+
+// <o> BCAST_RX_TIMEOUT_MS - Time without a report after which a sensor is dropped.
+// <i> At most 500000, the app_timer counter range.
+#ifndef BCAST_RX_TIMEOUT_MS
+#define BCAST_RX_TIMEOUT_MS 30000
+#endif
+
+// <o> BCAST_RX_REPORT_INTERVAL_MS - Interval between two logs of the sensor table.
+#ifndef BCAST_RX_REPORT_INTERVAL_MS
+#define BCAST_RX_REPORT_INTERVAL_MS 10000
+#endif
+
+// </e>
+
+// <e> SCAN_FILTER_ENABLED - scan_filter - Match advertisers against a compiled list of targets
+// <i> Replaces the name filter of the scanning module. Target addresses, 128-bit service UUIDs
+// <i> and name prefixes are hashed at init, each report is parsed once.
+//==========================================================
+#ifndef SCAN_FILTER_ENABLED
+#define SCAN_FILTER_ENABLED 1
+#endif
+// <o> SCAN_FILTER_TABLE_BITS - Size of the target table, as a power of two.
+// <i> Half of the slots hold targets at most, 4 takes up to 8 targets.
+#ifndef SCAN_FILTER_TABLE_BITS
+#define SCAN_FILTER_TABLE_BITS 4
+#endif
+
+// </e>
+
+// <q> PEER_CACHE_ENABLED  - peer_cache - Store the service handles of bonded peers with their bond
+// <i> Reconnections to bonded peers skip the discovery and the CCCD writes, the peripheral
+// <i> restores its CCCDs from the bond.
+#ifndef PEER_CACHE_ENABLED
+#define PEER_CACHE_ENABLED 1
+#endif
+
+// <q> LESC_PROF_ENABLED  - lesc_prof - Measure the LE Secure Connections key computations
+// <i> Logs the cost of the DHKey computations and how long the requests wait for them.
+#ifndef LESC_PROF_ENABLED
+#define LESC_PROF_ENABLED 1
+#endif
+
 // </h>
 //==========================================================
 
@@ -112,7 +462,7 @@
 
 
 #ifndef NRF_BLE_LESC_ENABLED
-#define NRF_BLE_LESC_ENABLED 0
+#define NRF_BLE_LESC_ENABLED 1
 #endif
 
 // <e> NRF_BLE_QWR_ENABLED - nrf_ble_qwr - Queued writes support module (prepare/execute write)
@@ -279,7 +629,7 @@
 // <i> If set to true, you need to call nrf_ble_lesc_request_handler() in the main loop to respond to LESC-related BLE events. If LESC support is not required, set this to false to save code space.
 
 #ifndef PM_LESC_ENABLED
-#define PM_LESC_ENABLED 0
+#define PM_LESC_ENABLED 1
 #endif
 
 // <e> PM_RA_PROTECTION_ENABLED - Enable/disable protection against repeated pairing attempts in Peer Manager.
@@ -684,7 +1034,7 @@
 // <e> NRF_CRYPTO_ENABLED - nrf_crypto - Cryptography library.
 //==========================================================
 #ifndef NRF_CRYPTO_ENABLED
-#define NRF_CRYPTO_ENABLED 0
+#define NRF_CRYPTO_ENABLED 1
 #endif
 // <o> NRF_CRYPTO_ALLOCATOR  - Memory allocator
 
@@ -6036,7 +6386,7 @@
 
 
 #ifndef APP_SCHEDULER_WITH_PROFILER
-#define APP_SCHEDULER_WITH_PROFILER 0
+#define APP_SCHEDULER_WITH_PROFILER 1
 #endif
 
 // </e>
@@ -12133,6 +12483,10 @@
 #endif
 
 // <o> NRF_SDH_BLE_CENTRAL_LINK_COUNT - Maximum number of central links.
+// <i> The SoftDevice allows up to 20, the application RAM far fewer. Each link takes about 10 kB
+// <i> in the link context table with the default modules (see link_ctx.h), so LINK_CTX_RAM_BUDGET
+// <i> holds 2 links; without NUS_ARQ and NUS_LZ about 3 kB, 8 links. The SoftDevice RAM reported
+// <i> by nrf_sdh_ble_enable() grows with every link on top of this.
 #ifndef NRF_SDH_BLE_CENTRAL_LINK_COUNT
 #define NRF_SDH_BLE_CENTRAL_LINK_COUNT 2
 #endif
@@ -12163,7 +12517,7 @@
 
 // <o> NRF_SDH_BLE_VS_UUID_COUNT - The number of vendor-specific UUIDs.
 #ifndef NRF_SDH_BLE_VS_UUID_COUNT
-#define NRF_SDH_BLE_VS_UUID_COUNT 0
+#define NRF_SDH_BLE_VS_UUID_COUNT 2
 #endif
 
 // <q> NRF_SDH_BLE_SERVICE_CHANGED  - Include the Service Changed characteristic in the Attribute Table.
@@ -12518,7 +12872,7 @@
 // <2=> NRF_SDH_DISPATCH_MODEL_POLLING
 
 #ifndef NRF_SDH_DISPATCH_MODEL
-#define NRF_SDH_DISPATCH_MODEL 0
+#define NRF_SDH_DISPATCH_MODEL 2
 #endif
 
 // </h>
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+#include <string.h>
+#include "peer_cache.h"
+#include "peer_manager.h"
+
+#define NRF_LOG_MODULE_NAME peer_cache
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RECORD_VERSION  1                                                       /**< Bumped when the meaning of the record changes. */
+#define RECORD_TAG      ((RECORD_VERSION << 16) | sizeof(peer_cache_t))         /**< Tag of the records of this build. */
+
+/**@brief Statistics of the records. */
+typedef struct
+{
+        uint32_t hits;          /**< Records loaded. */
+        uint32_t misses;        /**< Bonded peers without a record of this build. */
+        uint32_t stale;         /**< Records deleted because their handles were stale. */
+} peer_cache_stats_t;
+
+static peer_cache_stats_t m_stats;      /**< Statistics since the last reset. */
+
+
+/**@brief Function for getting the bonded peer of a link.
+ *
+ * @return Peer ID, or PM_PEER_ID_INVALID if the peer is not bonded.
+ */
+static pm_peer_id_t peer_id_get(uint16_t conn_handle)
+{
+        pm_peer_id_t peer_id;
+
+        if (pm_peer_id_get(conn_handle, &peer_id) != NRF_SUCCESS)
+        {
+                return PM_PEER_ID_INVALID;
+        }
+        return peer_id;
+}
+
+
+ret_code_t peer_cache_load(uint16_t conn_handle, peer_cache_t * p_cache)
+{
+        pm_peer_id_t peer_id = peer_id_get(conn_handle);
+        uint32_t     len     = sizeof(*p_cache);
+        ret_code_t   err_code;
+
+        if (peer_id == PM_PEER_ID_INVALID)
+        {
+                return NRF_ERROR_NOT_FOUND;
+        }
+
+        err_code = pm_peer_data_app_data_load(peer_id, p_cache, &len);
+        if ((err_code != NRF_SUCCESS) || (len != sizeof(*p_cache)) || (p_cache->tag != RECORD_TAG))
+        {
+                // No record, or one written by a build with other services.
+                m_stats.misses++;
+                return NRF_ERROR_NOT_FOUND;
+        }
+
+        m_stats.hits++;
+        NRF_LOG_DEBUG("Handles of peer %d loaded.", peer_id);
+
+        return NRF_SUCCESS;
+}
+
+
+ret_code_t peer_cache_store(uint16_t conn_handle, peer_cache_t * p_cache)
+{
+        pm_peer_id_t peer_id = peer_id_get(conn_handle);
+
+        if (peer_id == PM_PEER_ID_INVALID)
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        p_cache->tag = RECORD_TAG;
+
+        NRF_LOG_DEBUG("Storing the handles of peer %d.", peer_id);
+
+        return pm_peer_data_app_data_store(peer_id, p_cache, sizeof(*p_cache), NULL);
+}
+
+
+ret_code_t peer_cache_delete(uint16_t conn_handle)
+{
+        pm_peer_id_t peer_id = peer_id_get(conn_handle);
+
+        if (peer_id == PM_PEER_ID_INVALID)
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        m_stats.stale++;
+        NRF_LOG_INFO("Handles of peer %d are stale, deleting them.", peer_id);
+
+        return pm_peer_data_delete(peer_id, PM_PEER_DATA_ID_APPLICATION);
+}
+
+
+void peer_cache_stats_log(void)
+{
+        NRF_LOG_INFO("Peer cache: %d hits, %d misses, %d stale.",
+                     m_stats.hits, m_stats.misses, m_stats.stale);
+}
+
+
+void peer_cache_stats_reset(void)
+{
+        memset(&m_stats, 0, sizeof(m_stats));
+}
+
+#endif // NRF_MODULE_ENABLED(PEER_CACHE)
@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup peer_cache Peer handle cache
+ * @{
+ * @brief    Handles of the services of bonded peers, stored with their bond.
+ *
+ * @details  A bonded peripheral restores the CCCDs its central enabled, so on a reconnection the
+ *           notifications flow without any request from the central. What the central lacks is
+ *           the handles, which would take a service discovery. This module stores them with the
+ *           bond through the Peer Manager, as application data, once the notifications of a link
+ *           are enabled. On the next connection of the peer they are loaded again, and the
+ *           discovery and the CCCD writes are skipped.
+ *
+ *           Records carry a tag made of a version and their size, records written by a build with
+ *           other services are ignored. Records are deleted with the bond.
+ *
+ * @note     Compiles to nothing unless PEER_CACHE_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef PEER_CACHE_H__
+#define PEER_CACHE_H__
+
+#include <stdint.h>
+#include "ble_hrs_c.h"
+#include "ble_bas_c.h"
+#include "ble_nus_c.h"
+#include "sdk_errors.h"
+#include "sdk_config.h"
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+#include "ble_hrt_c.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NRF_MODULE_ENABLED(PEER_CACHE)
+
+/**@brief Record stored with the bond of a peer.
+ *
+ * @details Services the peer does not have keep invalid handles. The Peer Manager stores whole
+ *          words, the tag makes the record word aligned and sized.
+ */
+typedef struct
+{
+        uint32_t            tag;        /**< Version and size of the record, set by @ref peer_cache_store. */
+        hrs_db_t            hrs;        /**< Heart Rate Service handles. */
+        bas_c_db_t          bas;        /**< Battery Service handles. */
+        ble_nus_c_handles_t nus;        /**< Nordic UART Service handles. */
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+        ble_hrt_c_handles_t hrt;        /**< Heart Rate Telemetry Service handles. */
+#endif
+} peer_cache_t;
+
+
+/**@brief Function for loading the record of the peer of a link.
+ *
+ * @param[in]  conn_handle  Connection handle.
+ * @param[out] p_cache      Record.
+ *
+ * @retval NRF_SUCCESS          The record is loaded.
+ * @retval NRF_ERROR_NOT_FOUND  The peer is not bonded, or has no record of this build.
+ */
+ret_code_t peer_cache_load(uint16_t conn_handle, peer_cache_t * p_cache);
+
+
+/**@brief Function for storing the record of the peer of a link.
+ *
+ * @details The Peer Manager writes the record later, it must stay valid until
+ *          @ref PM_EVT_PEER_DATA_UPDATE_SUCCEEDED or @ref PM_EVT_PEER_DATA_UPDATE_FAILED.
+ *
+ * @param[in]     conn_handle  Connection handle.
+ * @param[in,out] p_cache      Record, its tag is set.
+ *
+ * @retval NRF_SUCCESS              The record is queued for writing.
+ * @retval NRF_ERROR_INVALID_STATE  The peer is not bonded.
+ * @return Other errors from pm_peer_data_app_data_store().
+ */
+ret_code_t peer_cache_store(uint16_t conn_handle, peer_cache_t * p_cache);
+
+
+/**@brief Function for deleting the record of the peer of a link, its handles are stale.
+ *
+ * @param[in] conn_handle  Connection handle.
+ *
+ * @retval NRF_SUCCESS              The record is queued for deletion.
+ * @retval NRF_ERROR_INVALID_STATE  The peer is not bonded.
+ * @return Other errors from pm_peer_data_delete().
+ */
+ret_code_t peer_cache_delete(uint16_t conn_handle);
+
+
+/**@brief Function for logging the records loaded, missed and found stale since the last reset. */
+void peer_cache_stats_log(void);
+
+
+/**@brief Function for clearing the statistics. */
+void peer_cache_stats_reset(void);
+
+#endif // NRF_MODULE_ENABLED(PEER_CACHE)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PEER_CACHE_H__
+
+/** @} */
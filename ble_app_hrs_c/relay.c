@@ -0,0 +1,663 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(RELAY)
+#include <string.h>
+#include "relay.h"
+#include "ble.h"
+#include "ble_gap.h"
+#include "ble_nus.h"
+#include "ble_hrs_c.h"
+#include "ble_advertising.h"
+#include "nus_mux.h"
+#include "nrf_sdh_ble.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+
+#define NRF_LOG_MODULE_NAME relay
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RELAY_BLE_OBSERVER_PRIO 1                                       /**< Ahead of the service, which reports enabled notifications on connection. */
+
+#define ADV_INTERVAL            MSEC_TO_UNITS(250, UNIT_0_625_MS)      /**< Advertising interval, long to leave the radio to the scanner. */
+#define CONN_PARAM_DELAY        APP_TIMER_TICKS(5000)                   /**< Time from connection to the connection parameter update. */
+#define CONN_SUP_TIMEOUT        MSEC_TO_UNITS(4000, UNIT_10_MS)         /**< Supervision timeout of the upstream link. */
+#define REPORT_INTERVAL         APP_TIMER_TICKS(RELAY_REPORT_INTERVAL_MS)
+
+#define TICKS_TO_US(_ticks)     ((uint32_t)(((uint64_t)(_ticks) * 1000000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+#define QUEUED_MAX              16      /**< Messages of a channel timed while in the multiplexer queue. Power of two. */
+#define INFLIGHT_MAX            32      /**< Messages timed while in the SoftDevice queue. Power of two. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(QUEUED_MAX));
+STATIC_ASSERT(IS_POWER_OF_TWO(INFLIGHT_MAX));
+STATIC_ASSERT(RELAY_HDR_LEN + BLE_NUS_MAX_DATA_LEN <= NUS_MUX_MSG_MAX);
+STATIC_ASSERT(NRF_SDH_BLE_PERIPHERAL_LINK_COUNT == 1);
+STATIC_ASSERT(NRF_SDH_BLE_TOTAL_LINK_COUNT == NRF_SDH_BLE_CENTRAL_LINK_COUNT + 1);
+
+#if !NRF_MODULE_ENABLED(BLE_NUS) || !NRF_MODULE_ENABLED(BLE_ADVERTISING)
+#error "RELAY needs BLE_NUS and BLE_ADVERTISING."
+#endif
+
+/**@brief Queueing times of the messages of one channel that have not gone to the SoftDevice. */
+typedef struct
+{
+        uint32_t tick[QUEUED_MAX];      /**< Time of the call that queued the message. */
+        uint8_t  rd;                    /**< Oldest entry. */
+        uint8_t  cnt;                   /**< Number of entries. */
+} queued_t;
+
+/**@brief Message handed to the SoftDevice and not yet acknowledged. */
+typedef struct
+{
+        uint32_t tick;                  /**< Time of the call that queued the message. */
+        uint32_t pkt_seq;               /**< Notification that carries the end of the message. */
+} inflight_t;
+
+/**@brief Statistics of one report interval. */
+typedef struct
+{
+        uint32_t msgs;                  /**< Messages queued. */
+        uint32_t drops;                 /**< Messages dropped for lack of room. */
+        uint32_t msg_bytes;             /**< Bytes of the queued messages, headers included. */
+        uint32_t pkt_bytes;             /**< Bytes of the notifications sent. */
+        uint32_t lat_cnt;               /**< Messages timed up to the acknowledgement. */
+        uint32_t lat_min_us;            /**< Shortest latency. */
+        uint32_t lat_max_us;            /**< Longest latency. */
+        uint64_t lat_total_us;          /**< Sum of the latencies. */
+} relay_stats_t;
+
+BLE_NUS_DEF(m_nus, NRF_SDH_BLE_TOTAL_LINK_COUNT);               /**< Service instance, the link context is indexed by connection. */
+BLE_ADVERTISING_DEF(m_advertising);                             /**< Advertising instance. */
+APP_TIMER_DEF(m_conn_param_timer);                              /**< Delays the connection parameter update. */
+APP_TIMER_DEF(m_report_timer);                                  /**< Periodic report timer. */
+
+static nus_mux_t     m_mux;                                     /**< Multiplexer of the upstream link. */
+static uint16_t      m_conn_handle = BLE_CONN_HANDLE_INVALID;   /**< Upstream link. */
+static uint8_t       m_conn_cfg_tag;                            /**< SoftDevice configuration of the upstream link. */
+static bool          m_notif_enabled;                           /**< True once the peer has enabled notifications. */
+static queued_t      m_queued[NUS_MUX_CH_COUNT];                /**< Messages in the multiplexer queues. */
+static inflight_t    m_inflight[INFLIGHT_MAX];                  /**< Messages in the SoftDevice queue. */
+static uint8_t       m_inflight_rd;                             /**< Oldest entry of m_inflight. */
+static uint8_t       m_inflight_cnt;                            /**< Number of entries in m_inflight. */
+static uint32_t      m_pkt_seq;                                 /**< Notifications handed to the SoftDevice. */
+static uint32_t      m_pkt_done;                                /**< Notifications acknowledged. */
+static relay_stats_t m_stats;                                   /**< Statistics of the current report interval. */
+
+
+/**@brief Function for clearing the statistics. Call with interrupts masked. */
+static void stats_clear(void)
+{
+        memset(&m_stats, 0, sizeof(m_stats));
+        m_stats.lat_min_us = UINT32_MAX;
+}
+
+
+/**@brief Function for forgetting the messages being timed, when the link is established or lost. */
+static void timing_reset(void)
+{
+        CRITICAL_REGION_ENTER();
+        memset(m_queued, 0, sizeof(m_queued));
+        m_inflight_rd  = 0;
+        m_inflight_cnt = 0;
+        m_pkt_seq      = 0;
+        m_pkt_done     = 0;
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for moving messages that went to the SoftDevice from a channel to the flight list.
+ *
+ * @param[in] ch       Channel.
+ * @param[in] msg_cnt  Number of messages, oldest first.
+ */
+static void on_tx_sent(nus_mux_ch_t ch, uint16_t msg_cnt)
+{
+        queued_t * p_q = &m_queued[ch];
+
+        CRITICAL_REGION_ENTER();
+
+        while ((msg_cnt-- > 0) && (p_q->cnt > 0))
+        {
+                // A full flight list loses its oldest entry, that message is not timed.
+                if (m_inflight_cnt == INFLIGHT_MAX)
+                {
+                        m_inflight_rd = (m_inflight_rd + 1) & (INFLIGHT_MAX - 1);
+                        m_inflight_cnt--;
+                }
+
+                inflight_t * p_entry = &m_inflight[(m_inflight_rd + m_inflight_cnt) & (INFLIGHT_MAX - 1)];
+
+                // The message ends in the last notification handed over so far, or in an earlier one.
+                p_entry->tick    = p_q->tick[p_q->rd];
+                p_entry->pkt_seq = m_pkt_seq;
+                m_inflight_cnt++;
+
+                p_q->rd = (p_q->rd + 1) & (QUEUED_MAX - 1);
+                p_q->cnt--;
+        }
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for timing the messages of acknowledged notifications.
+ *
+ * @param[in] count  Number of notifications acknowledged.
+ */
+static void on_hvn_tx_complete(uint8_t count)
+{
+        uint32_t now = app_timer_cnt_get();
+
+        CRITICAL_REGION_ENTER();
+
+        m_pkt_done += count;
+
+        while ((m_inflight_cnt > 0) && ((int32_t)(m_inflight[m_inflight_rd].pkt_seq - m_pkt_done) <= 0))
+        {
+                uint32_t lat_us = TICKS_TO_US(app_timer_cnt_diff_compute(now, m_inflight[m_inflight_rd].tick));
+
+                m_stats.lat_cnt++;
+                m_stats.lat_total_us += lat_us;
+                m_stats.lat_min_us    = MIN(m_stats.lat_min_us, lat_us);
+                m_stats.lat_max_us    = MAX(m_stats.lat_max_us, lat_us);
+
+                m_inflight_rd = (m_inflight_rd + 1) & (INFLIGHT_MAX - 1);
+                m_inflight_cnt--;
+        }
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for queueing a message to the upstream link.
+ *
+ * @details Messages are dropped rather than held back, the downstream links must not wait for the
+ *          phone.
+ *
+ * @param[in] ch     Channel.
+ * @param[in] p_msg  Message, header included.
+ * @param[in] len    Length of the message.
+ */
+static void msg_send(nus_mux_ch_t ch, uint8_t const * p_msg, uint16_t len)
+{
+        queued_t * p_q = &m_queued[ch];
+        ret_code_t err_code;
+        bool       timed;
+
+        if ((m_conn_handle == BLE_CONN_HANDLE_INVALID) || !m_notif_enabled)
+        {
+                return;
+        }
+
+        // Record the time first, the message can reach the SoftDevice before nus_mux_send() returns.
+        CRITICAL_REGION_ENTER();
+        timed = (p_q->cnt < QUEUED_MAX);
+        if (timed)
+        {
+                p_q->tick[(p_q->rd + p_q->cnt) & (QUEUED_MAX - 1)] = app_timer_cnt_get();
+                p_q->cnt++;
+        }
+        CRITICAL_REGION_EXIT();
+
+        // The timing list doubles as a bound on the messages waiting in the channel.
+        err_code = timed ? nus_mux_send(&m_mux, ch, p_msg, len, true) : NRF_ERROR_NO_MEM;
+
+        CRITICAL_REGION_ENTER();
+        if (err_code == NRF_SUCCESS)
+        {
+                m_stats.msgs++;
+                m_stats.msg_bytes += len;
+        }
+        else
+        {
+                m_stats.drops++;
+                if (timed)
+                {
+                        p_q->cnt--;
+                }
+        }
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for sending a multiplexer packet to the upstream link.
+ *
+ * @param[in] p_context  Unused.
+ * @param[in] p_data     Packet to send.
+ * @param[in] length     Length of the packet.
+ *
+ * @return The result of ble_nus_data_send().
+ */
+static ret_code_t mux_send(void * p_context, uint8_t * p_data, uint16_t length)
+{
+        ret_code_t err_code;
+
+        UNUSED_PARAMETER(p_context);
+
+        err_code = ble_nus_data_send(&m_nus, p_data, &length, m_conn_handle);
+        if (err_code == NRF_SUCCESS)
+        {
+                m_pkt_seq++;
+                m_stats.pkt_bytes += length;
+        }
+
+        return err_code;
+}
+
+
+/**@brief Function for handling multiplexer events of the upstream link.
+ *
+ * @param[in] p_mux  Multiplexer instance.
+ * @param[in] p_evt  Event.
+ */
+static void mux_evt_handler(nus_mux_t * p_mux, nus_mux_evt_t const * p_evt)
+{
+        UNUSED_PARAMETER(p_mux);
+
+        switch (p_evt->type)
+        {
+        case NUS_MUX_EVT_TX_SENT:
+                on_tx_sent(p_evt->ch, p_evt->msg_cnt);
+                break;
+
+        case NUS_MUX_EVT_RX_DATA:
+                // Nothing is taken from the phone yet.
+                NRF_LOG_DEBUG("%d bytes on channel %d ignored.", p_evt->len, p_evt->ch);
+                break;
+
+        default:
+                break;
+        }
+}
+
+
+/**@brief Function for handling events of the Nordic UART Service.
+ *
+ * @param[in] p_evt  Event.
+ */
+static void nus_data_handler(ble_nus_evt_t * p_evt)
+{
+        if (p_evt->conn_handle != m_conn_handle)
+        {
+                return;
+        }
+
+        switch (p_evt->type)
+        {
+        case BLE_NUS_EVT_RX_DATA:
+                nus_mux_on_data(&m_mux, p_evt->params.rx_data.p_data, p_evt->params.rx_data.length);
+                break;
+
+        case BLE_NUS_EVT_COMM_STARTED:
+                NRF_LOG_INFO("Upstream notifications enabled.");
+                m_notif_enabled = true;
+                break;
+
+        case BLE_NUS_EVT_COMM_STOPPED:
+                m_notif_enabled = false;
+                break;
+
+        default:
+                // BLE_NUS_EVT_TX_RDY is taken from BLE_GATTS_EVT_HVN_TX_COMPLETE, which has the count.
+                break;
+        }
+}
+
+
+/**@brief Function for handling advertising events.
+ *
+ * @param[in] ble_adv_evt  Advertising event.
+ */
+static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
+{
+        switch (ble_adv_evt)
+        {
+        case BLE_ADV_EVT_FAST:
+                NRF_LOG_INFO("Advertising to the upstream central.");
+                break;
+
+        default:
+                break;
+        }
+}
+
+
+/**@brief Function for moving the upstream link away from the downstream connection intervals. */
+static void conn_param_timeout_handler(void * p_context)
+{
+        ret_code_t           err_code;
+        ble_gap_conn_params_t conn_params;
+
+        UNUSED_PARAMETER(p_context);
+
+        if (m_conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+                return;
+        }
+
+        memset(&conn_params, 0, sizeof(conn_params));
+        conn_params.min_conn_interval = MSEC_TO_UNITS(RELAY_MIN_CONN_INTERVAL_MS, UNIT_1_25_MS);
+        conn_params.max_conn_interval = MSEC_TO_UNITS(RELAY_MAX_CONN_INTERVAL_MS, UNIT_1_25_MS);
+        conn_params.slave_latency     = 0;
+        conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+
+        // The phone may refuse, the relay still works at its interval.
+        err_code = sd_ble_gap_conn_param_update(m_conn_handle, &conn_params);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("Upstream connection parameter update failed: 0x%x.", err_code);
+        }
+}
+
+
+/**@brief Function for logging and restarting the statistics. */
+static void report_timeout_handler(void * p_context)
+{
+        relay_stats_t stats;
+
+        UNUSED_PARAMETER(p_context);
+
+        CRITICAL_REGION_ENTER();
+        stats = m_stats;
+        stats_clear();
+        CRITICAL_REGION_EXIT();
+
+        if (m_conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+                return;
+        }
+
+        NRF_LOG_INFO("Relayed %d messages, %d B/s, upstream %d B/s, %d dropped.",
+                     stats.msgs,
+                     (uint32_t)(((uint64_t)stats.msg_bytes * 1000) / RELAY_REPORT_INTERVAL_MS),
+                     (uint32_t)(((uint64_t)stats.pkt_bytes * 1000) / RELAY_REPORT_INTERVAL_MS),
+                     stats.drops);
+
+        if (stats.lat_cnt != 0)
+        {
+                NRF_LOG_INFO("Relay latency (us): min=%d avg=%d max=%d over %d messages.",
+                             stats.lat_min_us,
+                             (uint32_t)(stats.lat_total_us / stats.lat_cnt),
+                             stats.lat_max_us,
+                             stats.lat_cnt);
+        }
+}
+
+
+/**@brief Function for handling BLE events of the upstream link.
+ *
+ * @param[in] p_ble_evt  Event.
+ * @param[in] p_context  Unused.
+ */
+static void relay_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        ret_code_t            err_code;
+        ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
+
+        UNUSED_PARAMETER(p_context);
+
+        switch (p_ble_evt->header.evt_id)
+        {
+        case BLE_GAP_EVT_CONNECTED:
+                if (p_gap_evt->params.connected.role != BLE_GAP_ROLE_PERIPH)
+                {
+                        break;
+                }
+
+                NRF_LOG_INFO("Upstream link 0x%x established.", p_gap_evt->conn_handle);
+
+                m_conn_handle   = p_gap_evt->conn_handle;
+                m_notif_enabled = false;
+                nus_mux_reset(&m_mux);
+                timing_reset();
+
+                CRITICAL_REGION_ENTER();
+                stats_clear();
+                CRITICAL_REGION_EXIT();
+
+                err_code = app_timer_start(m_conn_param_timer, CONN_PARAM_DELAY, NULL);
+                APP_ERROR_CHECK(err_code);
+                err_code = app_timer_start(m_report_timer, REPORT_INTERVAL, NULL);
+                APP_ERROR_CHECK(err_code);
+                break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+                if (p_gap_evt->conn_handle != m_conn_handle)
+                {
+                        break;
+                }
+
+                NRF_LOG_INFO("Upstream link lost (reason: 0x%x).", p_gap_evt->params.disconnected.reason);
+
+                err_code = app_timer_stop(m_conn_param_timer);
+                APP_ERROR_CHECK(err_code);
+                err_code = app_timer_stop(m_report_timer);
+                APP_ERROR_CHECK(err_code);
+
+                m_conn_handle   = BLE_CONN_HANDLE_INVALID;
+                m_notif_enabled = false;
+                nus_mux_reset(&m_mux);
+                timing_reset();
+                // ble_advertising restarts on its own.
+                break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+                if (p_gap_evt->conn_handle == m_conn_handle)
+                {
+                        NRF_LOG_INFO("Upstream connection interval %d us.",
+                                     p_gap_evt->params.conn_param_update.conn_params.max_conn_interval * 1250);
+                }
+                break;
+
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+                if (p_ble_evt->evt.gatts_evt.conn_handle == m_conn_handle)
+                {
+                        on_hvn_tx_complete(p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+                        nus_mux_tx_process(&m_mux);
+                }
+                break;
+
+        default:
+                break;
+        }
+}
+
+NRF_SDH_BLE_OBSERVER(m_relay_obs, RELAY_BLE_OBSERVER_PRIO, relay_on_ble_evt, NULL);
+
+
+ret_code_t relay_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+        ret_code_t err_code;
+        ble_cfg_t  ble_cfg;
+
+        m_conn_cfg_tag = conn_cfg_tag;
+
+        // A short event leaves most of the radio time to the downstream links.
+        memset(&ble_cfg, 0, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                     = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.gap_conn_cfg.conn_count   = NRF_SDH_BLE_PERIPHERAL_LINK_COUNT;
+        ble_cfg.conn_cfg.params.gap_conn_cfg.event_length = RELAY_GAP_EVENT_LENGTH;
+        err_code = sd_ble_cfg_set(BLE_CONN_CFG_GAP, &ble_cfg, ram_start);
+        VERIFY_SUCCESS(err_code);
+
+        memset(&ble_cfg, 0, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                 = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.gatt_conn_cfg.att_mtu = NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
+        err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATT, &ble_cfg, ram_start);
+        VERIFY_SUCCESS(err_code);
+
+        memset(&ble_cfg, 0, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                            = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = RELAY_HVN_TX_QUEUE_SIZE;
+        return sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+}
+
+
+void relay_init(void)
+{
+        ret_code_t              err_code;
+        ble_gap_conn_sec_mode_t sec_mode;
+        ble_nus_init_t          nus_init;
+        nus_mux_init_t          mux_init;
+        ble_advertising_init_t  adv_init;
+        ble_uuid_t              adv_uuids[] = {{BLE_UUID_NUS_SERVICE, 0}};
+
+        BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
+        err_code = sd_ble_gap_device_name_set(&sec_mode,
+                                              (uint8_t const *)RELAY_DEVICE_NAME,
+                                              strlen(RELAY_DEVICE_NAME));
+        APP_ERROR_CHECK(err_code);
+
+        memset(&nus_init, 0, sizeof(nus_init));
+        nus_init.data_handler = nus_data_handler;
+        err_code = ble_nus_init(&m_nus, &nus_init);
+        APP_ERROR_CHECK(err_code);
+
+        memset(&mux_init, 0, sizeof(mux_init));
+        mux_init.send        = mux_send;
+        mux_init.evt_handler = mux_evt_handler;
+        err_code = nus_mux_init(&m_mux, &mux_init);
+        APP_ERROR_CHECK(err_code);
+
+        // The vendor specific UUID type is known once the service is added.
+        adv_uuids[0].type = m_nus.uuid_type;
+
+        memset(&adv_init, 0, sizeof(adv_init));
+        adv_init.advdata.name_type               = BLE_ADVDATA_FULL_NAME;
+        adv_init.advdata.flags                   = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+        adv_init.srdata.uuids_complete.uuid_cnt  = ARRAY_SIZE(adv_uuids);
+        adv_init.srdata.uuids_complete.p_uuids   = adv_uuids;
+        adv_init.config.ble_adv_fast_enabled     = true;
+        adv_init.config.ble_adv_fast_interval    = ADV_INTERVAL;
+        adv_init.config.ble_adv_fast_timeout     = 0;   // Until a phone connects.
+        adv_init.evt_handler                     = on_adv_evt;
+        err_code = ble_advertising_init(&m_advertising, &adv_init);
+        APP_ERROR_CHECK(err_code);
+
+        ble_advertising_conn_cfg_tag_set(&m_advertising, m_conn_cfg_tag);
+
+        err_code = app_timer_create(&m_conn_param_timer, APP_TIMER_MODE_SINGLE_SHOT, conn_param_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+        err_code = app_timer_create(&m_report_timer, APP_TIMER_MODE_REPEATED, report_timeout_handler);
+        APP_ERROR_CHECK(err_code);
+
+        stats_clear();
+}
+
+
+void relay_adv_start(void)
+{
+        ret_code_t err_code = ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST);
+        APP_ERROR_CHECK(err_code);
+}
+
+
+bool relay_is_upstream(uint16_t conn_handle)
+{
+        return (conn_handle != BLE_CONN_HANDLE_INVALID) && (conn_handle == m_conn_handle);
+}
+
+
+void relay_on_att_mtu(uint16_t conn_handle, uint16_t att_mtu)
+{
+        if (relay_is_upstream(conn_handle))
+        {
+                nus_mux_payload_max_set(&m_mux, att_mtu - OPCODE_LENGTH - HANDLE_LENGTH);
+        }
+}
+
+
+void relay_hrm(uint8_t slot, uint16_t hr_value, uint16_t const * p_rr, uint16_t rr_cnt)
+{
+        uint8_t  msg[RELAY_HDR_LEN + sizeof(uint16_t) * (1 + BLE_HRS_C_RR_INTERVALS_MAX_CNT)];
+        uint16_t len;
+
+        rr_cnt = MIN(rr_cnt, BLE_HRS_C_RR_INTERVALS_MAX_CNT);
+
+        msg[0] = RELAY_MSG_HRM;
+        msg[1] = slot;
+        len    = RELAY_HDR_LEN;
+        len   += uint16_encode(hr_value, &msg[len]);
+        for (uint32_t i = 0; i < rr_cnt; i++)
+        {
+                len += uint16_encode(p_rr[i], &msg[len]);
+        }
+
+        msg_send(NUS_MUX_CH_TELEMETRY, msg, len);
+}
+
+
+void relay_batt(uint8_t slot, uint8_t level)
+{
+        uint8_t const msg[] = {RELAY_MSG_BATT, slot, level};
+
+        msg_send(NUS_MUX_CH_TELEMETRY, msg, sizeof(msg));
+}
+
+
+void relay_link(uint8_t slot, bool up)
+{
+        uint8_t const msg[] = {RELAY_MSG_LINK, slot, up ? 1 : 0};
+
+        msg_send(NUS_MUX_CH_TELEMETRY, msg, sizeof(msg));
+}
+
+
+void relay_data(uint8_t slot, uint8_t const * p_data, uint16_t len)
+{
+        uint8_t msg[RELAY_HDR_LEN + BLE_NUS_MAX_DATA_LEN];
+
+        if ((len == 0) || (len > BLE_NUS_MAX_DATA_LEN))
+        {
+                return;
+        }
+
+        msg[0] = RELAY_MSG_DATA;
+        msg[1] = slot;
+        memcpy(&msg[RELAY_HDR_LEN], p_data, len);
+
+        msg_send(NUS_MUX_CH_DATA, msg, RELAY_HDR_LEN + len);
+}
+
+#endif // NRF_MODULE_ENABLED(RELAY)
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup relay Upstream relay
+ * @{
+ * @brief    Serves the data of all downstream links to one upstream central, such as a phone.
+ *
+ * @details  The collector also advertises as RELAY_DEVICE_NAME and accepts one peripheral link.
+ *           The link carries the Nordic UART Service, with the multiplexer of @ref nus_mux on
+ *           top, the same framing as the downstream links. Every message starts with its type
+ *           and the link context slot of its source:
+ *
+ *           @code
+ *           | type | slot | payload |
+ *           @endcode
+ *
+ *           - @ref RELAY_MSG_HRM, heart rate (2, LE) and RR intervals (2 each, LE), on
+ *             @ref NUS_MUX_CH_TELEMETRY.
+ *           - @ref RELAY_MSG_BATT, battery level (1), on @ref NUS_MUX_CH_TELEMETRY.
+ *           - @ref RELAY_MSG_LINK, 1 when the source link is up and 0 when it is lost, on
+ *             @ref NUS_MUX_CH_TELEMETRY.
+ *           - @ref RELAY_MSG_DATA, UART data of the source, on @ref NUS_MUX_CH_DATA.
+ *
+ *           Several messages share a notification up to the ATT MTU of the link. A message that
+ *           does not fit the multiplexer queues is dropped and counted, the downstream links are
+ *           never held up.
+ *
+ *           The upstream link uses its own SoftDevice connection configuration,
+ *           RELAY_GAP_EVENT_LENGTH long, and asks for a connection interval of
+ *           RELAY_MIN_CONN_INTERVAL_MS to RELAY_MAX_CONN_INTERVAL_MS. The downstream links keep
+ *           the radio for most of the time.
+ *
+ *           Every RELAY_REPORT_INTERVAL_MS the log gets the relayed and upstream throughput and
+ *           the latency of the messages, from the call that queues them to the notification
+ *           being acknowledged by the link layer.
+ *
+ * @note     Compiles to nothing unless RELAY_ENABLED is set in sdk_config.h, which it is not by
+ *           default. The settings it needs are listed there.
+ */
+
+#ifndef RELAY_H__
+#define RELAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RELAY_HDR_LEN           2   /**< Length of the message header. */
+
+/**@brief Message types. */
+typedef enum
+{
+        RELAY_MSG_HRM  = 0x01,      /**< Heart rate measurement. */
+        RELAY_MSG_BATT = 0x02,      /**< Battery level. */
+        RELAY_MSG_LINK = 0x03,      /**< Source link established or lost. */
+        RELAY_MSG_DATA = 0x04,      /**< UART data. */
+} relay_msg_t;
+
+
+#if NRF_MODULE_ENABLED(RELAY)
+
+/**@brief Function for configuring the SoftDevice for the upstream link.
+ *
+ * @details Call between nrf_sdh_ble_default_cfg_set() and nrf_sdh_ble_enable().
+ *
+ * @param[in] conn_cfg_tag  Connection configuration tag of the upstream link, not used by the
+ *                          downstream links.
+ * @param[in] ram_start     Start address of the application RAM.
+ *
+ * @return The result of sd_ble_cfg_set().
+ */
+ret_code_t relay_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+
+/**@brief Function for initializing the service, the advertising and the multiplexer.
+ *
+ * @details Call after the Peer Manager is initialized.
+ */
+void relay_init(void);
+
+
+/**@brief Function for starting the advertising. */
+void relay_adv_start(void);
+
+
+/**@brief Function for checking whether a connection is the upstream link.
+ *
+ * @param[in] conn_handle  Connection handle.
+ *
+ * @return True if @p conn_handle is the upstream link.
+ */
+bool relay_is_upstream(uint16_t conn_handle);
+
+
+/**@brief Function for handling an ATT MTU update of a link.
+ *
+ * @param[in] conn_handle  Connection handle, ignored unless it is the upstream link.
+ * @param[in] att_mtu      Effective ATT MTU.
+ */
+void relay_on_att_mtu(uint16_t conn_handle, uint16_t att_mtu);
+
+
+/**@brief Function for relaying a heart rate measurement.
+ *
+ * @param[in] slot        Link context slot of the source.
+ * @param[in] hr_value    Heart rate.
+ * @param[in] p_rr        RR intervals in 1/1024 seconds.
+ * @param[in] rr_cnt      Number of RR intervals.
+ */
+void relay_hrm(uint8_t slot, uint16_t hr_value, uint16_t const * p_rr, uint16_t rr_cnt);
+
+
+/**@brief Function for relaying a battery level.
+ *
+ * @param[in] slot   Link context slot of the source.
+ * @param[in] level  Battery level in percent.
+ */
+void relay_batt(uint8_t slot, uint8_t level);
+
+
+/**@brief Function for relaying the state of a source link.
+ *
+ * @param[in] slot  Link context slot of the source.
+ * @param[in] up    True when the link is established, false when it is lost.
+ */
+void relay_link(uint8_t slot, bool up);
+
+
+/**@brief Function for relaying UART data.
+ *
+ * @param[in] slot    Link context slot of the source.
+ * @param[in] p_data  Data.
+ * @param[in] len     Length of the data.
+ */
+void relay_data(uint8_t slot, uint8_t const * p_data, uint16_t len);
+
+#else
+
+#define relay_init()
+#define relay_adv_start()
+#define relay_is_upstream(_conn_handle)                     (false)
+#define relay_on_att_mtu(_conn_handle, _att_mtu)
+#define relay_hrm(_slot, _hr_value, _p_rr, _rr_cnt)
+#define relay_batt(_slot, _level)
+#define relay_link(_slot, _up)
+#define relay_data(_slot, _p_data, _len)
+
+#endif // NRF_MODULE_ENABLED(RELAY)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RELAY_H__
+
+/** @} */
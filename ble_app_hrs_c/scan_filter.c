@@ -0,0 +1,288 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+#include <string.h>
+#include "scan_filter.h"
+
+#define TABLE_SIZE              (1UL << SCAN_FILTER_TABLE_BITS)         /**< Slots in the table. */
+#define TABLE_MASK              (TABLE_SIZE - 1)
+
+#define TARGET_NONE             0xFF            /**< Target of a free slot. */
+#define FNV_OFFSET              0x811C9DC5UL    /**< FNV-1a hash of nothing. */
+#define FNV_PRIME               0x01000193UL    /**< FNV-1a multiplier. */
+
+STATIC_ASSERT((SCAN_FILTER_TABLE_BITS >= 2) && (SCAN_FILTER_TABLE_BITS <= 8));
+
+/**@brief Slot of the table. */
+typedef struct
+{
+        uint32_t hash;          /**< Hash of the key. */
+        uint8_t  type;          /**< Kind of the target, see @ref scan_filter_type_t. */
+        uint8_t  len;           /**< Length of the key. */
+        uint8_t  target;        /**< Index of the target, TARGET_NONE if the slot is free. */
+} slot_t;
+
+static slot_t                       m_table[TABLE_SIZE];        /**< Open-addressed table, linear probing. */
+static scan_filter_target_t const * m_p_targets;                /**< Targets given to scan_filter_init(). */
+static uint32_t                     m_types;                    /**< Bit n set if there are targets of type n. */
+static uint32_t                     m_name_lens;                /**< Bit n set if there is a name prefix of n characters. */
+
+
+/**@brief Function for starting the hash of a key, the type keeps equal bytes of different
+ *        kinds apart.
+ */
+static __INLINE uint32_t hash_start(scan_filter_type_t type)
+{
+        return (FNV_OFFSET ^ type) * FNV_PRIME;
+}
+
+
+/**@brief Function for adding a byte to the hash of a key. */
+static __INLINE uint32_t hash_step(uint32_t hash, uint8_t byte)
+{
+        return (hash ^ byte) * FNV_PRIME;
+}
+
+
+static uint32_t hash_compute(scan_filter_type_t type, uint8_t const * p_key, uint32_t len)
+{
+        uint32_t hash = hash_start(type);
+
+        for (uint32_t i = 0; i < len; i++)
+        {
+                hash = hash_step(hash, p_key[i]);
+        }
+        return hash;
+}
+
+
+/**@brief Function for computing the first slot probed for a hash. */
+static __INLINE uint32_t slot_home(uint32_t hash)
+{
+        hash *= 0x9E3779B1UL;
+        return hash >> (32 - SCAN_FILTER_TABLE_BITS);
+}
+
+
+/**@brief Function for looking up a key.
+ *
+ * @param[in] type   Kind of the key.
+ * @param[in] p_key  Key bytes from the report.
+ * @param[in] len    Length of the key.
+ * @param[in] hash   Hash of the key.
+ *
+ * @return Index of the matching target, TARGET_NONE if there is none.
+ */
+static uint32_t lookup(scan_filter_type_t type, uint8_t const * p_key, uint32_t len, uint32_t hash)
+{
+        // The table is at most half full, the loop ends at a free slot.
+        for (uint32_t slot = slot_home(hash); m_table[slot].target != TARGET_NONE; slot = (slot + 1) & TABLE_MASK)
+        {
+                slot_t const * p_slot = &m_table[slot];
+
+                if ((p_slot->hash == hash) &&
+                    (p_slot->type == type) &&
+                    (p_slot->len  == len) &&
+                    (memcmp(m_p_targets[p_slot->target].p_value, p_key, len) == 0))
+                {
+                        return p_slot->target;
+                }
+        }
+
+        return TARGET_NONE;
+}
+
+
+/**@brief Function for matching a local name against the name prefixes.
+ *
+ * @details The name is hashed once, with a lookup at every prefix length in use.
+ */
+static uint32_t name_match(uint8_t const * p_name, uint32_t len)
+{
+        uint32_t hash   = hash_start(SCAN_FILTER_NAME_PREFIX);
+        uint32_t lens   = m_name_lens;
+        uint32_t target = TARGET_NONE;
+
+        for (uint32_t i = 0; (i < len) && (lens != 0) && (target == TARGET_NONE); i++)
+        {
+                hash   = hash_step(hash, p_name[i]);
+                lens >>= 1;
+
+                if ((lens & 1) != 0)
+                {
+                        target = lookup(SCAN_FILTER_NAME_PREFIX, p_name, i + 1, hash);
+                }
+        }
+
+        return target;
+}
+
+
+ret_code_t scan_filter_init(scan_filter_target_t const * p_targets, uint32_t count)
+{
+        VERIFY_TRUE(count <= SCAN_FILTER_TARGETS_MAX, NRF_ERROR_NO_MEM);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+                VERIFY_PARAM_NOT_NULL(p_targets[i].p_value);
+                VERIFY_TRUE(p_targets[i].type < SCAN_FILTER_TYPE_CNT, NRF_ERROR_INVALID_PARAM);
+
+                if (p_targets[i].type == SCAN_FILTER_NAME_PREFIX)
+                {
+                        size_t len = strlen(p_targets[i].p_value);
+
+                        VERIFY_TRUE((len > 0) && (len <= SCAN_FILTER_NAME_MAX_LEN), NRF_ERROR_INVALID_PARAM);
+                }
+        }
+
+        memset(m_table, TARGET_NONE, sizeof(m_table));
+        m_p_targets = p_targets;
+        m_types     = 0;
+        m_name_lens = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+                scan_filter_type_t type = p_targets[i].type;
+                uint32_t           len;
+                uint32_t           hash;
+                uint32_t           slot;
+
+                switch (type)
+                {
+                case SCAN_FILTER_ADDR:
+                        len = BLE_GAP_ADDR_LEN;
+                        break;
+
+                case SCAN_FILTER_UUID128:
+                        len = SCAN_FILTER_UUID128_LEN;
+                        break;
+
+                default:
+                        len          = strlen(p_targets[i].p_value);
+                        m_name_lens |= 1UL << len;
+                        break;
+                }
+
+                hash = hash_compute(type, p_targets[i].p_value, len);
+                for (slot = slot_home(hash); m_table[slot].target != TARGET_NONE; slot = (slot + 1) & TABLE_MASK)
+                {
+                }
+
+                m_table[slot].hash   = hash;
+                m_table[slot].type   = type;
+                m_table[slot].len    = len;
+                m_table[slot].target = i;
+                m_types             |= 1UL << type;
+        }
+
+        return NRF_SUCCESS;
+}
+
+
+bool scan_filter_match(ble_gap_evt_adv_report_t const * p_report, uint32_t * p_target)
+{
+        uint8_t const * p_data = p_report->data.p_data;
+        uint32_t        len    = p_report->data.len;
+        uint32_t        target = TARGET_NONE;
+
+        if ((m_types & (1UL << SCAN_FILTER_ADDR)) != 0)
+        {
+                target = lookup(SCAN_FILTER_ADDR,
+                                p_report->peer_addr.addr,
+                                BLE_GAP_ADDR_LEN,
+                                hash_compute(SCAN_FILTER_ADDR, p_report->peer_addr.addr, BLE_GAP_ADDR_LEN));
+        }
+
+        if ((m_types & ~(1UL << SCAN_FILTER_ADDR)) == 0)
+        {
+                // Only addresses, the advertising data is not looked at.
+                len = 0;
+        }
+
+        // One pass over the AD structures, each is a length, a type and the data.
+        for (uint32_t offset = 0; (offset + 1 < len) && (target == TARGET_NONE); offset += p_data[offset] + 1)
+        {
+                uint8_t const * p_field = &p_data[offset + 2];
+                uint32_t        field_len;
+
+                if ((p_data[offset] == 0) || (offset + 1 + p_data[offset] > len))
+                {
+                        break;
+                }
+                field_len = p_data[offset] - 1;
+
+                switch (p_data[offset + 1])
+                {
+                case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE:
+                case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE:
+                        if ((m_types & (1UL << SCAN_FILTER_UUID128)) == 0)
+                        {
+                                break;
+                        }
+                        for (uint32_t i = 0; (i + SCAN_FILTER_UUID128_LEN <= field_len) && (target == TARGET_NONE); i += SCAN_FILTER_UUID128_LEN)
+                        {
+                                target = lookup(SCAN_FILTER_UUID128,
+                                                &p_field[i],
+                                                SCAN_FILTER_UUID128_LEN,
+                                                hash_compute(SCAN_FILTER_UUID128, &p_field[i], SCAN_FILTER_UUID128_LEN));
+                        }
+                        break;
+
+                case BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME:
+                case BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME:
+                        target = name_match(p_field, field_len);
+                        break;
+
+                default:
+                        break;
+                }
+        }
+
+        if (target == TARGET_NONE)
+        {
+                return false;
+        }
+
+        *p_target = target;
+        return true;
+}
+
+#endif // NRF_MODULE_ENABLED(SCAN_FILTER)
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup scan_filter Scan filter
+ * @{
+ * @brief    Matches advertising reports against a list of target peripherals.
+ *
+ * @details  Targets are given by device address, 128-bit service UUID or local name prefix, in
+ *           any mix. @ref scan_filter_init hashes them all into one open-addressed table, so
+ *           matching a report takes one pass over its advertising data and a lookup per address,
+ *           128-bit UUID and name length of interest, whatever the number of targets. Lookups
+ *           that hit are confirmed against the target itself, hash collisions never match.
+ *
+ *           A name prefix matches the complete and the shortened local name. The address is
+ *           compared without its type, like the address filter of the scanning module.
+ *
+ * @note     Compiles to nothing unless SCAN_FILTER_ENABLED is set in sdk_config.h.
+ */
+
+#ifndef SCAN_FILTER_H__
+#define SCAN_FILTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+#include "sdk_errors.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NRF_MODULE_ENABLED(SCAN_FILTER)
+
+#define SCAN_FILTER_UUID128_LEN     16      /**< Length of a 128-bit UUID. */
+#define SCAN_FILTER_NAME_MAX_LEN    29      /**< Longest name prefix, all the name that fits in the advertising data. */
+#define SCAN_FILTER_TARGETS_MAX     ((1UL << SCAN_FILTER_TABLE_BITS) / 2)  /**< Targets at most, the table is kept half empty. */
+
+/**@brief Kinds of targets. */
+typedef enum
+{
+        SCAN_FILTER_ADDR,               /**< Device address, BLE_GAP_ADDR_LEN bytes. */
+        SCAN_FILTER_UUID128,            /**< 128-bit service UUID, little-endian as in the advertising data. */
+        SCAN_FILTER_NAME_PREFIX,        /**< Start of the local name, a NUL-terminated string. */
+        SCAN_FILTER_TYPE_CNT
+} scan_filter_type_t;
+
+/**@brief Target peripheral. */
+typedef struct
+{
+        scan_filter_type_t type;        /**< Kind of the target. */
+        void const       * p_value;     /**< Address, UUID or name prefix, see @ref scan_filter_type_t. */
+} scan_filter_target_t;
+
+
+/**@brief Function for compiling the list of targets.
+ *
+ * @param[in] p_targets  Targets, must stay valid as long as the filter is used.
+ * @param[in] count      Number of targets, at most SCAN_FILTER_TARGETS_MAX.
+ *
+ * @retval NRF_SUCCESS              The targets replace the previous ones.
+ * @retval NRF_ERROR_NULL           A target has no value.
+ * @retval NRF_ERROR_INVALID_PARAM  A target type is unknown or a name prefix is empty or too long.
+ * @retval NRF_ERROR_NO_MEM         Too many targets for SCAN_FILTER_TABLE_BITS.
+ */
+ret_code_t scan_filter_init(scan_filter_target_t const * p_targets, uint32_t count);
+
+
+/**@brief Function for matching an advertising report against the targets.
+ *
+ * @param[in]  p_report  Advertising report.
+ * @param[out] p_target  Index of the matching target in the list, if any.
+ *
+ * @return True if the advertiser is a target.
+ */
+bool scan_filter_match(ble_gap_evt_adv_report_t const * p_report, uint32_t * p_target);
+
+#endif // NRF_MODULE_ENABLED(SCAN_FILTER)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCAN_FILTER_H__
+
+/** @} */
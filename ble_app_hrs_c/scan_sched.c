@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#include <string.h>
+#include "scan_sched.h"
+#include "link_ctx.h"
+#include "app_timer.h"
+
+#define NRF_LOG_MODULE_NAME scan_sched
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define TICKS_TO_MS(_ticks)     ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+
+/**@brief Scan statistics. */
+typedef struct
+{
+        uint32_t connects;          /**< Number of links established by scanning. */
+        uint32_t ttc_total_ms;      /**< Sum of the time-to-connect of all links. */
+        uint32_t ttc_max_ms;        /**< Longest time-to-connect. */
+        uint32_t timeouts;          /**< Number of scans that timed out. */
+        uint32_t scan_ms;           /**< Total time a scan was running. */
+        uint32_t radio_ms;          /**< Total time the radio was listening, window / interval of scan_ms. */
+} scan_stats_t;
+
+static ble_gap_scan_params_t m_params;          /**< Parameters of the current or next scan. */
+static uint8_t               m_backoff;         /**< Number of consecutive scan timeouts. */
+static uint16_t              m_shaped_interval; /**< Scan interval of the current or next scan, before backoff. */
+static bool                  m_scanning;        /**< True while a scan is running. */
+static bool                  m_searching;       /**< True if the running scan looks for a missing link. */
+static uint32_t              m_scan_start_tick; /**< RTC tick at which the current scan started. */
+static uint32_t              m_search_ms;       /**< Scan time accumulated since a link went missing. */
+static scan_stats_t          m_stats;           /**< Statistics. */
+
+
+/**@brief Function for closing the accounting of the running scan. */
+static void scan_session_end(void)
+{
+        uint32_t elapsed_ms;
+
+        if (!m_scanning)
+        {
+                return;
+        }
+
+        // A scan never lasts longer than the scan timeout, well within the RTC wrap-around.
+        elapsed_ms   = TICKS_TO_MS(app_timer_cnt_diff_compute(app_timer_cnt_get(), m_scan_start_tick));
+        m_scanning = false;
+
+        // Scanning with all links up only follows broadcasts, it is no time spent connecting.
+        if (m_searching)
+        {
+                m_search_ms += elapsed_ms;
+        }
+
+        m_stats.scan_ms  += elapsed_ms;
+        m_stats.radio_ms += (uint32_t)((uint64_t)elapsed_ms * m_params.window / m_params.interval);
+}
+
+
+/**@brief Function for computing interval and window from the established links.
+ *
+ * @param[out] p_interval  Scan interval in 0.625 ms units, before backoff.
+ * @param[out] p_window    Scan window in 0.625 ms units.
+ */
+static void shape_compute(uint16_t * p_interval, uint16_t * p_window)
+{
+        uint32_t links       = 0;
+        uint32_t min_conn_ci = UINT16_MAX;
+
+        for (uint32_t i = 0; i < LINK_CTX_MAX; i++)
+        {
+                link_ctx_t const * p_link = link_ctx_at(i);
+
+                if (link_ctx_in_use(p_link))
+                {
+                        links++;
+                        min_conn_ci = MIN(min_conn_ci, p_link->conn_interval);
+                }
+        }
+
+        if (links == 0)
+        {
+                // Nothing to collide with, listen all the time.
+                *p_interval = SCAN_SCHED_FAST_INTERVAL;
+                *p_window   = SCAN_SCHED_FAST_INTERVAL;
+                return;
+        }
+
+        // Connection parameters are in 1.25 ms units, scan parameters in 0.625 ms units.
+        // Assume every link runs at the shortest interval, which is the worst case.
+        uint32_t period = 2 * min_conn_ci;
+        uint32_t busy   = 2 * links * NRF_SDH_BLE_GAP_EVENT_LENGTH + SCAN_SCHED_GUARD;
+
+        // A window cannot be split over several gaps, it must fit in the one between two rounds
+        // of connection events. It repeats with them, the backoff keeps a multiple of the period.
+        if ((busy < period) && (period - busy >= SCAN_SCHED_MIN_WINDOW))
+        {
+                *p_interval = (uint16_t)period;
+                *p_window   = (uint16_t)(period - busy);
+                return;
+        }
+
+        // The connection events leave no usable gap, any window collides with them.
+        *p_interval = SCAN_SCHED_SHARED_INTERVAL;
+        *p_window   = SCAN_SCHED_SHARED_WINDOW;
+}
+
+
+void scan_sched_init(ble_gap_scan_params_t const * p_base)
+{
+        m_params          = *p_base;
+        m_backoff         = 0;
+        m_shaped_interval = SCAN_SCHED_FAST_INTERVAL;
+        m_scanning        = false;
+        m_searching       = false;
+        memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+ble_gap_scan_params_t const * scan_sched_params_get(bool use_whitelist)
+{
+        uint16_t interval;
+        uint16_t window;
+        uint8_t  backoff = m_backoff;
+
+        shape_compute(&interval, &window);
+
+        // Links may have changed since the backoff was counted. Double only while the interval
+        // stays within bounds, so it remains a multiple of the shaped one.
+        while ((backoff > 0) && (((uint32_t)interval << backoff) > SCAN_SCHED_MAX_INTERVAL))
+        {
+                backoff--;
+        }
+
+        m_shaped_interval = interval;
+        interval          = (uint16_t)(interval << backoff);
+        window            = MIN(window, interval);
+
+        m_params.interval      = interval;
+        m_params.window        = window;
+        m_params.filter_policy = use_whitelist ? BLE_GAP_SCAN_FP_WHITELIST : BLE_GAP_SCAN_FP_ACCEPT_ALL;
+
+        NRF_LOG_DEBUG("Scan interval %d, window %d, backoff %d.", interval, window, backoff);
+
+        return &m_params;
+}
+
+
+void scan_sched_on_scan_start(bool searching)
+{
+        scan_session_end();
+
+        m_scanning        = true;
+        m_searching       = searching;
+        m_scan_start_tick = app_timer_cnt_get();
+}
+
+
+void scan_sched_on_scan_timeout(void)
+{
+        scan_session_end();
+
+        if (m_searching)
+        {
+                m_stats.timeouts++;
+        }
+
+#if !NRF_MODULE_ENABLED(BCAST_RX)
+        // Broadcasting sensors need the scan duty cycle kept, see @ref bcast_rx.
+        // Stop doubling once the next interval would pass the bound.
+        if (((uint32_t)m_shaped_interval << (m_backoff + 1)) <= SCAN_SCHED_MAX_INTERVAL)
+        {
+                m_backoff++;
+        }
+#endif
+}
+
+
+void scan_sched_on_connected(void)
+{
+        scan_session_end();
+
+        m_stats.connects++;
+        m_stats.ttc_total_ms += m_search_ms;
+        m_stats.ttc_max_ms    = MAX(m_stats.ttc_max_ms, m_search_ms);
+
+        NRF_LOG_INFO("Link connected after %d ms of scanning.", m_search_ms);
+
+        m_search_ms = 0;
+        m_backoff   = 0;
+}
+
+
+void scan_sched_on_disconnected(void)
+{
+        m_backoff = 0;
+}
+
+
+void scan_sched_stats_log(void)
+{
+        bool scanning = m_scanning;
+
+        // Close the running scan so its time is included, then reopen it.
+        scan_session_end();
+        if (scanning)
+        {
+                m_scanning        = true;
+                m_scan_start_tick = app_timer_cnt_get();
+        }
+
+        NRF_LOG_INFO("Scan: %d connects, time-to-connect avg %d ms max %d ms, %d timeouts.",
+                     m_stats.connects,
+                     (m_stats.connects != 0) ? (m_stats.ttc_total_ms / m_stats.connects) : 0,
+                     m_stats.ttc_max_ms,
+                     m_stats.timeouts);
+        NRF_LOG_INFO("Scan: %d ms scanning, %d ms radio time.",
+                     m_stats.scan_ms,
+                     m_stats.radio_ms);
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup scan_sched Scan scheduler
+ * @{
+ * @brief    Adapts the scan window and interval to the state of the central's links.
+ *
+ * @details  The scheduler computes the scan parameters used for every scan start:
+ *           - With no link established the radio is free, so the scan runs continuously
+ *             (window equal to interval).
+ *           - With links established the scan interval is the shortest connection interval and
+ *             the window is that interval less the connection event length reserved for each
+ *             link, so the window fits the gap between two rounds of connection events and
+ *             repeats with them. The SoftDevice picks where the scan starts, so this bounds the
+ *             radio time taken from the links rather than guaranteeing that the window never
+ *             overlaps an event; when it does, the SoftDevice arbitrates. When the gap is shorter
+ *             than @ref SCAN_SCHED_MIN_WINDOW, the scan runs at a fixed duty cycle.
+ *           - Every scan timeout without a connection doubles the scan interval, keeping the
+ *             window, as long as it stays within @ref SCAN_SCHED_MAX_INTERVAL. The backoff is
+ *             reset when a link is established or lost. There is no backoff while @ref bcast_rx follows broadcasts.
+ *
+ *           The scheduler also measures the time it takes to connect a missing link (scan time
+ *           while a link is missing, until the connection) and the radio time spent scanning,
+ *           see @ref scan_sched_stats_log.
+ */
+
+#ifndef SCAN_SCHED_H__
+#define SCAN_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCAN_SCHED_FAST_INTERVAL    96      /**< Scan interval and window when no link is established (60 ms, in 0.625 ms units). */
+#define SCAN_SCHED_MIN_WINDOW       8       /**< Smallest useful scan window (5 ms, in 0.625 ms units). */
+#define SCAN_SCHED_GUARD            4       /**< Margin left between the scan window and the next connection event (2.5 ms, in 0.625 ms units). */
+#define SCAN_SCHED_MAX_INTERVAL     16384   /**< Upper bound of the scan interval during backoff (10.24 s, in 0.625 ms units). */
+#define SCAN_SCHED_SHARED_INTERVAL  160     /**< Scan interval when the links leave no gap for a window (100 ms, in 0.625 ms units). */
+#define SCAN_SCHED_SHARED_WINDOW    48      /**< Scan window when the links leave no gap, the SoftDevice arbitrates (30 ms, in 0.625 ms units). */
+
+
+/**@brief Function for initializing the scan scheduler.
+ *
+ * @param[in] p_base  Parameters the scheduled ones are derived from. Only the interval and
+ *                    window are changed by the scheduler.
+ */
+void scan_sched_init(ble_gap_scan_params_t const * p_base);
+
+
+/**@brief Function for computing the parameters for the next scan.
+ *
+ * @param[in] use_whitelist  True to scan with the whitelist filter policy, false to accept all
+ *                           advertisers.
+ *
+ * @return Pointer to the scan parameters, valid until the next call.
+ */
+ble_gap_scan_params_t const * scan_sched_params_get(bool use_whitelist);
+
+
+/**@brief Function for notifying the scheduler that a scan has been started.
+ *
+ * @param[in] searching  True if a central link is missing. Only then does the scan time count
+ *                       toward the time-to-connect, and a timeout toward the statistics.
+ */
+void scan_sched_on_scan_start(bool searching);
+
+
+/**@brief Function for notifying the scheduler that a scan has timed out. */
+void scan_sched_on_scan_timeout(void);
+
+
+/**@brief Function for notifying the scheduler that a central link has been established. */
+void scan_sched_on_connected(void);
+
+
+/**@brief Function for notifying the scheduler that a central link has been lost. */
+void scan_sched_on_disconnected(void);
+
+
+/**@brief Function for writing the time-to-connect and scan radio time statistics to the log. */
+void scan_sched_stats_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCAN_SCHED_H__
+
+/** @} */
@@ -48,6 +48,7 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "nrf.h"
@@ -81,6 +82,38 @@
 #include "nrf_drv_clock.h"
 #include "nrf_ble_gatt.h"
 #include "nrf_ble_qwr.h"
+#include "nus_mux.h"
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+#include "ble_l2cap_coc.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+#include "nus_arq.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+#include "nus_lz.h"
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+#include "nus_tput.h"
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT)
+#include "ble_hrt.h"
+#include "hrt_codec.h"
+#endif
+#if NRF_MODULE_ENABLED(HRT_LOG)
+#include "hrt_log.h"
+#endif
+#if NRF_MODULE_ENABLED(PPG)
+#include "ppg.h"
+#endif
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+#include "ble_radio_notification.h"
+#include "nrf_rtc.h"
+#endif
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+#include "hrs_bcast.h"
+#endif
+#include "lesc_prof.h"
+#include "ble_ram_cfg.h"
 
 #if defined (UART_PRESENT)
 #include "nrf_uart.h"
@@ -120,6 +153,11 @@
 #define MAX_RR_INTERVAL                     500                                     /**< Maximum RR interval as returned by the simulated measurement function. */
 #define RR_INTERVAL_INCREMENT               1                                       /**< Value by which the RR interval is incremented/decremented for each call to the simulated measurement function. */
 
+#define PPG_STATS_INTERVAL                  60                                      /**< Heart rate measurements between two logs of the PPG statistics. */
+#define HRM_SYNC_STATS_INTERVAL             60                                      /**< Heart rate measurements between two logs of their latency. */
+#define HRM_SYNC_RTC                        NRF_RTC2                                /**< RTC timing the measurements at 32768 Hz, RTC1 counts the RTOS ticks at 1024 Hz. */
+#define HRM_SYNC_RTC_MASK                   0x00FFFFFF                              /**< The RTC counter is 24 bits wide. */
+
 #define SENSOR_CONTACT_DETECTED_INTERVAL    5000                                    /**< Sensor Contact Detected toggle interval (ms). */
 
 #define MIN_CONN_INTERVAL                   MSEC_TO_UNITS(400, UNIT_1_25_MS)        /**< Minimum acceptable connection interval (0.4 seconds). */
@@ -133,15 +171,24 @@
 
 #define SEC_PARAM_BOND                      1                                       /**< Perform bonding. */
 #define SEC_PARAM_MITM                      0                                       /**< Man In The Middle protection not required. */
-#define SEC_PARAM_LESC                      0                                       /**< LE Secure Connections not enabled. */
+#define SEC_PARAM_LESC                      1                                       /**< LE Secure Connections enabled. */
 #define SEC_PARAM_KEYPRESS                  0                                       /**< Keypress notifications not enabled. */
 #define SEC_PARAM_IO_CAPABILITIES           BLE_GAP_IO_CAPS_NONE                    /**< No I/O capabilities. */
 #define SEC_PARAM_OOB                       0                                       /**< Out Of Band data not available. */
 #define SEC_PARAM_MIN_KEY_SIZE              7                                       /**< Minimum encryption key size. */
 #define SEC_PARAM_MAX_KEY_SIZE              16                                      /**< Maximum encryption key size. */
 
+#define LESC_TASK_STACK_SIZE                512                                     /**< Stack of the LESC task in words, with room for the P-256 computation. */
+#define LESC_TASK_PRIORITY                  1                                       /**< Priority of the LESC task, below the SoftDevice and timer tasks. */
+
+#define SYS_ATTR_LEN_MAX                    64                                      /**< Largest system attributes stored with a bond, the CCCDs of all services take about 30 bytes. */
+
 #define DEAD_BEEF                           0xDEADBEEF                              /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
+#if NRF_MODULE_ENABLED(NUS_LZ) && !NRF_MODULE_ENABLED(NUS_ARQ)
+#error "NUS_LZ needs the in-order delivery of NUS_ARQ."
+#endif
+
 #define UART_TX_BUF_SIZE                256                                         /**< UART TX buffer size. */
 #define UART_RX_BUF_SIZE                256                                         /**< UART RX buffer size. */
 
@@ -151,23 +198,50 @@
 BLE_BAS_DEF(m_bas);                                                 /**< Battery service instance. */
 BLE_HRS_DEF(m_hrs);                                                 /**< Heart rate service instance. */
 BLE_NUS_DEF(m_nus, NRF_SDH_BLE_TOTAL_LINK_COUNT);                                   /**< BLE NUS service instance. */
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+BLE_L2CAP_COC_DEF(m_coc);                                           /**< L2CAP channel carrying the UART data instead of NUS. */
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT)
+BLE_HRT_DEF(m_hrt);                                                 /**< Heart rate telemetry service instance. */
+#endif
 
 NRF_BLE_GATT_DEF(m_gatt);                                           /**< GATT module instance. */
 NRF_BLE_QWR_DEF(m_qwr);                                             /**< Context for the Queued Write module.*/
 BLE_ADVERTISING_DEF(m_advertising);                                 /**< Advertising module instance. */
 
 static uint16_t m_conn_handle         = BLE_CONN_HANDLE_INVALID;    /**< Handle of the current connection. */
-static bool m_rr_interval_enabled = true;                           /**< Flag for enabling and disabling the registration of new RR interval measurements (the purpose of disabling this is just to test sending HRM without RR interval data. */
+static nus_mux_t m_mux;                                             /**< Logical channels carried over NUS or the L2CAP channel. */
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+static nus_arq_t m_arq;                                             /**< Reliable transfer on the data channel of the multiplexer. */
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+static nus_lz_t m_lz;                                               /**< Compression of the data carried by the reliable transfer. The encoder is used from the timer task only. */
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+static nus_tput_t m_tput;                                           /**< Throughput test, run by the central. */
+#endif
 
+static uint8_t       m_uart_lines[2][BLE_NUS_MAX_DATA_LEN];         /**< Lines received over UART, one filled while the other waits for the timer task. */
+static volatile bool m_uart_line_busy[2];                           /**< The line is pended to the timer task and must not be overwritten. */
+#if NRF_MODULE_ENABLED(BLE_HRT)
+static hrt_enc_t m_hrt_enc;                                         /**< Encoder of the heart rate telemetry blocks, fed from the timer task. */
+#endif
 static sensorsim_cfg_t m_battery_sim_cfg;                           /**< Battery Level sensor simulator configuration. */
 static sensorsim_state_t m_battery_sim_state;                       /**< Battery Level sensor simulator state. */
+#if !NRF_MODULE_ENABLED(PPG)
+static bool m_rr_interval_enabled = true;                           /**< Flag for enabling and disabling the registration of new RR interval measurements (the purpose of disabling this is just to test sending HRM without RR interval data. */
+
 static sensorsim_cfg_t m_heart_rate_sim_cfg;                        /**< Heart Rate sensor simulator configuration. */
 static sensorsim_state_t m_heart_rate_sim_state;                    /**< Heart Rate sensor simulator state. */
 static sensorsim_cfg_t m_rr_interval_sim_cfg;                       /**< RR Interval sensor simulator configuration. */
 static sensorsim_state_t m_rr_interval_sim_state;                   /**< RR Interval sensor simulator state. */
+#endif
 
 static uint16_t m_ble_nus_max_data_len = BLE_GATT_ATT_MTU_DEFAULT - 3;              /**< Maximum length of data (in bytes) that can be transmitted to the peer by the Nordic UART service module. */
 
+static uint32_t m_sys_attr[CEIL_DIV(offsetof(pm_peer_data_local_gatt_db_t, data) + SYS_ATTR_LEN_MAX,
+                                    sizeof(uint32_t))];             /**< System attributes being stored with a bond, kept until the Peer Manager has written them. */
+
 static ble_uuid_t m_adv_uuids[] =                                   /**< Universally unique service identifiers. */
 {
         {BLE_UUID_HEART_RATE_SERVICE, BLE_UUID_TYPE_BLE},
@@ -177,12 +251,57 @@ static ble_uuid_t m_adv_uuids[] =                                   /**< Univers
 
 static TimerHandle_t m_battery_timer;                               /**< Definition of battery timer. */
 static TimerHandle_t m_heart_rate_timer;                            /**< Definition of heart rate timer. */
+#if !NRF_MODULE_ENABLED(PPG)
 static TimerHandle_t m_rr_interval_timer;                           /**< Definition of RR interval timer. */
+#endif
 static TimerHandle_t m_sensor_contact_timer;                        /**< Definition of sensor contact detected timer. */
 
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+/**@brief Time from queueing a heart rate measurement to the HVN TX_COMPLETE event reporting it sent. */
+typedef struct
+{
+        uint32_t count;                                             /**< Measurements. */
+        uint32_t sum_us;                                            /**< Sum of their latencies. */
+        uint32_t min_us;                                            /**< Shortest latency. */
+        uint32_t max_us;                                            /**< Longest latency. */
+} hrm_latency_t;
+
+static volatile bool       m_hrm_due;                               /**< A measurement waits for the notification before the next connection event. */
+static volatile bool       m_hrm_queued;                            /**< A measurement was queued and is not reported sent yet. */
+static uint32_t            m_hrm_rtc;                               /**< RTC counter when the measurement was queued. */
+static uint32_t            m_hrm_hvn;                               /**< Notifications sent on the link once the measurement is sent. */
+static volatile uint32_t   m_hvn_queued;                            /**< Notifications queued on the link. */
+static volatile uint32_t   m_hvn_done;                              /**< Notifications reported sent on the link. */
+static hrm_latency_t       m_hrm_latency;                           /**< Latency statistics, reset when logged. */
+
+/**@brief Macro for starting to queue a notification, see @ref HVN_COUNT_EXIT. */
+#define HVN_COUNT_ENTER()           CRITICAL_REGION_ENTER()
+
+/**@brief Macro for counting a notification queued, in the critical region of the call queueing it
+ *        so that the count follows the order of the SoftDevice queue.
+ */
+#define HVN_COUNT_EXIT(_err_code)                                       \
+        if ((_err_code) == NRF_SUCCESS)                                 \
+        {                                                               \
+                m_hvn_queued++;                                         \
+        }                                                               \
+        CRITICAL_REGION_EXIT()
+#else
+#define HVN_COUNT_ENTER()
+#define HVN_COUNT_EXIT(_err_code)
+#endif
+
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+static hrs_bcast_enc_t m_bcast_enc;                                 /**< Measurement broadcast encoder, fed from the timer task. */
+static uint8_t         m_bcast_adv[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX]; /**< Advertising data, one buffer advertised while the other is written. */
+static uint8_t         m_bcast_adv_idx;                             /**< Buffer of m_bcast_adv being advertised. */
+static bool            m_bcast_started;                             /**< True once the broadcast advertising has started. */
+#endif
+
 #if NRF_LOG_ENABLED
 static TaskHandle_t m_logger_thread;                                /**< Definition of Logger thread. */
 #endif
+static TaskHandle_t m_lesc_thread;                                  /**< Thread computing the LESC DHKeys. */
 
 static void advertising_start(void * p_erase_bonds);
 
@@ -204,6 +323,42 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
 }
 
 
+/**@brief Function for storing the system attributes of a link with the new bond of its peer.
+ *
+ * @details The Peer Manager gives them back to the SoftDevice when the peer connects again, so
+ *          the CCCDs it enabled are enabled before its first request and it does not write them again.
+ *          The Peer Manager stores the CCCD writes of bonded peers itself, but a new peer writes
+ *          its CCCDs while the bond is being created and those writes would be lost.
+ *
+ * @param[in] conn_handle  Connection handle.
+ * @param[in] peer_id      Peer of the link.
+ */
+static void sys_attr_store(uint16_t conn_handle, pm_peer_id_t peer_id)
+{
+        pm_peer_data_local_gatt_db_t * p_db = (pm_peer_data_local_gatt_db_t *)m_sys_attr;
+        uint16_t                       len  = SYS_ATTR_LEN_MAX;
+        ret_code_t                     err_code;
+
+        p_db->flags = BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS | BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS;
+
+        err_code = sd_ble_gatts_sys_attr_get(conn_handle, p_db->data, &len, p_db->flags);
+        if (err_code == NRF_SUCCESS)
+        {
+                p_db->len = len;
+                err_code  = pm_peer_data_store(peer_id,
+                                               PM_PEER_DATA_ID_GATT_LOCAL,
+                                               p_db,
+                                               ALIGN_NUM(sizeof(uint32_t), offsetof(pm_peer_data_local_gatt_db_t, data) + len),
+                                               NULL);
+        }
+
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("System attributes of peer %d not stored: 0x%x.", peer_id, err_code);
+        }
+}
+
+
 /**@brief Function for handling Peer Manager events.
  *
  * @param[in] p_evt  Peer Manager event.
@@ -222,6 +377,15 @@ static void pm_evt_handler(pm_evt_t const * p_evt)
                 advertising_start(&delete_bonds);
                 break;
 
+        case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
+                if ((p_evt->params.peer_data_update_succeeded.data_id == PM_PEER_DATA_ID_BONDING) &&
+                    (p_evt->params.peer_data_update_succeeded.action == PM_PEER_DATA_OP_UPDATE) &&
+                    (p_evt->conn_handle == m_conn_handle))
+                {
+                        sys_attr_store(p_evt->conn_handle, p_evt->peer_id);
+                }
+                break;
+
         default:
                 break;
         }
@@ -237,8 +401,71 @@ static void battery_level_update(void)
         uint8_t battery_level;
 
         battery_level = (uint8_t)sensorsim_measure(&m_battery_sim_state, &m_battery_sim_cfg);
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+        hrs_bcast_enc_batt_set(&m_bcast_enc, battery_level);
+#endif
 
+        HVN_COUNT_ENTER();
         err_code = ble_bas_battery_level_update(&m_bas, battery_level, BLE_CONN_HANDLE_ALL);
+        HVN_COUNT_EXIT(err_code);
+        if ((err_code != NRF_SUCCESS) &&
+            (err_code != NRF_ERROR_INVALID_STATE) &&
+            (err_code != NRF_ERROR_RESOURCES) &&
+            (err_code != NRF_ERROR_BUSY) &&
+            (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
+            )
+        {
+                APP_ERROR_HANDLER(err_code);
+        }
+}
+
+
+/**@brief Function for handling the Battery measurement timer time-out.
+ *
+ * @details This function will be called each time the battery level measurement timer expires.
+ *
+ * @param[in] xTimer Handler to the timer that called this function.
+ *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ */
+static void battery_level_meas_timeout_handler(TimerHandle_t xTimer)
+{
+        UNUSED_PARAMETER(xTimer);
+        battery_level_update();
+}
+
+
+#if NRF_MODULE_ENABLED(BLE_HRT)
+/**@brief Function for converting FreeRTOS ticks to milliseconds without overflowing the product.
+ *
+ * @param[in] ticks  Tick count.
+ *
+ * @return Milliseconds, wrapping at 2^32.
+ */
+static uint32_t ticks_to_ms(TickType_t ticks)
+{
+        return (uint32_t)(((uint64_t)ticks * 1000) / configTICK_RATE_HZ);
+}
+
+
+/**@brief Function for sending a completed telemetry block.
+ *
+ * @details Called from the timer task by the encoder. A block that cannot be sent is kept in the
+ *          flash backlog, or dropped without it, the central counts the gap in the block sequence
+ *          numbers.
+ *
+ * @param[in] p_context  Unused.
+ * @param[in] p_block    Block.
+ * @param[in] len        Length of the block.
+ */
+static void hrt_block_handler(void * p_context, uint8_t const * p_block, uint16_t len)
+{
+        ret_code_t err_code;
+
+        UNUSED_PARAMETER(p_context);
+
+        HVN_COUNT_ENTER();
+        err_code = ble_hrt_block_send(&m_hrt, p_block, len);
+        HVN_COUNT_EXIT(err_code);
         if ((err_code != NRF_SUCCESS) &&
             (err_code != NRF_ERROR_INVALID_STATE) &&
             (err_code != NRF_ERROR_RESOURCES) &&
@@ -248,138 +475,844 @@ static void battery_level_update(void)
         {
                 APP_ERROR_HANDLER(err_code);
         }
+        else if (err_code != NRF_SUCCESS)
+        {
+#if NRF_MODULE_ENABLED(HRT_LOG)
+                err_code = hrt_log_append(p_block, len);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Telemetry block dropped: 0x%x.", err_code);
+                }
+#else
+                NRF_LOG_DEBUG("Telemetry block dropped: 0x%x.", err_code);
+#endif
+        }
+}
+
+
+#if NRF_MODULE_ENABLED(HRT_LOG)
+/**@brief Function for sending a block of the flash backlog.
+ *
+ * @param[in] p_context  Unused.
+ * @param[in] p_block    Block.
+ * @param[in] len        Length of the block.
+ *
+ * @return Result of @ref ble_hrt_block_send.
+ */
+static ret_code_t hrt_log_send(void * p_context, uint8_t const * p_block, uint16_t len)
+{
+        ret_code_t err_code;
+
+        UNUSED_PARAMETER(p_context);
+
+        HVN_COUNT_ENTER();
+        err_code = ble_hrt_block_send(&m_hrt, p_block, len);
+        HVN_COUNT_EXIT(err_code);
+
+        return err_code;
+}
+
+
+/**@brief Function for uploading the flash backlog while the link has room for it.
+ */
+static void hrt_log_drain(void)
+{
+        ret_code_t err_code;
+
+        err_code = hrt_log_upload(hrt_log_send, NULL);
+        if ((err_code != NRF_SUCCESS) &&
+            (err_code != NRF_ERROR_INVALID_STATE) &&
+            (err_code != NRF_ERROR_RESOURCES) &&
+            (err_code != NRF_ERROR_BUSY)
+            )
+        {
+                APP_ERROR_HANDLER(err_code);
+        }
+}
+#endif // NRF_MODULE_ENABLED(HRT_LOG)
+
+
+/**@brief Function for handling Heart Rate Telemetry Service events.
+ *
+ * @param[in] p_hrt  Service instance.
+ * @param[in] p_evt  Event.
+ */
+static void hrt_evt_handler(ble_hrt_t * p_hrt, ble_hrt_evt_t const * p_evt)
+{
+        UNUSED_PARAMETER(p_hrt);
+
+        switch (p_evt->evt_type)
+        {
+        case BLE_HRT_EVT_NOTIF_ENABLED:
+                NRF_LOG_INFO("Heart rate telemetry enabled.");
+#if NRF_MODULE_ENABLED(HRT_LOG)
+                NRF_LOG_INFO("Telemetry backlog: %u blocks.", hrt_log_depth());
+                hrt_log_drain();
+#endif
+                break;
+
+        case BLE_HRT_EVT_NOTIF_DISABLED:
+                NRF_LOG_INFO("Heart rate telemetry disabled.");
+                break;
+
+#if NRF_MODULE_ENABLED(HRT_LOG)
+        case BLE_HRT_EVT_TX_RDY:
+                hrt_log_drain();
+                break;
+#endif
+
+        default:
+                break;
+        }
+}
+#endif // NRF_MODULE_ENABLED(BLE_HRT)
+
+
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+/**@brief Function for logging the latency statistics of the heart rate measurements, and
+ *        clearing them.
+ */
+static void hrm_latency_log(void)
+{
+        hrm_latency_t latency;
+
+        CRITICAL_REGION_ENTER();
+        latency = m_hrm_latency;
+        memset(&m_hrm_latency, 0, sizeof(m_hrm_latency));
+        CRITICAL_REGION_EXIT();
+
+        if (latency.count == 0)
+        {
+                return;
+        }
+
+        NRF_LOG_INFO("HRM latency (%s): %d measurements, avg %d us, min %d us, max %d us.",
+                     HRM_SYNC_ALIGN ? "aligned" : "free-running",
+                     latency.count, latency.sum_us / latency.count, latency.min_us, latency.max_us);
+}
+#endif // NRF_MODULE_ENABLED(HRM_SYNC)
+
+
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+/**@brief Function for broadcasting a heart rate measurement, in the timer task.
+ *
+ * @details The SoftDevice keeps advertising from the buffer it was given, so the measurement is
+ *          encoded into the other buffer and the two are swapped. The first measurement starts
+ *          the advertising, non-connectable and non-scannable.
+ *
+ * @param[in] heart_rate  Heart rate.
+ */
+static void heart_rate_meas_broadcast(uint16_t heart_rate)
+{
+        ret_code_t               err_code;
+        uint8_t                  meas[HRS_BCAST_DATA_LEN];
+        uint8_t                  idx = m_bcast_adv_idx ^ 1;
+        ble_advdata_t            advdata;
+        ble_advdata_manuf_data_t manuf_data;
+        ble_gap_adv_data_t       adv_data;
+        ble_gap_adv_params_t     adv_params;
+
+        hrs_bcast_enc_meas(&m_bcast_enc, heart_rate, meas);
+
+        memset(&manuf_data, 0, sizeof(manuf_data));
+        manuf_data.company_identifier = HRS_BCAST_COMPANY_ID;
+        manuf_data.data.p_data        = meas;
+        manuf_data.data.size          = sizeof(meas);
+
+        memset(&advdata, 0, sizeof(advdata));
+        advdata.name_type             = BLE_ADVDATA_NO_NAME;
+        advdata.p_manuf_specific_data = &manuf_data;
+
+        memset(&adv_data, 0, sizeof(adv_data));
+        adv_data.adv_data.p_data = m_bcast_adv[idx];
+        adv_data.adv_data.len    = sizeof(m_bcast_adv[idx]);
+
+        err_code = ble_advdata_encode(&advdata, adv_data.adv_data.p_data, &adv_data.adv_data.len);
+        APP_ERROR_CHECK(err_code);
+
+        if (m_bcast_started)
+        {
+                // New data only, the SoftDevice switches to it at the next advertising event.
+                err_code = sd_ble_gap_adv_set_configure(&m_advertising.adv_handle, &adv_data, NULL);
+                APP_ERROR_CHECK(err_code);
+                m_bcast_adv_idx = idx;
+                return;
+        }
+
+        memset(&adv_params, 0, sizeof(adv_params));
+        adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+        adv_params.filter_policy   = BLE_GAP_ADV_FP_ANY;
+        adv_params.interval        = MSEC_TO_UNITS(HRS_BCAST_ADV_INTERVAL_MS, UNIT_0_625_MS);
+        adv_params.duration        = BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED;
+        adv_params.primary_phy     = BLE_GAP_PHY_1MBPS;
+
+        err_code = sd_ble_gap_adv_set_configure(&m_advertising.adv_handle, &adv_data, &adv_params);
+        APP_ERROR_CHECK(err_code);
+
+        err_code = sd_ble_gap_adv_start(m_advertising.adv_handle, APP_BLE_CONN_CFG_TAG);
+        APP_ERROR_CHECK(err_code);
+
+        m_bcast_adv_idx = idx;
+        m_bcast_started = true;
+        NRF_LOG_INFO("Broadcasting heart rate measurements.");
+}
+#endif // NRF_MODULE_ENABLED(HRS_BCAST)
+
+
+/**@brief Function for taking a heart rate measurement and queueing it, in the timer task.
+ *
+ * @details With the simulated sensor, it will exclude RR Interval data from every third
+ *          measurement.
+ */
+static void heart_rate_meas_send(void)
+{
+        static uint32_t cnt = 0;
+        ret_code_t err_code;
+        uint16_t heart_rate;
+
+#if NRF_MODULE_ENABLED(PPG)
+        heart_rate = ppg_heart_rate_get();
+#else
+        heart_rate = (uint16_t)sensorsim_measure(&m_heart_rate_sim_state, &m_heart_rate_sim_cfg);
+#endif
+
+        cnt++;
+#if NRF_MODULE_ENABLED(BLE_HRT)
+        if (m_conn_handle != BLE_CONN_HANDLE_INVALID)
+        {
+                // Blocks fill one notification at the ATT MTU of the link.
+                hrt_enc_block_max_set(&m_hrt_enc, m_ble_nus_max_data_len);
+        }
+        hrt_enc_hr_add(&m_hrt_enc, ticks_to_ms(xTaskGetTickCount()), heart_rate);
+#endif
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+        heart_rate_meas_broadcast(heart_rate);
+#endif
+        HVN_COUNT_ENTER();
+        err_code = ble_hrs_heart_rate_measurement_send(&m_hrs, heart_rate);
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+        if ((err_code == NRF_SUCCESS) && !m_hrm_queued)
+        {
+                // Sent once the notifications queued so far, this one included, are sent.
+                m_hrm_rtc    = nrf_rtc_counter_get(HRM_SYNC_RTC);
+                m_hrm_hvn    = m_hvn_queued + 1;
+                m_hrm_queued = true;
+        }
+#endif
+        HVN_COUNT_EXIT(err_code);
+        if ((err_code != NRF_SUCCESS) &&
+            (err_code != NRF_ERROR_INVALID_STATE) &&
+            (err_code != NRF_ERROR_RESOURCES) &&
+            (err_code != NRF_ERROR_BUSY) &&
+            (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
+            )
+        {
+                APP_ERROR_HANDLER(err_code);
+        }
+
+#if NRF_MODULE_ENABLED(PPG)
+        if ((cnt % PPG_STATS_INTERVAL) == 0)
+        {
+                ppg_stats_log();
+        }
+#else
+        // Disable RR Interval recording every third heart rate measurement.
+        // NOTE: An application will normally not do this. It is done here just for testing generation
+        // of messages without RR Interval measurements.
+        m_rr_interval_enabled = ((cnt % 3) != 0);
+#endif
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+        if ((cnt % HRM_SYNC_STATS_INTERVAL) == 0)
+        {
+                hrm_latency_log();
+        }
+#endif
+}
+
+
+/**@brief Function for handling the Heart rate measurement timer time-out.
+ *
+ * @details This function will be called each time the heart rate measurement timer expires.
+ *          With HRM_SYNC_ALIGN, the measurement of a connected link is left to the radio
+ *          notification before the next connection event, so that it does not wait in the
+ *          SoftDevice for up to a connection interval.
+ *
+ * @param[in] xTimer Handler to the timer that called this function.
+ *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ */
+static void heart_rate_meas_timeout_handler(TimerHandle_t xTimer)
+{
+        UNUSED_PARAMETER(xTimer);
+
+#if NRF_MODULE_ENABLED(HRM_SYNC) && HRM_SYNC_ALIGN
+        if (m_conn_handle != BLE_CONN_HANDLE_INVALID)
+        {
+                m_hrm_due = true;
+                return;
+        }
+#endif
+        heart_rate_meas_send();
+}
+
+
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+/**@brief Function for taking a heart rate measurement pended from the radio notification.
+ *
+ * @param[in] p_context  Unused.
+ * @param[in] unused     Unused.
+ */
+static void heart_rate_meas_pended(void * p_context, uint32_t unused)
+{
+        UNUSED_PARAMETER(p_context);
+        UNUSED_PARAMETER(unused);
+
+        heart_rate_meas_send();
+}
+
+
+/**@brief Function for handling the radio notifications, in the SWI interrupt.
+ *
+ * @details The notification before a radio event pends a due measurement to the timer task,
+ *          which queues it before the event starts.
+ *
+ * @param[in] radio_active  True before a radio event, false after it.
+ */
+static void radio_notification_evt_handler(bool radio_active)
+{
+        BaseType_t yield_req = pdFALSE;
+
+        if (!radio_active || !m_hrm_due)
+        {
+                return;
+        }
+
+        m_hrm_due = false;
+        if (pdPASS != xTimerPendFunctionCallFromISR(heart_rate_meas_pended,
+                                                    NULL,
+                                                    0,
+                                                    &yield_req))
+        {
+                // The timer queue is full, try again before the next event.
+                m_hrm_due = true;
+                return;
+        }
+        portYIELD_FROM_ISR(yield_req);
+}
+
+
+/**@brief Function for handling the notifications reported sent, closing the latency of the
+ *        measurement once the notification carrying it is sent.
+ *
+ * @details The SoftDevice sends the notifications of a link in the order they were queued, the
+ *          measurement is sent with the m_hrm_hvn-th notification queued. Times are taken from
+ *          the RTC, to about 31 us.
+ *
+ * @param[in] count  Notifications sent, from BLE_GATTS_EVT_HVN_TX_COMPLETE.
+ */
+static void hrm_hvn_tx_complete(uint8_t count)
+{
+        uint32_t now = nrf_rtc_counter_get(HRM_SYNC_RTC);
+
+        CRITICAL_REGION_ENTER();
+
+        m_hvn_done += count;
+        if (m_hrm_queued && ((int32_t)(m_hvn_done - m_hrm_hvn) >= 0))
+        {
+                // 1000000 / 32768 = 15625 / 512 us per RTC tick.
+                uint32_t ticks      = (now - m_hrm_rtc) & HRM_SYNC_RTC_MASK;
+                uint32_t latency_us = (uint32_t)ROUNDED_DIV((uint64_t)ticks * 15625, 512);
+
+                m_hrm_queued         = false;
+                m_hrm_latency.sum_us += latency_us;
+                m_hrm_latency.max_us  = MAX(m_hrm_latency.max_us, latency_us);
+                m_hrm_latency.min_us  = (m_hrm_latency.count == 0) ? latency_us
+                                        : MIN(m_hrm_latency.min_us, latency_us);
+                m_hrm_latency.count++;
+        }
+
+        CRITICAL_REGION_EXIT();
+}
+#endif // NRF_MODULE_ENABLED(HRM_SYNC)
+
+
+#if NRF_MODULE_ENABLED(PPG)
+/**@brief Function for running the PPG beat detection on a full buffer, in the timer task.
+ *
+ * @param[in] p_samples  Samples.
+ * @param[in] count      Number of samples.
+ */
+static void ppg_buffer_process(void * p_samples, uint32_t count)
+{
+        ppg_process((int16_t const *)p_samples, (uint16_t)count);
+}
+
+
+/**@brief Function for handling a full PPG buffer, in the SAADC interrupt.
+ *
+ * @details The DSP runs in the timer task, like the other sensor handlers, so that the RR
+ *          intervals reach the Heart Rate Service and the telemetry encoder from one task.
+ *
+ * @param[in] p_samples  Samples.
+ * @param[in] count      Number of samples.
+ */
+static void ppg_buffer_handler(int16_t const * p_samples, uint16_t count)
+{
+        BaseType_t yield_req = pdFALSE;
+
+        if (pdPASS != xTimerPendFunctionCallFromISR(ppg_buffer_process,
+                                                    (void *)p_samples,
+                                                    count,
+                                                    &yield_req))
+        {
+                // The timer queue is full, the buffer is dropped.
+                NRF_LOG_WARNING("PPG buffer dropped.");
+                return;
+        }
+
+        portYIELD_FROM_ISR(yield_req);
+}
+
+
+/**@brief Function for handling an RR interval from the PPG beat detection.
+ *
+ * @param[in] p_context    Unused.
+ * @param[in] rr_interval  RR interval in 1/1024 seconds.
+ */
+static void ppg_beat_handler(void * p_context, uint16_t rr_interval)
+{
+        UNUSED_PARAMETER(p_context);
+
+        ble_hrs_rr_interval_add(&m_hrs, rr_interval);
+#if NRF_MODULE_ENABLED(BLE_HRT)
+        hrt_enc_rr_add(&m_hrt_enc, rr_interval);
+#endif
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+        hrs_bcast_enc_rr_add(&m_bcast_enc, rr_interval);
+#endif
+}
+#else
+/**@brief Function for handling the RR interval timer time-out.
+ *
+ * @details This function will be called each time the RR interval timer expires.
+ *
+ * @param[in] xTimer Handler to the timer that called this function.
+ *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ */
+static void rr_interval_timeout_handler(TimerHandle_t xTimer)
+{
+        UNUSED_PARAMETER(xTimer);
+
+        if (m_rr_interval_enabled)
+        {
+                uint16_t rr_interval;
+
+                rr_interval = (uint16_t)sensorsim_measure(&m_rr_interval_sim_state,
+                                                          &m_rr_interval_sim_cfg);
+                ble_hrs_rr_interval_add(&m_hrs, rr_interval);
+#if NRF_MODULE_ENABLED(BLE_HRT)
+                hrt_enc_rr_add(&m_hrt_enc, rr_interval);
+#endif
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+                hrs_bcast_enc_rr_add(&m_bcast_enc, rr_interval);
+#endif
+        }
+}
+#endif // NRF_MODULE_ENABLED(PPG)
+
+
+/**@brief Function for handling the Sensor Contact Detected timer time-out.
+ *
+ * @details This function will be called each time the Sensor Contact Detected timer expires.
+ *
+ * @param[in] xTimer Handler to the timer that called this function.
+ *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ */
+static void sensor_contact_detected_timeout_handler(TimerHandle_t xTimer)
+{
+        static bool sensor_contact_detected = false;
+
+        UNUSED_PARAMETER(xTimer);
+
+#if NRF_MODULE_ENABLED(PPG)
+        sensor_contact_detected = ppg_contact_get();
+#else
+        sensor_contact_detected = !sensor_contact_detected;
+#endif
+        ble_hrs_sensor_contact_detected_update(&m_hrs, sensor_contact_detected);
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+        hrs_bcast_enc_flag_set(&m_bcast_enc, HRS_BCAST_FLAG_CONTACT, sensor_contact_detected);
+#endif
+}
+
+
+/**@brief Function for writing data received over BLE to the UART.
+ *
+ * @param[in] p_data  Received data.
+ * @param[in] length  Length of the data.
+ */
+static void uart_data_write(uint8_t const * p_data, uint16_t length)
+{
+        uint32_t err_code;
+
+        NRF_LOG_DEBUG("Received data over BLE. Writing data on UART.");
+        NRF_LOG_HEXDUMP_DEBUG(p_data, length);
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+                do
+                {
+                        err_code = app_uart_put(p_data[i]);
+                        if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_BUSY))
+                        {
+                                NRF_LOG_ERROR("Failed receiving NUS message. Error 0x%x. ", err_code);
+                                APP_ERROR_CHECK(err_code);
+                        }
+                } while (err_code == NRF_ERROR_BUSY);
+        }
+        if (p_data[length - 1] == '\r')
+        {
+                while (app_uart_put('\n') == NRF_ERROR_BUSY);
+        }
+}
+
+
+/**@brief Function for handling the data from the Nordic UART Service.
+ *
+ * @details This function will process the data received from the Nordic UART BLE Service and send
+ *          it to the UART module.
+ *
+ * @param[in] p_evt       Nordic UART Service event.
+ */
+/**@snippet [Handling the data received over BLE] */
+static void nus_data_handler(ble_nus_evt_t * p_evt)
+{
+
+        switch (p_evt->type)
+        {
+        case BLE_NUS_EVT_RX_DATA:
+                nus_mux_on_data(&m_mux, p_evt->params.rx_data.p_data, p_evt->params.rx_data.length);
+                break;
+
+        case BLE_NUS_EVT_TX_RDY:
+                nus_mux_tx_process(&m_mux);
+                break;
+
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        case BLE_NUS_EVT_COMM_STARTED:
+        {
+                // Tell the central it may compress what it sends to us.
+                uint8_t    hello[NUS_LZ_HELLO_LEN];
+                ret_code_t err_code;
+
+                nus_lz_hello_get(hello);
+                err_code = nus_mux_send(&m_mux, NUS_MUX_CH_CTRL, hello, sizeof(hello), true);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Compression announcement failed: 0x%x.", err_code);
+                }
+        } break;
+#endif
+
+        default:
+                break;
+        }
+
+}
+/**@snippet [Handling the data received over BLE] */
+
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+/**@brief Function for handling events from the L2CAP channel transport.
+ *
+ * @details The central opens the channel once it has found the Nordic UART Service. From then on
+ *          the UART data goes over the channel in both directions.
+ *
+ * @param[in] p_coc  L2CAP channel instance.
+ * @param[in] p_evt  Event.
+ */
+static void l2cap_coc_evt_handler(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_evt_t const * p_evt)
+{
+        switch (p_evt->evt_type)
+        {
+        case BLE_L2CAP_COC_EVT_CONNECTED:
+                NRF_LOG_INFO("UART data moved to the L2CAP channel.");
+                nus_mux_payload_max_set(&m_mux, p_coc->tx_mtu);
+                break;
+
+        case BLE_L2CAP_COC_EVT_DISCONNECTED:
+                nus_mux_payload_max_set(&m_mux, m_ble_nus_max_data_len);
+                break;
+
+        case BLE_L2CAP_COC_EVT_RX_DATA:
+                nus_mux_on_data(&m_mux, p_evt->p_data, p_evt->data_len);
+                break;
+
+        case BLE_L2CAP_COC_EVT_TX_RDY:
+                nus_mux_tx_process(&m_mux);
+                break;
+
+        default:
+                break;
+        }
+}
+#endif // NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+
+
+/**@brief Function for sending a multiplexer packet to the central.
+ *
+ * @details The packet goes over the L2CAP channel once it is set up, and over the Nordic UART
+ *          Service otherwise. Busy transports return NRF_ERROR_RESOURCES and the multiplexer
+ *          retries on the next TX complete event.
+ *
+ * @param[in] p_context  Unused.
+ * @param[in] p_data     Packet to send.
+ * @param[in] length     Length of the packet.
+ *
+ * @return The result of the transport used.
+ */
+static ret_code_t mux_send(void * p_context, uint8_t * p_data, uint16_t length)
+{
+        ret_code_t err_code;
+
+        UNUSED_PARAMETER(p_context);
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        if (ble_l2cap_coc_is_connected(&m_coc))
+        {
+                return ble_l2cap_coc_data_send(&m_coc, p_data, length);
+        }
+#endif
+
+        HVN_COUNT_ENTER();
+        err_code = ble_nus_data_send(&m_nus, p_data, &length, m_conn_handle);
+        HVN_COUNT_EXIT(err_code);
+
+        return err_code;
+}
+
+
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+/**@brief Function for handling events from the reliable transfer.
+ *
+ * @param[in] p_arq  Reliable transfer instance.
+ * @param[in] p_evt  Event.
+ */
+static void arq_evt_handler(nus_arq_t * p_arq, nus_arq_evt_t const * p_evt)
+{
+        UNUSED_PARAMETER(p_arq);
+
+        switch (p_evt->type)
+        {
+        case NUS_ARQ_EVT_RX_DATA:
+        {
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                uint8_t const * p_data;
+                uint16_t        len;
+
+                if ((nus_lz_decode(&m_lz, p_evt->p_data, p_evt->len, &p_data, &len) == NRF_SUCCESS) && (len > 0))
+                {
+                        uart_data_write(p_data, len);
+                }
+#else
+                uart_data_write(p_evt->p_data, p_evt->len);
+#endif
+        } break;
+
+        case NUS_ARQ_EVT_TX_RDY:
+                NRF_LOG_DEBUG("Link accepts data again.");
+                break;
+
+        default:
+                break;
+        }
 }
+#endif // NRF_MODULE_ENABLED(NUS_ARQ)
 
 
-/**@brief Function for handling the Battery measurement timer time-out.
+#if NRF_MODULE_ENABLED(NUS_LZ)
+/**@brief Function for discarding the compression history of the previous link, in the timer task.
  *
- * @details This function will be called each time the battery level measurement timer expires.
+ * @details Pended by the SoftDevice task when a link is established. The central sends data only
+ *          once it has discovered the service, long after the timer task ran this.
  *
- * @param[in] xTimer Handler to the timer that called this function.
- *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ * @param[in] p_context  Unused.
+ * @param[in] unused     Unused.
  */
-static void battery_level_meas_timeout_handler(TimerHandle_t xTimer)
+static void lz_reset_pended(void * p_context, uint32_t unused)
 {
-        UNUSED_PARAMETER(xTimer);
-        battery_level_update();
+        UNUSED_PARAMETER(p_context);
+        UNUSED_PARAMETER(unused);
+
+        nus_lz_reset(&m_lz);
 }
 
 
-/**@brief Function for handling the Heart rate measurement timer time-out.
- *
- * @details This function will be called each time the heart rate measurement timer expires.
- *          It will exclude RR Interval data from every third measurement.
+/**@brief Function for taking the compression window announced by the central, in the timer task.
  *
- * @param[in] xTimer Handler to the timer that called this function.
- *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ * @param[in] p_context    Unused.
+ * @param[in] window_log2  Window from the announcement.
  */
-static void heart_rate_meas_timeout_handler(TimerHandle_t xTimer)
+static void lz_hello_pended(void * p_context, uint32_t window_log2)
 {
-        static uint32_t cnt = 0;
-        ret_code_t err_code;
-        uint16_t heart_rate;
-
-        UNUSED_PARAMETER(xTimer);
-
-        heart_rate = (uint16_t)sensorsim_measure(&m_heart_rate_sim_state, &m_heart_rate_sim_cfg);
+        uint8_t const hello[NUS_LZ_HELLO_LEN] = {NUS_MUX_OP_LZ_HELLO, (uint8_t)window_log2};
 
-        cnt++;
-        err_code = ble_hrs_heart_rate_measurement_send(&m_hrs, heart_rate);
-        if ((err_code != NRF_SUCCESS) &&
-            (err_code != NRF_ERROR_INVALID_STATE) &&
-            (err_code != NRF_ERROR_RESOURCES) &&
-            (err_code != NRF_ERROR_BUSY) &&
-            (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
-            )
-        {
-                APP_ERROR_HANDLER(err_code);
-        }
+        UNUSED_PARAMETER(p_context);
 
-        // Disable RR Interval recording every third heart rate measurement.
-        // NOTE: An application will normally not do this. It is done here just for testing generation
-        // of messages without RR Interval measurements.
-        m_rr_interval_enabled = ((cnt % 3) != 0);
+        nus_lz_on_hello(&m_lz, hello, sizeof(hello));
 }
+#endif
 
 
-/**@brief Function for handling the RR interval timer time-out.
- *
- * @details This function will be called each time the RR interval timer expires.
+/**@brief Function for handling a message received on the control channel.
  *
- * @param[in] xTimer Handler to the timer that called this function.
- *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ * @param[in] p_data  Message, starting with its @ref nus_mux_op_t opcode.
+ * @param[in] len     Length of the message, at least 1.
  */
-static void rr_interval_timeout_handler(TimerHandle_t xTimer)
+static void ctrl_handle(uint8_t const * p_data, uint16_t len)
 {
-        UNUSED_PARAMETER(xTimer);
+        switch (p_data[0])
+        {
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        case NUS_MUX_OP_ARQ_ACK:
+                nus_arq_on_ack(&m_arq, p_data, len);
+                break;
+#endif
 
-        if (m_rr_interval_enabled)
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        case NUS_MUX_OP_LZ_HELLO:
+                // The window changes what the encoder produces, hand it to the task that encodes.
+                if (len >= NUS_LZ_HELLO_LEN)
+                {
+                        UNUSED_RETURN_VALUE(xTimerPendFunctionCall(lz_hello_pended,
+                                                                   NULL,
+                                                                   p_data[1],
+                                                                   portMAX_DELAY));
+                }
+                break;
+#endif
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        case NUS_MUX_OP_TPUT_START:
+        case NUS_MUX_OP_TPUT_STOP:
+                nus_tput_on_ctrl(&m_tput, p_data, len);
+                break;
+#endif
+
+        case NUS_MUX_OP_PING:
         {
-                uint16_t rr_interval;
+                // Latency probe of the central, echo it right away.
+                uint8_t    pong[NUS_MUX_PACKET_MAX];
+                ret_code_t err_code;
 
-                rr_interval = (uint16_t)sensorsim_measure(&m_rr_interval_sim_state,
-                                                          &m_rr_interval_sim_cfg);
-                ble_hrs_rr_interval_add(&m_hrs, rr_interval);
+                len = MIN(len, sizeof(pong));
+                memcpy(pong, p_data, len);
+                pong[0] = NUS_MUX_OP_PONG;
+
+                err_code = nus_mux_send(&m_mux, NUS_MUX_CH_CTRL, pong, len, true);
+                if (err_code != NRF_SUCCESS)
+                {
+                        NRF_LOG_DEBUG("Probe echo dropped: 0x%x.", err_code);
+                }
+        } break;
+
+        default:
+                NRF_LOG_DEBUG("Control opcode 0x%x ignored.", p_data[0]);
+                break;
         }
 }
 
 
-/**@brief Function for handling the Sensor Contact Detected timer time-out.
+/**@brief Function for sending a UART line to the central, in the timer task.
  *
- * @details This function will be called each time the Sensor Contact Detected timer expires.
+ * @param[in] p_data  Data to send.
+ * @param[in] len     Length of the data.
  *
- * @param[in] xTimer Handler to the timer that called this function.
- *                   You may get identifier given to the function xTimerCreate using pvTimerGetTimerID.
+ * @return The result of the layer the data is queued in.
  */
-static void sensor_contact_detected_timeout_handler(TimerHandle_t xTimer)
+static ret_code_t data_send(uint8_t const * p_data, uint16_t len)
 {
-        static bool sensor_contact_detected = false;
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        uint8_t    coded[NUS_LZ_ENC_MAX];
+        uint16_t   coded_len;
+        ret_code_t err_code;
 
-        UNUSED_PARAMETER(xTimer);
+        err_code = nus_lz_encode(&m_lz, p_data, len, coded, &coded_len);
+        VERIFY_SUCCESS(err_code);
 
-        sensor_contact_detected = !sensor_contact_detected;
-        ble_hrs_sensor_contact_detected_update(&m_hrs, sensor_contact_detected);
+        // The central only sees the line if it was queued, keep the histories in step.
+        err_code = nus_arq_send(&m_arq, coded, coded_len);
+        if (err_code == NRF_SUCCESS)
+        {
+                nus_lz_encode_commit(&m_lz);
+        }
+
+        return err_code;
+#elif NRF_MODULE_ENABLED(NUS_ARQ)
+        return nus_arq_send(&m_arq, p_data, len);
+#else
+        return nus_mux_send(&m_mux, NUS_MUX_CH_DATA, p_data, len, true);
+#endif
 }
 
 
-/**@brief Function for handling the data from the Nordic UART Service.
- *
- * @details This function will process the data received from the Nordic UART BLE Service and send
- *          it to the UART module.
+/**@brief Function for handling events from the multiplexer.
  *
- * @param[in] p_evt       Nordic UART Service event.
+ * @param[in] p_mux  Multiplexer instance.
+ * @param[in] p_evt  Event.
  */
-/**@snippet [Handling the data received over BLE] */
-static void nus_data_handler(ble_nus_evt_t * p_evt)
+static void mux_evt_handler(nus_mux_t * p_mux, nus_mux_evt_t const * p_evt)
 {
+        UNUSED_PARAMETER(p_mux);
 
-        if (p_evt->type == BLE_NUS_EVT_RX_DATA)
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        if ((p_evt->type == NUS_MUX_EVT_TX_RDY) && (p_evt->ch == NUS_MUX_CH_DATA))
+        {
+                nus_arq_on_tx_rdy(&m_arq);
+        }
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        if ((p_evt->type == NUS_MUX_EVT_TX_RDY) && (p_evt->ch == NUS_MUX_CH_TEST))
         {
-                uint32_t err_code;
+                nus_tput_on_tx_rdy(&m_tput);
+        }
+#endif
 
-                NRF_LOG_DEBUG("Received data from BLE NUS. Writing data on UART.");
-                NRF_LOG_HEXDUMP_DEBUG(p_evt->params.rx_data.p_data, p_evt->params.rx_data.length);
+        if (p_evt->type != NUS_MUX_EVT_RX_DATA)
+        {
+                return;
+        }
 
-                for (uint32_t i = 0; i < p_evt->params.rx_data.length; i++)
+        switch (p_evt->ch)
+        {
+        case NUS_MUX_CH_DATA:
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                nus_arq_on_data(&m_arq, p_evt->p_data, p_evt->len, p_evt->eom);
+#else
+                if (p_evt->len > 0)
                 {
-                        do
-                        {
-                                err_code = app_uart_put(p_evt->params.rx_data.p_data[i]);
-                                if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_BUSY))
-                                {
-                                        NRF_LOG_ERROR("Failed receiving NUS message. Error 0x%x. ", err_code);
-                                        APP_ERROR_CHECK(err_code);
-                                }
-                        } while (err_code == NRF_ERROR_BUSY);
+                        uart_data_write(p_evt->p_data, p_evt->len);
                 }
-                if (p_evt->params.rx_data.p_data[p_evt->params.rx_data.length - 1] == '\r')
+#endif
+                break;
+
+        case NUS_MUX_CH_CTRL:
+                if (p_evt->len > 0)
                 {
-                        while (app_uart_put('\n') == NRF_ERROR_BUSY);
+                        ctrl_handle(p_evt->p_data, p_evt->len);
                 }
-        }
+                break;
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        case NUS_MUX_CH_TEST:
+                nus_tput_on_data(&m_tput, p_evt->p_data, p_evt->len);
+                break;
+#endif
 
+        default:
+                NRF_LOG_DEBUG("%d bytes on channel %d ignored.", p_evt->len, p_evt->ch);
+                break;
+        }
 }
-/**@snippet [Handling the data received over BLE] */
 
 
 /**@brief Function for the Timer initialization.
@@ -403,11 +1336,13 @@ static void timers_init(void)
                                           pdTRUE,
                                           NULL,
                                           heart_rate_meas_timeout_handler);
+#if !NRF_MODULE_ENABLED(PPG)
         m_rr_interval_timer = xTimerCreate("RRT",
                                            RR_INTERVAL_INTERVAL,
                                            pdTRUE,
                                            NULL,
                                            rr_interval_timeout_handler);
+#endif
         m_sensor_contact_timer = xTimerCreate("SCT",
                                               SENSOR_CONTACT_DETECTED_INTERVAL,
                                               pdTRUE,
@@ -417,11 +1352,16 @@ static void timers_init(void)
         /* Error checking */
         if ( (NULL == m_battery_timer)
              || (NULL == m_heart_rate_timer)
-             || (NULL == m_rr_interval_timer)
              || (NULL == m_sensor_contact_timer) )
         {
                 APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
         }
+#if !NRF_MODULE_ENABLED(PPG)
+        if (NULL == m_rr_interval_timer)
+        {
+                APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+        }
+#endif
 }
 
 
@@ -458,10 +1398,34 @@ static void gap_params_init(void)
 }
 
 
+/**@brief Function for handling events from the GATT module.
+ *
+ * @param[in] p_gatt  GATT module instance.
+ * @param[in] p_evt   Event.
+ */
+static void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t const * p_evt)
+{
+        UNUSED_PARAMETER(p_gatt);
+
+        if (p_evt->evt_id == NRF_BLE_GATT_EVT_ATT_MTU_UPDATED)
+        {
+                m_ble_nus_max_data_len = p_evt->params.att_mtu_effective - OPCODE_LENGTH - HANDLE_LENGTH;
+                NRF_LOG_INFO("ATT MTU changed to %d.", p_evt->params.att_mtu_effective);
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+                if (!ble_l2cap_coc_is_connected(&m_coc))
+#endif
+                {
+                        nus_mux_payload_max_set(&m_mux, m_ble_nus_max_data_len);
+                }
+        }
+}
+
+
 /**@brief Function for initializing the GATT module. */
 static void gatt_init(void)
 {
-        ret_code_t err_code = nrf_ble_gatt_init(&m_gatt, NULL);
+        ret_code_t err_code = nrf_ble_gatt_init(&m_gatt, gatt_evt_handler);
         APP_ERROR_CHECK(err_code);
 }
 
@@ -492,6 +1456,19 @@ static void services_init(void)
         ble_nus_init_t nus_init;
         nrf_ble_qwr_init_t qwr_init = {0};
         uint8_t body_sensor_location;
+        nus_mux_init_t mux_init;
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        nus_arq_init_t arq_init;
+#endif
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        ble_l2cap_coc_init_t coc_init;
+#endif
+#if NRF_MODULE_ENABLED(BLE_HRT)
+        ble_hrt_init_t hrt_init;
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        nus_tput_init_t tput_init;
+#endif
 
         // Initialize Queued Write Module.
         qwr_init.error_handler = nrf_qwr_error_handler;
@@ -541,6 +1518,22 @@ static void services_init(void)
         err_code = ble_dis_init(&dis_init);
         APP_ERROR_CHECK(err_code);
 
+#if NRF_MODULE_ENABLED(BLE_HRT)
+#if NRF_MODULE_ENABLED(HRT_LOG)
+        // The backlog registers with FDS, which the Peer Manager initializes.
+        err_code = hrt_log_init();
+        APP_ERROR_CHECK(err_code);
+#endif
+
+        // Initialize Heart Rate Telemetry Service.
+        hrt_init.evt_handler = hrt_evt_handler;
+
+        err_code = ble_hrt_init(&m_hrt, &hrt_init);
+        APP_ERROR_CHECK(err_code);
+
+        hrt_enc_init(&m_hrt_enc, hrt_block_handler, NULL, HEART_RATE_MEAS_INTERVAL, BLE_HRT_BLOCK_PERIOD_MS);
+#endif
+
         // Initialize NUS.
         memset(&nus_init, 0, sizeof(nus_init));
 
@@ -548,6 +1541,45 @@ static void services_init(void)
 
         err_code = ble_nus_init(&m_nus, &nus_init);
         APP_ERROR_CHECK(err_code);
+
+        // Initialize the multiplexer carrying the UART data.
+        memset(&mux_init, 0, sizeof(mux_init));
+
+        mux_init.send        = mux_send;
+        mux_init.evt_handler = mux_evt_handler;
+
+        err_code = nus_mux_init(&m_mux, &mux_init);
+        APP_ERROR_CHECK(err_code);
+
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+        // Initialize the reliable transfer on top of the multiplexer.
+        arq_init.p_mux       = &m_mux;
+        arq_init.evt_handler = arq_evt_handler;
+
+        err_code = nus_arq_init(&m_arq, &arq_init);
+        APP_ERROR_CHECK(err_code);
+#endif
+
+#if NRF_MODULE_ENABLED(NUS_LZ)
+        nus_lz_init(&m_lz);
+#endif
+
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+        // Initialize the throughput test on top of the multiplexer.
+        tput_init.p_mux       = &m_mux;
+        tput_init.evt_handler = NULL;
+
+        err_code = nus_tput_init(&m_tput, &tput_init);
+        APP_ERROR_CHECK(err_code);
+#endif
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        // Initialize the L2CAP channel transport, the central opens the channel.
+        coc_init.evt_handler = l2cap_coc_evt_handler;
+
+        err_code = ble_l2cap_coc_init(&m_coc, &coc_init);
+        APP_ERROR_CHECK(err_code);
+#endif
 }
 
 
@@ -561,6 +1593,7 @@ static void sensor_simulator_init(void)
 
         sensorsim_init(&m_battery_sim_state, &m_battery_sim_cfg);
 
+#if !NRF_MODULE_ENABLED(PPG)
         m_heart_rate_sim_cfg.min          = MIN_HEART_RATE;
         m_heart_rate_sim_cfg.max          = MAX_HEART_RATE;
         m_heart_rate_sim_cfg.incr         = HEART_RATE_INCREMENT;
@@ -574,7 +1607,44 @@ static void sensor_simulator_init(void)
         m_rr_interval_sim_cfg.start_at_max = false;
 
         sensorsim_init(&m_rr_interval_sim_state, &m_rr_interval_sim_cfg);
+#endif
+}
+
+
+#if NRF_MODULE_ENABLED(PPG)
+/**@brief Function for initializing the PPG heart rate sensor. */
+static void ppg_sensor_init(void)
+{
+        ret_code_t err_code;
+        ppg_init_t ppg_init_params;
+
+        ppg_init_params.buffer_handler = ppg_buffer_handler;
+        ppg_init_params.beat_handler   = ppg_beat_handler;
+        ppg_init_params.p_context      = NULL;
+
+        err_code = ppg_init(&ppg_init_params);
+        APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+/**@brief Function for enabling the radio notifications before and after every radio event, and
+ *        starting the RTC timing the measurements.
+ */
+static void radio_notification_init(void)
+{
+        ret_code_t err_code;
+
+        nrf_rtc_prescaler_set(HRM_SYNC_RTC, 0);
+        nrf_rtc_task_trigger(HRM_SYNC_RTC, NRF_RTC_TASK_START);
+
+        err_code = ble_radio_notification_init(APP_IRQ_PRIORITY_LOW,
+                                               HRM_SYNC_DISTANCE,
+                                               radio_notification_evt_handler);
+        APP_ERROR_CHECK(err_code);
 }
+#endif
 
 
 /**@brief   Function for starting application timers.
@@ -591,10 +1661,15 @@ static void application_timers_start(void)
         {
                 APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
         }
+#if NRF_MODULE_ENABLED(PPG)
+        // The buffers are processed in the timer task.
+        ppg_start();
+#else
         if (pdPASS != xTimerStart(m_rr_interval_timer, OSTIMER_WAIT_FOR_QUEUE))
         {
                 APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
         }
+#endif
         if (pdPASS != xTimerStart(m_sensor_contact_timer, OSTIMER_WAIT_FOR_QUEUE))
         {
                 APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
@@ -723,11 +1798,51 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
                 m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
                 err_code = nrf_ble_qwr_conn_handle_assign(&m_qwr, m_conn_handle);
                 APP_ERROR_CHECK(err_code);
+                nus_mux_reset(&m_mux);
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                nus_arq_reset(&m_arq);
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                UNUSED_RETURN_VALUE(xTimerPendFunctionCall(lz_reset_pended, NULL, 0, portMAX_DELAY));
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+                nus_tput_reset(&m_tput);
+#endif
                 break;
 
         case BLE_GAP_EVT_DISCONNECTED:
                 NRF_LOG_INFO("Disconnected");
                 m_conn_handle = BLE_CONN_HANDLE_INVALID;
+                m_ble_nus_max_data_len = BLE_GATT_ATT_MTU_DEFAULT - OPCODE_LENGTH - HANDLE_LENGTH;
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+                // The notifications left in the queue are dropped unreported.
+                CRITICAL_REGION_ENTER();
+                m_hrm_due    = false;
+                m_hrm_queued = false;
+                m_hvn_queued = 0;
+                m_hvn_done   = 0;
+                CRITICAL_REGION_EXIT();
+#endif
+#if NRF_MODULE_ENABLED(HRT_LOG)
+                hrt_log_stats_log();
+#endif
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+                nus_arq_stats_log(&m_arq);
+                nus_arq_reset(&m_arq);
+#endif
+#if NRF_MODULE_ENABLED(NUS_LZ)
+                nus_lz_stats_log(&m_lz);
+#endif
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+                nus_tput_reset(&m_tput);
+#endif
+                lesc_prof_stats_log();
+                break;
+
+        case BLE_GAP_EVT_LESC_DHKEY_REQUEST:
+                // The Peer Manager has marked the request, the key is computed by lesc_thread.
+                lesc_prof_dhkey_request();
+                xTaskNotifyGive(m_lesc_thread);
                 break;
 
         case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
@@ -750,6 +1865,12 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
                 APP_ERROR_CHECK(err_code);
                 break;
 
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+                hrm_hvn_tx_complete(p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+                break;
+#endif
+
         case BLE_GATTS_EVT_TIMEOUT:
                 // Disconnect on GATT Server timeout event.
                 NRF_LOG_DEBUG("GATT Server Timeout.");
@@ -782,10 +1903,25 @@ static void ble_stack_init(void)
         err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
         APP_ERROR_CHECK(err_code);
 
+        ble_ram_cfg_init(ram_start);
+
+        err_code = ble_ram_cfg_conn_queues_set(APP_BLE_CONN_CFG_TAG, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+        err_code = ble_l2cap_coc_cfg_set(APP_BLE_CONN_CFG_TAG, ram_start);
+        APP_ERROR_CHECK(err_code);
+
+        ble_ram_cfg_probe("L2CAP CoC", ram_start);
+#endif
+
         // Enable BLE stack.
+        uint32_t const ram_start_link = ram_start;
         err_code = nrf_sdh_ble_enable(&ram_start);
         APP_ERROR_CHECK(err_code);
 
+        ble_ram_cfg_log(ram_start_link, ram_start);
+
         // Register a handler for BLE events.
         NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
 }
@@ -837,8 +1973,11 @@ static void peer_manager_init(void)
         ble_gap_sec_params_t sec_param;
         ret_code_t err_code;
 
+        // Generates the LESC key pair, used for all pairings.
+        LESC_PROF_KEYGEN_BEGIN();
         err_code = pm_init();
         APP_ERROR_CHECK(err_code);
+        LESC_PROF_KEYGEN_END();
 
         memset(&sec_param, 0, sizeof(ble_gap_sec_params_t));
 
@@ -876,45 +2015,77 @@ static void delete_bonds(void)
 }
 
 
+/**@brief Function for sending a line received over UART, in the timer task.
+ *
+ * @details The compression and the reliable transfer are shared with the SoftDevice task, so
+ *          they are not used from the UART interrupt.
+ *
+ * @param[in] p_line  Line, one of @ref m_uart_lines.
+ * @param[in] len     Length of the line.
+ */
+static void uart_line_process(void * p_line, uint32_t len)
+{
+        ret_code_t err_code;
+
+        NRF_LOG_DEBUG("Ready to send data over BLE NUS");
+        NRF_LOG_HEXDUMP_DEBUG(p_line, len);
+
+        err_code = data_send(p_line, (uint16_t)len);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_DEBUG("Data dropped: 0x%x.", err_code);
+        }
+
+        m_uart_line_busy[(p_line == m_uart_lines[0]) ? 0 : 1] = false;
+}
+
+
 /**@brief   Function for handling app_uart events.
  *
  * @details This function will receive a single character from the app_uart module and append it to
  *          a string. The string will be be sent over BLE when the last character received was a
  *          'new line' '\n' (hex 0x0A) or if the string has reached the maximum data length.
+ *          A full line is pended to the timer task, and the next one is received in the other
+ *          buffer. A line is dropped if that buffer has not been sent yet.
  */
 /**@snippet [Handling the data received over UART] */
 void uart_event_handle(app_uart_evt_t * p_event)
 {
-        static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
+        static uint8_t line  = 0;
         static uint8_t index = 0;
-        uint32_t err_code;
+        uint8_t      * p_line    = m_uart_lines[line];
+        BaseType_t     yield_req = pdFALSE;
 
         switch (p_event->evt_type)
         {
         case APP_UART_DATA_READY:
-                UNUSED_VARIABLE(app_uart_get(&data_array[index]));
+                UNUSED_VARIABLE(app_uart_get(&p_line[index]));
                 index++;
 
-                if ((data_array[index - 1] == '\n') ||
-                    (data_array[index - 1] == '\r') ||
-                    (index >= m_ble_nus_max_data_len))
+                if ((p_line[index - 1] == '\n') ||
+                    (p_line[index - 1] == '\r') ||
+                    (index >= BLE_NUS_MAX_DATA_LEN))
                 {
                         if (index > 1)
                         {
-                                NRF_LOG_DEBUG("Ready to send data over BLE NUS");
-                                NRF_LOG_HEXDUMP_DEBUG(data_array, index);
-
-                                do
+                                if (m_uart_line_busy[line ^ 1])
+                                {
+                                        NRF_LOG_WARNING("UART line dropped.");
+                                }
+                                else if (pdPASS == xTimerPendFunctionCallFromISR(uart_line_process,
+                                                                                p_line,
+                                                                                index,
+                                                                                &yield_req))
+                                {
+                                        m_uart_line_busy[line] = true;
+                                        line ^= 1;
+                                        portYIELD_FROM_ISR(yield_req);
+                                }
+                                else
                                 {
-                                        uint16_t length = (uint16_t)index;
-                                        err_code = ble_nus_data_send(&m_nus, data_array, &length, m_conn_handle);
-                                        if ((err_code != NRF_ERROR_INVALID_STATE) &&
-                                            (err_code != NRF_ERROR_RESOURCES) &&
-                                            (err_code != NRF_ERROR_NOT_FOUND))
-                                        {
-                                                APP_ERROR_CHECK(err_code);
-                                        }
-                                } while (err_code == NRF_ERROR_RESOURCES);
+                                        // The timer queue is full, the line is dropped.
+                                        NRF_LOG_WARNING("UART line dropped.");
+                                }
                         }
 
                         index = 0;
@@ -1038,8 +2209,12 @@ static void advertising_start(void * p_erase_bonds)
         }
         else
         {
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+                // The broadcast starts with the first heart rate measurement.
+#else
                 ret_code_t err_code = ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST);
                 APP_ERROR_CHECK(err_code);
+#endif
         }
 }
 
@@ -1066,6 +2241,29 @@ static void logger_thread(void * arg)
 }
 #endif //NRF_LOG_ENABLED
 
+/**@brief Thread for computing the LESC DHKeys.
+ *
+ * @details A key takes milliseconds. The SoftDevice task only marks the request and wakes this
+ *          thread, so it goes on handling BLE events while the key is computed at a lower priority.
+ *
+ * @param[in]   arg   Unused.
+ */
+static void lesc_thread(void * arg)
+{
+        UNUSED_PARAMETER(arg);
+
+        while (1)
+        {
+                ret_code_t err_code;
+
+                (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+                err_code = lesc_prof_request_handler();
+                APP_ERROR_CHECK(err_code);
+        }
+}
+
+
 /**@brief A function which is hooked to idle task.
  * @note Idle hook must be enabled in FreeRTOS configuration (configUSE_IDLE_HOOK).
  */
@@ -1110,6 +2308,11 @@ int main(void)
         }
 #endif
 
+        if (pdPASS != xTaskCreate(lesc_thread, "LESC", LESC_TASK_STACK_SIZE, NULL, LESC_TASK_PRIORITY, &m_lesc_thread))
+        {
+                APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+        }
+
         // Activate deep sleep mode.
         SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
 
@@ -1124,7 +2327,17 @@ int main(void)
         advertising_init();
         services_init();
         sensor_simulator_init();
+#if NRF_MODULE_ENABLED(HRS_BCAST)
+        hrs_bcast_enc_init(&m_bcast_enc);
+#endif
+#if NRF_MODULE_ENABLED(PPG)
+        ppg_sensor_init();
+#endif
+#if NRF_MODULE_ENABLED(HRM_SYNC)
+        radio_notification_init();
+#endif
         conn_params_init();
+        lesc_prof_init();
         peer_manager_init();
         application_timers_start();
 
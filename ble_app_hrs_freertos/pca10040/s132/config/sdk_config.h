@@ -46,6 +46,315 @@
 #ifdef USE_APP_CONFIG
 #include "app_config.h"
 #endif
+// <h> Application
+
+// <e> BLE_RAM_CFG_ENABLED - ble_ram_cfg - SoftDevice queues and the RAM of each BLE setting
+// <i> Sizes the per-link TX queues and logs at startup the SoftDevice RAM every BLE setting takes.
+// <i> When disabled, the queues keep the SoftDevice default of one entry.
+//==========================================================
+#ifndef BLE_RAM_CFG_ENABLED
+#define BLE_RAM_CFG_ENABLED 1
+#endif
+// <o> APP_HVN_TX_QUEUE_SIZE - Handle Value Notification TX queue size per link.
+// <i> Number of notifications that can be queued in the SoftDevice for one connection
+// <i> before sd_ble_gatts_hvx() returns NRF_ERROR_RESOURCES. The SoftDevice default is 1.
+// <i> The RAM needed by the SoftDevice grows with every entry, check the RAM start logged at
+// <i> startup and move RAM_START in the linker settings accordingly.
+#ifndef APP_HVN_TX_QUEUE_SIZE
+#define APP_HVN_TX_QUEUE_SIZE 4
+#endif
+
+// <o> APP_WRITE_CMD_TX_QUEUE_SIZE - Write Command TX queue size per link.
+// <i> Number of Write Commands that can be queued in the SoftDevice for one connection
+// <i> before sd_ble_gattc_write() returns NRF_ERROR_RESOURCES. The SoftDevice default is 1.
+// <i> The RAM needed by the SoftDevice grows with every entry, check the RAM start logged at
+// <i> startup and move RAM_START in the linker settings accordingly.
+#ifndef APP_WRITE_CMD_TX_QUEUE_SIZE
+#define APP_WRITE_CMD_TX_QUEUE_SIZE 1
+#endif
+
+// </e>
+//==========================================================
+
+// <e> BLE_L2CAP_COC_ENABLED - ble_l2cap_coc - L2CAP connection-oriented channel transport
+// <i> Carries the UART data over an LE credit-based L2CAP channel instead of the Nordic UART
+// <i> Service when both sides enable it. Must be set the same on the central and the peripheral.
+//==========================================================
+#ifndef BLE_L2CAP_COC_ENABLED
+#define BLE_L2CAP_COC_ENABLED 0
+#endif
+// <o> BLE_L2CAP_COC_PSM - LE Protocol/Service Multiplexer of the channel. <0x80-0xFF>
+#ifndef BLE_L2CAP_COC_PSM
+#define BLE_L2CAP_COC_PSM 0x80
+#endif
+
+// <o> BLE_L2CAP_COC_MTU - Largest SDU in bytes. <23-65535>
+// <i> Every link holds one receive and BLE_L2CAP_COC_TX_QUEUE_SIZE transmit buffers of this size.
+#ifndef BLE_L2CAP_COC_MTU
+#define BLE_L2CAP_COC_MTU 512
+#endif
+
+// <o> BLE_L2CAP_COC_MPS - Largest PDU payload in bytes. <23-65535>
+// <i> Best set so that one PDU fills one Link Layer packet, that is NRF_SDH_BLE_GAP_DATA_LENGTH - 4.
+#ifndef BLE_L2CAP_COC_MPS
+#define BLE_L2CAP_COC_MPS 247
+#endif
+
+// <o> BLE_L2CAP_COC_TX_QUEUE_SIZE - Number of SDUs that can be queued for transmission per link.
+#ifndef BLE_L2CAP_COC_TX_QUEUE_SIZE
+#define BLE_L2CAP_COC_TX_QUEUE_SIZE 2
+#endif
+
+// <o> BLE_L2CAP_COC_BLE_OBSERVER_PRIO
+// <i> Priority with which BLE events are dispatched to the L2CAP channel transport.
+#ifndef BLE_L2CAP_COC_BLE_OBSERVER_PRIO
+#define BLE_L2CAP_COC_BLE_OBSERVER_PRIO 2
+#endif
+
+// </e>
+
+// <e> NUS_MUX_ENABLED - nus_mux - NUS stream multiplexer
+// <i> Frames the UART data into prioritized logical channels. Must be set the same on the central
+// <i> and the peripheral.
+//==========================================================
+#ifndef NUS_MUX_ENABLED
+#define NUS_MUX_ENABLED 1
+#endif
+// <o> NUS_MUX_TX_BUF_SIZE - Transmit queue size per channel in bytes.
+// <i> Every link holds one queue per channel. Bounds the largest message queued in one call.
+#ifndef NUS_MUX_TX_BUF_SIZE
+#define NUS_MUX_TX_BUF_SIZE 256
+#endif
+
+// <o> NUS_MUX_PACKET_MAX - Largest packet handed to NUS or the L2CAP channel in bytes.
+#ifndef NUS_MUX_PACKET_MAX
+#define NUS_MUX_PACKET_MAX 244
+#endif
+
+// </e>
+
+// <e> NUS_ARQ_ENABLED - nus_arq - Reliable transfer over the NUS multiplexer
+// <i> Numbers the frames on the data channel and retransmits the lost ones. Must be set the same
+// <i> on the central and the peripheral.
+//==========================================================
+#ifndef NUS_ARQ_ENABLED
+#define NUS_ARQ_ENABLED 1
+#endif
+// <o> NUS_ARQ_WINDOW - Frames in flight per link. <2-32>
+// <i> Every link holds two windows of frames, one to send and one to reorder.
+#ifndef NUS_ARQ_WINDOW
+#define NUS_ARQ_WINDOW 8
+#endif
+
+// <o> NUS_ARQ_PAYLOAD_MAX - Largest payload of one frame in bytes.
+// <i> The multiplexer splits frames into packets. A frame must fit NUS_MUX_TX_BUF_SIZE.
+#ifndef NUS_ARQ_PAYLOAD_MAX
+#define NUS_ARQ_PAYLOAD_MAX 240
+#endif
+
+// <o> NUS_ARQ_RTO_MS - Retransmission timeout in milliseconds.
+// <i> Should cover a few connection intervals of the slowest link.
+#ifndef NUS_ARQ_RTO_MS
+#define NUS_ARQ_RTO_MS 200
+#endif
+
+// <o> NUS_ARQ_ACK_DELAY_MS - Longest delay of an acknowledgement in milliseconds.
+#ifndef NUS_ARQ_ACK_DELAY_MS
+#define NUS_ARQ_ACK_DELAY_MS 10
+#endif
+
+// <o> NUS_ARQ_LOSS_PERMILLE - Received frames dropped on purpose, per thousand. <0-999>
+// <i> Test aid for the retransmission. Keep at 0 in production.
+#ifndef NUS_ARQ_LOSS_PERMILLE
+#define NUS_ARQ_LOSS_PERMILLE 0
+#endif
+
+// </e>
+
+// <e> NUS_LZ_ENABLED - nus_lz - NUS stream compression
+// <i> Compresses the UART data sent over the reliable transfer, once the peer has announced that
+// <i> it can decompress. Needs NUS_ARQ_ENABLED. Must be set the same on the central and the peripheral.
+//==========================================================
+#ifndef NUS_LZ_ENABLED
+#define NUS_LZ_ENABLED 1
+#endif
+// <o> NUS_LZ_WINDOW - History window in bytes, a power of two.
+// <256=> 256
+// <512=> 512
+// <1024=> 1024
+// <2048=> 2048
+// <4096=> 4096
+// <i> Every link holds two windows, one to compress and one to decompress.
+#ifndef NUS_LZ_WINDOW
+#define NUS_LZ_WINDOW 1024
+#endif
+
+// <o> NUS_LZ_HASH_BITS - log2 of the match table size. <6-12>
+// <i> Every link holds 2 << NUS_LZ_HASH_BITS bytes of table.
+#ifndef NUS_LZ_HASH_BITS
+#define NUS_LZ_HASH_BITS 8
+#endif
+
+// <o> NUS_LZ_MSG_MAX - Largest message in bytes before compression.
+// <i> Must hold one UART line, BLE_NUS_MAX_DATA_LEN bytes.
+#ifndef NUS_LZ_MSG_MAX
+#define NUS_LZ_MSG_MAX 256
+#endif
+
+// </e>
+
+// <q> NUS_TPUT_ENABLED  - nus_tput - NUS throughput test
+// <i> Adds the test channel to the multiplexer. Must be set the same on the central and the
+// <i> peripheral. The central runs the test with the #tput UART command.
+#ifndef NUS_TPUT_ENABLED
+#define NUS_TPUT_ENABLED 1
+#endif
+
+// <e> BLE_HRT_ENABLED - ble_hrt - Heart Rate Telemetry Service
+// <i> Sends the heart rate and RR interval series as compact delta coded blocks, next to the
+// <i> Heart Rate Service. The service uses a vendor specific UUID, count it in
+// <i> NRF_SDH_BLE_VS_UUID_COUNT.
+//==========================================================
+#ifndef BLE_HRT_ENABLED
+#define BLE_HRT_ENABLED 1
+#endif
+// <o> BLE_HRT_BLOCK_PERIOD_MS - Longest time covered by one block in milliseconds.
+// <i> A block is sent when it fills one notification or when it gets this old.
+#ifndef BLE_HRT_BLOCK_PERIOD_MS
+#define BLE_HRT_BLOCK_PERIOD_MS 30000
+#endif
+
+// <o> BLE_HRT_BLE_OBSERVER_PRIO
+// <i> Priority with which BLE events are dispatched to the Heart Rate Telemetry Service.
+#ifndef BLE_HRT_BLE_OBSERVER_PRIO
+#define BLE_HRT_BLE_OBSERVER_PRIO 2
+#endif
+
+// </e>
+
+// <e> HRT_LOG_ENABLED - hrt_log - Flash backlog of heart rate telemetry blocks
+// <i> Keeps the blocks that could not be sent in FDS records and uploads them once the central
+// <i> enables the telemetry again. Every record takes a block and an 8 byte header in flash,
+// <i> size FDS_VIRTUAL_PAGES for HRT_LOG_RECORDS_MAX records next to the peer data.
+//==========================================================
+#ifndef HRT_LOG_ENABLED
+#define HRT_LOG_ENABLED 1
+#endif
+// <o> HRT_LOG_FILE_ID - FDS file ID of the backlog records. <0x0000-0xBFFF>
+#ifndef HRT_LOG_FILE_ID
+#define HRT_LOG_FILE_ID 0x4854
+#endif
+
+// <o> HRT_LOG_RECORD_KEY - FDS record key of the backlog records. <0x0001-0xBFFF>
+#ifndef HRT_LOG_RECORD_KEY
+#define HRT_LOG_RECORD_KEY 0x0001
+#endif
+
+// <o> HRT_LOG_RECORDS_MAX - Number of blocks kept, the oldest is overwritten beyond it.
+#ifndef HRT_LOG_RECORDS_MAX
+#define HRT_LOG_RECORDS_MAX 96
+#endif
+
+// <o> HRT_LOG_WRITE_QUEUE_SIZE - Number of blocks that can be waiting for their flash write.
+// <i> Keep it below FDS_OP_QUEUE_SIZE so that deletions and the Peer Manager find room.
+#ifndef HRT_LOG_WRITE_QUEUE_SIZE
+#define HRT_LOG_WRITE_QUEUE_SIZE 4
+#endif
+
+// </e>
+
+// <e> PPG_ENABLED - ppg - PPG heart rate sensor on the SAADC
+// <i> Derives the heart rate and the RR intervals from a photoplethysmogram in place of the
+// <i> sensor simulator. Needs SAADC_ENABLED, PPI_ENABLED and the TIMER instance below.
+//==========================================================
+#ifndef PPG_ENABLED
+#define PPG_ENABLED 1
+#endif
+// <o> PPG_SAADC_INPUT  - Analog input of the sensor output
+// <1=> AIN0
+// <2=> AIN1
+// <3=> AIN2
+// <4=> AIN3
+// <5=> AIN4
+// <6=> AIN5
+// <7=> AIN6
+// <8=> AIN7
+#ifndef PPG_SAADC_INPUT
+#define PPG_SAADC_INPUT 1
+#endif
+
+// <o> PPG_TIMER_INSTANCE  - TIMER instance pacing the samples <1-4>
+// <i> TIMER0 belongs to the SoftDevice. The instance must be enabled.
+#ifndef PPG_TIMER_INSTANCE
+#define PPG_TIMER_INSTANCE 1
+#endif
+
+// <o> PPG_BUFFER_SIZE - Samples per DMA buffer.
+// <i> At 100 Hz, the DSP runs every PPG_BUFFER_SIZE * 10 ms and must be done within as long.
+#ifndef PPG_BUFFER_SIZE
+#define PPG_BUFFER_SIZE 50
+#endif
+
+// <q> PPG_INVERT  - The pulse shows as a dip of the sensor output
+// <i> Set for a photodiode whose output falls as the blood volume rises.
+#ifndef PPG_INVERT
+#define PPG_INVERT 1
+#endif
+
+// </e>
+
+// <e> HRM_SYNC_ENABLED - Heart rate measurements timed by the radio notifications
+// <i> Logs the time from queueing each measurement to the HVN TX_COMPLETE event reporting it sent, timed by RTC2.
+//==========================================================
+#ifndef HRM_SYNC_ENABLED
+#define HRM_SYNC_ENABLED 1
+#endif
+// <q> HRM_SYNC_ALIGN  - Take the measurements right before the connection events
+// <i> With 0 they stay on the free-running timer, for comparison of the latency.
+
+#ifndef HRM_SYNC_ALIGN
+#define HRM_SYNC_ALIGN 1
+#endif
+
+// <o> HRM_SYNC_DISTANCE  - Notification distance before the radio event
+// <i> Must leave the timer task time to take the measurement and queue it.
+// <1=> 800 us
+// <2=> 1740 us
+// <3=> 2680 us
+// <4=> 3620 us
+// <5=> 4560 us
+// <6=> 5500 us
+
+#ifndef HRM_SYNC_DISTANCE
+#define HRM_SYNC_DISTANCE 2
+#endif
+
+// </e>
+
+// <e> HRS_BCAST_ENABLED - hrs_bcast - Broadcast the measurements instead of accepting connections
+// <i> Every heart rate measurement updates the manufacturer specific data of non-connectable
+// <i> advertisements, with the RR intervals, battery level and a sequence number.
+//==========================================================
+#ifndef HRS_BCAST_ENABLED
+#define HRS_BCAST_ENABLED 0
+#endif
+// <o> HRS_BCAST_ADV_INTERVAL_MS - Advertising interval.
+// <i> Collectors see every measurement several times at the default HEART_RATE_MEAS_INTERVAL.
+#ifndef HRS_BCAST_ADV_INTERVAL_MS
+#define HRS_BCAST_ADV_INTERVAL_MS 250
+#endif
+
+// </e>
+
+// <q> LESC_PROF_ENABLED  - lesc_prof - Measure the LE Secure Connections key computations
+// <i> Logs the cost of the DHKey computations and how long the requests wait for them.
+#ifndef LESC_PROF_ENABLED
+#define LESC_PROF_ENABLED 1
+#endif
+
+// </h>
+//==========================================================
+
 // <h> Board Support
 
 //==========================================================
@@ -111,6 +420,13 @@
 #define NRF_BLE_GATT_ENABLED 1
 #endif
 
+// <q> NRF_BLE_LESC_ENABLED  - nrf_ble_lesc - Le Secure Connection
+
+
+#ifndef NRF_BLE_LESC_ENABLED
+#define NRF_BLE_LESC_ENABLED 1
+#endif
+
 // <e> NRF_BLE_QWR_ENABLED - nrf_ble_qwr - Queued writes support module (prepare/execute write)
 //==========================================================
 #ifndef NRF_BLE_QWR_ENABLED
@@ -174,7 +490,7 @@
 // <i> If set to true, you need to call nrf_ble_lesc_request_handler() in the main loop to respond to LESC-related BLE events. If LESC support is not required, set this to false to save code space.
 
 #ifndef PM_LESC_ENABLED
-#define PM_LESC_ENABLED 0
+#define PM_LESC_ENABLED 1
 #endif
 
 // <e> PM_RA_PROTECTION_ENABLED - Enable/disable protection against repeated pairing attempts in Peer Manager.
@@ -1111,7 +1427,7 @@
 // <i> The nRF HW backend provide access to RNG peripheral in nRF5x devices.
 //==========================================================
 #ifndef NRF_CRYPTO_BACKEND_NRF_HW_RNG_ENABLED
-#define NRF_CRYPTO_BACKEND_NRF_HW_RNG_ENABLED 0
+#define NRF_CRYPTO_BACKEND_NRF_HW_RNG_ENABLED 1
 #endif
 // <q> NRF_CRYPTO_BACKEND_NRF_HW_RNG_MBEDTLS_CTR_DRBG_ENABLED  - Enable mbed TLS CTR-DRBG algorithm.
 
@@ -1147,7 +1463,7 @@
 // <i> The Oberon backend
 //==========================================================
 #ifndef NRF_CRYPTO_BACKEND_OBERON_ENABLED
-#define NRF_CRYPTO_BACKEND_OBERON_ENABLED 0
+#define NRF_CRYPTO_BACKEND_OBERON_ENABLED 1
 #endif
 // <q> NRF_CRYPTO_BACKEND_OBERON_CHACHA_POLY_ENABLED  - Enable the CHACHA-POLY mode using Oberon.
 
@@ -1232,6 +1548,30 @@
 
 // </e>
 
+// <h> nrf_crypto_rng - RNG Configuration
+
+//==========================================================
+// <q> NRF_CRYPTO_RNG_STATIC_MEMORY_BUFFERS_ENABLED  - Use static memory buffers for context and temporary init buffer.
+
+
+// <i> Always recommended when using the nRF HW RNG as the context and temporary buffers are small. Consider disabling if using the CC310 RNG in a RAM constrained application. In this case, memory must be provided to nrf_crypto_rng_init, or it can be allocated internally provided that NRF_CRYPTO_ALLOCATOR does not allocate memory on the stack.
+
+#ifndef NRF_CRYPTO_RNG_STATIC_MEMORY_BUFFERS_ENABLED
+#define NRF_CRYPTO_RNG_STATIC_MEMORY_BUFFERS_ENABLED 1
+#endif
+
+// <q> NRF_CRYPTO_RNG_AUTO_INIT_ENABLED  - Initialize the RNG module automatically when nrf_crypto is initialized.
+
+
+// <i> Automatic initialization is only supported with static or internally allocated context and temporary memory.
+
+#ifndef NRF_CRYPTO_RNG_AUTO_INIT_ENABLED
+#define NRF_CRYPTO_RNG_AUTO_INIT_ENABLED 1
+#endif
+
+// </h>
+//==========================================================
+
 // </h>
 //==========================================================
 
@@ -2437,7 +2777,7 @@
 // <e> NRFX_PPI_ENABLED - nrfx_ppi - PPI peripheral allocator
 //==========================================================
 #ifndef NRFX_PPI_ENABLED
-#define NRFX_PPI_ENABLED 0
+#define NRFX_PPI_ENABLED 1
 #endif
 // <e> NRFX_PPI_CONFIG_LOG_ENABLED - Enables logging in the module.
 //==========================================================
@@ -3132,7 +3472,7 @@
 // <e> NRFX_SAADC_ENABLED - nrfx_saadc - SAADC peripheral driver
 //==========================================================
 #ifndef NRFX_SAADC_ENABLED
-#define NRFX_SAADC_ENABLED 0
+#define NRFX_SAADC_ENABLED 1
 #endif
 // <o> NRFX_SAADC_CONFIG_RESOLUTION  - Resolution
 
@@ -3690,7 +4030,7 @@
 // <e> NRFX_TIMER_ENABLED - nrfx_timer - TIMER periperal driver
 //==========================================================
 #ifndef NRFX_TIMER_ENABLED
-#define NRFX_TIMER_ENABLED 0
+#define NRFX_TIMER_ENABLED 1
 #endif
 // <q> NRFX_TIMER0_ENABLED  - Enable TIMER0 instance
 
@@ -3703,7 +4043,7 @@
 
 
 #ifndef NRFX_TIMER1_ENABLED
-#define NRFX_TIMER1_ENABLED 0
+#define NRFX_TIMER1_ENABLED 1
 #endif
 
 // <q> NRFX_TIMER2_ENABLED  - Enable TIMER2 instance
@@ -4655,7 +4995,7 @@
 
 
 #ifndef PPI_ENABLED
-#define PPI_ENABLED 0
+#define PPI_ENABLED 1
 #endif
 
 // <e> PWM_ENABLED - nrf_drv_pwm - PWM peripheral driver - legacy layer
@@ -5144,7 +5484,7 @@
 // <e> SAADC_ENABLED - nrf_drv_saadc - SAADC peripheral driver - legacy layer
 //==========================================================
 #ifndef SAADC_ENABLED
-#define SAADC_ENABLED 0
+#define SAADC_ENABLED 1
 #endif
 // <o> SAADC_CONFIG_RESOLUTION  - Resolution
 
@@ -5385,7 +5725,7 @@
 // <e> TIMER_ENABLED - nrf_drv_timer - TIMER periperal driver - legacy layer
 //==========================================================
 #ifndef TIMER_ENABLED
-#define TIMER_ENABLED 0
+#define TIMER_ENABLED 1
 #endif
 // <o> TIMER_DEFAULT_CONFIG_FREQUENCY  - Timer frequency if in Timer mode
 
@@ -5452,7 +5792,7 @@
 
 
 #ifndef TIMER1_ENABLED
-#define TIMER1_ENABLED 0
+#define TIMER1_ENABLED 1
 #endif
 
 // <q> TIMER2_ENABLED  - Enable TIMER2 instance
@@ -6428,7 +6768,7 @@
 // <i> The total amount of flash memory that is used by FDS amounts to @ref FDS_VIRTUAL_PAGES * @ref FDS_VIRTUAL_PAGE_SIZE * 4 bytes.
 
 #ifndef FDS_VIRTUAL_PAGES
-#define FDS_VIRTUAL_PAGES 3
+#define FDS_VIRTUAL_PAGES 10
 #endif
 
 // <o> FDS_VIRTUAL_PAGE_SIZE  - The size of a virtual flash page.
@@ -6473,7 +6813,7 @@
 // <i> Increase this value if you frequently get synchronous FDS_ERR_NO_SPACE_IN_QUEUES errors.
 
 #ifndef FDS_OP_QUEUE_SIZE
-#define FDS_OP_QUEUE_SIZE 4
+#define FDS_OP_QUEUE_SIZE 8
 #endif
 
 // </h>
@@ -11995,7 +12335,7 @@
 // <i> Requested BLE GAP data length to be negotiated.
 
 #ifndef NRF_SDH_BLE_GAP_DATA_LENGTH
-#define NRF_SDH_BLE_GAP_DATA_LENGTH 27
+#define NRF_SDH_BLE_GAP_DATA_LENGTH 251
 #endif
 
 // <o> NRF_SDH_BLE_PERIPHERAL_LINK_COUNT - Maximum number of peripheral links.
@@ -12024,17 +12364,17 @@
 
 // <o> NRF_SDH_BLE_GATT_MAX_MTU_SIZE - Static maximum MTU size.
 #ifndef NRF_SDH_BLE_GATT_MAX_MTU_SIZE
-#define NRF_SDH_BLE_GATT_MAX_MTU_SIZE 23
+#define NRF_SDH_BLE_GATT_MAX_MTU_SIZE 247
 #endif
 
 // <o> NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE - Attribute Table size in bytes. The size must be a multiple of 4.
 #ifndef NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE
-#define NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE 1408
+#define NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE 2048
 #endif
 
 // <o> NRF_SDH_BLE_VS_UUID_COUNT - The number of vendor-specific UUIDs.
 #ifndef NRF_SDH_BLE_VS_UUID_COUNT
-#define NRF_SDH_BLE_VS_UUID_COUNT 0
+#define NRF_SDH_BLE_VS_UUID_COUNT 2
 #endif
 
 // <q> NRF_SDH_BLE_SERVICE_CHANGED  - Include the Service Changed characteristic in the Attribute Table.
@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BLE_HRT)
+#include <string.h>
+
+#include "ble.h"
+#include "ble_hrt.h"
+
+#define NRF_LOG_MODULE_NAME ble_hrt
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+
+/**@brief Function for passing an event to the application.
+ *
+ * @param[in] p_hrt     Pointer to the service structure.
+ * @param[in] evt_type  Type of the event.
+ */
+static void evt_send(ble_hrt_t * p_hrt, ble_hrt_evt_type_t evt_type)
+{
+        ble_hrt_evt_t evt;
+
+        if (p_hrt->evt_handler == NULL)
+        {
+                return;
+        }
+
+        evt.evt_type = evt_type;
+        p_hrt->evt_handler(p_hrt, &evt);
+}
+
+
+/**@brief Function for handling the @ref BLE_GAP_EVT_CONNECTED event.
+ *
+ * @details A bonded peer does not write the CCCD again, its value is checked here.
+ *
+ * @param[in] p_hrt      Pointer to the service structure.
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ */
+static void on_connect(ble_hrt_t * p_hrt, ble_evt_t const * p_ble_evt)
+{
+        ret_code_t        err_code;
+        ble_gatts_value_t gatts_val;
+        uint8_t           cccd_value[BLE_CCCD_VALUE_LEN];
+
+        p_hrt->conn_handle   = p_ble_evt->evt.gap_evt.conn_handle;
+        p_hrt->notif_enabled = false;
+
+        memset(&gatts_val, 0, sizeof(gatts_val));
+        gatts_val.p_value = cccd_value;
+        gatts_val.len     = sizeof(cccd_value);
+
+        err_code = sd_ble_gatts_value_get(p_hrt->conn_handle,
+                                          p_hrt->block_handles.cccd_handle,
+                                          &gatts_val);
+        if ((err_code == NRF_SUCCESS) && ble_srv_is_notification_enabled(cccd_value))
+        {
+                p_hrt->notif_enabled = true;
+                evt_send(p_hrt, BLE_HRT_EVT_NOTIF_ENABLED);
+        }
+}
+
+
+/**@brief Function for handling the @ref BLE_GATTS_EVT_WRITE event.
+ *
+ * @param[in] p_hrt      Pointer to the service structure.
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ */
+static void on_write(ble_hrt_t * p_hrt, ble_evt_t const * p_ble_evt)
+{
+        ble_gatts_evt_write_t const * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+        bool                          enabled;
+
+        if ((p_evt_write->handle != p_hrt->block_handles.cccd_handle) ||
+            (p_evt_write->len != BLE_CCCD_VALUE_LEN))
+        {
+                return;
+        }
+
+        enabled = ble_srv_is_notification_enabled(p_evt_write->data);
+        if (enabled == p_hrt->notif_enabled)
+        {
+                return;
+        }
+
+        p_hrt->notif_enabled = enabled;
+        evt_send(p_hrt, enabled ? BLE_HRT_EVT_NOTIF_ENABLED : BLE_HRT_EVT_NOTIF_DISABLED);
+}
+
+
+void ble_hrt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        ble_hrt_t * p_hrt = (ble_hrt_t *)p_context;
+
+        if ((p_hrt == NULL) || (p_ble_evt == NULL))
+        {
+                return;
+        }
+
+        switch (p_ble_evt->header.evt_id)
+        {
+                case BLE_GAP_EVT_CONNECTED:
+                        on_connect(p_hrt, p_ble_evt);
+                        break;
+
+                case BLE_GAP_EVT_DISCONNECTED:
+                        if (p_ble_evt->evt.gap_evt.conn_handle == p_hrt->conn_handle)
+                        {
+                                p_hrt->conn_handle   = BLE_CONN_HANDLE_INVALID;
+                                p_hrt->notif_enabled = false;
+                        }
+                        break;
+
+                case BLE_GATTS_EVT_WRITE:
+                        if (p_ble_evt->evt.gatts_evt.conn_handle == p_hrt->conn_handle)
+                        {
+                                on_write(p_hrt, p_ble_evt);
+                        }
+                        break;
+
+                case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+                        if ((p_ble_evt->evt.gatts_evt.conn_handle == p_hrt->conn_handle) &&
+                            p_hrt->notif_enabled)
+                        {
+                                evt_send(p_hrt, BLE_HRT_EVT_TX_RDY);
+                        }
+                        break;
+
+                default:
+                        // No implementation needed.
+                        break;
+        }
+}
+
+
+ret_code_t ble_hrt_init(ble_hrt_t * p_hrt, ble_hrt_init_t const * p_init)
+{
+        ret_code_t            err_code;
+        ble_uuid_t            ble_uuid;
+        ble_uuid128_t         base_uuid = HRT_BASE_UUID;
+        ble_add_char_params_t add_char_params;
+
+        VERIFY_PARAM_NOT_NULL(p_hrt);
+        VERIFY_PARAM_NOT_NULL(p_init);
+
+        p_hrt->evt_handler   = p_init->evt_handler;
+        p_hrt->conn_handle   = BLE_CONN_HANDLE_INVALID;
+        p_hrt->notif_enabled = false;
+
+        err_code = sd_ble_uuid_vs_add(&base_uuid, &p_hrt->uuid_type);
+        VERIFY_SUCCESS(err_code);
+
+        ble_uuid.type = p_hrt->uuid_type;
+        ble_uuid.uuid = BLE_UUID_HRT_SERVICE;
+
+        err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY,
+                                            &ble_uuid,
+                                            &p_hrt->service_handle);
+        VERIFY_SUCCESS(err_code);
+
+        memset(&add_char_params, 0, sizeof(add_char_params));
+        add_char_params.uuid              = BLE_UUID_HRT_BLOCK_CHAR;
+        add_char_params.uuid_type         = p_hrt->uuid_type;
+        add_char_params.max_len           = HRT_BLOCK_MAX;
+        add_char_params.init_len          = sizeof(uint8_t);
+        add_char_params.is_var_len        = true;
+        add_char_params.char_props.notify = 1;
+
+        add_char_params.read_access       = SEC_OPEN;
+        add_char_params.cccd_write_access = SEC_OPEN;
+
+        return characteristic_add(p_hrt->service_handle, &add_char_params, &p_hrt->block_handles);
+}
+
+
+ret_code_t ble_hrt_block_send(ble_hrt_t * p_hrt, uint8_t const * p_data, uint16_t len)
+{
+        ble_gatts_hvx_params_t hvx_params;
+
+        VERIFY_PARAM_NOT_NULL(p_hrt);
+
+        if ((p_hrt->conn_handle == BLE_CONN_HANDLE_INVALID) || !p_hrt->notif_enabled)
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        memset(&hvx_params, 0, sizeof(hvx_params));
+        hvx_params.handle = p_hrt->block_handles.value_handle;
+        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+        hvx_params.p_data = p_data;
+        hvx_params.p_len  = &len;
+
+        return sd_ble_gatts_hvx(p_hrt->conn_handle, &hvx_params);
+}
+
+#endif // NRF_MODULE_ENABLED(BLE_HRT)
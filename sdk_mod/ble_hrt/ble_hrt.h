@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ble_hrt Heart Rate Telemetry Service
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Compact heart rate and RR interval logging service.
+ *
+ * @details  A vendor specific service with a single notify characteristic. Every notification is
+ *           one block of the @ref hrt_codec: a run of heart rate samples and RR intervals, delta
+ *           and varint coded behind one block timestamp. It is meant for continuous logging, next
+ *           to the Heart Rate Service which keeps sending one measurement per notification.
+ *
+ *           The service tracks a single link. @ref BLE_HRT_EVT_TX_RDY tells the application that
+ *           the SoftDevice has room for more notifications.
+ */
+
+#ifndef BLE_HRT_H__
+#define BLE_HRT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "nrf_sdh_ble.h"
+#include "sdk_errors.h"
+#include "hrt_codec.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief   Macro for defining a ble_hrt instance.
+ * @param   _name   Name of the instance.
+ * @hideinitializer
+ */
+#define BLE_HRT_DEF(_name)                                                                          \
+        static ble_hrt_t _name;                                                                     \
+        NRF_SDH_BLE_OBSERVER(_name ## _obs,                                                         \
+                             BLE_HRT_BLE_OBSERVER_PRIO,                                             \
+                             ble_hrt_on_ble_evt, &_name)
+
+#define HRT_BASE_UUID           {{0x3B, 0x51, 0x7A, 0x0C, 0x64, 0x2F, 0x4E, 0x9D, 0xB1, 0x27, 0x58, 0xE6, 0x00, 0x00, 0xC0, 0x8A}} /**< Vendor specific base UUID of the service. */
+#define BLE_UUID_HRT_SERVICE    0x0001  /**< UUID of the service. */
+#define BLE_UUID_HRT_BLOCK_CHAR 0x0002  /**< UUID of the block characteristic. */
+
+
+/**@brief Heart Rate Telemetry Service event type. */
+typedef enum
+{
+        BLE_HRT_EVT_NOTIF_ENABLED,      /**< The peer has enabled notifications of blocks. */
+        BLE_HRT_EVT_NOTIF_DISABLED,     /**< The peer has disabled notifications of blocks. */
+        BLE_HRT_EVT_TX_RDY              /**< Notifications have been sent, there is room for more. */
+} ble_hrt_evt_type_t;
+
+/**@brief Heart Rate Telemetry Service event. */
+typedef struct
+{
+        ble_hrt_evt_type_t evt_type;    /**< Type of the event. */
+} ble_hrt_evt_t;
+
+// Forward declaration of the ble_hrt_t type.
+typedef struct ble_hrt_s ble_hrt_t;
+
+/**@brief   Event handler type.
+ * @details This is the type of the event handler that should be provided by the application
+ *          of this module to receive events.
+ */
+typedef void (* ble_hrt_evt_handler_t)(ble_hrt_t * p_hrt, ble_hrt_evt_t const * p_evt);
+
+/**@brief Heart Rate Telemetry Service structure. */
+struct ble_hrt_s
+{
+        uint8_t                  uuid_type;             /**< UUID type of the vendor specific base UUID. */
+        uint16_t                 service_handle;        /**< Handle of the service. */
+        ble_gatts_char_handles_t block_handles;         /**< Handles of the block characteristic. */
+        uint16_t                 conn_handle;           /**< Handle of the current connection. */
+        bool                     notif_enabled;         /**< True if the peer has enabled notifications. */
+        ble_hrt_evt_handler_t    evt_handler;           /**< Application event handler. */
+};
+
+/**@brief Heart Rate Telemetry Service initialization structure. */
+typedef struct
+{
+        ble_hrt_evt_handler_t evt_handler;      /**< Application event handler. */
+} ble_hrt_init_t;
+
+
+/**@brief Function for initializing the Heart Rate Telemetry Service.
+ *
+ * @param[out] p_hrt   Pointer to the service structure.
+ * @param[in]  p_init  Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the service was added.
+ * @retval NRF_ERROR_NULL If a NULL pointer was passed.
+ * @return Otherwise, the error code returned by the SoftDevice.
+ */
+ret_code_t ble_hrt_init(ble_hrt_t * p_hrt, ble_hrt_init_t const * p_init);
+
+
+/**@brief Function for handling BLE events from the SoftDevice.
+ *
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ * @param[in] p_context  Pointer to the service structure.
+ */
+void ble_hrt_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context);
+
+
+/**@brief Function for sending one block to the peer.
+ *
+ * @param[in] p_hrt   Pointer to the service structure.
+ * @param[in] p_data  Block, as produced by the @ref hrt_codec encoder.
+ * @param[in] len     Length of the block.
+ *
+ * @retval NRF_SUCCESS             If the notification was queued.
+ * @retval NRF_ERROR_INVALID_STATE If there is no link or notifications are disabled.
+ * @retval NRF_ERROR_RESOURCES     If the SoftDevice queue is full. Wait for
+ *                                 @ref BLE_HRT_EVT_TX_RDY.
+ * @return Otherwise, the error code returned by @ref sd_ble_gatts_hvx.
+ */
+ret_code_t ble_hrt_block_send(ble_hrt_t * p_hrt, uint8_t const * p_data, uint16_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_HRT_H__
+
+/** @} */
@@ -0,0 +1,477 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BLE_HRT) || NRF_MODULE_ENABLED(BLE_HRT_C)
+#include <string.h>
+
+#include "hrt_codec.h"
+
+#define HDR_SIZE_MAX    (1 + 5 + 3 + 1 + 1)     /**< Largest block header: sequence number, t0, dt and both counts. */
+
+STATIC_ASSERT(HRT_BLOCK_MIN >= HDR_SIZE_MAX + 3);
+STATIC_ASSERT(HRT_BLOCK_MAX >= HRT_BLOCK_MIN);
+
+
+/**@brief Function for computing the length of a varint.
+ *
+ * @param[in] value  Value to encode.
+ *
+ * @return Number of bytes.
+ */
+static uint16_t varint_len(uint32_t value)
+{
+        uint16_t len = 1;
+
+        while (value >= 0x80)
+        {
+                value >>= 7;
+                len++;
+        }
+
+        return len;
+}
+
+
+/**@brief Function for writing a varint.
+ *
+ * @param[out] p_buf  Buffer to write to.
+ * @param[in]  value  Value to encode.
+ *
+ * @return Number of bytes written.
+ */
+static uint16_t varint_put(uint8_t * p_buf, uint32_t value)
+{
+        uint16_t len = 0;
+
+        while (value >= 0x80)
+        {
+                p_buf[len++] = (uint8_t)(value | 0x80);
+                value      >>= 7;
+        }
+        p_buf[len++] = (uint8_t)value;
+
+        return len;
+}
+
+
+/**@brief Function for reading a varint.
+ *
+ * @param[in]    p_buf    Buffer to read from.
+ * @param[in]    len      Length of the buffer.
+ * @param[inout] p_pos    Read position, advanced past the varint.
+ * @param[out]   p_value  Decoded value.
+ *
+ * @return False if the buffer ends within the varint or the varint is too long.
+ */
+static bool varint_get(uint8_t const * p_buf, uint16_t len, uint16_t * p_pos, uint32_t * p_value)
+{
+        uint32_t value = 0;
+
+        for (uint32_t shift = 0; (shift < 32) && (*p_pos < len); shift += 7)
+        {
+                uint8_t byte = p_buf[(*p_pos)++];
+
+                value |= (uint32_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                        *p_value = value;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+
+/**@brief Function for mapping a signed delta to an unsigned value, small magnitudes first. */
+static __INLINE uint32_t zigzag(int32_t delta)
+{
+        return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+
+/**@brief Function for reversing @ref zigzag. */
+static __INLINE int32_t unzigzag(uint32_t value)
+{
+        return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+/**@brief Function for computing the encoded size of the next sample of a series.
+ *
+ * @param[in] p_series  Samples already in the block.
+ * @param[in] count     Number of samples already in the block.
+ * @param[in] value     Next sample.
+ *
+ * @return Number of bytes.
+ */
+static uint16_t sample_len(uint16_t const * p_series, uint8_t count, uint16_t value)
+{
+        if (count == 0)
+        {
+                return varint_len(value);
+        }
+
+        return varint_len(zigzag((int32_t)value - p_series[count - 1]));
+}
+
+
+/**@brief Function for writing a series: the count, the first sample, then the deltas.
+ *
+ * @param[out] p_buf     Buffer to write to.
+ * @param[in]  p_series  Samples.
+ * @param[in]  count     Number of samples.
+ *
+ * @return Number of bytes written.
+ */
+static uint16_t series_put(uint8_t * p_buf, uint16_t const * p_series, uint8_t count)
+{
+        uint16_t len = varint_put(p_buf, count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+                uint32_t value = (i == 0) ? p_series[0]
+                                          : zigzag((int32_t)p_series[i] - p_series[i - 1]);
+
+                len += varint_put(&p_buf[len], value);
+        }
+
+        return len;
+}
+
+
+/**@brief Function for computing the encoded size of a series, without its count.
+ *
+ * @param[in] p_series  Samples.
+ * @param[in] count     Number of samples.
+ *
+ * @return Number of bytes.
+ */
+static uint16_t series_len(uint16_t const * p_series, uint8_t count)
+{
+        uint16_t len = 0;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+                len += sample_len(p_series, i, p_series[i]);
+        }
+
+        return len;
+}
+
+
+/**@brief Function for emptying the pending block of an encoder.
+ *
+ * @param[in] p_enc  Pointer to the encoder.
+ */
+static void block_clear(hrt_enc_t * p_enc)
+{
+        p_enc->size     = HDR_SIZE_MAX;
+        p_enc->hr_count = 0;
+        p_enc->rr_count = 0;
+}
+
+
+/**@brief Function for completing a block with the first samples of the pending block.
+ *
+ * @details The samples left over stay pending, the heart rate samples with t0 moved past the
+ *          ones sent.
+ *
+ * @param[in] p_enc     Pointer to the encoder.
+ * @param[in] hr_count  Heart rate samples to send.
+ * @param[in] rr_count  RR intervals to send.
+ */
+static void block_emit(hrt_enc_t * p_enc, uint8_t hr_count, uint8_t rr_count)
+{
+        uint16_t len = 0;
+
+        p_enc->block[len++] = p_enc->seq;
+        len += varint_put(&p_enc->block[len], p_enc->t0);
+        len += varint_put(&p_enc->block[len], p_enc->dt_ms);
+        len += series_put(&p_enc->block[len], p_enc->hr, hr_count);
+        len += series_put(&p_enc->block[len], p_enc->rr, rr_count);
+
+        p_enc->seq++;
+        if ((hr_count == p_enc->hr_count) && (rr_count == p_enc->rr_count))
+        {
+                block_clear(p_enc);
+        }
+        else
+        {
+                p_enc->hr_count -= hr_count;
+                p_enc->rr_count -= rr_count;
+                p_enc->t0       += (uint32_t)hr_count * p_enc->dt_ms;
+                memmove(p_enc->hr, &p_enc->hr[hr_count], p_enc->hr_count * sizeof(p_enc->hr[0]));
+                memmove(p_enc->rr, &p_enc->rr[rr_count], p_enc->rr_count * sizeof(p_enc->rr[0]));
+
+                // The first sample left over is no longer a delta.
+                p_enc->size = HDR_SIZE_MAX + series_len(p_enc->hr, p_enc->hr_count)
+                                           + series_len(p_enc->rr, p_enc->rr_count);
+        }
+
+        if (p_enc->block_handler != NULL)
+        {
+                p_enc->block_handler(p_enc->p_context, p_enc->block, len);
+        }
+}
+
+
+void hrt_enc_init(hrt_enc_t             * p_enc,
+                  hrt_enc_block_handler_t block_handler,
+                  void                  * p_context,
+                  uint16_t                dt_ms,
+                  uint32_t                age_max_ms)
+{
+        p_enc->block_handler = block_handler;
+        p_enc->p_context     = p_context;
+        p_enc->dt_ms         = dt_ms;
+        p_enc->age_max_ms    = age_max_ms;
+        p_enc->block_max     = HRT_BLOCK_MAX;
+        p_enc->t0            = 0;
+        p_enc->seq           = 0;
+
+        block_clear(p_enc);
+}
+
+
+void hrt_enc_block_max_set(hrt_enc_t * p_enc, uint16_t block_max)
+{
+        p_enc->block_max = MAX(MIN(block_max, HRT_BLOCK_MAX), HRT_BLOCK_MIN);
+
+        // A pending block that no longer fits goes out in as many blocks as it takes, each one
+        // with as many samples as fit.
+        while (p_enc->size > p_enc->block_max)
+        {
+                uint16_t size     = HDR_SIZE_MAX;
+                uint8_t  hr_count = 0;
+                uint8_t  rr_count = 0;
+
+                while ((hr_count < p_enc->hr_count) &&
+                       (size + sample_len(p_enc->hr, hr_count, p_enc->hr[hr_count]) <= p_enc->block_max))
+                {
+                        size += sample_len(p_enc->hr, hr_count, p_enc->hr[hr_count]);
+                        hr_count++;
+                }
+                while ((rr_count < p_enc->rr_count) &&
+                       (size + sample_len(p_enc->rr, rr_count, p_enc->rr[rr_count]) <= p_enc->block_max))
+                {
+                        size += sample_len(p_enc->rr, rr_count, p_enc->rr[rr_count]);
+                        rr_count++;
+                }
+
+                block_emit(p_enc, hr_count, rr_count);
+        }
+}
+
+
+void hrt_enc_hr_add(hrt_enc_t * p_enc, uint32_t t_ms, uint16_t hr)
+{
+        uint16_t len;
+
+        if (p_enc->hr_count > 0)
+        {
+                // Sample times are implied by t0 and dt, a late or early sample needs a new block.
+                int32_t skew = (int32_t)(t_ms - (p_enc->t0 + (uint32_t)p_enc->hr_count * p_enc->dt_ms));
+
+                if ((skew > p_enc->dt_ms / 2) || (-skew > p_enc->dt_ms / 2) ||
+                    (t_ms - p_enc->t0 >= p_enc->age_max_ms))
+                {
+                        hrt_enc_flush(p_enc, t_ms);
+                }
+        }
+
+        len = sample_len(p_enc->hr, p_enc->hr_count, hr);
+        if ((p_enc->size + len > p_enc->block_max) || (p_enc->hr_count == HRT_SERIES_MAX))
+        {
+                hrt_enc_flush(p_enc, t_ms);
+                len = sample_len(p_enc->hr, 0, hr);
+        }
+
+        if (p_enc->hr_count == 0)
+        {
+                p_enc->t0 = t_ms;
+        }
+
+        p_enc->hr[p_enc->hr_count++] = hr;
+        p_enc->size                 += len;
+}
+
+
+void hrt_enc_rr_add(hrt_enc_t * p_enc, uint16_t rr)
+{
+        uint16_t len = sample_len(p_enc->rr, p_enc->rr_count, rr);
+
+        if ((p_enc->size + len > p_enc->block_max) || (p_enc->rr_count == HRT_SERIES_MAX))
+        {
+                hrt_enc_flush(p_enc, p_enc->t0);
+                len = sample_len(p_enc->rr, 0, rr);
+        }
+
+        p_enc->rr[p_enc->rr_count++] = rr;
+        p_enc->size                 += len;
+}
+
+
+void hrt_enc_flush(hrt_enc_t * p_enc, uint32_t t_ms)
+{
+        if ((p_enc->hr_count == 0) && (p_enc->rr_count == 0))
+        {
+                return;
+        }
+
+        if (p_enc->hr_count == 0)
+        {
+                p_enc->t0 = t_ms;
+        }
+
+        block_emit(p_enc, p_enc->hr_count, p_enc->rr_count);
+}
+
+
+void hrt_dec_init(hrt_dec_t * p_dec, hrt_dec_sample_handler_t sample_handler, void * p_context)
+{
+        p_dec->sample_handler = sample_handler;
+        p_dec->p_context      = p_context;
+
+        hrt_dec_reset(p_dec);
+}
+
+
+void hrt_dec_reset(hrt_dec_t * p_dec)
+{
+        p_dec->synced   = false;
+        p_dec->seq_next = 0;
+        memset(&p_dec->stats, 0, sizeof(p_dec->stats));
+}
+
+
+/**@brief Function for walking the series of a block.
+ *
+ * @param[in] p_dec    Pointer to the decoder.
+ * @param[in] p_data   Block, past the sequence number.
+ * @param[in] len      Length of the block.
+ * @param[in] deliver  False to check the block only, true to pass its samples to the handler.
+ *
+ * @return False if the block is malformed.
+ */
+static bool block_walk(hrt_dec_t * p_dec, uint8_t const * p_data, uint16_t len, bool deliver)
+{
+        uint16_t pos = 1;
+        uint32_t t0;
+        uint32_t dt;
+
+        if (!varint_get(p_data, len, &pos, &t0) || !varint_get(p_data, len, &pos, &dt))
+        {
+                return false;
+        }
+
+        for (uint32_t type = HRT_SAMPLE_HR; type <= HRT_SAMPLE_RR; type++)
+        {
+                uint32_t count;
+                int32_t  value = 0;
+
+                if (!varint_get(p_data, len, &pos, &count) || (count > HRT_SERIES_MAX))
+                {
+                        return false;
+                }
+
+                for (uint32_t i = 0; i < count; i++)
+                {
+                        uint32_t coded;
+
+                        if (!varint_get(p_data, len, &pos, &coded))
+                        {
+                                return false;
+                        }
+
+                        value = (i == 0) ? (int32_t)coded : (value + unzigzag(coded));
+                        if ((value < 0) || (value > UINT16_MAX))
+                        {
+                                return false;
+                        }
+
+                        if (deliver)
+                        {
+                                p_dec->stats.samples++;
+                                if (p_dec->sample_handler != NULL)
+                                {
+                                        p_dec->sample_handler(p_dec->p_context,
+                                                              (hrt_sample_type_t)type,
+                                                              (type == HRT_SAMPLE_HR) ? (t0 + i * dt) : t0,
+                                                              (uint16_t)value);
+                                }
+                        }
+                }
+        }
+
+        // Bytes past the last series mean the counts are wrong.
+        return (pos == len);
+}
+
+
+ret_code_t hrt_dec_block(hrt_dec_t * p_dec, uint8_t const * p_data, uint16_t len)
+{
+        uint8_t seq;
+
+        // The whole block is checked first, a malformed block passes no sample to the handler.
+        if ((len == 0) || !block_walk(p_dec, p_data, len, false))
+        {
+                p_dec->stats.errors++;
+                return NRF_ERROR_INVALID_DATA;
+        }
+
+        // The sequence number of a malformed block cannot be trusted, the block counts as lost.
+        seq = p_data[0];
+        if (p_dec->synced && (seq != p_dec->seq_next))
+        {
+                p_dec->stats.lost += (uint8_t)(seq - p_dec->seq_next);
+        }
+        p_dec->synced   = true;
+        p_dec->seq_next = seq + 1;
+
+        (void)block_walk(p_dec, p_data, len, true);
+
+        p_dec->stats.blocks++;
+        p_dec->stats.bytes += len;
+
+        return NRF_SUCCESS;
+}
+
+#endif // NRF_MODULE_ENABLED(BLE_HRT) || NRF_MODULE_ENABLED(BLE_HRT_C)
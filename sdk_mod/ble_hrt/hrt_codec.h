@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup hrt_codec Heart rate telemetry block codec
+ * @{
+ * @ingroup  ble_hrt
+ * @brief    Packs heart rate and RR interval series into compact blocks.
+ *
+ * @details  A block fills one notification of the @ref ble_hrt characteristic:
+ *
+ *           @code
+ *           | seq (1 byte) | t0 (varint) | dt (varint) |
+ *           | HR count (varint) | HR 0 (varint) | zz(HR 1 - HR 0) (varint) | ... |
+ *           | RR count (varint) | RR 0 (varint) | zz(RR 1 - RR 0) (varint) | ... |
+ *           @endcode
+ *
+ *           Varints are little endian base 128, 7 bits per byte with the top bit set on all but
+ *           the last byte. zz() is the zig-zag mapping of signed deltas to unsigned values, so
+ *           small changes of either sign take one byte.
+ *
+ *           t0 is the time of the first heart rate sample in milliseconds and dt the spacing of
+ *           the heart rate samples. RR intervals are in 1/1024 seconds and carry no timestamps,
+ *           they follow each other. A heart rate sample that breaks the dt spacing starts a new
+ *           block.
+ *
+ *           A steady signal takes about one byte per sample, against 3 to 5 bytes of payload plus
+ *           the ATT header for a Heart Rate Measurement notification per heart rate sample.
+ */
+
+#ifndef HRT_CODEC_H__
+#define HRT_CODEC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HRT_BLOCK_MAX           (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3)     /**< Largest block, one notification at the largest ATT MTU. */
+#define HRT_BLOCK_MIN           20                                      /**< Smallest block limit, one notification at the default ATT MTU of 23. */
+#define HRT_SERIES_MAX          127                                     /**< Most samples of one series in a block, the count takes one byte. */
+
+/**@brief Sample type. */
+typedef enum
+{
+        HRT_SAMPLE_HR,          /**< Heart rate in beats per minute. */
+        HRT_SAMPLE_RR           /**< RR interval in 1/1024 seconds. */
+} hrt_sample_type_t;
+
+/**@brief Block handler type, called by the encoder for every completed block.
+ *
+ * @param[in] p_context  Context given at initialization.
+ * @param[in] p_block    Block, valid during the call.
+ * @param[in] len        Length of the block.
+ */
+typedef void (* hrt_enc_block_handler_t)(void * p_context, uint8_t const * p_block, uint16_t len);
+
+/**@brief Sample handler type, called by the decoder for every sample of a well formed block.
+ *
+ * @param[in] p_context  Context given at initialization.
+ * @param[in] type       Sample type.
+ * @param[in] t_ms       Time of a heart rate sample, time of the block for an RR interval.
+ * @param[in] value      Sample value.
+ */
+typedef void (* hrt_dec_sample_handler_t)(void * p_context, hrt_sample_type_t type, uint32_t t_ms, uint16_t value);
+
+/**@brief Block encoder. */
+typedef struct
+{
+        hrt_enc_block_handler_t block_handler;          /**< Completed block handler. */
+        void                  * p_context;              /**< Context passed to the handler. */
+        uint16_t                dt_ms;                  /**< Nominal spacing of the heart rate samples. */
+        uint32_t                age_max_ms;             /**< Longest time covered by one block. */
+        uint16_t                block_max;              /**< Largest block, set from the ATT MTU. */
+        uint16_t                size;                   /**< Encoded size of the pending block, t0 counted at its largest. */
+        uint32_t                t0;                     /**< Time of the first heart rate sample of the pending block. */
+        uint8_t                 seq;                    /**< Sequence number of the pending block. */
+        uint8_t                 hr_count;               /**< Heart rate samples in the pending block. */
+        uint8_t                 rr_count;               /**< RR intervals in the pending block. */
+        uint16_t                hr[HRT_SERIES_MAX];     /**< Heart rate samples of the pending block. */
+        uint16_t                rr[HRT_SERIES_MAX];     /**< RR intervals of the pending block. */
+        uint8_t                 block[HRT_BLOCK_MAX];   /**< Block being flushed. */
+} hrt_enc_t;
+
+/**@brief Block decoder statistics. */
+typedef struct
+{
+        uint32_t blocks;        /**< Blocks decoded. */
+        uint32_t lost;          /**< Blocks missing from the sequence, malformed blocks included. */
+        uint32_t errors;        /**< Malformed blocks. */
+        uint32_t samples;       /**< Samples decoded. */
+        uint32_t bytes;         /**< Bytes of the blocks decoded. */
+} hrt_dec_stats_t;
+
+/**@brief Block decoder. */
+typedef struct
+{
+        hrt_dec_sample_handler_t sample_handler;        /**< Sample handler. */
+        void                   * p_context;             /**< Context passed to the handler. */
+        bool                     synced;                /**< True once a block has been decoded. */
+        uint8_t                  seq_next;              /**< Sequence number expected next. */
+        hrt_dec_stats_t          stats;                 /**< Statistics. */
+} hrt_dec_t;
+
+
+/**@brief Function for initializing a block encoder.
+ *
+ * @param[out] p_enc          Pointer to the encoder.
+ * @param[in]  block_handler  Handler for completed blocks.
+ * @param[in]  p_context      Context passed to the handler.
+ * @param[in]  dt_ms          Nominal spacing of the heart rate samples in milliseconds.
+ * @param[in]  age_max_ms     Longest time covered by one block in milliseconds.
+ */
+void hrt_enc_init(hrt_enc_t             * p_enc,
+                  hrt_enc_block_handler_t block_handler,
+                  void                  * p_context,
+                  uint16_t                dt_ms,
+                  uint32_t                age_max_ms);
+
+
+/**@brief Function for setting the largest block.
+ *
+ * @details A pending block that no longer fits is split, the blocks completed are no larger than
+ *          the new limit.
+ *
+ * @param[in] p_enc      Pointer to the encoder.
+ * @param[in] block_max  Largest block, kept between @ref HRT_BLOCK_MIN and @ref HRT_BLOCK_MAX.
+ */
+void hrt_enc_block_max_set(hrt_enc_t * p_enc, uint16_t block_max);
+
+
+/**@brief Function for adding a heart rate sample.
+ *
+ * @param[in] p_enc  Pointer to the encoder.
+ * @param[in] t_ms   Time of the sample in milliseconds.
+ * @param[in] hr     Heart rate in beats per minute.
+ */
+void hrt_enc_hr_add(hrt_enc_t * p_enc, uint32_t t_ms, uint16_t hr);
+
+
+/**@brief Function for adding an RR interval.
+ *
+ * @param[in] p_enc  Pointer to the encoder.
+ * @param[in] rr     RR interval in 1/1024 seconds.
+ */
+void hrt_enc_rr_add(hrt_enc_t * p_enc, uint16_t rr);
+
+
+/**@brief Function for completing the pending block, if it holds any sample.
+ *
+ * @param[in] p_enc  Pointer to the encoder.
+ * @param[in] t_ms   Current time, used as t0 of a block without heart rate samples.
+ */
+void hrt_enc_flush(hrt_enc_t * p_enc, uint32_t t_ms);
+
+
+/**@brief Function for initializing a block decoder.
+ *
+ * @param[out] p_dec           Pointer to the decoder.
+ * @param[in]  sample_handler  Handler for decoded samples.
+ * @param[in]  p_context       Context passed to the handler.
+ */
+void hrt_dec_init(hrt_dec_t * p_dec, hrt_dec_sample_handler_t sample_handler, void * p_context);
+
+
+/**@brief Function for forgetting the sequence and the statistics, when a link is established.
+ *
+ * @param[in] p_dec  Pointer to the decoder.
+ */
+void hrt_dec_reset(hrt_dec_t * p_dec);
+
+
+/**@brief Function for decoding a block, calling the sample handler for every sample.
+ *
+ * @param[in] p_dec   Pointer to the decoder.
+ * @param[in] p_data  Block.
+ * @param[in] len     Length of the block.
+ *
+ * @retval NRF_SUCCESS            If the block was decoded.
+ * @retval NRF_ERROR_INVALID_DATA If the block is malformed. No sample has been passed to the
+ *                                handler and the block counts as lost.
+ */
+ret_code_t hrt_dec_block(hrt_dec_t * p_dec, uint8_t const * p_data, uint16_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HRT_CODEC_H__
+
+/** @} */
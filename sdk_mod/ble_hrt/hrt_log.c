@@ -0,0 +1,574 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(HRT_LOG)
+#include <string.h>
+
+#include "fds.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "hrt_log.h"
+#ifdef FREERTOS
+#include "FreeRTOS.h"
+#endif
+
+#define NRF_LOG_MODULE_NAME hrt_log
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#ifdef FREERTOS
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000) / configTICK_RATE_HZ))
+#else
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+#endif
+
+/**@brief Header in front of the block in every record. */
+typedef struct
+{
+        uint32_t index;         /**< Running index of the block. */
+        uint16_t len;           /**< Length of the block in bytes. */
+        uint16_t reserved;      /**< Pads the header to whole words. */
+} rec_hdr_t;
+
+/**@brief Record as written to flash. */
+typedef struct
+{
+        rec_hdr_t hdr;                                          /**< Header. */
+        uint8_t   block[ALIGN_NUM(sizeof(uint32_t), HRT_BLOCK_MAX)]; /**< Block, padded to whole words. */
+} rec_t;
+
+#define RECORD_ID_NONE      0       /**< FDS hands out record IDs from 1. */
+
+STATIC_ASSERT(sizeof(rec_hdr_t) % sizeof(uint32_t) == 0);
+STATIC_ASSERT((HRT_LOG_RECORDS_MAX > 0) && (HRT_LOG_RECORDS_MAX < UINT16_MAX));
+STATIC_ASSERT((HRT_LOG_WRITE_QUEUE_SIZE > 0) && (HRT_LOG_WRITE_QUEUE_SIZE <= UINT8_MAX));
+STATIC_ASSERT(sizeof(rec_t) * HRT_LOG_WRITE_QUEUE_SIZE >= sizeof(uint32_t) * HRT_LOG_RECORDS_MAX);
+
+// The records in m_ids, oldest first: m_sent records uploaded and waiting to be deleted, then the
+// records to upload, and last m_writing records whose write has not completed.
+static uint32_t        m_ids[HRT_LOG_RECORDS_MAX];      /**< FDS record IDs, oldest at m_tail. */
+static uint16_t        m_tail;                          /**< Position of the oldest record in m_ids. */
+static uint16_t        m_count;                         /**< Records in m_ids. */
+static uint16_t        m_sent;                          /**< Oldest records uploaded and waiting for room in the FDS queue to be deleted. */
+static uint16_t        m_writing;                       /**< Newest records whose write has not completed. */
+static uint32_t        m_next_index;                    /**< Index of the next block appended. */
+static rec_t           m_wbuf[HRT_LOG_WRITE_QUEUE_SIZE]; /**< Write buffers, released in order as FDS completes the writes. */
+static uint8_t         m_wbuf_head;                     /**< Next free write buffer. */
+static bool            m_ready;                         /**< True once the records left from before a reset are indexed. */
+static bool            m_gc_pending;                    /**< True if the flash is to be garbage collected once the uploaded records are deleted. */
+static volatile bool   m_deleting;                      /**< True while a context issues the deletions. */
+static volatile bool   m_delete_again;                  /**< True if deletions were asked for meanwhile. */
+static bool            m_uploading;                     /**< True from the first block uploaded until the backlog is empty. */
+static uint32_t        m_upload_start;                  /**< Tick of the first block uploaded. */
+static uint32_t        m_upload_blocks;                 /**< Blocks uploaded since m_upload_start. */
+static uint32_t        m_upload_bytes;                  /**< Bytes uploaded since m_upload_start. */
+static hrt_log_stats_t m_stats;                         /**< Statistics. */
+
+
+/**@brief Function for taking the oldest record off the backlog. Call with interrupts masked.
+ *
+ * @return FDS record ID of the record.
+ */
+static uint32_t id_pop(void)
+{
+        uint32_t record_id = m_ids[m_tail];
+
+        m_tail = (m_tail + 1) % HRT_LOG_RECORDS_MAX;
+        m_count--;
+
+        return record_id;
+}
+
+
+/**@brief Function for removing a record from the middle of the backlog. Call with interrupts masked.
+ *
+ * @param[in] pos  Position of the record counted from the oldest.
+ */
+static void id_remove(uint16_t pos)
+{
+        for (uint16_t i = pos; i + 1 < m_count; i++)
+        {
+                m_ids[(m_tail + i) % HRT_LOG_RECORDS_MAX] = m_ids[(m_tail + i + 1) % HRT_LOG_RECORDS_MAX];
+        }
+        m_count--;
+}
+
+
+/**@brief Function for deleting the uploaded records, as far as the FDS queue has room.
+ *
+ * @details Called from the FDS events and from the upload, which may run in different tasks. One
+ *          context at a time issues the deletions, so that a record is deleted once. A call
+ *          while another context is at it makes that context look again before it lets go.
+ */
+static void deletes_issue(void)
+{
+        bool again;
+
+        CRITICAL_REGION_ENTER();
+        again          = !m_deleting;
+        m_delete_again = m_deleting;
+        m_deleting     = true;
+        CRITICAL_REGION_EXIT();
+
+        while (again)
+        {
+                for (;;)
+                {
+                        ret_code_t        err_code;
+                        fds_record_desc_t desc;
+                        uint32_t          record_id;
+
+                        CRITICAL_REGION_ENTER();
+                        record_id = (m_sent > 0) ? m_ids[m_tail] : RECORD_ID_NONE;
+                        CRITICAL_REGION_EXIT();
+
+                        if (record_id == RECORD_ID_NONE)
+                        {
+                                break;
+                        }
+
+                        (void)fds_descriptor_from_rec_id(&desc, record_id);
+
+                        err_code = fds_record_delete(&desc);
+                        if (err_code == FDS_ERR_NO_SPACE_IN_QUEUES)
+                        {
+                                // Retried on the next FDS event.
+                                break;
+                        }
+                        if (err_code != NRF_SUCCESS)
+                        {
+                                NRF_LOG_WARNING("Deleting record 0x%x failed: 0x%x.", record_id, err_code);
+                        }
+
+                        // An append may have taken the record off meanwhile to make room.
+                        CRITICAL_REGION_ENTER();
+                        if ((m_sent > 0) && (m_ids[m_tail] == record_id))
+                        {
+                                (void)id_pop();
+                                m_sent--;
+                        }
+                        CRITICAL_REGION_EXIT();
+                }
+
+                if (m_gc_pending && (m_sent == 0))
+                {
+                        // Reclaim the flash of the records deleted during the upload.
+                        m_gc_pending = false;
+                        (void)fds_gc();
+                }
+
+                CRITICAL_REGION_ENTER();
+                again          = m_delete_again;
+                m_delete_again = false;
+                m_deleting     = again;
+                CRITICAL_REGION_EXIT();
+        }
+}
+
+
+/**@brief Function for indexing the records left from before a reset.
+ *
+ * @details Flash order is not the write order once a garbage collection has moved records, the
+ *          records are sorted on the index in their header. Only the newest
+ *          @ref HRT_LOG_RECORDS_MAX records are kept, older ones are deleted.
+ *
+ *          No write is in flight before the backlog is ready, the write buffers hold the indexes
+ *          of the records during the sort.
+ */
+static void index_build(void)
+{
+        uint32_t         * p_index = (uint32_t *)m_wbuf;
+        fds_record_desc_t  desc;
+        fds_find_token_t   token;
+        fds_flash_record_t rec;
+
+        memset(&token, 0, sizeof(token));
+
+        while (fds_record_find(HRT_LOG_FILE_ID, HRT_LOG_RECORD_KEY, &desc, &token) == NRF_SUCCESS)
+        {
+                rec_hdr_t const * p_hdr;
+                uint32_t          index;
+                uint16_t          pos;
+
+                if (fds_record_open(&desc, &rec) != NRF_SUCCESS)
+                {
+                        continue;
+                }
+
+                p_hdr = (rec_hdr_t const *)rec.p_data;
+                index = p_hdr->index;
+
+                if ((p_hdr->len == 0) || (p_hdr->len > HRT_BLOCK_MAX) ||
+                    ((m_count == HRT_LOG_RECORDS_MAX) && (index < p_index[0])))
+                {
+                        (void)fds_record_close(&desc);
+                        (void)fds_record_delete(&desc);
+                        continue;
+                }
+                (void)fds_record_close(&desc);
+
+                if (m_count == HRT_LOG_RECORDS_MAX)
+                {
+                        // Newer than the oldest record kept, which makes room.
+                        fds_record_desc_t old_desc;
+
+                        (void)fds_descriptor_from_rec_id(&old_desc, m_ids[0]);
+                        (void)fds_record_delete(&old_desc);
+
+                        m_count--;
+                        memmove(&m_ids[0], &m_ids[1], m_count * sizeof(m_ids[0]));
+                        memmove(&p_index[0], &p_index[1], m_count * sizeof(p_index[0]));
+                }
+
+                // Insertion sort, the records mostly come in order.
+                for (pos = m_count; (pos > 0) && (p_index[pos - 1] > index); pos--)
+                {
+                        m_ids[pos]   = m_ids[pos - 1];
+                        p_index[pos] = p_index[pos - 1];
+                }
+                m_ids[pos]   = desc.record_id;
+                p_index[pos] = index;
+                m_count++;
+
+                m_next_index = MAX(m_next_index, index + 1);
+        }
+
+        m_ready = true;
+
+        NRF_LOG_INFO("Backlog: %d blocks in flash.", m_count);
+}
+
+
+/**@brief Function for handling the completion of a write.
+ *
+ * @details FDS completes the operations in order, so the write is the one of the oldest record
+ *          still being written, and of the oldest write buffer in use.
+ *
+ * @param[in] p_evt  FDS event.
+ */
+static void on_write(fds_evt_t const * p_evt)
+{
+        CRITICAL_REGION_ENTER();
+
+        uint16_t pos = m_count - m_writing;
+
+        if (p_evt->result == NRF_SUCCESS)
+        {
+                m_ids[(m_tail + pos) % HRT_LOG_RECORDS_MAX] = p_evt->write.record_id;
+                m_stats.appended++;
+        }
+        else
+        {
+                id_remove(pos);
+                m_stats.dropped++;
+        }
+        m_writing--;
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for handling FDS events.
+ *
+ * @param[in] p_evt  FDS event.
+ */
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+        switch (p_evt->id)
+        {
+                case FDS_EVT_INIT:
+                        if (p_evt->result == NRF_SUCCESS)
+                        {
+                                index_build();
+                        }
+                        break;
+
+                case FDS_EVT_WRITE:
+                        if (p_evt->write.file_id == HRT_LOG_FILE_ID)
+                        {
+                                on_write(p_evt);
+                        }
+                        break;
+
+                default:
+                        break;
+        }
+
+        // Every completed operation leaves room in the FDS queue.
+        deletes_issue();
+}
+
+
+/**@brief Function for ending an upload once the backlog is empty. */
+static void upload_done(void)
+{
+        uint32_t elapsed_ms;
+
+        if (!m_uploading)
+        {
+                return;
+        }
+
+        m_uploading = false;
+        elapsed_ms  = TICKS_TO_MS(app_timer_cnt_diff_compute(app_timer_cnt_get(), m_upload_start));
+
+        NRF_LOG_INFO("Backlog uploaded: %d blocks, %d bytes in %d ms, %d bytes/s.",
+                     m_upload_blocks,
+                     m_upload_bytes,
+                     elapsed_ms,
+                     (elapsed_ms == 0) ? 0 : (uint32_t)((uint64_t)m_upload_bytes * 1000 / elapsed_ms));
+
+        m_gc_pending = true;
+}
+
+
+ret_code_t hrt_log_init(void)
+{
+        m_tail         = 0;
+        m_count        = 0;
+        m_sent         = 0;
+        m_writing      = 0;
+        m_next_index   = 0;
+        m_wbuf_head    = 0;
+        m_ready        = false;
+        m_gc_pending   = false;
+        m_deleting     = false;
+        m_delete_again = false;
+        m_uploading    = false;
+        memset(&m_stats, 0, sizeof(m_stats));
+
+        return fds_register(fds_evt_handler);
+}
+
+
+ret_code_t hrt_log_append(uint8_t const * p_block, uint16_t len)
+{
+        ret_code_t        err_code;
+        fds_record_t      record;
+        fds_record_desc_t desc;
+        rec_t           * p_rec  = NULL;
+        uint32_t          oldest = RECORD_ID_NONE;
+
+        if (!m_ready)
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        if ((len == 0) || (len > HRT_BLOCK_MAX))
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        CRITICAL_REGION_ENTER();
+
+        // A full backlog makes room by deleting its oldest block, unless that one is uploaded
+        // already and its deletion is waiting.
+        if ((m_writing < HRT_LOG_WRITE_QUEUE_SIZE) &&
+            ((m_count < HRT_LOG_RECORDS_MAX) || ((m_count > m_writing) && (m_sent == 0))))
+        {
+                if (m_count == HRT_LOG_RECORDS_MAX)
+                {
+                        oldest = id_pop();
+                        m_stats.overwritten++;
+                }
+
+                // Reserve the newest position, its record ID is filled in when the write completes.
+                p_rec            = &m_wbuf[m_wbuf_head];
+                p_rec->hdr.index = m_next_index++;
+                m_wbuf_head      = (m_wbuf_head + 1) % HRT_LOG_WRITE_QUEUE_SIZE;
+                m_count++;
+                m_writing++;
+        }
+        else
+        {
+                m_stats.dropped++;
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        if (p_rec == NULL)
+        {
+                return NRF_ERROR_NO_MEM;
+        }
+
+        if (oldest != RECORD_ID_NONE)
+        {
+                fds_record_desc_t old_desc;
+
+                (void)fds_descriptor_from_rec_id(&old_desc, oldest);
+                if (fds_record_delete(&old_desc) != NRF_SUCCESS)
+                {
+                        NRF_LOG_WARNING("Deleting record 0x%x failed.", oldest);
+                }
+        }
+
+        p_rec->hdr.len      = len;
+        p_rec->hdr.reserved = 0;
+        memcpy(p_rec->block, p_block, len);
+
+        record.file_id           = HRT_LOG_FILE_ID;
+        record.key               = HRT_LOG_RECORD_KEY;
+        record.data.p_data       = p_rec;
+        record.data.length_words = BYTES_TO_WORDS(sizeof(rec_hdr_t) + len);
+
+        err_code = fds_record_write(&desc, &record);
+        if (err_code != NRF_SUCCESS)
+        {
+                CRITICAL_REGION_ENTER();
+                m_wbuf_head = (m_wbuf_head + HRT_LOG_WRITE_QUEUE_SIZE - 1) % HRT_LOG_WRITE_QUEUE_SIZE;
+                m_count--;
+                m_writing--;
+                m_stats.dropped++;
+                CRITICAL_REGION_EXIT();
+
+                if (err_code == FDS_ERR_NO_SPACE_IN_FLASH)
+                {
+                        (void)fds_gc();
+                }
+
+                return NRF_ERROR_NO_MEM;
+        }
+
+        return NRF_SUCCESS;
+}
+
+
+ret_code_t hrt_log_upload(hrt_log_send_t send, void * p_context)
+{
+        ret_code_t err_code = NRF_SUCCESS;
+
+        for (;;)
+        {
+                fds_record_desc_t  desc;
+                fds_flash_record_t rec;
+                uint32_t           record_id;
+                uint16_t           len  = 0;
+                bool               sent = false;
+                bool               empty;
+
+                CRITICAL_REGION_ENTER();
+                empty     = (m_sent + m_writing == m_count);
+                record_id = m_ids[(m_tail + m_sent) % HRT_LOG_RECORDS_MAX];
+                CRITICAL_REGION_EXIT();
+
+                if (empty)
+                {
+                        upload_done();
+                        break;
+                }
+
+                (void)fds_descriptor_from_rec_id(&desc, record_id);
+
+                err_code = fds_record_open(&desc, &rec);
+                if (err_code == NRF_SUCCESS)
+                {
+                        rec_hdr_t const * p_hdr = (rec_hdr_t const *)rec.p_data;
+
+                        // The SoftDevice copies the notification, the record can be closed right away.
+                        len      = p_hdr->len;
+                        err_code = send(p_context, (uint8_t const *)(p_hdr + 1), len);
+                        (void)fds_record_close(&desc);
+
+                        if ((err_code == NRF_ERROR_RESOURCES) ||
+                            (err_code == NRF_ERROR_BUSY) ||
+                            (err_code == NRF_ERROR_INVALID_STATE))
+                        {
+                                break;
+                        }
+                        if (err_code == NRF_SUCCESS)
+                        {
+                                sent = true;
+                        }
+                        else
+                        {
+                                NRF_LOG_WARNING("Backlog block discarded: 0x%x.", err_code);
+                                err_code = NRF_SUCCESS;
+                        }
+                }
+                else
+                {
+                        NRF_LOG_WARNING("Backlog record 0x%x missing.", record_id);
+                        err_code = NRF_SUCCESS;
+                }
+
+                CRITICAL_REGION_ENTER();
+                // An append may have taken the oldest record off meanwhile to make room.
+                if (m_ids[(m_tail + m_sent) % HRT_LOG_RECORDS_MAX] == record_id)
+                {
+                        m_sent++;
+                }
+                CRITICAL_REGION_EXIT();
+
+                if (sent)
+                {
+                        if (!m_uploading)
+                        {
+                                m_uploading     = true;
+                                m_upload_start  = app_timer_cnt_get();
+                                m_upload_blocks = 0;
+                                m_upload_bytes  = 0;
+                        }
+                        m_upload_blocks++;
+                        m_upload_bytes       += len;
+                        m_stats.uploaded++;
+                        m_stats.upload_bytes += len;
+                }
+        }
+
+        deletes_issue();
+
+        return err_code;
+}
+
+
+uint32_t hrt_log_depth(void)
+{
+        return m_count - m_sent;
+}
+
+
+void hrt_log_stats_log(void)
+{
+        NRF_LOG_INFO("Backlog: %d blocks, %d written, %d overwritten, %d dropped.",
+                     hrt_log_depth(), m_stats.appended, m_stats.overwritten, m_stats.dropped);
+        NRF_LOG_INFO("Backlog uploaded: %d blocks, %d bytes.", m_stats.uploaded, m_stats.upload_bytes);
+}
+
+#endif // NRF_MODULE_ENABLED(HRT_LOG)
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup hrt_log Heart rate telemetry flash backlog
+ * @{
+ * @ingroup  ble_hrt
+ * @brief    Keeps the telemetry blocks that could not be sent in flash until the central is back.
+ *
+ * @details  Every block is one FDS record in @ref HRT_LOG_FILE_ID, so the records share the FDS
+ *           pages with the Peer Manager and are wear levelled and garbage collected by FDS. A
+ *           record holds the block behind a small header with a running index, which restores the
+ *           order of the records after a reset. In RAM the module keeps the FDS record IDs of the
+ *           backlog in write order, 4 bytes per record.
+ *
+ *           The backlog is a ring of at most @ref HRT_LOG_RECORDS_MAX records: when it is full
+ *           the oldest record is deleted to make room. @ref hrt_log_upload sends the oldest
+ *           records through an application function until the link has no room left. The records
+ *           sent are deleted as the FDS queue has room, a reset before that sends them again. Call
+ *           it again when the link has room, for example on
+ *           @ref BLE_HRT_EVT_TX_RDY. When the backlog is empty the upload rate is logged and the
+ *           deleted records are garbage collected.
+ *
+ *           FDS does not copy the data it writes, so @ref HRT_LOG_WRITE_QUEUE_SIZE buffers hold
+ *           the blocks until their write completes. Blocks are appended from any context, the
+ *           FDS events and the upload run in the SoftDevice event context.
+ */
+
+#ifndef HRT_LOG_H__
+#define HRT_LOG_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "hrt_codec.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Function type for sending one block of the backlog.
+ *
+ * @param[in] p_context  Context given to @ref hrt_log_upload.
+ * @param[in] p_block    Block, in flash.
+ * @param[in] len        Length of the block.
+ *
+ * @retval NRF_SUCCESS             If the block was queued, it is deleted from the backlog.
+ * @retval NRF_ERROR_RESOURCES     If the link has no room, the upload stops and the block stays.
+ * @retval NRF_ERROR_BUSY          Same as NRF_ERROR_RESOURCES.
+ * @retval NRF_ERROR_INVALID_STATE If there is no link, same as NRF_ERROR_RESOURCES.
+ * @return Any other error discards the block.
+ */
+typedef ret_code_t (* hrt_log_send_t)(void * p_context, uint8_t const * p_block, uint16_t len);
+
+/**@brief Backlog statistics. */
+typedef struct
+{
+        uint32_t appended;      /**< Blocks written to flash. */
+        uint32_t overwritten;   /**< Oldest blocks deleted to make room. */
+        uint32_t dropped;       /**< Blocks lost because no write buffer or no flash was free. */
+        uint32_t uploaded;      /**< Blocks sent from the backlog. */
+        uint32_t upload_bytes;  /**< Bytes sent from the backlog. */
+} hrt_log_stats_t;
+
+
+/**@brief Function for initializing the backlog.
+ *
+ * @details Registers with FDS, so it must be called before FDS is initialized, that is before
+ *          the Peer Manager. The records left from before a reset are indexed on FDS_EVT_INIT.
+ *
+ * @retval NRF_SUCCESS If the module was registered with FDS.
+ * @return Otherwise, the error code returned by @ref fds_register.
+ */
+ret_code_t hrt_log_init(void);
+
+
+/**@brief Function for appending a block to the backlog.
+ *
+ * @param[in] p_block  Block.
+ * @param[in] len      Length of the block, at most @ref HRT_BLOCK_MAX.
+ *
+ * @retval NRF_SUCCESS              If the block is being written.
+ * @retval NRF_ERROR_INVALID_STATE  If FDS is not initialized yet.
+ * @retval NRF_ERROR_INVALID_LENGTH If the block is empty or too long.
+ * @retval NRF_ERROR_NO_MEM         If no write buffer is free or FDS has no room. The block is
+ *                                  counted as dropped.
+ */
+ret_code_t hrt_log_append(uint8_t const * p_block, uint16_t len);
+
+
+/**@brief Function for sending the oldest blocks of the backlog.
+ *
+ * @param[in] send       Function sending one block.
+ * @param[in] p_context  Context passed to @p send.
+ *
+ * @retval NRF_SUCCESS If the backlog is empty or only holds blocks still being written.
+ * @return Otherwise, the error of @p send that stopped the upload.
+ */
+ret_code_t hrt_log_upload(hrt_log_send_t send, void * p_context);
+
+
+/**@brief Function for getting the number of blocks in the backlog.
+ *
+ * @return Number of blocks not uploaded yet, including those still being written.
+ */
+uint32_t hrt_log_depth(void);
+
+
+/**@brief Function for logging the backlog statistics. */
+void hrt_log_stats_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HRT_LOG_H__
+
+/** @} */
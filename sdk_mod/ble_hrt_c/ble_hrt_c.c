@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BLE_HRT_C)
+#include <string.h>
+
+#include "ble.h"
+#include "ble_gattc.h"
+#include "ble_hrt_c.h"
+
+#define NRF_LOG_MODULE_NAME ble_hrt_c
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+static uint8_t m_uuid_type = BLE_UUID_TYPE_UNKNOWN;    /**< UUID type of the base UUID, shared by all instances. */
+
+
+/**@brief Function for writing the CCCD of the block characteristic.
+ *
+ * @param[in] p_hrt_c  Pointer to the instance.
+ *
+ * @return The error code returned by @ref sd_ble_gattc_write.
+ */
+static ret_code_t cccd_write(ble_hrt_c_t * p_hrt_c)
+{
+        ret_code_t               err_code;
+        uint8_t                  cccd_value[BLE_CCCD_VALUE_LEN];
+        ble_gattc_write_params_t write_params;
+
+        cccd_value[0] = LSB_16(BLE_GATT_HVX_NOTIFICATION);
+        cccd_value[1] = MSB_16(BLE_GATT_HVX_NOTIFICATION);
+
+        memset(&write_params, 0, sizeof(write_params));
+        write_params.write_op = BLE_GATT_OP_WRITE_REQ;
+        write_params.handle   = p_hrt_c->handles.block_cccd_handle;
+        write_params.len      = sizeof(cccd_value);
+        write_params.p_value  = cccd_value;
+
+        err_code = sd_ble_gattc_write(p_hrt_c->conn_handle, &write_params);
+
+        p_hrt_c->cccd_pending = (err_code == NRF_ERROR_BUSY);
+
+        return err_code;
+}
+
+
+void ble_hrt_c_on_db_disc_evt(ble_hrt_c_t * p_hrt_c, ble_db_discovery_evt_t const * p_evt)
+{
+        ble_hrt_c_evt_t            evt;
+        ble_gatt_db_char_t const * p_chars = p_evt->params.discovered_db.charateristics;
+
+        if ((p_evt->evt_type != BLE_DB_DISCOVERY_COMPLETE) ||
+            (p_evt->params.discovered_db.srv_uuid.uuid != BLE_UUID_HRT_SERVICE) ||
+            (p_evt->params.discovered_db.srv_uuid.type != m_uuid_type))
+        {
+                return;
+        }
+
+        memset(&evt, 0, sizeof(evt));
+        evt.handles.block_handle      = BLE_GATT_HANDLE_INVALID;
+        evt.handles.block_cccd_handle = BLE_GATT_HANDLE_INVALID;
+
+        for (uint32_t i = 0; i < p_evt->params.discovered_db.char_count; i++)
+        {
+                if (p_chars[i].characteristic.uuid.uuid == BLE_UUID_HRT_BLOCK_CHAR)
+                {
+                        evt.handles.block_handle      = p_chars[i].characteristic.handle_value;
+                        evt.handles.block_cccd_handle = p_chars[i].cccd_handle;
+                }
+        }
+
+        NRF_LOG_DEBUG("Heart Rate Telemetry Service discovered at peer.");
+
+        if (p_hrt_c->evt_handler != NULL)
+        {
+                evt.evt_type    = BLE_HRT_C_EVT_DISCOVERY_COMPLETE;
+                evt.conn_handle = p_evt->conn_handle;
+                p_hrt_c->evt_handler(p_hrt_c, &evt);
+        }
+}
+
+
+/**@brief Function for handling a notification.
+ *
+ * @param[in] p_hrt_c    Pointer to the instance.
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ */
+static void on_hvx(ble_hrt_c_t * p_hrt_c, ble_evt_t const * p_ble_evt)
+{
+        ble_gattc_evt_hvx_t const * p_hvx = &p_ble_evt->evt.gattc_evt.params.hvx;
+        ble_hrt_c_evt_t             evt;
+
+        if ((p_hvx->handle != p_hrt_c->handles.block_handle) || (p_hrt_c->evt_handler == NULL))
+        {
+                return;
+        }
+
+        memset(&evt, 0, sizeof(evt));
+        evt.evt_type    = BLE_HRT_C_EVT_BLOCK;
+        evt.conn_handle = p_hrt_c->conn_handle;
+        evt.p_data      = p_hvx->data;
+        evt.data_len    = p_hvx->len;
+
+        p_hrt_c->evt_handler(p_hrt_c, &evt);
+}
+
+
+void ble_hrt_c_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        ble_hrt_c_t * p_hrt_c = (ble_hrt_c_t *)p_context;
+
+        if ((p_hrt_c == NULL) || (p_ble_evt == NULL) ||
+            (p_hrt_c->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+            (p_hrt_c->conn_handle != p_ble_evt->evt.gap_evt.conn_handle))
+        {
+                return;
+        }
+
+        switch (p_ble_evt->header.evt_id)
+        {
+                case BLE_GATTC_EVT_HVX:
+                        on_hvx(p_hrt_c, p_ble_evt);
+                        break;
+
+                case BLE_GATTC_EVT_WRITE_RSP:
+                        // The client procedure of the link is free again.
+                        if (p_hrt_c->cccd_pending)
+                        {
+                                (void)cccd_write(p_hrt_c);
+                        }
+                        break;
+
+                case BLE_GAP_EVT_DISCONNECTED:
+                        p_hrt_c->conn_handle          = BLE_CONN_HANDLE_INVALID;
+                        p_hrt_c->handles.block_handle = BLE_GATT_HANDLE_INVALID;
+                        p_hrt_c->cccd_pending         = false;
+
+                        if (p_hrt_c->evt_handler != NULL)
+                        {
+                                ble_hrt_c_evt_t evt;
+
+                                memset(&evt, 0, sizeof(evt));
+                                evt.evt_type    = BLE_HRT_C_EVT_DISCONNECTED;
+                                evt.conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+                                p_hrt_c->evt_handler(p_hrt_c, &evt);
+                        }
+                        break;
+
+                default:
+                        // No implementation needed.
+                        break;
+        }
+}
+
+
+ret_code_t ble_hrt_c_init(ble_hrt_c_t * p_hrt_c, ble_hrt_c_init_t const * p_init)
+{
+        ret_code_t    err_code;
+        ble_uuid_t    hrt_uuid;
+        ble_uuid128_t base_uuid = HRT_BASE_UUID;
+
+        VERIFY_PARAM_NOT_NULL(p_hrt_c);
+        VERIFY_PARAM_NOT_NULL(p_init);
+
+        p_hrt_c->conn_handle               = BLE_CONN_HANDLE_INVALID;
+        p_hrt_c->handles.block_handle      = BLE_GATT_HANDLE_INVALID;
+        p_hrt_c->handles.block_cccd_handle = BLE_GATT_HANDLE_INVALID;
+        p_hrt_c->cccd_pending              = false;
+        p_hrt_c->evt_handler               = p_init->evt_handler;
+
+        if (m_uuid_type != BLE_UUID_TYPE_UNKNOWN)
+        {
+                p_hrt_c->uuid_type = m_uuid_type;
+                return NRF_SUCCESS;
+        }
+
+        err_code = sd_ble_uuid_vs_add(&base_uuid, &m_uuid_type);
+        VERIFY_SUCCESS(err_code);
+
+        p_hrt_c->uuid_type = m_uuid_type;
+
+        hrt_uuid.type = m_uuid_type;
+        hrt_uuid.uuid = BLE_UUID_HRT_SERVICE;
+
+        return ble_db_discovery_evt_register(&hrt_uuid);
+}
+
+
+ret_code_t ble_hrt_c_handles_assign(ble_hrt_c_t               * p_hrt_c,
+                                    uint16_t                    conn_handle,
+                                    ble_hrt_c_handles_t const * p_handles)
+{
+        VERIFY_PARAM_NOT_NULL(p_hrt_c);
+
+        p_hrt_c->conn_handle = conn_handle;
+        if (p_handles != NULL)
+        {
+                p_hrt_c->handles = *p_handles;
+        }
+
+        return NRF_SUCCESS;
+}
+
+
+ret_code_t ble_hrt_c_notif_enable(ble_hrt_c_t * p_hrt_c)
+{
+        ret_code_t err_code;
+
+        VERIFY_PARAM_NOT_NULL(p_hrt_c);
+
+        if ((p_hrt_c->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+            (p_hrt_c->handles.block_cccd_handle == BLE_GATT_HANDLE_INVALID))
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        err_code = cccd_write(p_hrt_c);
+
+        return (err_code == NRF_ERROR_BUSY) ? NRF_SUCCESS : err_code;
+}
+
+#endif // NRF_MODULE_ENABLED(BLE_HRT_C)
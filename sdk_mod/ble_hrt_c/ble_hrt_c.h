@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ble_hrt_c Heart Rate Telemetry Service Client
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Client of the @ref ble_hrt service.
+ *
+ * @details  Discovers the service with the DB discovery module, enables notifications of the block
+ *           characteristic and passes every block to the application, which decodes it with the
+ *           @ref hrt_codec decoder.
+ */
+
+#ifndef BLE_HRT_C_H__
+#define BLE_HRT_C_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_gatt.h"
+#include "ble_db_discovery.h"
+#include "nrf_sdh_ble.h"
+#include "sdk_errors.h"
+#include "ble_hrt.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief   Macro for defining a ble_hrt_c instance.
+ * @param   _name   Name of the instance.
+ * @hideinitializer
+ */
+#define BLE_HRT_C_DEF(_name)                                                                        \
+        static ble_hrt_c_t _name;                                                                   \
+        NRF_SDH_BLE_OBSERVER(_name ## _obs,                                                         \
+                             BLE_HRT_C_BLE_OBSERVER_PRIO,                                           \
+                             ble_hrt_c_on_ble_evt, &_name)
+
+
+/**@brief Heart Rate Telemetry Service Client event type. */
+typedef enum
+{
+        BLE_HRT_C_EVT_DISCOVERY_COMPLETE,       /**< The service has been discovered at the peer. */
+        BLE_HRT_C_EVT_BLOCK,                    /**< A block has been received. */
+        BLE_HRT_C_EVT_DISCONNECTED              /**< The link has been released. */
+} ble_hrt_c_evt_type_t;
+
+/**@brief Handles of the service at the peer. */
+typedef struct
+{
+        uint16_t block_handle;          /**< Handle of the block characteristic value. */
+        uint16_t block_cccd_handle;     /**< Handle of the block characteristic CCCD. */
+} ble_hrt_c_handles_t;
+
+/**@brief Heart Rate Telemetry Service Client event. */
+typedef struct
+{
+        ble_hrt_c_evt_type_t evt_type;          /**< Type of the event. */
+        uint16_t             conn_handle;       /**< Connection the event belongs to. */
+        ble_hrt_c_handles_t  handles;           /**< Discovered handles, for @ref BLE_HRT_C_EVT_DISCOVERY_COMPLETE. */
+        uint8_t const      * p_data;            /**< Block, for @ref BLE_HRT_C_EVT_BLOCK. */
+        uint16_t             data_len;          /**< Length of the block, for @ref BLE_HRT_C_EVT_BLOCK. */
+} ble_hrt_c_evt_t;
+
+// Forward declaration of the ble_hrt_c_t type.
+typedef struct ble_hrt_c_s ble_hrt_c_t;
+
+/**@brief   Event handler type.
+ * @details This is the type of the event handler that should be provided by the application
+ *          of this module to receive events.
+ */
+typedef void (* ble_hrt_c_evt_handler_t)(ble_hrt_c_t * p_hrt_c, ble_hrt_c_evt_t const * p_evt);
+
+/**@brief Heart Rate Telemetry Service Client structure. */
+struct ble_hrt_c_s
+{
+        uint8_t                  uuid_type;             /**< UUID type of the vendor specific base UUID. */
+        uint16_t                 conn_handle;           /**< Handle of the current connection. */
+        ble_hrt_c_handles_t      handles;               /**< Handles of the service at the peer. */
+        bool                     cccd_pending;          /**< True if the CCCD write has to be retried. */
+        ble_hrt_c_evt_handler_t  evt_handler;           /**< Application event handler. */
+};
+
+/**@brief Heart Rate Telemetry Service Client initialization structure. */
+typedef struct
+{
+        ble_hrt_c_evt_handler_t evt_handler;    /**< Application event handler. */
+} ble_hrt_c_init_t;
+
+
+/**@brief Function for initializing a Heart Rate Telemetry Service Client instance.
+ *
+ * @details Registers the service with the DB discovery module. The vendor specific base UUID is
+ *          added once and shared by all instances.
+ *
+ * @param[out] p_hrt_c  Pointer to the instance.
+ * @param[in]  p_init   Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the instance was initialized.
+ * @retval NRF_ERROR_NULL If a NULL pointer was passed.
+ * @return Otherwise, the error code returned by the SoftDevice or the DB discovery module.
+ */
+ret_code_t ble_hrt_c_init(ble_hrt_c_t * p_hrt_c, ble_hrt_c_init_t const * p_init);
+
+
+/**@brief Function for handling DB discovery events.
+ *
+ * @param[in] p_hrt_c  Pointer to the instance of the link.
+ * @param[in] p_evt    Pointer to the DB discovery event.
+ */
+void ble_hrt_c_on_db_disc_evt(ble_hrt_c_t * p_hrt_c, ble_db_discovery_evt_t const * p_evt);
+
+
+/**@brief Function for handling BLE events from the SoftDevice.
+ *
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ * @param[in] p_context  Pointer to the instance.
+ */
+void ble_hrt_c_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context);
+
+
+/**@brief Function for assigning the link and the peer handles to an instance.
+ *
+ * @param[in] p_hrt_c      Pointer to the instance.
+ * @param[in] conn_handle  Handle of the connection.
+ * @param[in] p_handles    Handles of the service at the peer, NULL to keep the current ones.
+ *
+ * @retval NRF_SUCCESS    If the handles were assigned.
+ * @retval NRF_ERROR_NULL If a NULL pointer was passed.
+ */
+ret_code_t ble_hrt_c_handles_assign(ble_hrt_c_t               * p_hrt_c,
+                                    uint16_t                    conn_handle,
+                                    ble_hrt_c_handles_t const * p_handles);
+
+
+/**@brief Function for enabling notifications of blocks at the peer.
+ *
+ * @details If the GATT client is busy, the write is retried on the next write response.
+ *
+ * @param[in] p_hrt_c  Pointer to the instance.
+ *
+ * @retval NRF_SUCCESS             If the write was sent or will be retried.
+ * @retval NRF_ERROR_INVALID_STATE If there is no link or the service has not been discovered.
+ * @return Otherwise, the error code returned by @ref sd_ble_gattc_write.
+ */
+ret_code_t ble_hrt_c_notif_enable(ble_hrt_c_t * p_hrt_c);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_HRT_C_H__
+
+/** @} */
@@ -0,0 +1,378 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BLE_L2CAP_COC)
+#include <string.h>
+
+#include "ble.h"
+#include "ble_l2cap_coc.h"
+#include "app_error.h"
+
+#define NRF_LOG_MODULE_NAME ble_l2cap_coc
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define SDU_LEN_FIELD_SIZE  2                                                       /**< Size of the SDU length field in the first PDU of an SDU. */
+#define RX_CREDITS          CEIL_DIV(BLE_L2CAP_COC_MTU + SDU_LEN_FIELD_SIZE, BLE_L2CAP_COC_MPS) /**< Credits granted to the peer, enough for one full SDU. */
+
+STATIC_ASSERT(BLE_L2CAP_COC_MTU >= BLE_L2CAP_MTU_MIN);
+STATIC_ASSERT(BLE_L2CAP_COC_MPS >= BLE_L2CAP_MPS_MIN);
+STATIC_ASSERT((BLE_L2CAP_COC_TX_QUEUE_SIZE > 0) && (BLE_L2CAP_COC_TX_QUEUE_SIZE <= UINT8_MAX));
+
+
+/**@brief Function for resetting the channel state of an instance.
+ *
+ * @param[in] p_coc  Pointer to the instance.
+ */
+static void channel_reset(ble_l2cap_coc_t * p_coc)
+{
+        p_coc->local_cid  = BLE_L2CAP_CID_INVALID;
+        p_coc->tx_mtu     = 0;
+        p_coc->tx_head    = 0;
+        p_coc->tx_pending = 0;
+}
+
+
+/**@brief Function for passing an event without data to the application.
+ *
+ * @param[in] p_coc     Pointer to the instance.
+ * @param[in] evt_type  Type of the event.
+ */
+static void evt_send(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_evt_type_t evt_type)
+{
+        ble_l2cap_coc_evt_t evt;
+
+        memset(&evt, 0, sizeof(evt));
+        evt.evt_type    = evt_type;
+        evt.conn_handle = p_coc->conn_handle;
+
+        if (p_coc->evt_handler != NULL)
+        {
+                p_coc->evt_handler(p_coc, &evt);
+        }
+}
+
+
+/**@brief Function for filling in the receive parameters of a channel setup.
+ *
+ * @param[in]  p_coc     Pointer to the instance.
+ * @param[out] p_params  Setup parameters.
+ */
+static void rx_params_set(ble_l2cap_coc_t * p_coc, ble_l2cap_ch_setup_params_t * p_params)
+{
+        memset(p_params, 0, sizeof(*p_params));
+        p_params->rx_params.rx_mtu         = BLE_L2CAP_COC_MTU;
+        p_params->rx_params.rx_mps         = BLE_L2CAP_COC_MPS;
+        p_params->rx_params.sdu_buf.p_data = p_coc->rx_buf;
+        p_params->rx_params.sdu_buf.len    = sizeof(p_coc->rx_buf);
+}
+
+
+/**@brief Function for handling a channel setup request from the peer.
+ *
+ * @param[in] p_coc        Pointer to the instance.
+ * @param[in] p_l2cap_evt  L2CAP event.
+ */
+static void on_ch_setup_request(ble_l2cap_coc_t * p_coc, ble_l2cap_evt_t const * p_l2cap_evt)
+{
+        ret_code_t                  err_code;
+        ble_l2cap_ch_setup_params_t params;
+        uint16_t                    local_cid = p_l2cap_evt->local_cid;
+
+        rx_params_set(p_coc, &params);
+
+        if (p_l2cap_evt->params.ch_setup_request.le_psm != BLE_L2CAP_COC_PSM)
+        {
+                params.status = BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED;
+        }
+        else if (ble_l2cap_coc_is_connected(p_coc))
+        {
+                params.status = BLE_L2CAP_CH_STATUS_CODE_NO_RESOURCES;
+        }
+        else
+        {
+                params.status = BLE_L2CAP_CH_STATUS_CODE_SUCCESS;
+        }
+
+        err_code = sd_ble_l2cap_ch_setup(p_coc->conn_handle, &local_cid, &params);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("Channel setup response failed: 0x%x.", err_code);
+        }
+}
+
+
+/**@brief Function for handling a completed channel setup.
+ *
+ * @param[in] p_coc        Pointer to the instance.
+ * @param[in] p_l2cap_evt  L2CAP event.
+ */
+static void on_ch_setup(ble_l2cap_coc_t * p_coc, ble_l2cap_evt_t const * p_l2cap_evt)
+{
+        ret_code_t err_code;
+
+        p_coc->local_cid = p_l2cap_evt->local_cid;
+        p_coc->tx_mtu    = MIN(p_l2cap_evt->params.ch_setup.tx_params.tx_mtu, BLE_L2CAP_COC_MTU);
+
+        // Let the peer send a whole SDU without waiting for credits.
+        err_code = sd_ble_l2cap_ch_flow_control(p_coc->conn_handle, p_coc->local_cid, RX_CREDITS, NULL);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("Setting the channel credits failed: 0x%x.", err_code);
+        }
+
+        NRF_LOG_INFO("Channel 0x%x set up on link 0x%x, SDU %d bytes, PDU %d bytes.",
+                     p_coc->local_cid,
+                     p_coc->conn_handle,
+                     p_coc->tx_mtu,
+                     p_l2cap_evt->params.ch_setup.tx_params.tx_mps);
+
+        evt_send(p_coc, BLE_L2CAP_COC_EVT_CONNECTED);
+}
+
+
+/**@brief Function for handling a received SDU.
+ *
+ * @param[in] p_coc        Pointer to the instance.
+ * @param[in] p_l2cap_evt  L2CAP event.
+ */
+static void on_ch_rx(ble_l2cap_coc_t * p_coc, ble_l2cap_evt_t const * p_l2cap_evt)
+{
+        ret_code_t          err_code;
+        ble_l2cap_coc_evt_t evt;
+        ble_data_t          sdu_buf;
+
+        memset(&evt, 0, sizeof(evt));
+        evt.evt_type    = BLE_L2CAP_COC_EVT_RX_DATA;
+        evt.conn_handle = p_coc->conn_handle;
+        evt.p_data      = p_l2cap_evt->params.rx.sdu_buf.p_data;
+        evt.data_len    = p_l2cap_evt->params.rx.sdu_len;
+
+        if (p_coc->evt_handler != NULL)
+        {
+                p_coc->evt_handler(p_coc, &evt);
+        }
+
+        // The data has been consumed, hand the buffer back for the next SDU.
+        sdu_buf.p_data = p_coc->rx_buf;
+        sdu_buf.len    = sizeof(p_coc->rx_buf);
+
+        err_code = sd_ble_l2cap_ch_rx(p_coc->conn_handle, p_coc->local_cid, &sdu_buf);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("Providing the receive buffer failed: 0x%x.", err_code);
+        }
+}
+
+
+/**@brief Function for handling the release of the channel or the link.
+ *
+ * @param[in] p_coc  Pointer to the instance.
+ */
+static void on_ch_released(ble_l2cap_coc_t * p_coc)
+{
+        if (!ble_l2cap_coc_is_connected(p_coc))
+        {
+                return;
+        }
+
+        NRF_LOG_INFO("Channel 0x%x on link 0x%x released.", p_coc->local_cid, p_coc->conn_handle);
+
+        channel_reset(p_coc);
+        evt_send(p_coc, BLE_L2CAP_COC_EVT_DISCONNECTED);
+}
+
+
+ret_code_t ble_l2cap_coc_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+        ble_cfg_t ble_cfg;
+
+        memset(&ble_cfg, 0x00, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                        = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_mps        = BLE_L2CAP_COC_MPS;
+        ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_mps        = BLE_L2CAP_COC_MPS;
+        ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_queue_size = 1;
+        ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_queue_size = BLE_L2CAP_COC_TX_QUEUE_SIZE;
+        ble_cfg.conn_cfg.params.l2cap_conn_cfg.ch_count      = 1;
+
+        return sd_ble_cfg_set(BLE_CONN_CFG_L2CAP, &ble_cfg, ram_start);
+}
+
+
+ret_code_t ble_l2cap_coc_init(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_init_t const * p_init)
+{
+        VERIFY_PARAM_NOT_NULL(p_coc);
+        VERIFY_PARAM_NOT_NULL(p_init);
+
+        p_coc->conn_handle = BLE_CONN_HANDLE_INVALID;
+        p_coc->evt_handler = p_init->evt_handler;
+        channel_reset(p_coc);
+
+        return NRF_SUCCESS;
+}
+
+
+void ble_l2cap_coc_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context)
+{
+        ble_l2cap_coc_t       * p_coc       = (ble_l2cap_coc_t *)p_context;
+        ble_l2cap_evt_t const * p_l2cap_evt = &p_ble_evt->evt.l2cap_evt;
+
+        if ((p_coc == NULL) || (p_ble_evt == NULL))
+        {
+                return;
+        }
+
+        if (p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED)
+        {
+                p_coc->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+                channel_reset(p_coc);
+                return;
+        }
+
+        // All connection-oriented events carry the connection handle in the same place.
+        if ((p_coc->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+            (p_coc->conn_handle != p_l2cap_evt->conn_handle))
+        {
+                return;
+        }
+
+        switch (p_ble_evt->header.evt_id)
+        {
+        case BLE_GAP_EVT_DISCONNECTED:
+                on_ch_released(p_coc);
+                p_coc->conn_handle = BLE_CONN_HANDLE_INVALID;
+                break;
+
+        case BLE_L2CAP_EVT_CH_SETUP_REQUEST:
+                on_ch_setup_request(p_coc, p_l2cap_evt);
+                break;
+
+        case BLE_L2CAP_EVT_CH_SETUP:
+                on_ch_setup(p_coc, p_l2cap_evt);
+                break;
+
+        case BLE_L2CAP_EVT_CH_SETUP_REFUSED:
+                NRF_LOG_INFO("Channel refused by link 0x%x, status 0x%x.",
+                             p_coc->conn_handle,
+                             p_l2cap_evt->params.ch_setup_refused.status);
+                evt_send(p_coc, BLE_L2CAP_COC_EVT_REFUSED);
+                break;
+
+        case BLE_L2CAP_EVT_CH_RELEASED:
+                on_ch_released(p_coc);
+                break;
+
+        case BLE_L2CAP_EVT_CH_RX:
+                on_ch_rx(p_coc, p_l2cap_evt);
+                break;
+
+        case BLE_L2CAP_EVT_CH_TX:
+                if (p_coc->tx_pending > 0)
+                {
+                        p_coc->tx_pending--;
+                }
+                evt_send(p_coc, BLE_L2CAP_COC_EVT_TX_RDY);
+                break;
+
+        default:
+                // No implementation needed.
+                break;
+        }
+}
+
+
+ret_code_t ble_l2cap_coc_connect(ble_l2cap_coc_t * p_coc)
+{
+        ble_l2cap_ch_setup_params_t params;
+        uint16_t                    local_cid = BLE_L2CAP_CID_INVALID;
+
+        VERIFY_PARAM_NOT_NULL(p_coc);
+
+        if ((p_coc->conn_handle == BLE_CONN_HANDLE_INVALID) || ble_l2cap_coc_is_connected(p_coc))
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        rx_params_set(p_coc, &params);
+        params.le_psm = BLE_L2CAP_COC_PSM;
+
+        return sd_ble_l2cap_ch_setup(p_coc->conn_handle, &local_cid, &params);
+}
+
+
+ret_code_t ble_l2cap_coc_data_send(ble_l2cap_coc_t * p_coc, uint8_t const * p_data, uint16_t length)
+{
+        ret_code_t err_code;
+        ble_data_t sdu_buf;
+
+        VERIFY_PARAM_NOT_NULL(p_coc);
+        VERIFY_PARAM_NOT_NULL(p_data);
+
+        if (!ble_l2cap_coc_is_connected(p_coc))
+        {
+                return NRF_ERROR_INVALID_STATE;
+        }
+
+        if ((length == 0) || (length > p_coc->tx_mtu))
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        if (p_coc->tx_pending >= BLE_L2CAP_COC_TX_QUEUE_SIZE)
+        {
+                return NRF_ERROR_RESOURCES;
+        }
+
+        // Buffers are released in the order they were queued, so the next free one is at the head.
+        memcpy(p_coc->tx_buf[p_coc->tx_head], p_data, length);
+        sdu_buf.p_data = p_coc->tx_buf[p_coc->tx_head];
+        sdu_buf.len    = length;
+
+        err_code = sd_ble_l2cap_ch_tx(p_coc->conn_handle, p_coc->local_cid, &sdu_buf);
+        if (err_code == NRF_SUCCESS)
+        {
+                p_coc->tx_head = (p_coc->tx_head + 1) % BLE_L2CAP_COC_TX_QUEUE_SIZE;
+                p_coc->tx_pending++;
+        }
+
+        return err_code;
+}
+
+#endif // NRF_MODULE_ENABLED(BLE_L2CAP_COC)
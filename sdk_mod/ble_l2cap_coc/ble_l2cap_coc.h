@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ble_l2cap_coc L2CAP connection-oriented channel transport
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Data transport over one LE credit-based L2CAP channel per link.
+ *
+ * @details  An alternative to the Nordic UART Service for bulk data. Data goes directly over an
+ *           L2CAP channel, without the ATT header and without the ATT MTU limit: one SDU carries
+ *           up to @ref BLE_L2CAP_COC_MTU bytes and is segmented by the SoftDevice into PDUs of
+ *           up to @ref BLE_L2CAP_COC_MPS bytes. Flow control is credit based: the receiver grants
+ *           enough credits for one full SDU.
+ *
+ *           The API follows the NUS modules so the application can pick either transport per
+ *           link: the central opens the channel with @ref ble_l2cap_coc_connect, the peripheral
+ *           accepts requests for @ref BLE_L2CAP_COC_PSM automatically, and both sides send with
+ *           @ref ble_l2cap_coc_data_send and receive @ref BLE_L2CAP_COC_EVT_RX_DATA.
+ *
+ *           The SoftDevice does not copy L2CAP data, so every instance owns one receive buffer
+ *           and @ref BLE_L2CAP_COC_TX_QUEUE_SIZE transmit buffers of @ref BLE_L2CAP_COC_MTU bytes.
+ *           The channel itself must be configured with @ref ble_l2cap_coc_cfg_set before the
+ *           SoftDevice is enabled.
+ */
+
+#ifndef BLE_L2CAP_COC_H__
+#define BLE_L2CAP_COC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_l2cap.h"
+#include "nrf_sdh_ble.h"
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief   Macro for defining a ble_l2cap_coc instance.
+ * @param   _name   Name of the instance.
+ * @hideinitializer
+ */
+#define BLE_L2CAP_COC_DEF(_name)                                                                    \
+        static ble_l2cap_coc_t _name;                                                               \
+        NRF_SDH_BLE_OBSERVER(_name ## _obs,                                                         \
+                             BLE_L2CAP_COC_BLE_OBSERVER_PRIO,                                       \
+                             ble_l2cap_coc_on_ble_evt, &_name)
+
+
+/**@brief L2CAP channel transport event type. */
+typedef enum
+{
+        BLE_L2CAP_COC_EVT_CONNECTED,    /**< The channel has been set up and data can be sent. */
+        BLE_L2CAP_COC_EVT_REFUSED,      /**< The peer refused to set up the channel. */
+        BLE_L2CAP_COC_EVT_DISCONNECTED, /**< The channel has been released. */
+        BLE_L2CAP_COC_EVT_RX_DATA,      /**< An SDU has been received from the peer. */
+        BLE_L2CAP_COC_EVT_TX_RDY        /**< An SDU has been sent and its buffer is free again. */
+} ble_l2cap_coc_evt_type_t;
+
+/**@brief L2CAP channel transport event. */
+typedef struct
+{
+        ble_l2cap_coc_evt_type_t evt_type;    /**< Type of the event. */
+        uint16_t                 conn_handle; /**< Connection the channel belongs to. */
+        uint8_t const          * p_data;      /**< Received data, for @ref BLE_L2CAP_COC_EVT_RX_DATA. */
+        uint16_t                 data_len;    /**< Length of the received data, for @ref BLE_L2CAP_COC_EVT_RX_DATA. */
+} ble_l2cap_coc_evt_t;
+
+// Forward declaration of the ble_l2cap_coc_t type.
+typedef struct ble_l2cap_coc_s ble_l2cap_coc_t;
+
+/**@brief   Event handler type.
+ * @details This is the type of the event handler that should be provided by the application
+ *          of this module to receive events.
+ */
+typedef void (* ble_l2cap_coc_evt_handler_t)(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_evt_t const * p_evt);
+
+/**@brief L2CAP channel transport structure. */
+struct ble_l2cap_coc_s
+{
+        uint16_t                    conn_handle;   /**< Handle of the current connection. */
+        uint16_t                    local_cid;     /**< Local channel ID, BLE_L2CAP_CID_INVALID if no channel is set up. */
+        uint16_t                    tx_mtu;        /**< Largest SDU the peer accepts. */
+        uint8_t                     tx_head;       /**< Index of the next free transmit buffer. */
+        uint8_t                     tx_pending;    /**< Number of transmit buffers owned by the SoftDevice. */
+        ble_l2cap_coc_evt_handler_t evt_handler;   /**< Application event handler. */
+        uint8_t                     rx_buf[BLE_L2CAP_COC_MTU];                            /**< Receive buffer. */
+        uint8_t                     tx_buf[BLE_L2CAP_COC_TX_QUEUE_SIZE][BLE_L2CAP_COC_MTU]; /**< Transmit buffers, released in order. */
+};
+
+/**@brief L2CAP channel transport initialization structure. */
+typedef struct
+{
+        ble_l2cap_coc_evt_handler_t evt_handler; /**< Application event handler. */
+} ble_l2cap_coc_init_t;
+
+
+/**@brief Function for configuring the L2CAP channels of a connection configuration.
+ *
+ * @details Call this function after @ref nrf_sdh_ble_default_cfg_set and before
+ *          @ref nrf_sdh_ble_enable.
+ *
+ * @param[in] conn_cfg_tag  Connection configuration tag used by the links.
+ * @param[in] ram_start     Start address of the application RAM.
+ *
+ * @retval NRF_SUCCESS If the configuration was set. Otherwise, the error code returned by
+ *                     @ref sd_ble_cfg_set is propagated.
+ */
+ret_code_t ble_l2cap_coc_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+
+/**@brief Function for initializing an L2CAP channel transport instance.
+ *
+ * @param[out] p_coc   Pointer to the instance.
+ * @param[in]  p_init  Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the instance was initialized.
+ * @retval NRF_ERROR_NULL If a NULL pointer was passed.
+ */
+ret_code_t ble_l2cap_coc_init(ble_l2cap_coc_t * p_coc, ble_l2cap_coc_init_t const * p_init);
+
+
+/**@brief Function for handling BLE events from the SoftDevice.
+ *
+ * @param[in] p_ble_evt  Pointer to the BLE event.
+ * @param[in] p_context  Pointer to the instance.
+ */
+void ble_l2cap_coc_on_ble_evt(ble_evt_t const * p_ble_evt, void * p_context);
+
+
+/**@brief Function for requesting the peer to set up the channel.
+ *
+ * @details Used by the central once the link is established. @ref BLE_L2CAP_COC_EVT_CONNECTED
+ *          or @ref BLE_L2CAP_COC_EVT_REFUSED follows.
+ *
+ * @param[in] p_coc  Pointer to the instance.
+ *
+ * @retval NRF_SUCCESS             If the request was sent.
+ * @retval NRF_ERROR_INVALID_STATE If there is no link or the channel is already set up.
+ * @return Otherwise, the error code returned by @ref sd_ble_l2cap_ch_setup.
+ */
+ret_code_t ble_l2cap_coc_connect(ble_l2cap_coc_t * p_coc);
+
+
+/**@brief Function for sending data to the peer.
+ *
+ * @details The data is copied into a transmit buffer of the instance and sent as one SDU.
+ *
+ * @param[in] p_coc   Pointer to the instance.
+ * @param[in] p_data  Data to send.
+ * @param[in] length  Length of the data, at most the SDU size of the peer.
+ *
+ * @retval NRF_SUCCESS              If the data was queued.
+ * @retval NRF_ERROR_INVALID_STATE  If the channel is not set up.
+ * @retval NRF_ERROR_INVALID_LENGTH If the data does not fit in one SDU.
+ * @retval NRF_ERROR_RESOURCES      If all transmit buffers are in use. Wait for
+ *                                  @ref BLE_L2CAP_COC_EVT_TX_RDY.
+ * @return Otherwise, the error code returned by @ref sd_ble_l2cap_ch_tx.
+ */
+ret_code_t ble_l2cap_coc_data_send(ble_l2cap_coc_t * p_coc, uint8_t const * p_data, uint16_t length);
+
+
+/**@brief Function for checking whether the channel is set up.
+ *
+ * @param[in] p_coc  Pointer to the instance.
+ *
+ * @return True if data can be sent over the channel.
+ */
+static __INLINE bool ble_l2cap_coc_is_connected(ble_l2cap_coc_t const * p_coc)
+{
+        return (p_coc->local_cid != BLE_L2CAP_CID_INVALID);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_L2CAP_COC_H__
+
+/** @} */
@@ -86,14 +86,15 @@ static void on_connect(ble_nus_t * p_nus, ble_evt_t const * p_ble_evt)
                       p_ble_evt->evt.gap_evt.conn_handle);
     }
 
-    /* Check the hosts CCCD value to inform of readiness to send data using the RX characteristic */
+    /* Check the hosts CCCD value to inform of readiness to send data using the TX characteristic.
+     * A bonded host does not write it again, the Peer Manager restored it on the connection. */
     memset(&gatts_val, 0, sizeof(ble_gatts_value_t));
     gatts_val.p_value = cccd_value;
     gatts_val.len     = sizeof(cccd_value);
     gatts_val.offset  = 0;
 
     err_code = sd_ble_gatts_value_get(p_ble_evt->evt.gap_evt.conn_handle,
-                                      p_nus->rx_handles.cccd_handle,
+                                      p_nus->tx_handles.cccd_handle,
                                       &gatts_val);
 
     if ((err_code == NRF_SUCCESS)     &&
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(BLE_RAM_CFG)
+#include <string.h>
+#include "ble.h"
+#include "ble_ram_cfg.h"
+
+#define NRF_LOG_MODULE_NAME ble_ram_cfg
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RAM_BASE        0x20000000UL    /**< Start of the RAM, below any RAM start the SoftDevice accepts. */
+
+static uint32_t m_ram_min;              /**< Lowest RAM start accepted at the previous probe. */
+
+
+/**@brief Function for finding the lowest application RAM start the SoftDevice accepts for its
+ *        configuration so far.
+ *
+ * @param[in] ram_start  Start address of the application RAM, accepted.
+ *
+ * @return Lowest RAM start accepted, 0 if not even @p ram_start is.
+ */
+static uint32_t ram_min_find(uint32_t ram_start)
+{
+        ble_cfg_t ble_cfg;
+        uint32_t  lo = RAM_BASE;
+        uint32_t  hi = ram_start;
+
+        // nrf_sdh_ble_default_cfg_set() made the same setting.
+        memset(&ble_cfg, 0x00, sizeof(ble_cfg));
+        ble_cfg.common_cfg.vs_uuid_cfg.vs_uuid_count = NRF_SDH_BLE_VS_UUID_COUNT;
+
+        if (sd_ble_cfg_set(BLE_COMMON_CFG_VS_UUID, &ble_cfg, hi) != NRF_SUCCESS)
+        {
+                return 0;
+        }
+
+        // hi is accepted and lo is not, both stay word aligned.
+        while (hi - lo > sizeof(uint32_t))
+        {
+                uint32_t mid = lo + (((hi - lo) / 2) & ~(sizeof(uint32_t) - 1));
+
+                if (sd_ble_cfg_set(BLE_COMMON_CFG_VS_UUID, &ble_cfg, mid) == NRF_SUCCESS)
+                {
+                        hi = mid;
+                }
+                else
+                {
+                        lo = mid;
+                }
+        }
+
+        // Leave the setting made at the actual RAM start.
+        (void)sd_ble_cfg_set(BLE_COMMON_CFG_VS_UUID, &ble_cfg, ram_start);
+
+        return hi;
+}
+
+
+void ble_ram_cfg_init(uint32_t ram_start)
+{
+        m_ram_min = ram_min_find(ram_start);
+
+        NRF_LOG_INFO("SoftDevice RAM: default configuration up to 0x%x.", m_ram_min);
+}
+
+
+void ble_ram_cfg_probe(char const * p_setting, uint32_t ram_start)
+{
+        uint32_t ram_min = ram_min_find(ram_start);
+
+        if (ram_min == 0)
+        {
+                NRF_LOG_WARNING("SoftDevice RAM: %s needs RAM start above 0x%x.", p_setting, ram_start);
+                return;
+        }
+
+        NRF_LOG_INFO("SoftDevice RAM: %s takes %d bytes, up to 0x%x.",
+                     p_setting, (int32_t)(ram_min - m_ram_min), ram_min);
+
+        m_ram_min = ram_min;
+}
+
+
+ret_code_t ble_ram_cfg_conn_queues_set(uint8_t conn_cfg_tag, uint32_t ram_start)
+{
+        ret_code_t err_code;
+        ble_cfg_t  ble_cfg;
+
+        memset(&ble_cfg, 0x00, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                            = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = APP_HVN_TX_QUEUE_SIZE;
+        err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+        VERIFY_SUCCESS(err_code);
+
+        ble_ram_cfg_probe("HVN TX queue", ram_start);
+
+        memset(&ble_cfg, 0x00, sizeof(ble_cfg));
+        ble_cfg.conn_cfg.conn_cfg_tag                                  = conn_cfg_tag;
+        ble_cfg.conn_cfg.params.gattc_conn_cfg.write_cmd_tx_queue_size = APP_WRITE_CMD_TX_QUEUE_SIZE;
+        err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTC, &ble_cfg, ram_start);
+        VERIFY_SUCCESS(err_code);
+
+        ble_ram_cfg_probe("Write Command TX queue", ram_start);
+
+        return NRF_SUCCESS;
+}
+
+
+void ble_ram_cfg_log(uint32_t ram_start_link, uint32_t ram_start_min)
+{
+        NRF_LOG_INFO("Queues per link: %d HVN TX, %d Write Command TX.",
+                     APP_HVN_TX_QUEUE_SIZE, APP_WRITE_CMD_TX_QUEUE_SIZE);
+        NRF_LOG_INFO("SoftDevice RAM ends at 0x%x, %d bytes unused below RAM start 0x%x.",
+                     ram_start_min, ram_start_link - ram_start_min, ram_start_link);
+}
+
+#endif // NRF_MODULE_ENABLED(BLE_RAM_CFG)
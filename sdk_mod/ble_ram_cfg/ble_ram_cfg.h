@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ble_ram_cfg SoftDevice RAM per BLE setting
+ * @{
+ * @brief    Sizes the per-link SoftDevice TX queues and logs the RAM every BLE setting takes.
+ *
+ * @details  sd_ble_cfg_set() refuses a setting with NRF_ERROR_NO_MEM when the application RAM
+ *           start it is given leaves the SoftDevice too little room for the configuration so far.
+ *           @ref ble_ram_cfg_probe finds the lowest RAM start still accepted by setting again the
+ *           vendor specific UUID count of the default configuration, which changes nothing, at
+ *           RAM starts found by bisection. The difference to the previous probe is the RAM the
+ *           settings made in between take, and is logged with their name.
+ *
+ *           Probing takes about a dozen sd_ble_cfg_set() calls, before the SoftDevice is enabled.
+ *
+ * @note     Without BLE_RAM_CFG_ENABLED in sdk_config.h the queues keep the SoftDevice default of
+ *           one entry and nothing is logged.
+ */
+
+#ifndef BLE_RAM_CFG_H__
+#define BLE_RAM_CFG_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NRF_MODULE_ENABLED(BLE_RAM_CFG)
+
+/**@brief Function for taking the RAM of the default configuration as the base of the probes.
+ *
+ * @details Call it after nrf_sdh_ble_default_cfg_set().
+ *
+ * @param[in] ram_start  Start address of the application RAM.
+ */
+void ble_ram_cfg_init(uint32_t ram_start);
+
+
+/**@brief Function for sizing the per-link TX queues of a connection configuration, with
+ *        @ref APP_HVN_TX_QUEUE_SIZE and @ref APP_WRITE_CMD_TX_QUEUE_SIZE entries.
+ *
+ * @details Larger queues let more packets go out in one connection event. The queues are
+ *          reserved for every link using the tag, the RAM of each queue is probed and logged.
+ *
+ * @param[in] conn_cfg_tag  Connection configuration tag.
+ * @param[in] ram_start     Start address of the application RAM.
+ *
+ * @retval NRF_SUCCESS If the queues were sized.
+ * @return Otherwise, the error code returned by sd_ble_cfg_set().
+ */
+ret_code_t ble_ram_cfg_conn_queues_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+
+
+/**@brief Function for logging the RAM taken by the settings made since the previous probe.
+ *
+ * @param[in] p_setting  Name of the settings, a string constant.
+ * @param[in] ram_start  Start address of the application RAM.
+ */
+void ble_ram_cfg_probe(char const * p_setting, uint32_t ram_start);
+
+
+/**@brief Function for logging the queue sizes and the RAM left unused by the SoftDevice.
+ *
+ * @param[in] ram_start_link  Start address of the application RAM from the linker settings.
+ * @param[in] ram_start_min   Lowest application RAM start the SoftDevice accepts, from
+ *                            nrf_sdh_ble_enable().
+ */
+void ble_ram_cfg_log(uint32_t ram_start_link, uint32_t ram_start_min);
+
+#else
+
+#define ble_ram_cfg_init(_ram_start)
+#define ble_ram_cfg_conn_queues_set(_conn_cfg_tag, _ram_start)  NRF_SUCCESS
+#define ble_ram_cfg_probe(_p_setting, _ram_start)
+#define ble_ram_cfg_log(_ram_start_link, _ram_start_min)
+
+#endif // NRF_MODULE_ENABLED(BLE_RAM_CFG)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_RAM_CFG_H__
+
+/** @} */
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(HRS_BCAST) || NRF_MODULE_ENABLED(BCAST_RX)
+#include <string.h>
+
+#include "hrs_bcast.h"
+#include "ble_gap.h"
+#include "ble_advdata.h"
+
+
+void hrs_bcast_enc_init(hrs_bcast_enc_t * p_enc)
+{
+        memset(p_enc, 0, sizeof(*p_enc));
+        p_enc->rr_min = UINT16_MAX;
+}
+
+
+void hrs_bcast_enc_rr_add(hrs_bcast_enc_t * p_enc, uint16_t rr_interval)
+{
+        if (p_enc->rr_cnt == UINT8_MAX)
+        {
+                return;
+        }
+
+        p_enc->rr_cnt++;
+        p_enc->rr_sum += rr_interval;
+        p_enc->rr_min  = MIN(p_enc->rr_min, rr_interval);
+        p_enc->rr_max  = MAX(p_enc->rr_max, rr_interval);
+}
+
+
+void hrs_bcast_enc_batt_set(hrs_bcast_enc_t * p_enc, uint8_t batt_level)
+{
+        p_enc->batt_level = batt_level;
+}
+
+
+void hrs_bcast_enc_flag_set(hrs_bcast_enc_t * p_enc, uint8_t flag, bool set)
+{
+        if (set)
+        {
+                p_enc->flags |= flag;
+        }
+        else
+        {
+                p_enc->flags &= ~flag;
+        }
+}
+
+
+void hrs_bcast_enc_meas(hrs_bcast_enc_t * p_enc, uint16_t hr_value, uint8_t * p_data)
+{
+        uint16_t len = 0;
+        bool     rr  = (p_enc->rr_cnt != 0);
+
+        p_data[len++] = HRS_BCAST_VERSION;
+        p_data[len++] = p_enc->seq;
+        p_data[len++] = p_enc->flags;
+        len          += uint16_encode(hr_value, &p_data[len]);
+        p_data[len++] = p_enc->batt_level;
+        p_data[len++] = p_enc->rr_cnt;
+        len          += uint16_encode(rr ? (uint16_t)(p_enc->rr_sum / p_enc->rr_cnt) : 0, &p_data[len]);
+        len          += uint16_encode(rr ? p_enc->rr_min : 0, &p_data[len]);
+        len          += uint16_encode(rr ? p_enc->rr_max : 0, &p_data[len]);
+
+        ASSERT(len == HRS_BCAST_DATA_LEN);
+
+        p_enc->seq++;
+        p_enc->rr_cnt = 0;
+        p_enc->rr_sum = 0;
+        p_enc->rr_min = UINT16_MAX;
+        p_enc->rr_max = 0;
+}
+
+
+ret_code_t hrs_bcast_decode(uint8_t const * p_adv, uint16_t len, hrs_bcast_meas_t * p_meas)
+{
+        uint16_t        offset = 0;
+        uint16_t        field_len;
+        uint8_t const * p_data;
+
+        field_len = ble_advdata_search(p_adv, len, &offset, BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA);
+
+        // Other devices use the company identifier too, the version byte and length tell ours.
+        if ((field_len != 2 + HRS_BCAST_DATA_LEN) ||
+            (uint16_decode(&p_adv[offset]) != HRS_BCAST_COMPANY_ID) ||
+            (p_adv[offset + 2] != HRS_BCAST_VERSION))
+        {
+                return NRF_ERROR_NOT_FOUND;
+        }
+
+        p_data = &p_adv[offset + 3];
+
+        p_meas->seq        = p_data[0];
+        p_meas->flags      = p_data[1];
+        p_meas->hr_value   = uint16_decode(&p_data[2]);
+        p_meas->batt_level = p_data[4];
+        p_meas->rr_cnt     = p_data[5];
+        p_meas->rr_mean    = uint16_decode(&p_data[6]);
+        p_meas->rr_min     = uint16_decode(&p_data[8]);
+        p_meas->rr_max     = uint16_decode(&p_data[10]);
+
+        return NRF_SUCCESS;
+}
+
+#endif // NRF_MODULE_ENABLED(HRS_BCAST) || NRF_MODULE_ENABLED(BCAST_RX)
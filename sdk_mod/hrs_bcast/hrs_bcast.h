@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup hrs_bcast Heart rate broadcast codec
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Carries heart rate measurements in the manufacturer specific data of advertisements.
+ *
+ * @details  A sensor in broadcast mode does not accept connections. Every measurement updates
+ *           the manufacturer specific data of its non-connectable advertisements, so any number
+ *           of collectors can follow any number of sensors while scanning. The data, after the
+ *           company identifier, is:
+ *
+ *           @code
+ *           | ver (1) | seq (1) | flags (1) | HR (2) | battery (1) |
+ *           | RR count (1) | RR mean (2) | RR min (2) | RR max (2) |
+ *           @endcode
+ *
+ *           Multi-byte fields are little endian. seq counts the measurements, a collector sees
+ *           each of them in several advertisements and tells new ones by it. The RR fields sum up
+ *           the RR intervals since the previous measurement, in 1/1024 seconds. They are 0 when
+ *           the RR count is 0.
+ */
+
+#ifndef HRS_BCAST_H__
+#define HRS_BCAST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HRS_BCAST_COMPANY_ID    0x0059  /**< Company identifier of the manufacturer specific data, Nordic Semiconductor. */
+#define HRS_BCAST_VERSION       0x01    /**< Version of the data layout. */
+#define HRS_BCAST_DATA_LEN      13      /**< Length of the data after the company identifier. */
+
+#define HRS_BCAST_FLAG_CONTACT  0x01    /**< Sensor contact detected. */
+
+/**@brief Content of one broadcast measurement. */
+typedef struct
+{
+        uint8_t  seq;           /**< Measurement sequence number. */
+        uint8_t  flags;         /**< HRS_BCAST_FLAG_* bits. */
+        uint16_t hr_value;      /**< Heart rate in beats per minute. */
+        uint8_t  batt_level;    /**< Battery level in percent. */
+        uint8_t  rr_cnt;        /**< RR intervals since the previous measurement. */
+        uint16_t rr_mean;       /**< Mean of the RR intervals. */
+        uint16_t rr_min;        /**< Shortest RR interval. */
+        uint16_t rr_max;        /**< Longest RR interval. */
+} hrs_bcast_meas_t;
+
+/**@brief Encoder, collects the values between two measurements. */
+typedef struct
+{
+        uint8_t  seq;           /**< Sequence number of the next measurement. */
+        uint8_t  flags;         /**< Current HRS_BCAST_FLAG_* bits. */
+        uint8_t  batt_level;    /**< Latest battery level. */
+        uint8_t  rr_cnt;        /**< RR intervals collected. */
+        uint32_t rr_sum;        /**< Sum of the RR intervals collected. */
+        uint16_t rr_min;        /**< Shortest RR interval collected. */
+        uint16_t rr_max;        /**< Longest RR interval collected. */
+} hrs_bcast_enc_t;
+
+
+/**@brief Function for initializing an encoder.
+ *
+ * @param[out] p_enc  Encoder.
+ */
+void hrs_bcast_enc_init(hrs_bcast_enc_t * p_enc);
+
+
+/**@brief Function for adding an RR interval to the next measurement.
+ *
+ * @param[in] p_enc        Encoder.
+ * @param[in] rr_interval  RR interval in 1/1024 seconds.
+ */
+void hrs_bcast_enc_rr_add(hrs_bcast_enc_t * p_enc, uint16_t rr_interval);
+
+
+/**@brief Function for setting the battery level of the next measurements.
+ *
+ * @param[in] p_enc       Encoder.
+ * @param[in] batt_level  Battery level in percent.
+ */
+void hrs_bcast_enc_batt_set(hrs_bcast_enc_t * p_enc, uint8_t batt_level);
+
+
+/**@brief Function for setting or clearing flags of the next measurements.
+ *
+ * @param[in] p_enc  Encoder.
+ * @param[in] flag   HRS_BCAST_FLAG_* bit.
+ * @param[in] set    True to set the flag.
+ */
+void hrs_bcast_enc_flag_set(hrs_bcast_enc_t * p_enc, uint8_t flag, bool set);
+
+
+/**@brief Function for encoding a measurement and starting the next one.
+ *
+ * @param[in]  p_enc     Encoder.
+ * @param[in]  hr_value  Heart rate.
+ * @param[out] p_data    Buffer of @ref HRS_BCAST_DATA_LEN bytes for the data after the company
+ *                       identifier.
+ */
+void hrs_bcast_enc_meas(hrs_bcast_enc_t * p_enc, uint16_t hr_value, uint8_t * p_data);
+
+
+/**@brief Function for finding and decoding a measurement in advertising data.
+ *
+ * @param[in]  p_adv   Advertising data, as in an advertising report.
+ * @param[in]  len     Length of the advertising data.
+ * @param[out] p_meas  Decoded measurement.
+ *
+ * @retval NRF_SUCCESS          If a measurement was decoded.
+ * @retval NRF_ERROR_NOT_FOUND  If the data holds no measurement of a supported version.
+ */
+ret_code_t hrs_bcast_decode(uint8_t const * p_adv, uint16_t len, hrs_bcast_meas_t * p_meas);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HRS_BCAST_H__
+
+/** @} */
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(LESC_PROF)
+#include <string.h>
+#include "lesc_prof.h"
+#include "app_util_platform.h"
+
+#define NRF_LOG_MODULE_NAME lesc_prof
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define CYCLES_PER_US           (SystemCoreClock / 1000000)     /**< CPU cycles per microsecond. */
+
+/**@brief Diffie-Hellman key statistics. */
+typedef struct
+{
+        uint32_t dhkeys;                        /**< Keys computed. */
+        uint32_t runs;                          /**< Handler runs that computed at least one key. */
+        uint32_t run_cyc;                       /**< Cycles spent in those runs. */
+        uint32_t run_max_cyc;                   /**< Longest of those runs. */
+        uint32_t wait_cyc;                      /**< Sum over the runs of the wait of the oldest request. */
+        uint32_t wait_max_cyc;                  /**< Longest wait of a request for its reply. */
+} lesc_prof_stats_t;
+
+static uint32_t          m_keygen_cyc;          /**< Cycles taken by the Peer Manager initialization. */
+static lesc_prof_stats_t m_stats;               /**< Statistics since the last reset. */
+static uint32_t          m_pending;             /**< Requests raised since the handler last ran. */
+static uint32_t          m_request_cyc;         /**< Time of the oldest of those requests. */
+
+
+void lesc_prof_init(void)
+{
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+void lesc_prof_keygen_record(uint32_t start_cyc)
+{
+        m_keygen_cyc = DWT->CYCCNT - start_cyc;
+}
+
+
+void lesc_prof_dhkey_request(void)
+{
+        CRITICAL_REGION_ENTER();
+        if (m_pending++ == 0)
+        {
+                m_request_cyc = DWT->CYCCNT;
+        }
+        CRITICAL_REGION_EXIT();
+}
+
+
+ret_code_t lesc_prof_request_handler(void)
+{
+        ret_code_t err_code;
+        uint32_t   pending;
+        uint32_t   request_cyc;
+        uint32_t   start_cyc;
+        uint32_t   run_cyc;
+        uint32_t   wait_cyc;
+
+        CRITICAL_REGION_ENTER();
+        pending     = m_pending;
+        request_cyc = m_request_cyc;
+        m_pending   = 0;
+        CRITICAL_REGION_EXIT();
+
+        if (pending == 0)
+        {
+                return nrf_ble_lesc_request_handler();
+        }
+
+        start_cyc = DWT->CYCCNT;
+        err_code  = nrf_ble_lesc_request_handler();
+        run_cyc   = DWT->CYCCNT - start_cyc;
+        wait_cyc  = DWT->CYCCNT - request_cyc;
+
+        m_stats.dhkeys      += pending;
+        m_stats.runs        += 1;
+        m_stats.run_cyc     += run_cyc;
+        m_stats.run_max_cyc  = MAX(m_stats.run_max_cyc, run_cyc);
+        m_stats.wait_cyc    += wait_cyc;
+        m_stats.wait_max_cyc = MAX(m_stats.wait_max_cyc, wait_cyc);
+
+        return err_code;
+}
+
+
+void lesc_prof_stats_log(void)
+{
+        NRF_LOG_INFO("LESC: Peer Manager init with key pair generation %d us.",
+                     m_keygen_cyc / CYCLES_PER_US);
+
+        if (m_stats.runs == 0)
+        {
+                NRF_LOG_INFO("LESC: no DHKey computed.");
+                return;
+        }
+
+        NRF_LOG_INFO("LESC: %d DHKeys in %d runs, %d us per key, run max %d us.",
+                     m_stats.dhkeys,
+                     m_stats.runs,
+                     m_stats.run_cyc / m_stats.dhkeys / CYCLES_PER_US,
+                     m_stats.run_max_cyc / CYCLES_PER_US);
+        NRF_LOG_INFO("LESC: request to reply avg %d us, max %d us.",
+                     m_stats.wait_cyc / m_stats.runs / CYCLES_PER_US,
+                     m_stats.wait_max_cyc / CYCLES_PER_US);
+}
+
+
+void lesc_prof_stats_reset(void)
+{
+        memset(&m_stats, 0, sizeof(m_stats));
+}
+
+#endif // NRF_MODULE_ENABLED(LESC_PROF)
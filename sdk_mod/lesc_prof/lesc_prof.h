@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup lesc_prof LE Secure Connections profiler
+ * @{
+ * @brief    Cost of the LE Secure Connections cryptography.
+ *
+ * @details  The P-256 key pair is generated once, by the Peer Manager when it is initialized, and
+ *           used for every pairing. What is left for each pairing is the Diffie-Hellman key, which
+ *           nrf_ble_lesc_request_handler() computes for the requests the SoftDevice raised since
+ *           it last ran. The application calls it from its lowest priority context through
+ *           @ref lesc_prof_request_handler, and the module measures with the DWT cycle counter
+ *           how long the computations take and how long a request waits for its reply.
+ *
+ *           Requests raised while the handler runs are counted with its next run.
+ *
+ * @note     Without LESC_PROF_ENABLED in sdk_config.h, @ref lesc_prof_request_handler only calls
+ *           nrf_ble_lesc_request_handler() and the other functions compile to nothing.
+ */
+
+#ifndef LESC_PROF_H__
+#define LESC_PROF_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "nrf_ble_lesc.h"
+#include "nrf.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NRF_MODULE_ENABLED(LESC_PROF)
+
+/**@brief Function for starting the cycle counter. Call it before the Peer Manager is initialized. */
+void lesc_prof_init(void);
+
+
+/**@brief Function for recording the time taken by the Peer Manager initialization, which
+ *        generates the key pair.
+ *
+ * @param[in] start_cyc  Value of the cycle counter before pm_init() was called.
+ */
+void lesc_prof_keygen_record(uint32_t start_cyc);
+
+
+/**@brief Function for counting a BLE_GAP_EVT_LESC_DHKEY_REQUEST event. Safe from any context. */
+void lesc_prof_dhkey_request(void);
+
+
+/**@brief Function for computing the pending Diffie-Hellman keys.
+ *
+ * @details Calls nrf_ble_lesc_request_handler(), and measures it when requests are pending.
+ *
+ * @return  The return value of nrf_ble_lesc_request_handler().
+ */
+ret_code_t lesc_prof_request_handler(void);
+
+
+/**@brief Function for writing the statistics to the log. */
+void lesc_prof_stats_log(void);
+
+
+/**@brief Function for clearing the statistics, except the key pair generation time. */
+void lesc_prof_stats_reset(void);
+
+
+/**@brief Macro for taking the timestamp before pm_init(). */
+#define LESC_PROF_KEYGEN_BEGIN()        uint32_t lesc_prof_start_cyc__ = DWT->CYCCNT
+
+/**@brief Macro for recording the Peer Manager initialization started with @ref LESC_PROF_KEYGEN_BEGIN. */
+#define LESC_PROF_KEYGEN_END()          lesc_prof_keygen_record(lesc_prof_start_cyc__)
+
+#else
+
+#define lesc_prof_init()
+#define LESC_PROF_KEYGEN_BEGIN()
+#define LESC_PROF_KEYGEN_END()
+#define lesc_prof_dhkey_request()
+#define lesc_prof_request_handler()     nrf_ble_lesc_request_handler()
+#define lesc_prof_stats_log()
+#define lesc_prof_stats_reset()
+
+#endif // NRF_MODULE_ENABLED(LESC_PROF)
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LESC_PROF_H__
+
+/** @} */
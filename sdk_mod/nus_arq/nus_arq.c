@@ -0,0 +1,570 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(NUS_ARQ)
+#include <string.h>
+
+#include "nus_arq.h"
+#include "app_util_platform.h"
+
+#define NRF_LOG_MODULE_NAME nus_arq
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define RX_ASM_DISCARD      UINT16_MAX                          /**< Assembly length marking a frame that is too long, dropped up to its end. */
+#define WINDOW_MASK(_n)     (((_n) >= 32) ? UINT32_MAX : ((1UL << (_n)) - 1)) /**< Bitmap of the first _n frames of the window. */
+
+STATIC_ASSERT((NUS_ARQ_WINDOW >= 2) && (NUS_ARQ_WINDOW <= 32));
+STATIC_ASSERT(NUS_ARQ_FRAME_MAX <= NUS_MUX_MSG_MAX);
+STATIC_ASSERT(NUS_ARQ_LOSS_PERMILLE < 1000);
+
+#if NUS_ARQ_LOSS_PERMILLE > 0
+static uint32_t m_rand = 0x2545F491;                            /**< State of the loss injection generator. */
+#endif
+
+
+/**@brief Function for deciding whether a received frame is dropped on purpose.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ *
+ * @return True if the frame must be dropped.
+ */
+static bool loss_inject(nus_arq_t * p_arq)
+{
+#if NUS_ARQ_LOSS_PERMILLE > 0
+        // xorshift32, good enough to spread the losses.
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 17;
+        m_rand ^= m_rand << 5;
+
+        if ((m_rand % 1000) < NUS_ARQ_LOSS_PERMILLE)
+        {
+                p_arq->stats.rx_dropped++;
+                return true;
+        }
+#else
+        UNUSED_PARAMETER(p_arq);
+#endif
+        return false;
+}
+
+
+/**@brief Function for queueing a frame of the window in the multiplexer.
+ *
+ * @details Called with the window locked, the multiplexer only copies the frame. The caller
+ *          starts transmission with @ref nus_mux_tx_process once the window is unlocked. A
+ *          retransmission the multiplexer cannot take is sent again on timeout.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ * @param[in] seq    Sequence number of the frame.
+ *
+ * @return True if the multiplexer took the frame.
+ */
+static bool frame_tx(nus_arq_t * p_arq, uint8_t seq)
+{
+        uint8_t idx = seq % NUS_ARQ_WINDOW;
+
+        return (nus_mux_queue(p_arq->p_mux, NUS_MUX_CH_DATA,
+                              p_arq->tx_buf[idx], p_arq->tx_len[idx], true) == NRF_SUCCESS);
+}
+
+
+/**@brief Function for queueing frames in the multiplexer until it is full.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+static void tx_pump(nus_arq_t * p_arq)
+{
+        while ((p_arq->tx_sent != p_arq->tx_next) && frame_tx(p_arq, p_arq->tx_sent))
+        {
+                p_arq->tx_sent++;
+        }
+}
+
+
+/**@brief Function for (re)starting the retransmission timer.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+static void rto_restart(nus_arq_t * p_arq)
+{
+        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->rto_timer));
+        UNUSED_RETURN_VALUE(app_timer_start(p_arq->rto_timer, APP_TIMER_TICKS(NUS_ARQ_RTO_MS), p_arq));
+}
+
+
+/**@brief Function for sending an acknowledgement of the receive state.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+static void ack_send(nus_arq_t * p_arq)
+{
+        uint8_t    ack[NUS_ARQ_ACK_LEN];
+        ret_code_t err_code;
+
+        ack[0] = NUS_MUX_OP_ARQ_ACK;
+        ack[1] = p_arq->rx_next;
+        UNUSED_RETURN_VALUE(uint32_encode(p_arq->rx_held >> 1, &ack[2]));
+
+        p_arq->rx_unacked = 0;
+        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->ack_timer));
+
+        err_code = nus_mux_send(p_arq->p_mux, NUS_MUX_CH_CTRL, ack, sizeof(ack), true);
+        if (err_code != NRF_SUCCESS)
+        {
+                // The peer retransmits on timeout and gets a new acknowledgement.
+                NRF_LOG_DEBUG("Acknowledgement dropped: 0x%x.", err_code);
+        }
+}
+
+
+/**@brief Function for passing received data to the application.
+ *
+ * @param[in] p_arq    Pointer to the instance.
+ * @param[in] p_frame  Frame, starting with the sequence number.
+ * @param[in] len      Length of the frame.
+ */
+static void frame_deliver(nus_arq_t * p_arq, uint8_t const * p_frame, uint16_t len)
+{
+        nus_arq_evt_t evt;
+
+        p_arq->stats.rx_frames++;
+
+        if (p_arq->evt_handler == NULL)
+        {
+                return;
+        }
+
+        memset(&evt, 0, sizeof(evt));
+        evt.type   = NUS_ARQ_EVT_RX_DATA;
+        evt.p_data = &p_frame[NUS_ARQ_SEQ_LEN];
+        evt.len    = len - NUS_ARQ_SEQ_LEN;
+
+        p_arq->evt_handler(p_arq, &evt);
+}
+
+
+/**@brief Function for handling a complete data frame.
+ *
+ * @param[in] p_arq    Pointer to the instance.
+ * @param[in] p_frame  Frame, starting with the sequence number.
+ * @param[in] len      Length of the frame, more than @ref NUS_ARQ_SEQ_LEN.
+ */
+static void frame_rx(nus_arq_t * p_arq, uint8_t const * p_frame, uint16_t len)
+{
+        uint8_t seq = p_frame[0];
+        uint8_t off = (uint8_t)(seq - p_arq->rx_next);
+
+        if (off >= NUS_ARQ_WINDOW)
+        {
+                // Already delivered, the acknowledgement was lost.
+                p_arq->stats.rx_dup++;
+                ack_send(p_arq);
+                return;
+        }
+
+        if (off > 0)
+        {
+                uint8_t idx = seq % NUS_ARQ_WINDOW;
+
+                if (p_arq->rx_held & (1UL << off))
+                {
+                        p_arq->stats.rx_dup++;
+                }
+                else
+                {
+                        memcpy(p_arq->rx_buf[idx], p_frame, len);
+                        p_arq->rx_len[idx]  = len;
+                        p_arq->rx_held     |= (1UL << off);
+                        p_arq->stats.rx_ooo++;
+                }
+
+                // Report the gap right away so the sender can fill it.
+                ack_send(p_arq);
+                return;
+        }
+
+        frame_deliver(p_arq, p_frame, len);
+        p_arq->rx_next++;
+        p_arq->rx_held >>= 1;
+        p_arq->rx_unacked++;
+
+        // Frames held behind the one just received are now in order.
+        while (p_arq->rx_held & 1)
+        {
+                uint8_t idx = p_arq->rx_next % NUS_ARQ_WINDOW;
+
+                frame_deliver(p_arq, p_arq->rx_buf[idx], p_arq->rx_len[idx]);
+                p_arq->rx_next++;
+                p_arq->rx_held >>= 1;
+                p_arq->rx_unacked++;
+        }
+
+        if ((p_arq->rx_held != 0) || (p_arq->rx_unacked >= NUS_ARQ_WINDOW / 2))
+        {
+                ack_send(p_arq);
+        }
+        else if (p_arq->rx_unacked == 1)
+        {
+                UNUSED_RETURN_VALUE(app_timer_start(p_arq->ack_timer,
+                                                    APP_TIMER_TICKS(NUS_ARQ_ACK_DELAY_MS),
+                                                    p_arq));
+        }
+}
+
+
+/**@brief Function for handling the retransmission timeout.
+ *
+ * @param[in] p_context  Pointer to the instance.
+ */
+static void rto_timeout_handler(void * p_context)
+{
+        nus_arq_t * p_arq = (nus_arq_t *)p_context;
+
+        CRITICAL_REGION_ENTER();
+
+        uint8_t sent = (uint8_t)(p_arq->tx_sent - p_arq->tx_base);
+
+        p_arq->tx_retx = 0;
+
+        for (uint8_t i = 0; i < sent; i++)
+        {
+                if (((p_arq->tx_acked & (1UL << i)) == 0) && frame_tx(p_arq, p_arq->tx_base + i))
+                {
+                        p_arq->stats.retx_rto++;
+                }
+        }
+
+        tx_pump(p_arq);
+
+        if (p_arq->tx_next != p_arq->tx_base)
+        {
+                rto_restart(p_arq);
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        nus_mux_tx_process(p_arq->p_mux);
+}
+
+
+/**@brief Function for handling the delayed acknowledgement timeout.
+ *
+ * @param[in] p_context  Pointer to the instance.
+ */
+static void ack_timeout_handler(void * p_context)
+{
+        nus_arq_t * p_arq = (nus_arq_t *)p_context;
+
+        if (p_arq->rx_unacked > 0)
+        {
+                ack_send(p_arq);
+        }
+}
+
+
+ret_code_t nus_arq_init(nus_arq_t * p_arq, nus_arq_init_t const * p_init)
+{
+        ret_code_t err_code;
+
+        VERIFY_PARAM_NOT_NULL(p_arq);
+        VERIFY_PARAM_NOT_NULL(p_init);
+        VERIFY_PARAM_NOT_NULL(p_init->p_mux);
+
+        memset(&p_arq->rto_timer_data, 0, sizeof(p_arq->rto_timer_data));
+        memset(&p_arq->ack_timer_data, 0, sizeof(p_arq->ack_timer_data));
+
+        p_arq->p_mux       = p_init->p_mux;
+        p_arq->evt_handler = p_init->evt_handler;
+        p_arq->rto_timer   = &p_arq->rto_timer_data;
+        p_arq->ack_timer   = &p_arq->ack_timer_data;
+
+        err_code = app_timer_create(&p_arq->rto_timer, APP_TIMER_MODE_SINGLE_SHOT, rto_timeout_handler);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = app_timer_create(&p_arq->ack_timer, APP_TIMER_MODE_SINGLE_SHOT, ack_timeout_handler);
+        VERIFY_SUCCESS(err_code);
+
+        nus_arq_reset(p_arq);
+
+        return NRF_SUCCESS;
+}
+
+
+void nus_arq_reset(nus_arq_t * p_arq)
+{
+        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->rto_timer));
+        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->ack_timer));
+
+        CRITICAL_REGION_ENTER();
+
+        p_arq->tx_base    = 0;
+        p_arq->tx_sent    = 0;
+        p_arq->tx_next    = 0;
+        p_arq->tx_acked   = 0;
+        p_arq->tx_retx    = 0;
+        p_arq->tx_full    = false;
+        p_arq->rx_next    = 0;
+        p_arq->rx_held    = 0;
+        p_arq->rx_unacked = 0;
+        p_arq->rx_asm_len = 0;
+        memset(&p_arq->stats, 0, sizeof(p_arq->stats));
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+ret_code_t nus_arq_send(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len)
+{
+        ret_code_t err_code = NRF_SUCCESS;
+        uint32_t   frames;
+
+        VERIFY_PARAM_NOT_NULL(p_arq);
+        VERIFY_PARAM_NOT_NULL(p_data);
+
+        if (len == 0)
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        frames = CEIL_DIV(len, NUS_ARQ_PAYLOAD_MAX);
+
+        CRITICAL_REGION_ENTER();
+
+        uint8_t in_flight = (uint8_t)(p_arq->tx_next - p_arq->tx_base);
+
+        if (frames > (uint32_t)(NUS_ARQ_WINDOW - in_flight))
+        {
+                p_arq->tx_full = true;
+                err_code       = NRF_ERROR_NO_MEM;
+        }
+        else
+        {
+                while (len > 0)
+                {
+                        uint16_t chunk = MIN(len, NUS_ARQ_PAYLOAD_MAX);
+                        uint8_t  idx   = p_arq->tx_next % NUS_ARQ_WINDOW;
+
+                        p_arq->tx_buf[idx][0] = p_arq->tx_next;
+                        memcpy(&p_arq->tx_buf[idx][NUS_ARQ_SEQ_LEN], p_data, chunk);
+                        p_arq->tx_len[idx] = NUS_ARQ_SEQ_LEN + chunk;
+
+                        p_arq->tx_next++;
+                        p_arq->stats.tx_frames++;
+                        p_data += chunk;
+                        len    -= chunk;
+                }
+
+                tx_pump(p_arq);
+
+                if (in_flight == 0)
+                {
+                        rto_restart(p_arq);
+                }
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        if (err_code == NRF_SUCCESS)
+        {
+                nus_mux_tx_process(p_arq->p_mux);
+        }
+
+        return err_code;
+}
+
+
+void nus_arq_on_tx_rdy(nus_arq_t * p_arq)
+{
+        CRITICAL_REGION_ENTER();
+        tx_pump(p_arq);
+        CRITICAL_REGION_EXIT();
+
+        nus_mux_tx_process(p_arq->p_mux);
+}
+
+
+void nus_arq_on_data(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len, bool eom)
+{
+        // Frames normally arrive in one chunk and are handled in place.
+        if ((p_arq->rx_asm_len == 0) && eom)
+        {
+                if ((len > NUS_ARQ_SEQ_LEN) && (len <= NUS_ARQ_FRAME_MAX) && !loss_inject(p_arq))
+                {
+                        frame_rx(p_arq, p_data, len);
+                }
+                return;
+        }
+
+        if (p_arq->rx_asm_len != RX_ASM_DISCARD)
+        {
+                if (p_arq->rx_asm_len + len <= NUS_ARQ_FRAME_MAX)
+                {
+                        memcpy(&p_arq->rx_asm[p_arq->rx_asm_len], p_data, len);
+                        p_arq->rx_asm_len += len;
+                }
+                else
+                {
+                        NRF_LOG_WARNING("Frame too long, dropped.");
+                        p_arq->rx_asm_len = RX_ASM_DISCARD;
+                }
+        }
+
+        if (!eom)
+        {
+                return;
+        }
+
+        if ((p_arq->rx_asm_len != RX_ASM_DISCARD) &&
+            (p_arq->rx_asm_len > NUS_ARQ_SEQ_LEN) &&
+            !loss_inject(p_arq))
+        {
+                frame_rx(p_arq, p_arq->rx_asm, p_arq->rx_asm_len);
+        }
+
+        p_arq->rx_asm_len = 0;
+}
+
+
+void nus_arq_on_ack(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len)
+{
+        bool tx_rdy = false;
+        bool retx   = false;
+
+        if ((len < NUS_ARQ_ACK_LEN) || loss_inject(p_arq))
+        {
+                return;
+        }
+
+        uint8_t  cum  = p_data[1];
+        uint32_t sack = uint32_decode(&p_data[2]);
+
+        CRITICAL_REGION_ENTER();
+
+        uint8_t in_flight = (uint8_t)(p_arq->tx_next - p_arq->tx_base);
+        uint8_t sent      = (uint8_t)(p_arq->tx_sent - p_arq->tx_base);
+        uint8_t adv       = (uint8_t)(cum - p_arq->tx_base);
+
+        if (adv <= sent)
+        {
+                for (uint8_t i = 0; i < adv; i++)
+                {
+                        p_arq->stats.tx_bytes += p_arq->tx_len[(uint8_t)(p_arq->tx_base + i) % NUS_ARQ_WINDOW]
+                                                 - NUS_ARQ_SEQ_LEN;
+                }
+
+                p_arq->tx_base   = cum;
+                p_arq->tx_acked  = (adv >= 32) ? 0 : (p_arq->tx_acked >> adv);
+                p_arq->tx_retx   = (adv >= 32) ? 0 : (p_arq->tx_retx >> adv);
+                in_flight       -= adv;
+                sent            -= adv;
+
+                // Frame cum is missing at the peer, bit i of the SACK is frame cum + 1 + i.
+                p_arq->tx_acked |= (sack << 1) & WINDOW_MASK(sent);
+
+                // Fill the holes below the highest frame the peer holds, once per timeout period.
+                for (int32_t top = (int32_t)sent - 1; top > 0; top--)
+                {
+                        if (p_arq->tx_acked & (1UL << top))
+                        {
+                                for (int32_t i = 0; i < top; i++)
+                                {
+                                        if ((((p_arq->tx_acked | p_arq->tx_retx) & (1UL << i)) == 0) &&
+                                            frame_tx(p_arq, p_arq->tx_base + i))
+                                        {
+                                                p_arq->tx_retx |= (1UL << i);
+                                                p_arq->stats.retx_fast++;
+                                                retx            = true;
+                                        }
+                                }
+                                break;
+                        }
+                }
+
+                if (in_flight == 0)
+                {
+                        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->rto_timer));
+                }
+                else if (adv > 0)
+                {
+                        rto_restart(p_arq);
+                }
+
+                if (p_arq->tx_full && (in_flight < NUS_ARQ_WINDOW))
+                {
+                        p_arq->tx_full = false;
+                        tx_rdy         = true;
+                }
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        if (retx)
+        {
+                nus_mux_tx_process(p_arq->p_mux);
+        }
+
+        if (tx_rdy && (p_arq->evt_handler != NULL))
+        {
+                nus_arq_evt_t evt;
+
+                memset(&evt, 0, sizeof(evt));
+                evt.type = NUS_ARQ_EVT_TX_RDY;
+
+                p_arq->evt_handler(p_arq, &evt);
+        }
+}
+
+
+void nus_arq_stats_log(nus_arq_t const * p_arq)
+{
+        NRF_LOG_INFO("ARQ tx: %d frames, %d bytes acknowledged, %d fast and %d timeout retransmits.",
+                     p_arq->stats.tx_frames,
+                     p_arq->stats.tx_bytes,
+                     p_arq->stats.retx_fast,
+                     p_arq->stats.retx_rto);
+        NRF_LOG_INFO("ARQ rx: %d frames, %d duplicates, %d out of order, %d dropped on purpose.",
+                     p_arq->stats.rx_frames,
+                     p_arq->stats.rx_dup,
+                     p_arq->stats.rx_ooo,
+                     p_arq->stats.rx_dropped);
+}
+
+#endif // NRF_MODULE_ENABLED(NUS_ARQ)
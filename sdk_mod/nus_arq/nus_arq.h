@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup nus_arq Reliable transfer over the NUS multiplexer
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Selective repeat sliding window protocol on the data channel of @ref nus_mux.
+ *
+ * @details  NUS notifications and Write Commands are not acknowledged by the peer application, so
+ *           data dropped by a full queue on either side is lost silently. This module numbers
+ *           every frame sent on @ref NUS_MUX_CH_DATA and keeps up to @ref NUS_ARQ_WINDOW frames
+ *           for retransmission until the peer acknowledges them.
+ *
+ *           Data frame, on @ref NUS_MUX_CH_DATA:
+ *           @code
+ *           | seq (1 byte) | payload |
+ *           @endcode
+ *
+ *           Acknowledgement, on @ref NUS_MUX_CH_CTRL:
+ *           @code
+ *           | NUS_MUX_OP_ARQ_ACK | next expected seq (1 byte) | SACK bitmap (4 bytes, LE) |
+ *           @endcode
+ *
+ *           Bit i of the SACK bitmap is set if frame (next expected + 1 + i) has been received out
+ *           of order. The receiver acknowledges every @ref NUS_ARQ_WINDOW / 2 frames, after
+ *           @ref NUS_ARQ_ACK_DELAY_MS, and immediately on a gap or a duplicate. The sender
+ *           retransmits the holes below the highest selectively acknowledged frame once, and all
+ *           unacknowledged frames when no acknowledgement arrives for @ref NUS_ARQ_RTO_MS.
+ *
+ *           The receiver buffers frames received out of order and delivers data strictly in
+ *           order. @ref NUS_ARQ_LOSS_PERMILLE drops received frames on purpose to exercise the
+ *           recovery on the target.
+ *
+ *           RAM per instance: 2 * NUS_ARQ_WINDOW * (NUS_ARQ_PAYLOAD_MAX + 1) bytes plus an assembly
+ *           buffer of one frame, about 4.1 kB with the defaults.
+ */
+
+#ifndef NUS_ARQ_H__
+#define NUS_ARQ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "app_timer.h"
+#include "nus_mux.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUS_ARQ_SEQ_LEN         1                                       /**< Length of the data frame header. */
+#define NUS_ARQ_ACK_LEN         6                                       /**< Length of an acknowledgement. */
+#define NUS_ARQ_FRAME_MAX       (NUS_ARQ_SEQ_LEN + NUS_ARQ_PAYLOAD_MAX) /**< Largest data frame. */
+
+/**@brief Reliable transfer event type. */
+typedef enum
+{
+        NUS_ARQ_EVT_RX_DATA,    /**< Data has been received, in order. */
+        NUS_ARQ_EVT_TX_RDY      /**< The window was full and has room again. */
+} nus_arq_evt_type_t;
+
+/**@brief Reliable transfer event. */
+typedef struct
+{
+        nus_arq_evt_type_t type;    /**< Type of the event. */
+        uint8_t const    * p_data;  /**< Received data, for @ref NUS_ARQ_EVT_RX_DATA. */
+        uint16_t           len;     /**< Length of the received data, for @ref NUS_ARQ_EVT_RX_DATA. */
+} nus_arq_evt_t;
+
+/**@brief Reliable transfer statistics. */
+typedef struct
+{
+        uint32_t tx_frames;     /**< Frames sent for the first time. */
+        uint32_t tx_bytes;      /**< Payload bytes acknowledged by the peer. */
+        uint32_t retx_fast;     /**< Frames retransmitted because of a selective acknowledgement. */
+        uint32_t retx_rto;      /**< Frames retransmitted on timeout. */
+        uint32_t rx_frames;     /**< Frames delivered to the application. */
+        uint32_t rx_dup;        /**< Duplicate frames received. */
+        uint32_t rx_ooo;        /**< Frames received out of order. */
+        uint32_t rx_dropped;    /**< Frames dropped by the loss injection. */
+} nus_arq_stats_t;
+
+// Forward declaration of the nus_arq_t type.
+typedef struct nus_arq_s nus_arq_t;
+
+/**@brief Event handler type. */
+typedef void (* nus_arq_evt_handler_t)(nus_arq_t * p_arq, nus_arq_evt_t const * p_evt);
+
+/**@brief Reliable transfer instance, one per link. */
+struct nus_arq_s
+{
+        nus_mux_t           * p_mux;                                    /**< Multiplexer the frames go through. */
+        nus_arq_evt_handler_t evt_handler;                              /**< Application event handler. */
+        app_timer_t           rto_timer_data;                           /**< Retransmission timer. */
+        app_timer_t           ack_timer_data;                           /**< Delayed acknowledgement timer. */
+        app_timer_id_t        rto_timer;                                /**< Retransmission timer ID. */
+        app_timer_id_t        ack_timer;                                /**< Delayed acknowledgement timer ID. */
+        uint8_t               tx_base;                                  /**< Oldest unacknowledged sequence number. */
+        uint8_t               tx_sent;                                  /**< Next sequence number to hand to the multiplexer. */
+        uint8_t               tx_next;                                  /**< Next sequence number to queue. */
+        uint32_t              tx_acked;                                 /**< Bit i set if frame tx_base + i has been selectively acknowledged. */
+        uint32_t              tx_retx;                                  /**< Bit i set if frame tx_base + i has been retransmitted since the last timeout. */
+        bool                  tx_full;                                  /**< True if data was rejected because the window was full. */
+        uint8_t               rx_next;                                  /**< Next sequence number expected. */
+        uint32_t              rx_held;                                  /**< Bit i set if frame rx_next + i is held in the receive buffer. */
+        uint8_t               rx_unacked;                               /**< Frames received since the last acknowledgement. */
+        uint16_t              rx_asm_len;                               /**< Bytes of the frame being reassembled. */
+        nus_arq_stats_t       stats;                                    /**< Statistics. */
+        uint16_t              tx_len[NUS_ARQ_WINDOW];                   /**< Length of each frame in the window. */
+        uint16_t              rx_len[NUS_ARQ_WINDOW];                   /**< Length of each frame held for reordering. */
+        uint8_t               tx_buf[NUS_ARQ_WINDOW][NUS_ARQ_FRAME_MAX]; /**< Frames kept for retransmission. */
+        uint8_t               rx_buf[NUS_ARQ_WINDOW][NUS_ARQ_FRAME_MAX]; /**< Frames held for reordering. */
+        uint8_t               rx_asm[NUS_ARQ_FRAME_MAX];                /**< Frame being reassembled from multiplexer chunks. */
+};
+
+/**@brief Reliable transfer initialization structure. */
+typedef struct
+{
+        nus_mux_t           * p_mux;        /**< Multiplexer of the link. */
+        nus_arq_evt_handler_t evt_handler;  /**< Application event handler. */
+} nus_arq_init_t;
+
+
+/**@brief Function for initializing a reliable transfer instance.
+ *
+ * @param[out] p_arq   Pointer to the instance.
+ * @param[in]  p_init  Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the instance was initialized.
+ * @retval NRF_ERROR_NULL If a NULL pointer was given.
+ * @return Otherwise, the error code returned by @ref app_timer_create.
+ */
+ret_code_t nus_arq_init(nus_arq_t * p_arq, nus_arq_init_t const * p_init);
+
+
+/**@brief Function for discarding all state, when a link is established or lost.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+void nus_arq_reset(nus_arq_t * p_arq);
+
+
+/**@brief Function for sending data reliably.
+ *
+ * @details The data is split into frames of up to @ref NUS_ARQ_PAYLOAD_MAX bytes, which the
+ *          multiplexer splits further into packets. Either all frames are queued or none. Frames
+ *          are handed to the multiplexer as its data channel has room, see @ref nus_arq_on_tx_rdy.
+ *
+ * @param[in] p_arq   Pointer to the instance.
+ * @param[in] p_data  Data to send.
+ * @param[in] len     Length of the data.
+ *
+ * @retval NRF_SUCCESS              If the data was queued.
+ * @retval NRF_ERROR_INVALID_LENGTH If the length is 0.
+ * @retval NRF_ERROR_NO_MEM         If the window has no room for the data. @ref NUS_ARQ_EVT_TX_RDY
+ *                                  follows when there is room again.
+ */
+ret_code_t nus_arq_send(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for handling @ref NUS_MUX_EVT_TX_RDY on @ref NUS_MUX_CH_DATA.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+void nus_arq_on_tx_rdy(nus_arq_t * p_arq);
+
+
+/**@brief Function for handling a chunk received on @ref NUS_MUX_CH_DATA.
+ *
+ * @param[in] p_arq   Pointer to the instance.
+ * @param[in] p_data  Chunk data.
+ * @param[in] len     Length of the chunk.
+ * @param[in] eom     True if the chunk ends a frame.
+ */
+void nus_arq_on_data(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len, bool eom);
+
+
+/**@brief Function for handling a @ref NUS_MUX_OP_ARQ_ACK message received on @ref NUS_MUX_CH_CTRL.
+ *
+ * @param[in] p_arq   Pointer to the instance.
+ * @param[in] p_data  Message, starting with the opcode.
+ * @param[in] len     Length of the message.
+ */
+void nus_arq_on_ack(nus_arq_t * p_arq, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for writing the statistics of an instance to the log.
+ *
+ * @param[in] p_arq  Pointer to the instance.
+ */
+void nus_arq_stats_log(nus_arq_t const * p_arq);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_ARQ_H__
+
+/** @} */
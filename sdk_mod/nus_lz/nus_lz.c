@@ -0,0 +1,421 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(NUS_LZ)
+#include <string.h>
+
+#include "nus_lz.h"
+#include "nus_mux.h"
+#include "nrf.h"
+#include "app_timer.h"
+#ifdef FREERTOS
+#include "FreeRTOS.h"
+#endif
+
+#define NRF_LOG_MODULE_NAME nus_lz
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define MATCH_MIN           3                                   /**< Shortest match worth encoding. */
+#define MATCH_MAX           (MATCH_MIN + 15)                    /**< Longest match, 4 bits of length. */
+#define DIST_MAX            4096                                /**< Longest match distance, 12 bits of distance. */
+#define POS_INVALID         UINT16_MAX                          /**< Empty slot of the match table. */
+
+#ifdef FREERTOS
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000) / configTICK_RATE_HZ))
+#else
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+#endif
+
+STATIC_ASSERT(IS_POWER_OF_TWO(NUS_LZ_WINDOW) && (NUS_LZ_WINDOW <= DIST_MAX));
+STATIC_ASSERT(NUS_LZ_WINDOW + NUS_LZ_MSG_MAX < POS_INVALID);
+
+
+/**@brief Function for hashing the 3 bytes a match starts with.
+ *
+ * @param[in] p  First byte.
+ *
+ * @return Index in the match table.
+ */
+static __INLINE uint32_t hash3(uint8_t const * p)
+{
+        uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+        return (uint32_t)(v * 2654435761U) >> (32 - NUS_LZ_HASH_BITS);
+}
+
+
+/**@brief Function for dropping all but the last @ref NUS_LZ_WINDOW bytes of a history.
+ *
+ * @param[in] p_hist    History buffer.
+ * @param[in] hist_len  Bytes in the history, more than @ref NUS_LZ_WINDOW.
+ *
+ * @return Number of bytes dropped.
+ */
+static uint16_t hist_slide(uint8_t * p_hist, uint16_t hist_len)
+{
+        uint16_t shift = hist_len - NUS_LZ_WINDOW;
+
+        memmove(p_hist, &p_hist[shift], NUS_LZ_WINDOW);
+
+        return shift;
+}
+
+
+/**@brief Function for compressing the message placed after the encoder history.
+ *
+ * @param[in]  p_lz   Pointer to the instance.
+ * @param[in]  len    Length of the message.
+ * @param[out] p_out  Encoded message.
+ *
+ * @return Length of the encoded message, or 0 if it would not be shorter than the raw one.
+ */
+static uint16_t lz_encode(nus_lz_t * p_lz, uint16_t len, uint8_t * p_out)
+{
+        uint8_t const * p_hist = p_lz->enc_hist;
+        uint16_t        pos    = p_lz->enc_len;
+        uint16_t        end    = p_lz->enc_len + len;
+        uint16_t        o      = NUS_LZ_HDR_LEN;
+
+        p_out[0] = NUS_LZ_HDR_LZ;
+
+        while (pos < end)
+        {
+                uint16_t flag_pos = o++;
+                uint8_t  flags    = 0;
+
+                for (uint32_t bit = 0; (bit < 8) && (pos < end); bit++)
+                {
+                        uint16_t match_len = 0;
+                        uint16_t dist      = 0;
+
+                        // The raw message is len + 1 bytes, give up once that cannot be beaten.
+                        if (o + 2 > len)
+                        {
+                                return 0;
+                        }
+
+                        if (end - pos >= MATCH_MIN)
+                        {
+                                uint32_t h    = hash3(&p_hist[pos]);
+                                uint16_t cand = p_lz->enc_table[h];
+
+                                p_lz->enc_table[h] = pos;
+
+                                // Table entries are only hints, the match is checked byte by byte.
+                                if ((cand < pos) && (pos - cand <= p_lz->dist_max))
+                                {
+                                        uint16_t max = MIN(MATCH_MAX, end - pos);
+
+                                        while ((match_len < max) && (p_hist[cand + match_len] == p_hist[pos + match_len]))
+                                        {
+                                                match_len++;
+                                        }
+                                        dist = pos - cand;
+                                }
+                        }
+
+                        if (match_len >= MATCH_MIN)
+                        {
+                                p_out[o++] = (uint8_t)((dist - 1) >> 4);
+                                p_out[o++] = (uint8_t)(((dist - 1) << 4) | (match_len - MATCH_MIN));
+                                flags     |= (1 << bit);
+
+                                for (uint16_t k = 1; (k < match_len) && (pos + k + MATCH_MIN <= end); k++)
+                                {
+                                        p_lz->enc_table[hash3(&p_hist[pos + k])] = pos + k;
+                                }
+                                pos += match_len;
+                        }
+                        else
+                        {
+                                p_out[o++] = p_hist[pos++];
+                        }
+                }
+
+                p_out[flag_pos] = flags;
+        }
+
+        return o;
+}
+
+
+void nus_lz_init(nus_lz_t * p_lz)
+{
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+        nus_lz_reset(p_lz);
+}
+
+
+void nus_lz_reset(nus_lz_t * p_lz)
+{
+        p_lz->dist_max    = 0;
+        p_lz->enc_len     = 0;
+        p_lz->enc_pending = 0;
+        p_lz->dec_len     = 0;
+        p_lz->start_tick  = app_timer_cnt_get();
+        memset(&p_lz->stats, 0, sizeof(p_lz->stats));
+        memset(p_lz->enc_table, 0xFF, sizeof(p_lz->enc_table));
+}
+
+
+void nus_lz_hello_get(uint8_t * p_hello)
+{
+        uint8_t window_log2 = 0;
+
+        while ((1UL << window_log2) < NUS_LZ_WINDOW)
+        {
+                window_log2++;
+        }
+
+        p_hello[0] = NUS_MUX_OP_LZ_HELLO;
+        p_hello[1] = window_log2;
+}
+
+
+void nus_lz_on_hello(nus_lz_t * p_lz, uint8_t const * p_data, uint16_t len)
+{
+        if ((len < NUS_LZ_HELLO_LEN) || (p_data[1] > 12))
+        {
+                NRF_LOG_WARNING("Malformed compression announcement.");
+                return;
+        }
+
+        p_lz->dist_max = MIN(NUS_LZ_WINDOW, 1UL << p_data[1]);
+
+        NRF_LOG_INFO("Peer accepts compression, window %d bytes.", p_lz->dist_max);
+}
+
+
+ret_code_t nus_lz_encode(nus_lz_t      * p_lz,
+                         uint8_t const * p_data,
+                         uint16_t        len,
+                         uint8_t       * p_out,
+                         uint16_t      * p_out_len)
+{
+        uint32_t start_cyc = DWT->CYCCNT;
+        uint16_t out_len   = 0;
+
+        if ((len == 0) || (len > NUS_LZ_MSG_MAX))
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        if (p_lz->enc_len + len > sizeof(p_lz->enc_hist))
+        {
+                uint16_t shift = hist_slide(p_lz->enc_hist, p_lz->enc_len);
+
+                for (uint32_t i = 0; i < ARRAY_SIZE(p_lz->enc_table); i++)
+                {
+                        uint16_t entry = p_lz->enc_table[i];
+
+                        p_lz->enc_table[i] = ((entry != POS_INVALID) && (entry >= shift)) ? (entry - shift)
+                                                                                             : POS_INVALID;
+                }
+                p_lz->enc_len -= shift;
+        }
+
+        memcpy(&p_lz->enc_hist[p_lz->enc_len], p_data, len);
+
+        if (p_lz->dist_max > 0)
+        {
+                out_len = lz_encode(p_lz, len, p_out);
+        }
+
+        if (out_len == 0)
+        {
+                p_out[0] = NUS_LZ_HDR_RAW;
+                memcpy(&p_out[NUS_LZ_HDR_LEN], p_data, len);
+                out_len = NUS_LZ_HDR_LEN + len;
+        }
+
+        p_lz->enc_pending      = len;
+        p_lz->stats.tx_raw    += len;
+        p_lz->stats.tx_coded  += out_len;
+        p_lz->stats.tx_cycles += DWT->CYCCNT - start_cyc;
+
+        *p_out_len = out_len;
+
+        return NRF_SUCCESS;
+}
+
+
+void nus_lz_encode_commit(nus_lz_t * p_lz)
+{
+        p_lz->enc_len     += p_lz->enc_pending;
+        p_lz->enc_pending  = 0;
+}
+
+
+ret_code_t nus_lz_decode(nus_lz_t        * p_lz,
+                         uint8_t const   * p_data,
+                         uint16_t          len,
+                         uint8_t const  ** pp_out,
+                         uint16_t        * p_out_len)
+{
+        uint32_t  start_cyc = DWT->CYCCNT;
+        uint8_t * p_hist;
+        uint16_t  pos;
+        uint16_t  end;
+        uint16_t  i = NUS_LZ_HDR_LEN;
+
+        if ((uint32_t)p_lz->dec_len + NUS_LZ_MSG_MAX > sizeof(p_lz->dec_hist))
+        {
+                p_lz->dec_len -= hist_slide(p_lz->dec_hist, p_lz->dec_len);
+        }
+
+        p_hist = p_lz->dec_hist;
+        pos    = p_lz->dec_len;
+        end    = p_lz->dec_len + NUS_LZ_MSG_MAX;
+
+        if ((len < NUS_LZ_HDR_LEN) || (p_data[0] > NUS_LZ_HDR_LZ))
+        {
+                goto error;
+        }
+
+        if (p_data[0] == NUS_LZ_HDR_RAW)
+        {
+                if (len - NUS_LZ_HDR_LEN > NUS_LZ_MSG_MAX)
+                {
+                        goto error;
+                }
+                memcpy(&p_hist[pos], &p_data[NUS_LZ_HDR_LEN], len - NUS_LZ_HDR_LEN);
+                pos += len - NUS_LZ_HDR_LEN;
+        }
+
+        while ((p_data[0] == NUS_LZ_HDR_LZ) && (i < len))
+        {
+                uint8_t flags = p_data[i++];
+
+                for (uint32_t bit = 0; (bit < 8) && (i < len); bit++)
+                {
+                        if (flags & (1 << bit))
+                        {
+                                uint16_t dist;
+                                uint16_t match_len;
+
+                                if (i + 2 > len)
+                                {
+                                        goto error;
+                                }
+
+                                dist      = (((uint16_t)p_data[i] << 4) | (p_data[i + 1] >> 4)) + 1;
+                                match_len = (p_data[i + 1] & 0x0F) + MATCH_MIN;
+                                i        += 2;
+
+                                if ((dist > pos) || (pos + match_len > end))
+                                {
+                                        goto error;
+                                }
+
+                                // Byte by byte, a match may overlap the data it produces.
+                                for (uint16_t k = 0; k < match_len; k++, pos++)
+                                {
+                                        p_hist[pos] = p_hist[pos - dist];
+                                }
+                        }
+                        else
+                        {
+                                if (pos >= end)
+                                {
+                                        goto error;
+                                }
+                                p_hist[pos++] = p_data[i++];
+                        }
+                }
+        }
+
+        *pp_out    = &p_hist[p_lz->dec_len];
+        *p_out_len = pos - p_lz->dec_len;
+
+        p_lz->dec_len          = pos;
+        p_lz->stats.rx_coded  += len;
+        p_lz->stats.rx_raw    += *p_out_len;
+        p_lz->stats.rx_cycles += DWT->CYCCNT - start_cyc;
+
+        return NRF_SUCCESS;
+
+error:
+        NRF_LOG_WARNING("Malformed message, history discarded.");
+        p_lz->dec_len = 0;
+        p_lz->stats.rx_errors++;
+
+        return NRF_ERROR_INVALID_DATA;
+}
+
+
+void nus_lz_stats_log(nus_lz_t const * p_lz)
+{
+        nus_lz_stats_t const * p_stats    = &p_lz->stats;
+        uint32_t               elapsed_ms = TICKS_TO_MS(app_timer_cnt_diff_compute(app_timer_cnt_get(),
+                                                                                   p_lz->start_tick));
+
+        if (p_stats->tx_raw > 0)
+        {
+                NRF_LOG_INFO("LZ tx: %d bytes coded to %d per mille, %d cycles per byte.",
+                             p_stats->tx_raw,
+                             (uint32_t)(((uint64_t)p_stats->tx_coded * 1000) / p_stats->tx_raw),
+                             p_stats->tx_cycles / p_stats->tx_raw);
+        }
+
+        if (p_stats->rx_raw > 0)
+        {
+                NRF_LOG_INFO("LZ rx: %d bytes decoded from %d per mille, %d cycles per byte, %d errors.",
+                             p_stats->rx_raw,
+                             (uint32_t)(((uint64_t)p_stats->rx_coded * 1000) / p_stats->rx_raw),
+                             p_stats->rx_cycles / p_stats->rx_raw,
+                             p_stats->rx_errors);
+        }
+
+        if (elapsed_ms > 0)
+        {
+                // Goodput is the application data rate, the coded rate is what the link carried.
+                NRF_LOG_INFO("LZ goodput over %d ms: tx %d B/s (%d B/s coded), rx %d B/s (%d B/s coded).",
+                             elapsed_ms,
+                             (uint32_t)(((uint64_t)p_stats->tx_raw * 1000) / elapsed_ms),
+                             (uint32_t)(((uint64_t)p_stats->tx_coded * 1000) / elapsed_ms),
+                             (uint32_t)(((uint64_t)p_stats->rx_raw * 1000) / elapsed_ms),
+                             (uint32_t)(((uint64_t)p_stats->rx_coded * 1000) / elapsed_ms));
+        }
+}
+
+#endif // NRF_MODULE_ENABLED(NUS_LZ)
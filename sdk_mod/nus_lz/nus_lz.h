@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup nus_lz NUS stream compression
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    LZSS compression of the UART stream, with a history shared across messages.
+ *
+ * @details  Every message starts with a 1-byte header, @ref NUS_LZ_HDR_RAW or
+ *           @ref NUS_LZ_HDR_LZ. A compressed body is a sequence of groups of one flag byte and up
+ *           to 8 items. Bit i of the flag byte, LSB first, tells whether item i is a literal byte
+ *           or a 2-byte match:
+ *
+ *           @code
+ *           byte 0: | (distance - 1)[11:4]                        |
+ *           byte 1: | (distance - 1)[3:0] | (length - 3) (4 bits) |
+ *           @endcode
+ *
+ *           Matches reach back up to @ref NUS_LZ_WINDOW bytes into the data of earlier messages,
+ *           so both ends must see every message exactly once and in order. Run the compressed
+ *           stream over @ref nus_arq.
+ *
+ *           Each end announces its window with @ref NUS_MUX_OP_LZ_HELLO once it can receive. A
+ *           message is compressed only after the peer's announcement has arrived, and only if it
+ *           gets shorter, so a peer without compression keeps receiving raw messages.
+ *
+ *           No heap is used. RAM per instance: 2 * (NUS_LZ_WINDOW + NUS_LZ_MSG_MAX) bytes of
+ *           history plus 2 << NUS_LZ_HASH_BITS bytes of match table, 3.1 kB with the defaults.
+ */
+
+#ifndef NUS_LZ_H__
+#define NUS_LZ_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUS_LZ_HDR_RAW          0x00                                    /**< Message header, raw body. */
+#define NUS_LZ_HDR_LZ           0x01                                    /**< Message header, compressed body. */
+#define NUS_LZ_HDR_LEN          1                                       /**< Length of the message header. */
+#define NUS_LZ_HELLO_LEN        2                                       /**< Length of @ref NUS_MUX_OP_LZ_HELLO, opcode and log2 of the window. */
+#define NUS_LZ_ENC_MAX          (NUS_LZ_HDR_LEN + NUS_LZ_MSG_MAX)       /**< Size of a buffer that holds any encoded message. */
+
+/**@brief Compression statistics. */
+typedef struct
+{
+        uint32_t tx_raw;        /**< Bytes given to @ref nus_lz_encode. */
+        uint32_t tx_coded;      /**< Bytes of the encoded messages, headers included. */
+        uint32_t tx_cycles;     /**< CPU cycles spent encoding. */
+        uint32_t rx_coded;      /**< Bytes of the received messages, headers included. */
+        uint32_t rx_raw;        /**< Bytes decoded. */
+        uint32_t rx_cycles;     /**< CPU cycles spent decoding. */
+        uint32_t rx_errors;     /**< Messages that could not be decoded. */
+} nus_lz_stats_t;
+
+/**@brief Compression instance, one per link. */
+typedef struct
+{
+        uint16_t       dist_max;                                        /**< Longest match distance the peer accepts, 0 until it has announced its window. */
+        uint16_t       enc_len;                                         /**< Bytes of committed history in the encoder. */
+        uint16_t       enc_pending;                                     /**< Bytes of the last encoded message, not committed yet. */
+        uint16_t       dec_len;                                         /**< Bytes of history in the decoder. */
+        uint32_t       start_tick;                                      /**< app_timer tick of the last reset. */
+        nus_lz_stats_t stats;                                           /**< Statistics. */
+        uint16_t       enc_table[1 << NUS_LZ_HASH_BITS];                /**< Last position of every 3-byte hash in the encoder history. */
+        uint8_t        enc_hist[NUS_LZ_WINDOW + NUS_LZ_MSG_MAX];        /**< Encoder history followed by the message being encoded. */
+        uint8_t        dec_hist[NUS_LZ_WINDOW + NUS_LZ_MSG_MAX];        /**< Decoder history followed by the message being decoded. */
+} nus_lz_t;
+
+
+/**@brief Function for initializing a compression instance.
+ *
+ * @details Also enables the DWT cycle counter used for the statistics.
+ *
+ * @param[out] p_lz  Pointer to the instance.
+ */
+void nus_lz_init(nus_lz_t * p_lz);
+
+
+/**@brief Function for discarding the history and the peer's window, when a link is established.
+ *
+ * @param[in] p_lz  Pointer to the instance.
+ */
+void nus_lz_reset(nus_lz_t * p_lz);
+
+
+/**@brief Function for building the announcement of the local window.
+ *
+ * @param[out] p_hello  Buffer of @ref NUS_LZ_HELLO_LEN bytes, to be sent on @ref NUS_MUX_CH_CTRL.
+ */
+void nus_lz_hello_get(uint8_t * p_hello);
+
+
+/**@brief Function for handling the peer's @ref NUS_MUX_OP_LZ_HELLO.
+ *
+ * @param[in] p_lz    Pointer to the instance.
+ * @param[in] p_data  Message received on @ref NUS_MUX_CH_CTRL.
+ * @param[in] len     Length of the message.
+ */
+void nus_lz_on_hello(nus_lz_t * p_lz, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for encoding a message.
+ *
+ * @details The message only becomes part of the history with @ref nus_lz_encode_commit, call it
+ *          once the encoded message has been queued. A message that was not queued is simply
+ *          not committed.
+ *
+ * @param[in]  p_lz     Pointer to the instance.
+ * @param[in]  p_data   Message to encode.
+ * @param[in]  len      Length of the message, at most @ref NUS_LZ_MSG_MAX.
+ * @param[out] p_out    Buffer of at least @ref NUS_LZ_ENC_MAX bytes.
+ * @param[out] p_out_len Length of the encoded message.
+ *
+ * @retval NRF_SUCCESS              If the message was encoded.
+ * @retval NRF_ERROR_INVALID_LENGTH If the length is 0 or above @ref NUS_LZ_MSG_MAX.
+ */
+ret_code_t nus_lz_encode(nus_lz_t      * p_lz,
+                         uint8_t const * p_data,
+                         uint16_t        len,
+                         uint8_t       * p_out,
+                         uint16_t      * p_out_len);
+
+
+/**@brief Function for adding the last encoded message to the history.
+ *
+ * @param[in] p_lz  Pointer to the instance.
+ */
+void nus_lz_encode_commit(nus_lz_t * p_lz);
+
+
+/**@brief Function for decoding a received message.
+ *
+ * @param[in]  p_lz      Pointer to the instance.
+ * @param[in]  p_data    Received message.
+ * @param[in]  len       Length of the message.
+ * @param[out] pp_out    Decoded message, valid until the next call.
+ * @param[out] p_out_len Length of the decoded message.
+ *
+ * @retval NRF_SUCCESS            If the message was decoded.
+ * @retval NRF_ERROR_INVALID_DATA If the message is malformed. The history is discarded.
+ */
+ret_code_t nus_lz_decode(nus_lz_t        * p_lz,
+                         uint8_t const   * p_data,
+                         uint16_t          len,
+                         uint8_t const  ** pp_out,
+                         uint16_t        * p_out_len);
+
+
+/**@brief Function for writing the compression ratio, cycles per byte and goodput to the log.
+ *
+ * @param[in] p_lz  Pointer to the instance.
+ */
+void nus_lz_stats_log(nus_lz_t const * p_lz);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_LZ_H__
+
+/** @} */
@@ -0,0 +1,421 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(NUS_MUX)
+#include <string.h>
+
+#include "nus_mux.h"
+#include "ble_gatt.h"
+#include "app_util_platform.h"
+
+#define NRF_LOG_MODULE_NAME nus_mux
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define HDR_CH_POS          5                                       /**< Position of the channel in the first header byte. */
+#define HDR_EOM_MASK        0x10                                    /**< EOM flag in the first header byte. */
+#define HDR_LEN_HI_MASK     0x0F                                    /**< Length bits in the first header byte. */
+#define REC_EOM_MASK        0x8000                                  /**< EOM flag in a queued message length. */
+#define PAYLOAD_DEFAULT     (BLE_GATT_ATT_MTU_DEFAULT - 3)          /**< Packet size until the lower layer reports a larger one. */
+
+STATIC_ASSERT(NUS_MUX_CH_COUNT <= 8);
+STATIC_ASSERT(NUS_MUX_PACKET_MAX > NUS_MUX_HDR_LEN);
+STATIC_ASSERT((NUS_MUX_TX_BUF_SIZE > NUS_MUX_HDR_LEN) && (NUS_MUX_TX_BUF_SIZE < REC_EOM_MASK));
+
+
+/**@brief Function for copying data into a transmit ring.
+ *
+ * @param[in] p_q     Transmit queue.
+ * @param[in] p_data  Data to copy.
+ * @param[in] len     Length of the data, must fit in the free space.
+ */
+static void ring_write(nus_mux_tx_queue_t * p_q, uint8_t const * p_data, uint16_t len)
+{
+        uint16_t first = MIN(len, NUS_MUX_TX_BUF_SIZE - p_q->wr);
+
+        memcpy(&p_q->buf[p_q->wr], p_data, first);
+        memcpy(&p_q->buf[0], &p_data[first], len - first);
+
+        p_q->wr    = (p_q->wr + len) % NUS_MUX_TX_BUF_SIZE;
+        p_q->used += len;
+}
+
+
+/**@brief Function for copying data out of a transmit ring.
+ *
+ * @param[in]  p_q     Transmit queue.
+ * @param[out] p_data  Destination.
+ * @param[in]  len     Number of bytes, must be available in the ring.
+ */
+static void ring_read(nus_mux_tx_queue_t * p_q, uint8_t * p_data, uint16_t len)
+{
+        uint16_t first = MIN(len, NUS_MUX_TX_BUF_SIZE - p_q->rd);
+
+        memcpy(p_data, &p_q->buf[p_q->rd], first);
+        memcpy(&p_data[first], &p_q->buf[0], len - first);
+
+        p_q->rd    = (p_q->rd + len) % NUS_MUX_TX_BUF_SIZE;
+        p_q->used -= len;
+}
+
+
+/**@brief Function for filling the packet buffer from the channel queues, in priority order.
+ *
+ * @param[in] p_mux  Pointer to the instance.
+ *
+ * @return Length of the packet, 0 if there is nothing to send.
+ */
+static uint16_t packet_build(nus_mux_t * p_mux)
+{
+        uint16_t len = 0;
+
+        for (uint32_t ch = 0; ch < NUS_MUX_CH_COUNT; ch++)
+        {
+                nus_mux_tx_queue_t * p_q = &p_mux->tx[ch];
+
+                while (((p_q->msg_left > 0) || (p_q->used > 0)) &&
+                       (p_mux->payload_max - len > NUS_MUX_HDR_LEN))
+                {
+                        uint16_t chunk;
+                        bool     eom;
+
+                        if (p_q->msg_left == 0)
+                        {
+                                uint8_t rec[NUS_MUX_HDR_LEN];
+
+                                ring_read(p_q, rec, sizeof(rec));
+                                p_q->msg_left = uint16_decode(rec) & ~REC_EOM_MASK;
+                                p_q->msg_eom  = (uint16_decode(rec) & REC_EOM_MASK) != 0;
+                        }
+
+                        chunk = MIN(p_q->msg_left, p_mux->payload_max - len - NUS_MUX_HDR_LEN);
+                        chunk = MIN(chunk, NUS_MUX_CHUNK_MAX);
+                        eom   = p_q->msg_eom && (chunk == p_q->msg_left);
+
+                        p_mux->pkt[len++] = (uint8_t)((ch << HDR_CH_POS) |
+                                                      (eom ? HDR_EOM_MASK : 0) |
+                                                      ((chunk >> 8) & HDR_LEN_HI_MASK));
+                        p_mux->pkt[len++] = (uint8_t)chunk;
+
+                        ring_read(p_q, &p_mux->pkt[len], chunk);
+                        len           += chunk;
+                        p_q->msg_left -= chunk;
+
+                        if (eom)
+                        {
+                                p_mux->pkt_msgs[ch]++;
+                        }
+                }
+        }
+
+        return len;
+}
+
+
+/**@brief Function for taking the channels that ran full and have room for a full message again.
+ *
+ * @param[in] p_mux  Pointer to the instance.
+ *
+ * @return Bitmask of the channels.
+ */
+static uint8_t tx_rdy_take(nus_mux_t * p_mux)
+{
+        uint8_t tx_rdy = 0;
+
+        for (uint32_t ch = 0; ch < NUS_MUX_CH_COUNT; ch++)
+        {
+                if ((p_mux->tx_full & (1 << ch)) && (p_mux->tx[ch].used == 0))
+                {
+                        p_mux->tx_full &= ~(1 << ch);
+                        tx_rdy         |= (1 << ch);
+                }
+        }
+
+        return tx_rdy;
+}
+
+
+ret_code_t nus_mux_init(nus_mux_t * p_mux, nus_mux_init_t const * p_init)
+{
+        VERIFY_PARAM_NOT_NULL(p_mux);
+        VERIFY_PARAM_NOT_NULL(p_init);
+        VERIFY_PARAM_NOT_NULL(p_init->send);
+
+        p_mux->send        = p_init->send;
+        p_mux->evt_handler = p_init->evt_handler;
+        p_mux->p_context   = p_init->p_context;
+        p_mux->tx_busy     = false;
+        p_mux->tx_again    = false;
+
+        nus_mux_reset(p_mux);
+
+        return NRF_SUCCESS;
+}
+
+
+void nus_mux_reset(nus_mux_t * p_mux)
+{
+        CRITICAL_REGION_ENTER();
+
+        p_mux->payload_max = PAYLOAD_DEFAULT;
+        p_mux->pkt_len     = 0;
+        p_mux->tx_full     = 0;
+        memset(p_mux->pkt_msgs, 0, sizeof(p_mux->pkt_msgs));
+        memset(p_mux->tx, 0, sizeof(p_mux->tx));
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+void nus_mux_payload_max_set(nus_mux_t * p_mux, uint16_t payload_max)
+{
+        p_mux->payload_max = MIN(payload_max, NUS_MUX_PACKET_MAX);
+}
+
+
+ret_code_t nus_mux_queue(nus_mux_t    * p_mux,
+                         nus_mux_ch_t   ch,
+                         uint8_t const * p_data,
+                         uint16_t       len,
+                         bool           eom)
+{
+        ret_code_t           err_code = NRF_SUCCESS;
+        nus_mux_tx_queue_t * p_q;
+        uint8_t              rec[NUS_MUX_HDR_LEN];
+
+        VERIFY_PARAM_NOT_NULL(p_mux);
+        VERIFY_PARAM_NOT_NULL(p_data);
+
+        if (ch >= NUS_MUX_CH_COUNT)
+        {
+                return NRF_ERROR_INVALID_PARAM;
+        }
+
+        if ((len == 0) || (len > NUS_MUX_MSG_MAX))
+        {
+                return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        p_q = &p_mux->tx[ch];
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)(len | (eom ? REC_EOM_MASK : 0)), rec));
+
+        CRITICAL_REGION_ENTER();
+
+        if (p_q->used + sizeof(rec) + len > NUS_MUX_TX_BUF_SIZE)
+        {
+                p_mux->tx_full |= (1 << ch);
+                err_code        = NRF_ERROR_NO_MEM;
+        }
+        else
+        {
+                ring_write(p_q, rec, sizeof(rec));
+                ring_write(p_q, p_data, len);
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        return err_code;
+}
+
+
+ret_code_t nus_mux_send(nus_mux_t    * p_mux,
+                        nus_mux_ch_t   ch,
+                        uint8_t const * p_data,
+                        uint16_t       len,
+                        bool           eom)
+{
+        ret_code_t err_code = nus_mux_queue(p_mux, ch, p_data, len, eom);
+
+        if (err_code == NRF_SUCCESS)
+        {
+                nus_mux_tx_process(p_mux);
+        }
+
+        return err_code;
+}
+
+
+void nus_mux_tx_process(nus_mux_t * p_mux)
+{
+        ret_code_t err_code;
+        bool       more   = true;
+        uint8_t    tx_rdy = 0;
+        uint16_t   sent[NUS_MUX_CH_COUNT];
+
+        memset(sent, 0, sizeof(sent));
+
+        CRITICAL_REGION_ENTER();
+
+        if (p_mux->tx_busy)
+        {
+                // The context offering the packet tries once more before it lets go.
+                p_mux->tx_again = true;
+                more            = false;
+        }
+        else
+        {
+                p_mux->tx_busy = true;
+        }
+
+        CRITICAL_REGION_EXIT();
+
+        while (more)
+        {
+                uint16_t pkt_len;
+
+                // Only the packet is claimed here, the lower layer is called with interrupts enabled.
+                CRITICAL_REGION_ENTER();
+
+                p_mux->tx_again = false;
+
+                if (p_mux->pkt_len == 0)
+                {
+                        p_mux->pkt_len = packet_build(p_mux);
+                }
+
+                pkt_len = p_mux->pkt_len;
+
+                if (pkt_len == 0)
+                {
+                        p_mux->tx_busy = false;
+                        tx_rdy        |= tx_rdy_take(p_mux);
+                        more           = false;
+                }
+
+                CRITICAL_REGION_EXIT();
+
+                if (!more)
+                {
+                        break;
+                }
+
+                err_code = p_mux->send(p_mux->p_context, p_mux->pkt, pkt_len);
+
+                CRITICAL_REGION_ENTER();
+
+                if (err_code == NRF_ERROR_RESOURCES)
+                {
+                        // Kept for the next call, or offered again if one came in meanwhile.
+                        more = p_mux->tx_again;
+                }
+                else
+                {
+                        // Sent or dropped, the messages have left the queues either way.
+                        for (uint32_t ch = 0; ch < NUS_MUX_CH_COUNT; ch++)
+                        {
+                                sent[ch]           += p_mux->pkt_msgs[ch];
+                                p_mux->pkt_msgs[ch] = 0;
+                        }
+
+                        p_mux->pkt_len = 0;
+                        more           = (err_code == NRF_SUCCESS) || p_mux->tx_again;
+                }
+
+                if (!more)
+                {
+                        p_mux->tx_busy = false;
+                        tx_rdy        |= tx_rdy_take(p_mux);
+                }
+
+                CRITICAL_REGION_EXIT();
+
+                if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_RESOURCES))
+                {
+                        NRF_LOG_WARNING("Packet of %d bytes dropped: 0x%x.", pkt_len, err_code);
+                }
+        }
+
+        for (uint32_t ch = 0; (ch < NUS_MUX_CH_COUNT) && (p_mux->evt_handler != NULL); ch++)
+        {
+                nus_mux_evt_t evt;
+
+                memset(&evt, 0, sizeof(evt));
+                evt.ch = (nus_mux_ch_t)ch;
+
+                if (sent[ch] != 0)
+                {
+                        evt.type    = NUS_MUX_EVT_TX_SENT;
+                        evt.msg_cnt = sent[ch];
+
+                        p_mux->evt_handler(p_mux, &evt);
+                }
+
+                if (tx_rdy & (1 << ch))
+                {
+                        evt.type    = NUS_MUX_EVT_TX_RDY;
+                        evt.msg_cnt = 0;
+
+                        p_mux->evt_handler(p_mux, &evt);
+                }
+        }
+}
+
+
+void nus_mux_on_data(nus_mux_t * p_mux, uint8_t const * p_data, uint16_t length)
+{
+        while (length >= NUS_MUX_HDR_LEN)
+        {
+                nus_mux_evt_t evt;
+                uint16_t      chunk = ((p_data[0] & HDR_LEN_HI_MASK) << 8) | p_data[1];
+
+                if (chunk > length - NUS_MUX_HDR_LEN)
+                {
+                        NRF_LOG_WARNING("Malformed chunk, %d bytes dropped.", length);
+                        return;
+                }
+
+                memset(&evt, 0, sizeof(evt));
+                evt.type   = NUS_MUX_EVT_RX_DATA;
+                evt.ch     = (nus_mux_ch_t)(p_data[0] >> HDR_CH_POS);
+                evt.eom    = (p_data[0] & HDR_EOM_MASK) != 0;
+                evt.p_data = &p_data[NUS_MUX_HDR_LEN];
+                evt.len    = chunk;
+
+                if ((evt.ch < NUS_MUX_CH_COUNT) && (p_mux->evt_handler != NULL))
+                {
+                        p_mux->evt_handler(p_mux, &evt);
+                }
+
+                p_data += NUS_MUX_HDR_LEN + chunk;
+                length -= NUS_MUX_HDR_LEN + chunk;
+        }
+}
+
+#endif // NRF_MODULE_ENABLED(NUS_MUX)
@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup nus_mux NUS stream multiplexer
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Carries several logical channels with different priorities over one NUS link.
+ *
+ * @details  Every packet handed to the lower layer (a NUS notification, a NUS write command or an
+ *           L2CAP SDU) holds one or more chunks. A chunk starts with a 2-byte header:
+ *
+ *           @code
+ *           byte 0: | ch (3 bits) | EOM (1 bit) | length[11:8] (4 bits) |
+ *           byte 1: | length[7:0]                                       |
+ *           @endcode
+ *
+ *           followed by up to 4095 bytes of channel data. EOM is set on the chunk that ends a
+ *           message. The overhead is 2 bytes per channel that has data in a packet.
+ *
+ *           Each channel has its own transmit queue. Packets are filled from the channels in
+ *           @ref nus_mux_ch_t order, so a command queued behind a long bulk transfer goes out in
+ *           the next packet instead of after the transfer. Lower priority channels only get the
+ *           room that is left, they can starve while a higher priority channel is saturated.
+ *
+ *           Received chunks are passed to the application as they arrive, without reassembly.
+ */
+
+#ifndef NUS_MUX_H__
+#define NUS_MUX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUS_MUX_HDR_LEN         2       /**< Length of the chunk header. */
+#define NUS_MUX_CHUNK_MAX       0x0FFF  /**< Largest amount of data in one chunk. */
+#define NUS_MUX_MSG_MAX         (NUS_MUX_TX_BUF_SIZE - NUS_MUX_HDR_LEN) /**< Largest amount of data queued with one call to @ref nus_mux_send. */
+
+/**@brief Logical channels, in priority order. */
+typedef enum
+{
+        NUS_MUX_CH_CTRL,        /**< Commands and responses. Highest priority. */
+        NUS_MUX_CH_TELEMETRY,   /**< Periodic measurements. */
+        NUS_MUX_CH_DATA,        /**< Bulk data, including the UART stream. */
+        NUS_MUX_CH_TEST,        /**< Generated data of the throughput test, see @ref nus_tput. Lowest priority. */
+        NUS_MUX_CH_COUNT        /**< Number of channels. At most 8 fit in the chunk header. */
+} nus_mux_ch_t;
+
+/**@brief Opcodes in the first byte of every message on @ref NUS_MUX_CH_CTRL. */
+typedef enum
+{
+        NUS_MUX_OP_ARQ_ACK     = 0x01, /**< Acknowledgement of the reliable transfer, see @ref nus_arq. */
+        NUS_MUX_OP_LZ_HELLO    = 0x02, /**< Compression window of the sender, see @ref nus_lz. */
+        NUS_MUX_OP_PING        = 0x03, /**< Round trip probe, sent back unchanged but for the opcode. */
+        NUS_MUX_OP_PONG        = 0x04, /**< Echo of a @ref NUS_MUX_OP_PING. */
+        NUS_MUX_OP_TPUT_START  = 0x05, /**< Start of a throughput test, see @ref nus_tput. */
+        NUS_MUX_OP_TPUT_STOP   = 0x06, /**< End of a throughput test. */
+        NUS_MUX_OP_TPUT_RESULT = 0x07, /**< Receive statistics of a throughput test. */
+} nus_mux_op_t;
+
+/**@brief Multiplexer event type. */
+typedef enum
+{
+        NUS_MUX_EVT_RX_DATA,    /**< A chunk has been received. */
+        NUS_MUX_EVT_TX_RDY,     /**< A channel that was full has room again. */
+        NUS_MUX_EVT_TX_SENT     /**< Messages of a channel have been passed whole to the lower layer. */
+} nus_mux_evt_type_t;
+
+/**@brief Multiplexer event. */
+typedef struct
+{
+        nus_mux_evt_type_t type;   /**< Type of the event. */
+        nus_mux_ch_t       ch;     /**< Channel the event belongs to. */
+        uint8_t const    * p_data; /**< Chunk data, for @ref NUS_MUX_EVT_RX_DATA. */
+        uint16_t           len;    /**< Length of the chunk data, for @ref NUS_MUX_EVT_RX_DATA. */
+        bool               eom;    /**< True if the chunk ends a message, for @ref NUS_MUX_EVT_RX_DATA. */
+        uint16_t           msg_cnt; /**< Number of messages, in queueing order, for @ref NUS_MUX_EVT_TX_SENT. */
+} nus_mux_evt_t;
+
+// Forward declaration of the nus_mux_t type.
+typedef struct nus_mux_s nus_mux_t;
+
+/**@brief Event handler type. */
+typedef void (* nus_mux_evt_handler_t)(nus_mux_t * p_mux, nus_mux_evt_t const * p_evt);
+
+/**@brief Lower layer send function type.
+ *
+ * @details Must not block. Return NRF_ERROR_RESOURCES when the lower layer is busy, the packet
+ *          is offered again on the next call to @ref nus_mux_tx_process. Any other error drops
+ *          the packet.
+ *
+ * @param[in] p_context  Context given at initialization.
+ * @param[in] p_data     Packet to send.
+ * @param[in] length     Length of the packet.
+ *
+ * @return NRF_SUCCESS if the packet was accepted.
+ */
+typedef ret_code_t (* nus_mux_send_t)(void * p_context, uint8_t * p_data, uint16_t length);
+
+/**@brief Transmit queue of one channel. */
+typedef struct
+{
+        uint8_t  buf[NUS_MUX_TX_BUF_SIZE]; /**< Ring of messages, each preceded by a 2-byte length and EOM flag. */
+        uint16_t rd;                       /**< Read index. */
+        uint16_t wr;                       /**< Write index. */
+        uint16_t used;                     /**< Number of bytes in the ring. */
+        uint16_t msg_left;                 /**< Bytes left of the message being sent. */
+        bool     msg_eom;                  /**< True if the message being sent ends with EOM. */
+} nus_mux_tx_queue_t;
+
+/**@brief Multiplexer instance, one per link. */
+struct nus_mux_s
+{
+        nus_mux_send_t        send;                     /**< Lower layer send function. */
+        nus_mux_evt_handler_t evt_handler;              /**< Application event handler. */
+        void                * p_context;                /**< Context passed to the send function. */
+        uint16_t              payload_max;              /**< Largest packet the lower layer accepts. */
+        uint16_t              pkt_len;                  /**< Length of the packet waiting for the lower layer, 0 if none. */
+        uint8_t               tx_full;                  /**< Bitmask of channels that rejected data for lack of room. */
+        bool                  tx_busy;                  /**< True while one context offers the packet to the lower layer. */
+        bool                  tx_again;                 /**< Set when transmission was requested during that offer. */
+        uint8_t               pkt[NUS_MUX_PACKET_MAX];  /**< Packet being sent. */
+        uint8_t               pkt_msgs[NUS_MUX_CH_COUNT]; /**< Messages of each channel that end in the packet being sent. */
+        nus_mux_tx_queue_t    tx[NUS_MUX_CH_COUNT];     /**< Transmit queues. */
+};
+
+/**@brief Multiplexer initialization structure. */
+typedef struct
+{
+        nus_mux_send_t        send;         /**< Lower layer send function. */
+        nus_mux_evt_handler_t evt_handler;  /**< Application event handler. */
+        void                * p_context;    /**< Context passed to the send function. */
+} nus_mux_init_t;
+
+
+/**@brief Function for initializing a multiplexer instance.
+ *
+ * @param[out] p_mux   Pointer to the instance.
+ * @param[in]  p_init  Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the instance was initialized.
+ * @retval NRF_ERROR_NULL If a NULL pointer or no send function was given.
+ */
+ret_code_t nus_mux_init(nus_mux_t * p_mux, nus_mux_init_t const * p_init);
+
+
+/**@brief Function for discarding all queued data, when a link is established or lost.
+ *
+ * @details Also sets the packet size back to the default ATT MTU.
+ *
+ * @param[in] p_mux  Pointer to the instance.
+ */
+void nus_mux_reset(nus_mux_t * p_mux);
+
+
+/**@brief Function for setting the largest packet the lower layer accepts.
+ *
+ * @param[in] p_mux        Pointer to the instance.
+ * @param[in] payload_max  Largest packet, capped at @ref NUS_MUX_PACKET_MAX.
+ */
+void nus_mux_payload_max_set(nus_mux_t * p_mux, uint16_t payload_max);
+
+
+/**@brief Function for queueing data on a channel and starting transmission.
+ *
+ * @details The data is copied. A message longer than @ref NUS_MUX_MSG_MAX is queued in several
+ *          calls, with @p eom set only on the last one.
+ *
+ * @param[in] p_mux   Pointer to the instance.
+ * @param[in] ch      Channel.
+ * @param[in] p_data  Data to send.
+ * @param[in] len     Length of the data.
+ * @param[in] eom     True if the data ends a message.
+ *
+ * @retval NRF_SUCCESS              If the data was queued.
+ * @retval NRF_ERROR_INVALID_PARAM  If the channel does not exist.
+ * @retval NRF_ERROR_INVALID_LENGTH If the length is 0 or above @ref NUS_MUX_MSG_MAX.
+ * @retval NRF_ERROR_NO_MEM         If the channel queue is full. @ref NUS_MUX_EVT_TX_RDY follows
+ *                                  when there is room again.
+ */
+ret_code_t nus_mux_send(nus_mux_t    * p_mux,
+                        nus_mux_ch_t   ch,
+                        uint8_t const * p_data,
+                        uint16_t       len,
+                        bool           eom);
+
+
+/**@brief Function for queueing data on a channel without starting transmission.
+ *
+ * @details Only copies the data into the channel queue, so it can be called from a critical
+ *          region. Call @ref nus_mux_tx_process once the region is left.
+ *
+ * @param[in] p_mux   Pointer to the instance.
+ * @param[in] ch      Channel.
+ * @param[in] p_data  Data to send.
+ * @param[in] len     Length of the data.
+ * @param[in] eom     True if the data ends a message.
+ *
+ * @return The same as @ref nus_mux_send.
+ */
+ret_code_t nus_mux_queue(nus_mux_t    * p_mux,
+                         nus_mux_ch_t   ch,
+                         uint8_t const * p_data,
+                         uint16_t       len,
+                         bool           eom);
+
+
+/**@brief Function for passing queued data to the lower layer.
+ *
+ * @details Call this function whenever the lower layer has freed a buffer, for example on
+ *          BLE_GATTS_EVT_HVN_TX_COMPLETE or BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE. Generates one
+ *          @ref NUS_MUX_EVT_TX_SENT event per channel that had messages go out. The lower layer
+ *          is called with interrupts enabled, by one context at a time. A call that comes in
+ *          meanwhile leaves the work to that context.
+ *
+ * @param[in] p_mux  Pointer to the instance.
+ */
+void nus_mux_tx_process(nus_mux_t * p_mux);
+
+
+/**@brief Function for handling a packet received from the lower layer.
+ *
+ * @details Generates one @ref NUS_MUX_EVT_RX_DATA event per chunk. A malformed packet is dropped
+ *          from the first chunk that does not fit.
+ *
+ * @param[in] p_mux   Pointer to the instance.
+ * @param[in] p_data  Received packet.
+ * @param[in] length  Length of the packet.
+ */
+void nus_mux_on_data(nus_mux_t * p_mux, uint8_t const * p_data, uint16_t length);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_MUX_H__
+
+/** @} */
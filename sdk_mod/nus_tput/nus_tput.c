@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(NUS_TPUT)
+#include <string.h>
+
+#include "nus_tput.h"
+#include "ble_gatt.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#ifdef FREERTOS
+#include "FreeRTOS.h"
+#endif
+
+#define NRF_LOG_MODULE_NAME nus_tput
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#ifdef FREERTOS
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000) / configTICK_RATE_HZ))
+#else
+#define TICKS_TO_MS(_ticks) ((uint32_t)(((uint64_t)(_ticks) * 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)) / APP_TIMER_CLOCK_FREQ))
+#endif
+
+#define START_LEN           2       /**< Length of @ref NUS_MUX_OP_TPUT_START. */
+
+STATIC_ASSERT(NUS_TPUT_RESULT_LEN + NUS_MUX_HDR_LEN <= BLE_GATT_ATT_MTU_DEFAULT - 3);
+
+
+/**@brief Function for clearing the receive statistics. */
+static void rx_clear(nus_tput_t * p_tput)
+{
+        CRITICAL_REGION_ENTER();
+        memset(&p_tput->rx, 0, sizeof(p_tput->rx));
+        p_tput->rx_first = 0;
+        p_tput->rx_last  = 0;
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for taking a snapshot of the receive statistics.
+ *
+ * @param[in]  p_tput   Pointer to the instance.
+ * @param[out] p_stats  Statistics with the receive time filled in.
+ */
+static void rx_stats_get(nus_tput_t const * p_tput, nus_tput_rx_stats_t * p_stats)
+{
+        CRITICAL_REGION_ENTER();
+        *p_stats    = p_tput->rx;
+        p_stats->ms = (p_stats->chunks < 2) ? 0 :
+                      TICKS_TO_MS(app_timer_cnt_diff_compute(p_tput->rx_last, p_tput->rx_first));
+        CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for queueing test data until the test channel is full. */
+static void tx_fill(nus_tput_t * p_tput)
+{
+        uint8_t  msg[NUS_MUX_MSG_MAX];
+        uint16_t len;
+
+        // One message per packet, every packet then carries a single chunk header.
+        len = MIN(p_tput->p_mux->payload_max - NUS_MUX_HDR_LEN, sizeof(msg));
+
+        while (p_tput->tx_on)
+        {
+                for (uint16_t i = 0; i < len; i++)
+                {
+                        msg[i] = (uint8_t)(p_tput->tx_next + i);
+                }
+
+                if (nus_mux_send(p_tput->p_mux, NUS_MUX_CH_TEST, msg, len, true) != NRF_SUCCESS)
+                {
+                        // NUS_MUX_EVT_TX_RDY follows.
+                        break;
+                }
+                p_tput->tx_next += (uint8_t)len;
+        }
+}
+
+
+/**@brief Function for sending the receive statistics to the peer. */
+static void result_send(nus_tput_t * p_tput)
+{
+        nus_tput_rx_stats_t stats;
+        uint8_t             msg[NUS_TPUT_RESULT_LEN];
+        uint16_t            len = 0;
+        ret_code_t          err_code;
+
+        rx_stats_get(p_tput, &stats);
+
+        msg[len++] = NUS_MUX_OP_TPUT_RESULT;
+        len       += uint32_encode(stats.bytes, &msg[len]);
+        len       += uint32_encode(stats.chunks, &msg[len]);
+        len       += uint32_encode(stats.ms, &msg[len]);
+        len       += uint32_encode(stats.errors, &msg[len]);
+
+        err_code = nus_mux_send(p_tput->p_mux, NUS_MUX_CH_CTRL, msg, len, true);
+        if (err_code != NRF_SUCCESS)
+        {
+                NRF_LOG_WARNING("Throughput result not sent: 0x%x.", err_code);
+        }
+}
+
+
+ret_code_t nus_tput_init(nus_tput_t * p_tput, nus_tput_init_t const * p_init)
+{
+        VERIFY_PARAM_NOT_NULL(p_tput);
+        VERIFY_PARAM_NOT_NULL(p_init);
+        VERIFY_PARAM_NOT_NULL(p_init->p_mux);
+
+        p_tput->p_mux       = p_init->p_mux;
+        p_tput->evt_handler = p_init->evt_handler;
+
+        nus_tput_reset(p_tput);
+
+        return NRF_SUCCESS;
+}
+
+
+void nus_tput_reset(nus_tput_t * p_tput)
+{
+        p_tput->tx_on   = false;
+        p_tput->tx_next = 0;
+        p_tput->rx_next = 0;
+        rx_clear(p_tput);
+}
+
+
+ret_code_t nus_tput_start(nus_tput_t * p_tput, bool local_tx, bool peer_tx)
+{
+        ret_code_t err_code;
+        uint8_t    msg[START_LEN];
+
+        msg[0] = NUS_MUX_OP_TPUT_START;
+        msg[1] = peer_tx ? NUS_TPUT_FLAG_PEER_TX : 0;
+
+        err_code = nus_mux_send(p_tput->p_mux, NUS_MUX_CH_CTRL, msg, sizeof(msg), true);
+        VERIFY_SUCCESS(err_code);
+
+        rx_clear(p_tput);
+        p_tput->tx_on = local_tx;
+        tx_fill(p_tput);
+
+        return NRF_SUCCESS;
+}
+
+
+ret_code_t nus_tput_stop(nus_tput_t * p_tput)
+{
+        uint8_t msg = NUS_MUX_OP_TPUT_STOP;
+
+        p_tput->tx_on = false;
+
+        return nus_mux_send(p_tput->p_mux, NUS_MUX_CH_CTRL, &msg, sizeof(msg), true);
+}
+
+
+void nus_tput_on_ctrl(nus_tput_t * p_tput, uint8_t const * p_data, uint16_t len)
+{
+        switch (p_data[0])
+        {
+                case NUS_MUX_OP_TPUT_START:
+                        if (len < START_LEN)
+                        {
+                                break;
+                        }
+                        rx_clear(p_tput);
+                        p_tput->tx_on = (p_data[1] & NUS_TPUT_FLAG_PEER_TX) != 0;
+                        NRF_LOG_INFO("Throughput test started, %s.", p_tput->tx_on ? "sending" : "receiving");
+                        tx_fill(p_tput);
+                        break;
+
+                case NUS_MUX_OP_TPUT_STOP:
+                        p_tput->tx_on = false;
+                        result_send(p_tput);
+                        NRF_LOG_INFO("Throughput test stopped.");
+                        break;
+
+                case NUS_MUX_OP_TPUT_RESULT:
+                {
+                        nus_tput_rx_stats_t local;
+                        nus_tput_rx_stats_t peer;
+                        nus_tput_evt_t      evt;
+
+                        if ((len < NUS_TPUT_RESULT_LEN) || (p_tput->evt_handler == NULL))
+                        {
+                                break;
+                        }
+
+                        peer.bytes  = uint32_decode(&p_data[1]);
+                        peer.chunks = uint32_decode(&p_data[5]);
+                        peer.ms     = uint32_decode(&p_data[9]);
+                        peer.errors = uint32_decode(&p_data[13]);
+                        rx_stats_get(p_tput, &local);
+
+                        memset(&evt, 0, sizeof(evt));
+                        evt.type    = NUS_TPUT_EVT_RESULT;
+                        evt.p_local = &local;
+                        evt.p_peer  = &peer;
+
+                        p_tput->evt_handler(p_tput, &evt);
+                } break;
+
+                default:
+                        break;
+        }
+}
+
+
+void nus_tput_on_data(nus_tput_t * p_tput, uint8_t const * p_data, uint16_t len)
+{
+        uint32_t now = app_timer_cnt_get();
+
+        if (len == 0)
+        {
+                return;
+        }
+
+        CRITICAL_REGION_ENTER();
+
+        if (p_tput->rx.chunks == 0)
+        {
+                p_tput->rx_first = now;
+        }
+        else if (p_data[0] != p_tput->rx_next)
+        {
+                p_tput->rx.errors++;
+        }
+        p_tput->rx_last    = now;
+        p_tput->rx_next    = (uint8_t)(p_data[len - 1] + 1);
+        p_tput->rx.bytes  += len;
+        p_tput->rx.chunks++;
+
+        CRITICAL_REGION_EXIT();
+}
+
+
+void nus_tput_on_tx_rdy(nus_tput_t * p_tput)
+{
+        tx_fill(p_tput);
+}
+
+#endif // NRF_MODULE_ENABLED(NUS_TPUT)
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup nus_tput NUS throughput test
+ * @{
+ * @ingroup  ble_sdk_srv
+ * @brief    Streams generated data over the NUS multiplexer as fast as the link takes it.
+ *
+ * @details  The test data goes on @ref NUS_MUX_CH_TEST, the lowest priority channel, in messages
+ *           that fill one packet each. The transmit queue is refilled on every
+ *           @ref NUS_MUX_EVT_TX_RDY, so the lower layer always has a packet waiting. The data is a
+ *           running byte counter, and the receiver counts the chunks that do not continue it.
+ *
+ *           One end runs the test with three control messages on @ref NUS_MUX_CH_CTRL:
+ *
+ *           @code
+ *           NUS_MUX_OP_TPUT_START:  | op | flags |
+ *           NUS_MUX_OP_TPUT_STOP:   | op |
+ *           NUS_MUX_OP_TPUT_RESULT: | op | bytes (4) | chunks (4) | ms (4) | errors (4) |
+ *           @endcode
+ *
+ *           START clears the receive statistics of the peer and, with @ref NUS_TPUT_FLAG_PEER_TX,
+ *           makes it transmit. STOP makes it stop and answer with RESULT, the statistics of what it
+ *           received. Both directions are timed by their receiver, from the first to the last
+ *           chunk.
+ *
+ *           No heap is used. The test channel adds NUS_MUX_TX_BUF_SIZE bytes to every multiplexer.
+ */
+
+#ifndef NUS_TPUT_H__
+#define NUS_TPUT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "nus_mux.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NUS_TPUT_FLAG_PEER_TX   0x01    /**< Flag of @ref NUS_MUX_OP_TPUT_START, the peer transmits. */
+#define NUS_TPUT_RESULT_LEN     17      /**< Length of @ref NUS_MUX_OP_TPUT_RESULT. */
+
+/**@brief Receive statistics of one direction. */
+typedef struct
+{
+        uint32_t bytes;         /**< Bytes received. */
+        uint32_t chunks;        /**< Chunks received, one per packet while the sender keeps up. */
+        uint32_t ms;            /**< Time from the first to the last chunk in milliseconds. */
+        uint32_t errors;        /**< Chunks that did not continue the byte counter. */
+} nus_tput_rx_stats_t;
+
+/**@brief Throughput test event type. */
+typedef enum
+{
+        NUS_TPUT_EVT_RESULT     /**< The peer has answered @ref NUS_MUX_OP_TPUT_STOP. */
+} nus_tput_evt_type_t;
+
+/**@brief Throughput test event. */
+typedef struct
+{
+        nus_tput_evt_type_t         type;       /**< Type of the event. */
+        nus_tput_rx_stats_t const * p_local;    /**< What was received from the peer. */
+        nus_tput_rx_stats_t const * p_peer;     /**< What the peer received. */
+} nus_tput_evt_t;
+
+// Forward declaration of the nus_tput_t type.
+typedef struct nus_tput_s nus_tput_t;
+
+/**@brief Event handler type. */
+typedef void (* nus_tput_evt_handler_t)(nus_tput_t * p_tput, nus_tput_evt_t const * p_evt);
+
+/**@brief Throughput test instance, one per link. */
+struct nus_tput_s
+{
+        nus_mux_t            * p_mux;       /**< Multiplexer of the link. */
+        nus_tput_evt_handler_t evt_handler; /**< Application event handler. */
+        bool                   tx_on;       /**< True while test data is sent. */
+        uint8_t                tx_next;     /**< Next byte of the sent counter. */
+        uint8_t                rx_next;     /**< Next byte expected from the peer. */
+        uint32_t               rx_first;    /**< app_timer tick of the first chunk received. */
+        uint32_t               rx_last;     /**< app_timer tick of the last chunk received. */
+        nus_tput_rx_stats_t    rx;          /**< Receive statistics, ms filled in when read. */
+};
+
+/**@brief Throughput test initialization structure. */
+typedef struct
+{
+        nus_mux_t            * p_mux;       /**< Multiplexer of the link. */
+        nus_tput_evt_handler_t evt_handler; /**< Application event handler. */
+} nus_tput_init_t;
+
+
+/**@brief Function for initializing a throughput test instance.
+ *
+ * @param[out] p_tput  Pointer to the instance.
+ * @param[in]  p_init  Pointer to the initialization structure.
+ *
+ * @retval NRF_SUCCESS    If the instance was initialized.
+ * @retval NRF_ERROR_NULL If a NULL pointer or no multiplexer was given.
+ */
+ret_code_t nus_tput_init(nus_tput_t * p_tput, nus_tput_init_t const * p_init);
+
+
+/**@brief Function for stopping the test and clearing the statistics, when a link is established
+ *        or lost.
+ *
+ * @param[in] p_tput  Pointer to the instance.
+ */
+void nus_tput_reset(nus_tput_t * p_tput);
+
+
+/**@brief Function for starting a test on the link.
+ *
+ * @param[in] p_tput    Pointer to the instance.
+ * @param[in] local_tx  True to send test data to the peer.
+ * @param[in] peer_tx   True to make the peer send test data.
+ *
+ * @retval NRF_SUCCESS If the test was started.
+ * @return Otherwise, the error of @ref nus_mux_send for the start message.
+ */
+ret_code_t nus_tput_start(nus_tput_t * p_tput, bool local_tx, bool peer_tx);
+
+
+/**@brief Function for ending a test on the link.
+ *
+ * @details @ref NUS_TPUT_EVT_RESULT follows once the peer has answered.
+ *
+ * @param[in] p_tput  Pointer to the instance.
+ *
+ * @retval NRF_SUCCESS If the stop message was queued.
+ * @return Otherwise, the error of @ref nus_mux_send for the stop message.
+ */
+ret_code_t nus_tput_stop(nus_tput_t * p_tput);
+
+
+/**@brief Function for handling a throughput test message from @ref NUS_MUX_CH_CTRL.
+ *
+ * @param[in] p_tput  Pointer to the instance.
+ * @param[in] p_data  Message, starting with its opcode.
+ * @param[in] len     Length of the message.
+ */
+void nus_tput_on_ctrl(nus_tput_t * p_tput, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for handling a chunk received on @ref NUS_MUX_CH_TEST.
+ *
+ * @param[in] p_tput  Pointer to the instance.
+ * @param[in] p_data  Chunk data.
+ * @param[in] len     Length of the chunk data.
+ */
+void nus_tput_on_data(nus_tput_t * p_tput, uint8_t const * p_data, uint16_t len);
+
+
+/**@brief Function for refilling the test channel, on @ref NUS_MUX_EVT_TX_RDY for
+ *        @ref NUS_MUX_CH_TEST.
+ *
+ * @param[in] p_tput  Pointer to the instance.
+ */
+void nus_tput_on_tx_rdy(nus_tput_t * p_tput);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_TPUT_H__
+
+/** @} */
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(PPG)
+#include "ppg.h"
+#include "nrf.h"
+#include "nrfx_saadc.h"
+#include "nrfx_timer.h"
+#include "nrfx_ppi.h"
+#include "app_util_platform.h"
+
+#define NRF_LOG_MODULE_NAME ppg
+#include "nrf_log.h"
+NRF_LOG_MODULE_REGISTER();
+
+#define SAADC_CHANNEL       0                                   /**< SAADC channel of the sensor. */
+#define SAMPLE_PERIOD_US    (1000000 / PPG_DSP_FS_HZ)           /**< Sampling period. */
+
+STATIC_ASSERT(PPG_BUFFER_SIZE > 0);
+
+/**@brief Acquisition statistics. */
+typedef struct
+{
+        uint32_t buffers;       /**< Buffers processed. */
+        uint32_t overruns;      /**< Buffers handed out before the previous one was processed. */
+        uint32_t cycles;        /**< CPU cycles spent in the DSP. */
+        uint32_t cycles_max;    /**< Most CPU cycles spent on one buffer. */
+} ppg_stats_t;
+
+static const nrfx_timer_t   m_timer = NRFX_TIMER_INSTANCE(PPG_TIMER_INSTANCE);  /**< Timer pacing the samples. */
+static nrf_ppi_channel_t    m_ppi_channel;                                      /**< PPI channel from the timer compare to the SAADC SAMPLE task. */
+static nrf_saadc_value_t    m_buffer[2][PPG_BUFFER_SIZE];                       /**< EasyDMA buffers. */
+static ppg_buffer_handler_t m_buffer_handler;                                   /**< Handler for the full buffers. */
+static volatile uint8_t     m_pending;                                          /**< Buffers handed out and not processed yet. */
+static ppg_dsp_t            m_dsp;                                              /**< Filter and beat detector. */
+static ppg_stats_t          m_stats;                                            /**< Statistics. */
+
+
+/**@brief Function for handling the timer events. The compare event only drives PPI. */
+static void timer_evt_handler(nrf_timer_event_t event_type, void * p_context)
+{
+        UNUSED_PARAMETER(event_type);
+        UNUSED_PARAMETER(p_context);
+}
+
+
+/**@brief Function for handling the SAADC events.
+ *
+ * @param[in] p_event  SAADC event.
+ */
+static void saadc_evt_handler(nrfx_saadc_evt_t const * p_event)
+{
+        ret_code_t err_code;
+
+        if (p_event->type != NRFX_SAADC_EVT_DONE)
+        {
+                return;
+        }
+
+        // The SAADC is filling the other buffer already. This one is queued behind it, so it
+        // is not written again for a whole buffer period.
+        err_code = nrfx_saadc_buffer_convert(p_event->data.done.p_buffer, PPG_BUFFER_SIZE);
+        APP_ERROR_CHECK(err_code);
+
+        if (m_pending != 0)
+        {
+                m_stats.overruns++;
+        }
+        m_pending++;
+
+        m_buffer_handler(p_event->data.done.p_buffer, p_event->data.done.size);
+}
+
+
+ret_code_t ppg_init(ppg_init_t const * p_init)
+{
+        ret_code_t                 err_code;
+        nrfx_saadc_config_t        saadc_config   = NRFX_SAADC_DEFAULT_CONFIG;
+        nrf_saadc_channel_config_t channel_config = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(PPG_SAADC_INPUT);
+        nrfx_timer_config_t        timer_config   = NRFX_TIMER_DEFAULT_CONFIG;
+
+        VERIFY_PARAM_NOT_NULL(p_init);
+        VERIFY_PARAM_NOT_NULL(p_init->buffer_handler);
+
+        m_buffer_handler = p_init->buffer_handler;
+        ppg_dsp_init(&m_dsp, p_init->beat_handler, p_init->p_context, PPG_INVERT);
+
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+        // 12 bits over 0 to VDD, the sensor output is ratiometric.
+        saadc_config.resolution     = NRF_SAADC_RESOLUTION_12BIT;
+        saadc_config.oversample     = NRF_SAADC_OVERSAMPLE_DISABLED;
+        saadc_config.low_power_mode = false;
+
+        channel_config.gain      = NRF_SAADC_GAIN1_4;
+        channel_config.reference = NRF_SAADC_REFERENCE_VDD4;
+
+        err_code = nrfx_saadc_init(&saadc_config, saadc_evt_handler);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = nrfx_saadc_channel_init(SAADC_CHANNEL, &channel_config);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = nrfx_saadc_buffer_convert(m_buffer[0], PPG_BUFFER_SIZE);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = nrfx_saadc_buffer_convert(m_buffer[1], PPG_BUFFER_SIZE);
+        VERIFY_SUCCESS(err_code);
+
+        timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+        timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+
+        err_code = nrfx_timer_init(&m_timer, &timer_config, timer_evt_handler);
+        VERIFY_SUCCESS(err_code);
+
+        nrfx_timer_extended_compare(&m_timer,
+                                    NRF_TIMER_CC_CHANNEL0,
+                                    nrfx_timer_us_to_ticks(&m_timer, SAMPLE_PERIOD_US),
+                                    NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK,
+                                    false);
+
+        err_code = nrfx_ppi_channel_alloc(&m_ppi_channel);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = nrfx_ppi_channel_assign(m_ppi_channel,
+                                           nrfx_timer_compare_event_address_get(&m_timer, NRF_TIMER_CC_CHANNEL0),
+                                           nrfx_saadc_sample_task_get());
+        VERIFY_SUCCESS(err_code);
+
+        return nrfx_ppi_channel_enable(m_ppi_channel);
+}
+
+
+void ppg_start(void)
+{
+        nrfx_timer_enable(&m_timer);
+}
+
+
+void ppg_process(int16_t const * p_samples, uint16_t count)
+{
+        uint32_t start_cyc = DWT->CYCCNT;
+        uint32_t cycles;
+
+        ppg_dsp_process(&m_dsp, p_samples, count);
+
+        cycles = DWT->CYCCNT - start_cyc;
+
+        CRITICAL_REGION_ENTER();
+        m_pending--;
+        CRITICAL_REGION_EXIT();
+
+        m_stats.buffers++;
+        m_stats.cycles    += cycles;
+        m_stats.cycles_max = MAX(m_stats.cycles_max, cycles);
+}
+
+
+uint16_t ppg_heart_rate_get(void)
+{
+        return ppg_dsp_heart_rate_get(&m_dsp);
+}
+
+
+bool ppg_contact_get(void)
+{
+        return ppg_dsp_contact_get(&m_dsp);
+}
+
+
+void ppg_stats_log(void)
+{
+        ppg_dsp_stats_t * p_dsp_stats = &m_dsp.stats;
+
+        NRF_LOG_INFO("PPG: %d samples, %d beats, %d rejected, %d overruns, heart rate %d.",
+                     p_dsp_stats->samples,
+                     p_dsp_stats->beats,
+                     p_dsp_stats->rejected,
+                     m_stats.overruns,
+                     ppg_dsp_heart_rate_get(&m_dsp));
+        if (p_dsp_stats->samples != 0)
+        {
+                NRF_LOG_INFO("PPG DSP: %d cycles per sample, %d cycles at most per buffer of %d.",
+                             m_stats.cycles / p_dsp_stats->samples,
+                             m_stats.cycles_max,
+                             PPG_BUFFER_SIZE);
+        }
+
+        memset(p_dsp_stats, 0, sizeof(ppg_dsp_stats_t));
+        memset(&m_stats, 0, sizeof(m_stats));
+}
+
+#endif // NRF_MODULE_ENABLED(PPG)
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ppg PPG heart rate sensor
+ * @{
+ * @ingroup  ble_sdk_lib
+ * @brief    Photoplethysmogram acquisition on the SAADC, feeding @ref ppg_dsp.
+ *
+ * @details  A TIMER compare event triggers the SAADC SAMPLE task through PPI every
+ *           1 / @ref PPG_DSP_FS_HZ seconds, so sampling does not depend on interrupt latency. The
+ *           SAADC writes the samples with EasyDMA into two buffers of @ref PPG_BUFFER_SIZE samples.
+ *           It fills one while the other is processed.
+ *
+ *           The SAADC interrupt hands every full buffer to the buffer handler. The handler must
+ *           defer the work to a thread that calls @ref ppg_process. That thread must finish with
+ *           the buffer before the other one fills, which takes PPG_BUFFER_SIZE samples. A late
+ *           buffer is counted as an overrun.
+ *
+ *           The DWT cycle counter measures the cost of @ref ppg_process per sample.
+ */
+
+#ifndef PPG_H__
+#define PPG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "ppg_dsp.h"
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**@brief Buffer handler type, called from the SAADC interrupt for every full buffer.
+ *
+ * @param[in] p_samples  Samples, to be passed to @ref ppg_process.
+ * @param[in] count      Number of samples.
+ */
+typedef void (* ppg_buffer_handler_t)(int16_t const * p_samples, uint16_t count);
+
+/**@brief Initialization parameters. */
+typedef struct
+{
+        ppg_buffer_handler_t   buffer_handler;  /**< Handler for the full buffers, called in interrupt context. */
+        ppg_dsp_beat_handler_t beat_handler;    /**< Handler for the RR intervals, called from @ref ppg_process. */
+        void                 * p_context;       /**< Context passed to the beat handler. */
+} ppg_init_t;
+
+
+/**@brief Function for initializing the SAADC, the TIMER and the PPI channel.
+ *
+ * @param[in] p_init  Initialization parameters.
+ *
+ * @retval NRF_SUCCESS If the drivers were initialized.
+ * @return Error code of the SAADC, TIMER or PPI driver otherwise.
+ */
+ret_code_t ppg_init(ppg_init_t const * p_init);
+
+
+/**@brief Function for starting the sampling. */
+void ppg_start(void);
+
+
+/**@brief Function for running the filter and the beat detection on a full buffer.
+ *
+ * @param[in] p_samples  Samples given to the buffer handler.
+ * @param[in] count      Number of samples.
+ */
+void ppg_process(int16_t const * p_samples, uint16_t count);
+
+
+/**@brief Function for getting the heart rate.
+ *
+ * @return Heart rate in beats per minute, 0 without a pulse.
+ */
+uint16_t ppg_heart_rate_get(void);
+
+
+/**@brief Function for telling whether the sensor sees a pulse.
+ *
+ * @return True if a beat has been detected recently.
+ */
+bool ppg_contact_get(void);
+
+
+/**@brief Function for logging the statistics gathered since the previous call, then clearing them. */
+void ppg_stats_log(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPG_H__
+
+/** @} */
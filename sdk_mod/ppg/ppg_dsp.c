@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "sdk_common.h"
+#if NRF_MODULE_ENABLED(PPG)
+#include <stdlib.h>
+#include <string.h>
+
+#include "ppg_dsp.h"
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "nrf.h"
+#endif
+
+#define DC_A                31755                                       /**< Pole of the DC blocker, exp(-2 pi 0.5 / 100) in Q15. */
+#define RR_MIN_SAMPLES      ((PPG_DSP_RR_MIN_MS * PPG_DSP_FS_HZ) / 1000)     /**< Refractory period after a beat, in samples. */
+#define RR_MAX_SAMPLES      ((PPG_DSP_RR_MAX_MS * PPG_DSP_FS_HZ) / 1000)     /**< Longest RR interval in samples. */
+#define RR_MIN              ((PPG_DSP_RR_MIN_MS * 1024) / 1000)          /**< Shortest RR interval in 1/1024 seconds. */
+#define RR_MAX              ((PPG_DSP_RR_MAX_MS * 1024) / 1000)          /**< Longest RR interval in 1/1024 seconds. */
+#define THR_NUM             5                                           /**< Beat threshold in eighths of the pulse amplitude. */
+#define REFRACTORY_PCT      50                                          /**< Refractory period in percent of the average RR interval. */
+#define CONTACT_SAMPLES     ((PPG_DSP_CONTACT_MS * PPG_DSP_FS_HZ) / 1000)    /**< Contact timeout in samples. */
+
+/**@brief Packs two 16-bit values into a word, the first one in the low half. */
+#define PACK(_lo, _hi)      (((uint32_t)(uint16_t)(_lo)) | ((uint32_t)(uint16_t)(_hi) << 16))
+
+/* Butterworth low-pass, 5 Hz at 100 Hz, as two biquads with Q14 coefficients. The feedback
+ * coefficients are negated so that every term is accumulated. */
+static const int16_t  m_b0[PPG_DSP_STAGES]  = {312, 359};                              /**< b0 of each biquad. */
+static const uint32_t m_b12[PPG_DSP_STAGES] = {PACK(624, 312), PACK(717, 359)};        /**< b1 and b2 of each biquad. */
+static const uint32_t m_a12[PPG_DSP_STAGES] = {PACK(24243, -9107), PACK(27869, -12919)}; /**< -a1 and -a2 of each biquad. */
+
+
+/**@brief Function for the dual signed 16-bit multiply with a 32-bit accumulate.
+ *
+ * @param[in] x    Two samples, packed.
+ * @param[in] y    Two coefficients, packed.
+ * @param[in] acc  Accumulator.
+ *
+ * @return acc + x.lo * y.lo + x.hi * y.hi.
+ */
+static __INLINE int32_t smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return (int32_t)__SMLAD(x, y, (uint32_t)acc);
+#else
+        return acc
+               + (int32_t)(int16_t)(x & 0xFFFF) * (int16_t)(y & 0xFFFF)
+               + (int32_t)(int16_t)(x >> 16)    * (int16_t)(y >> 16);
+#endif
+}
+
+
+/**@brief Function for shifting a sample into a packed pair.
+ *
+ * @param[in] v     New sample.
+ * @param[in] pair  Pair, latest sample in the low half.
+ *
+ * @return The new sample in the low half and the previous latest one in the high half.
+ */
+static __INLINE uint32_t shift_in(int16_t v, uint32_t pair)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return __PKHBT((uint32_t)v, pair, 16);
+#else
+        return PACK(v, pair);
+#endif
+}
+
+
+/**@brief Function for saturating a value to 16 bits.
+ *
+ * @param[in] v  Value.
+ *
+ * @return The value, clamped to the int16_t range.
+ */
+static __INLINE int16_t sat16(int32_t v)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+        return (int16_t)__SSAT(v, 16);
+#else
+        return (v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : (int16_t)v);
+#endif
+}
+
+
+/**@brief Function for filtering one sample.
+ *
+ * @param[in] p_dsp   Pointer to the instance.
+ * @param[in] sample  12-bit sample.
+ *
+ * @return Filtered sample.
+ */
+static int16_t filter(ppg_dsp_t * p_dsp, int16_t sample)
+{
+        int16_t x = (int16_t)(sample * 4);
+        int16_t s;
+
+        if (p_dsp->invert)
+        {
+                x = -x;
+        }
+
+        if (p_dsp->n == 0)
+        {
+                // Start from the DC level rather than from a step.
+                p_dsp->dc_x1 = x;
+        }
+
+        // DC blocker, the output keeps its fraction so that the slow pole does not stall.
+        p_dsp->dc_y1 = (int32_t)(((int64_t)DC_A * p_dsp->dc_y1) >> 15)
+                       + ((int32_t)(x - p_dsp->dc_x1) << 15);
+        p_dsp->dc_x1 = x;
+        s            = sat16(p_dsp->dc_y1 >> 15);
+
+        for (uint32_t i = 0; i < PPG_DSP_STAGES; i++)
+        {
+                int32_t acc = (int32_t)m_b0[i] * s;
+                int16_t y;
+
+                acc = smlad(p_dsp->x_state[i], m_b12[i], acc);
+                acc = smlad(p_dsp->y_state[i], m_a12[i], acc);
+                y   = sat16((acc + (1 << 13)) >> 14);
+
+                p_dsp->x_state[i] = shift_in(s, p_dsp->x_state[i]);
+                p_dsp->y_state[i] = shift_in(y, p_dsp->y_state[i]);
+                s                 = y;
+        }
+
+        return s;
+}
+
+
+/**@brief Function for getting the lowest filtered sample over the upstroke of a peak.
+ *
+ * @param[in] p_dsp  Pointer to the instance.
+ *
+ * @return Lowest of the last @ref PPG_DSP_UPSTROKE_LEN samples.
+ */
+static int16_t upstroke_min(ppg_dsp_t const * p_dsp)
+{
+        int16_t low = INT16_MAX;
+
+        for (uint32_t i = 0; i < PPG_DSP_UPSTROKE_LEN; i++)
+        {
+                low = MIN(low, p_dsp->hist[i]);
+        }
+
+        return low;
+}
+
+
+/**@brief Function for getting the time after a beat during which no other beat is taken.
+ *
+ * @details Once the average is established the refractory period grows with it, so that the
+ *          dicrotic wave of a slow pulse is not taken for a beat.
+ *
+ * @param[in] p_dsp  Pointer to the instance.
+ *
+ * @return Refractory period in samples.
+ */
+static uint32_t refractory_get(ppg_dsp_t const * p_dsp)
+{
+        uint32_t samples = RR_MIN_SAMPLES;
+
+        if (p_dsp->rr_count >= PPG_DSP_RR_AVG_MIN)
+        {
+                // REFRACTORY_PCT percent of the average, from 1/1024 seconds to samples.
+                samples = MAX(samples, ((uint32_t)p_dsp->rr_avg * REFRACTORY_PCT * PPG_DSP_FS_HZ) / (100 * 1024));
+        }
+
+        return samples;
+}
+
+
+/**@brief Function for checking an RR interval and passing it on.
+ *
+ * @param[in] p_dsp  Pointer to the instance.
+ * @param[in] rr     RR interval in 1/1024 seconds.
+ */
+static void rr_on(ppg_dsp_t * p_dsp, uint16_t rr)
+{
+        if ((rr < RR_MIN) || (rr > RR_MAX))
+        {
+                p_dsp->stats.rejected++;
+                return;
+        }
+
+        if (p_dsp->rr_count >= PPG_DSP_RR_AVG_MIN)
+        {
+                uint32_t dev = (uint32_t)abs((int32_t)rr - p_dsp->rr_avg);
+
+                if (dev * 100 > (uint32_t)p_dsp->rr_avg * PPG_DSP_RR_DEV_PCT)
+                {
+                        // A missed or an extra beat. Several in a row mean the rate has moved.
+                        p_dsp->stats.rejected++;
+                        if (++p_dsp->rr_rejects >= PPG_DSP_RR_REJECT_MAX)
+                        {
+                                p_dsp->rr_count   = 0;
+                                p_dsp->rr_rejects = 0;
+                        }
+                        return;
+                }
+        }
+
+        p_dsp->rr_rejects = 0;
+        if (p_dsp->rr_count == 0)
+        {
+                p_dsp->rr_avg = rr;
+        }
+        else
+        {
+                p_dsp->rr_avg = (uint16_t)(p_dsp->rr_avg + ((int32_t)rr - p_dsp->rr_avg) / 4);
+        }
+        if (p_dsp->rr_count < UINT8_MAX)
+        {
+                p_dsp->rr_count++;
+        }
+
+        if (p_dsp->beat_handler != NULL)
+        {
+                p_dsp->beat_handler(p_dsp->p_context, rr);
+        }
+}
+
+
+/**@brief Function for handling a beat at the previous sample.
+ *
+ * @param[in] p_dsp   Pointer to the instance.
+ * @param[in] height  Rise of the filtered signal over the upstroke.
+ * @param[in] frac    Offset of the peak from the previous sample, 1/256 sample.
+ */
+static void beat_on(ppg_dsp_t * p_dsp, int32_t height, int16_t frac)
+{
+        uint32_t beat_n = p_dsp->n - 1;
+
+        p_dsp->stats.beats++;
+        // The amplitude rises quickly and falls slowly, so that the dicrotic wave of a beat
+        // taken by mistake barely lowers the threshold.
+        if ((height << 8) > p_dsp->amp)
+        {
+                p_dsp->amp += ((height << 8) - p_dsp->amp) / 2;
+        }
+        else
+        {
+                p_dsp->amp += ((height << 8) - p_dsp->amp) / 16;
+        }
+
+        if (p_dsp->synced && (beat_n - p_dsp->beat_n <= RR_MAX_SAMPLES))
+        {
+                int32_t d = (int32_t)(beat_n - p_dsp->beat_n) * 256 + frac - p_dsp->beat_frac;
+
+                // 1/256 sample to 1/1024 second.
+                rr_on(p_dsp, (uint16_t)((d * 4 + PPG_DSP_FS_HZ / 2) / PPG_DSP_FS_HZ));
+        }
+        else
+        {
+                // First beat, or the first after a gap. The average starts over.
+                p_dsp->rr_count   = 0;
+                p_dsp->rr_rejects = 0;
+        }
+
+        p_dsp->synced    = true;
+        p_dsp->beat_n    = beat_n;
+        p_dsp->beat_frac = frac;
+}
+
+
+void ppg_dsp_init(ppg_dsp_t            * p_dsp,
+                  ppg_dsp_beat_handler_t beat_handler,
+                  void                 * p_context,
+                  bool                   invert)
+{
+        memset(p_dsp, 0, sizeof(ppg_dsp_t));
+
+        p_dsp->beat_handler = beat_handler;
+        p_dsp->p_context    = p_context;
+        p_dsp->invert       = invert;
+}
+
+
+void ppg_dsp_process(ppg_dsp_t * p_dsp, int16_t const * p_samples, uint16_t count)
+{
+        for (uint16_t i = 0; i < count; i++)
+        {
+                int16_t y0 = filter(p_dsp, p_samples[i]);
+                int16_t y1 = p_dsp->y1;
+                int16_t y2 = p_dsp->y2;
+
+                // The amplitude decays with a time constant of 512 samples.
+                p_dsp->amp -= p_dsp->amp / 512;
+
+                if ((p_dsp->n >= 2) && (y1 > y2) && (y1 >= y0))
+                {
+                        // The rise over the upstroke only, so that baseline wander left by the
+                        // DC blocker barely moves it.
+                        int32_t rise = (int32_t)y1 - upstroke_min(p_dsp);
+                        int32_t thr  = MAX((p_dsp->amp * THR_NUM) >> 11, PPG_DSP_AMP_MIN);
+
+                        if ((rise > thr)
+                            && (!p_dsp->synced || (p_dsp->n - 1 - p_dsp->beat_n >= refractory_get(p_dsp))))
+                        {
+                                // Vertex of the parabola through y2, y1, y0, within half a sample.
+                                int32_t den  = (int32_t)y2 - 2 * (int32_t)y1 + y0;
+                                int16_t frac = (int16_t)((((int32_t)y2 - y0) * 128) / den);
+
+                                beat_on(p_dsp, rise, frac);
+                        }
+                }
+
+                p_dsp->hist[p_dsp->n % PPG_DSP_UPSTROKE_LEN] = y0;
+                p_dsp->y2 = y1;
+                p_dsp->y1 = y0;
+                p_dsp->n++;
+        }
+
+        p_dsp->stats.samples += count;
+}
+
+
+uint16_t ppg_dsp_heart_rate_get(ppg_dsp_t const * p_dsp)
+{
+        if (!ppg_dsp_contact_get(p_dsp) || (p_dsp->rr_count < PPG_DSP_RR_AVG_MIN))
+        {
+                return 0;
+        }
+
+        return (uint16_t)((60 * 1024 + p_dsp->rr_avg / 2) / p_dsp->rr_avg);
+}
+
+
+bool ppg_dsp_contact_get(ppg_dsp_t const * p_dsp)
+{
+        return p_dsp->synced && (p_dsp->n - p_dsp->beat_n <= CONTACT_SAMPLES);
+}
+
+#endif // NRF_MODULE_ENABLED(PPG)
@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @defgroup ppg_dsp PPG beat detection
+ * @{
+ * @ingroup  ppg
+ * @brief    Fixed-point band-pass filter and beat detector for a photoplethysmogram.
+ *
+ * @details  The samples go through a first order DC blocker with a corner at 0.5 Hz and a fourth
+ *           order Butterworth low-pass at 5 Hz, built as two biquads with Q14 coefficients. The
+ *           biquads use the dual 16-bit multiply-accumulate of the Cortex-M4 when the compiler
+ *           targets it, and the same arithmetic in plain C otherwise.
+ *
+ *           A beat is a local maximum of the filtered signal that rises over the upstroke before
+ *           it by more than 5/8 of the pulse amplitude, at least @ref PPG_DSP_RR_MIN_MS after the
+ *           previous beat and at least half of the average RR interval once it is established. The
+ *           amplitude follows the rise of the beats and decays between them. The peak time is refined to 1/256 of a
+ *           sample with a parabola through the three samples around the maximum.
+ *
+ *           An RR interval is reported when it is in range and, once the average is established,
+ *           within @ref PPG_DSP_RR_DEV_PCT percent of the average. The heart rate follows the
+ *           average of the RR intervals.
+ *
+ *           The coefficients are designed for @ref PPG_DSP_FS_HZ. The code uses no SDK driver,
+ *           so it runs unchanged on recorded signals.
+ */
+
+#ifndef PPG_DSP_H__
+#define PPG_DSP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PPG_DSP_FS_HZ           100             /**< Sample rate in Hz. */
+#define PPG_DSP_STAGES          2               /**< Biquads of the low-pass filter. */
+#define PPG_DSP_RR_MIN_MS       300             /**< Shortest RR interval, 200 beats per minute. */
+#define PPG_DSP_RR_MAX_MS       2000            /**< Longest RR interval, 30 beats per minute. */
+#define PPG_DSP_RR_DEV_PCT      20              /**< Largest deviation of an RR interval from the average. */
+#define PPG_DSP_RR_AVG_MIN      4               /**< RR intervals that establish the average. */
+#define PPG_DSP_RR_REJECT_MAX   3               /**< Consecutive rejected RR intervals that restart the average. */
+#define PPG_DSP_UPSTROKE_LEN    25              /**< Samples over which the rise of a beat is measured. */
+#define PPG_DSP_AMP_MIN         8               /**< Smallest pulse amplitude, in filtered units, taken as a beat. */
+#define PPG_DSP_CONTACT_MS      3000            /**< Time without a beat after which the contact is lost. */
+
+/**@brief Beat handler type, called for every RR interval that passes the checks.
+ *
+ * @param[in] p_context    Context given at initialization.
+ * @param[in] rr_interval  RR interval in 1/1024 seconds.
+ */
+typedef void (* ppg_dsp_beat_handler_t)(void * p_context, uint16_t rr_interval);
+
+/**@brief Detector statistics. */
+typedef struct
+{
+        uint32_t samples;       /**< Samples processed. */
+        uint32_t beats;         /**< Beats detected. */
+        uint32_t rejected;      /**< RR intervals out of range or too far from the average. */
+} ppg_dsp_stats_t;
+
+/**@brief Filter and detector state. */
+typedef struct
+{
+        ppg_dsp_beat_handler_t beat_handler;            /**< Beat handler. */
+        void                 * p_context;               /**< Context passed to the handler. */
+        bool                   invert;                  /**< True if the pulse shows as a dip of the input. */
+        int16_t                dc_x1;                   /**< Last input of the DC blocker. */
+        int32_t                dc_y1;                   /**< Last output of the DC blocker, Q15 fraction kept. */
+        uint32_t               x_state[PPG_DSP_STAGES]; /**< Last two inputs of each biquad, packed, latest in the low half. */
+        uint32_t               y_state[PPG_DSP_STAGES]; /**< Last two outputs of each biquad, packed, latest in the low half. */
+        int16_t                y1;                      /**< Filtered sample n - 1. */
+        int16_t                y2;                      /**< Filtered sample n - 2. */
+        int16_t                hist[PPG_DSP_UPSTROKE_LEN]; /**< Last filtered samples. */
+        int32_t                amp;                     /**< Pulse amplitude, Q8. */
+        uint32_t               n;                       /**< Index of the current sample. */
+        bool                   synced;                  /**< True once a beat has been detected. */
+        uint32_t               beat_n;                  /**< Sample index of the last beat. */
+        int16_t                beat_frac;               /**< Offset of the last beat from its sample, 1/256 sample. */
+        uint16_t               rr_avg;                  /**< Average RR interval in 1/1024 seconds. */
+        uint8_t                rr_count;                /**< RR intervals in the average, established at @ref PPG_DSP_RR_AVG_MIN. */
+        uint8_t                rr_rejects;              /**< Consecutive rejected RR intervals. */
+        ppg_dsp_stats_t        stats;                   /**< Statistics. */
+} ppg_dsp_t;
+
+
+/**@brief Function for initializing the filter and detector.
+ *
+ * @param[out] p_dsp         Pointer to the instance.
+ * @param[in]  beat_handler  Handler for the RR intervals.
+ * @param[in]  p_context     Context passed to the handler.
+ * @param[in]  invert        True if the pulse shows as a dip of the input.
+ */
+void ppg_dsp_init(ppg_dsp_t            * p_dsp,
+                  ppg_dsp_beat_handler_t beat_handler,
+                  void                 * p_context,
+                  bool                   invert);
+
+
+/**@brief Function for processing a block of samples.
+ *
+ * @details The beat handler is called from within this function.
+ *
+ * @param[in] p_dsp      Pointer to the instance.
+ * @param[in] p_samples  Samples, 12-bit single ended.
+ * @param[in] count      Number of samples.
+ */
+void ppg_dsp_process(ppg_dsp_t * p_dsp, int16_t const * p_samples, uint16_t count);
+
+
+/**@brief Function for getting the heart rate.
+ *
+ * @param[in] p_dsp  Pointer to the instance.
+ *
+ * @return Heart rate in beats per minute, 0 while the RR average is not established or after
+ *         the contact has been lost.
+ */
+uint16_t ppg_dsp_heart_rate_get(ppg_dsp_t const * p_dsp);
+
+
+/**@brief Function for telling whether the sensor sees a pulse.
+ *
+ * @param[in] p_dsp  Pointer to the instance.
+ *
+ * @return True if a beat has been detected within the last @ref PPG_DSP_CONTACT_MS.
+ */
+bool ppg_dsp_contact_get(ppg_dsp_t const * p_dsp);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PPG_DSP_H__
+
+/** @} */
@@ -0,0 +1,394 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test and benchmark of the broadcast receiver.
+ *
+ * @details Synthetic report streams, each sensor repeating every measurement a few times and
+ *          some reports lost, go through the sensor table. The counters of every sensor are
+ *          checked against a model of the stream, the table is checked after refusals and
+ *          ageing, and the #advbench path is checked to leave the live table alone. The
+ *          benchmark times the handling of a report for a growing number of sensors.
+ */
+
+#include "host_test.h"
+#include "app_scheduler.h"
+
+#include "bcast_rx.c"
+#include "hrs_bcast.c"
+
+#define RATE                    400                             /**< Reports per second of the streams. */
+#define STEP                    (APP_TIMER_TICKS(1000) / RATE)  /**< Ticks between two reports. */
+#define BENCH_REPORTS           200000                          /**< Reports per benchmark run. */
+
+/**@brief Model of a sensor, as the table should see it. */
+typedef struct
+{
+        bool     seen;          /**< A measurement of the sensor went through. */
+        uint8_t  seq;           /**< Sequence number of the latest measurement sent. */
+        uint8_t  seq_rcvd;      /**< Sequence number of the latest measurement received. */
+        uint16_t meas;          /**< New measurements received. */
+        uint16_t dup;           /**< Repeated measurements received. */
+        uint16_t lost;          /**< Measurements missing from the received sequence. */
+} model_t;
+
+/**@brief Synthetic report. */
+typedef struct
+{
+        ble_gap_addr_t addr;
+        uint8_t        adv[3 + 4 + HRS_BCAST_DATA_LEN];
+        bool           lost;
+} stream_report_t;
+
+static model_t         m_model[BCAST_RX_BENCH_SENSORS_MAX];
+static stream_report_t m_stream[BENCH_REPORTS];
+static uint32_t        m_sched_puts;
+static bool            m_sched_full;
+
+
+ret_code_t app_evt_queue_sched_put(app_sched_event_handler_t handler, void const * p_data, uint16_t size)
+{
+        if (m_sched_full)
+        {
+                return NRF_ERROR_NO_MEM;
+        }
+        m_sched_puts++;
+        return app_sched_event_put(p_data, size, handler);
+}
+
+
+/**@brief Function for generating a report of a stream, the same way as the benchmark command. */
+static void stream_report(uint32_t * p_rand, uint32_t sensors, hrs_bcast_enc_t * p_enc,
+                          stream_report_t * p_report, uint32_t * p_sensor)
+{
+        uint32_t r      = bench_rand(p_rand);
+        uint32_t sensor = r % sensors;
+
+        memset(&p_report->addr, 0, sizeof(p_report->addr));
+        p_report->addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+        (void)uint32_encode(sensor * 0x9E3779B1UL, p_report->addr.addr);
+        (void)uint16_encode((uint16_t)(0xC000 | sensor), &p_report->addr.addr[4]);
+
+        if ((r >> 16) % BENCH_REPEAT == 0)
+        {
+                m_model[sensor].seq++;
+        }
+
+        p_report->adv[0] = 2;
+        p_report->adv[1] = BLE_GAP_AD_TYPE_FLAGS;
+        p_report->adv[2] = BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED;
+        p_report->adv[3] = 1 + 2 + HRS_BCAST_DATA_LEN;
+        p_report->adv[4] = BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA;
+        (void)uint16_encode(HRS_BCAST_COMPANY_ID, &p_report->adv[5]);
+        p_enc->seq = m_model[sensor].seq;
+        hrs_bcast_enc_meas(p_enc, 60 + (r >> 24) % 60, &p_report->adv[7]);
+
+        p_report->lost = ((r >> 8) % 100 < BENCH_LOSS_PERCENT);
+        *p_sensor      = sensor;
+}
+
+
+/**@brief Function for updating the model of a sensor with a received report. */
+static void model_rcvd(model_t * p_model)
+{
+        uint8_t seq_diff = (uint8_t)(p_model->seq - p_model->seq_rcvd);
+
+        if (!p_model->seen)
+        {
+                p_model->seen = true;
+                p_model->meas++;
+        }
+        else if (seq_diff == 0)
+        {
+                p_model->dup++;
+        }
+        else
+        {
+                p_model->meas++;
+                p_model->lost += (seq_diff < SEQ_RESTART) ? seq_diff - 1 : 0;
+        }
+        p_model->seq_rcvd = p_model->seq;
+}
+
+
+/**@brief Function for sending a stream through the live table, as the scanner would. */
+static void stream_send(uint32_t sensors, uint32_t reports)
+{
+        hrs_bcast_enc_t enc;
+        uint32_t        rand = BENCH_SEED;
+
+        memset(m_model, 0, sizeof(m_model));
+        hrs_bcast_enc_init(&enc);
+
+        for (uint32_t i = 0; i < reports; i++)
+        {
+                stream_report_t          report;
+                ble_gap_evt_adv_report_t adv_report;
+                uint32_t                 sensor;
+
+                stream_report(&rand, sensors, &enc, &report, &sensor);
+                m_host_app_timer_cnt += STEP;
+                if (report.lost)
+                {
+                        continue;
+                }
+
+                adv_report.peer_addr   = report.addr;
+                adv_report.rssi        = -60;
+                adv_report.data.p_data = report.adv;
+                adv_report.data.len    = sizeof(report.adv);
+
+                if ((m_table.count < PEERS_MAX) || m_model[sensor].seen)
+                {
+                        model_rcvd(&m_model[sensor]);
+                }
+                bcast_rx_on_adv_report(&adv_report);
+        }
+}
+
+
+/**@brief Function for checking that every sensor of a table is found from its home slot. */
+static void table_check(bcast_table_t * p_table)
+{
+        uint32_t count = 0;
+
+        for (uint32_t slot = 0; slot < TABLE_SIZE; slot++)
+        {
+                bcast_peer_t * p_peer = &p_table->peers[slot];
+                bool           found;
+
+                if (p_peer->addr_type == TYPE_EMPTY)
+                {
+                        continue;
+                }
+                count++;
+                TEST_CHECK_EQ(peer_find(p_table, p_peer->addr, p_peer->addr_type, &found), slot);
+                TEST_CHECK(found);
+        }
+        TEST_CHECK_EQ(count, p_table->count);
+        TEST_CHECK(p_table->count <= PEERS_MAX);
+}
+
+
+static void test_counters(void)
+{
+        uint32_t sensors = 40;
+
+        bcast_rx_init();
+        stream_send(sensors, 20000);
+
+        TEST_CHECK_EQ(m_table.count, sensors);
+        TEST_CHECK_EQ(m_table.stats.full, 0);
+        TEST_CHECK_EQ(m_table.stats.aged, 0);
+        table_check(&m_table);
+
+        for (uint32_t i = 0; i < sensors; i++)
+        {
+                ble_gap_addr_t addr;
+                bool           found;
+                uint32_t       slot;
+
+                memset(&addr, 0, sizeof(addr));
+                (void)uint32_encode(i * 0x9E3779B1UL, addr.addr);
+                (void)uint16_encode((uint16_t)(0xC000 | i), &addr.addr[4]);
+
+                slot = peer_find(&m_table, addr.addr, BLE_GAP_ADDR_TYPE_RANDOM_STATIC, &found);
+                TEST_CHECK(found);
+                TEST_CHECK_EQ(m_table.peers[slot].meas.seq, m_model[i].seq_rcvd);
+                TEST_CHECK_EQ(m_table.peers[slot].meas_cnt, m_model[i].meas);
+                TEST_CHECK_EQ(m_table.peers[slot].dup_cnt, m_model[i].dup);
+                TEST_CHECK_EQ(m_table.peers[slot].lost_cnt, m_model[i].lost);
+        }
+
+        // The log resets the counters of every sensor.
+        bcast_rx_report();
+        TEST_CHECK_EQ(m_table.stats.reports, 0);
+        for (uint32_t i = 0; i < TABLE_SIZE; i++)
+        {
+                TEST_CHECK_EQ(m_table.peers[i].meas_cnt, 0);
+        }
+}
+
+
+static void test_full(void)
+{
+        bcast_rx_init();
+        stream_send(PEERS_MAX + 20, 20000);
+
+        TEST_CHECK_EQ(m_table.count, PEERS_MAX);
+        TEST_CHECK(m_table.stats.full > 0);
+        table_check(&m_table);
+}
+
+
+static void test_ageing(void)
+{
+        ble_gap_evt_adv_report_t adv_report;
+        stream_report_t          report;
+        hrs_bcast_enc_t          enc;
+        uint32_t                 rand = BENCH_SEED;
+        uint32_t                 sensor;
+
+        bcast_rx_init();
+        stream_send(40, 2000);
+        TEST_CHECK_EQ(m_table.count, 40);
+
+        // One sensor goes on after all others fell silent. Each of its reports checks two slots,
+        // a slot emptied is checked again, so the table is swept after (slots + sensors) / 2.
+        m_host_app_timer_cnt += TIMEOUT + 1;
+        hrs_bcast_enc_init(&enc);
+        stream_report(&rand, 1, &enc, &report, &sensor);
+
+        adv_report.peer_addr   = report.addr;
+        adv_report.rssi        = -60;
+        adv_report.data.p_data = report.adv;
+        adv_report.data.len    = sizeof(report.adv);
+
+        for (uint32_t i = 0; i < (TABLE_SIZE + 40) / AGE_STEP; i++)
+        {
+                m_host_app_timer_cnt += STEP;
+                bcast_rx_on_adv_report(&adv_report);
+                table_check(&m_table);
+        }
+
+        TEST_CHECK_EQ(m_table.count, 1);
+        TEST_CHECK_EQ(m_table.stats.aged, 39);
+}
+
+
+static void test_bench_apart(void)
+{
+        static bcast_table_t live;
+        uint32_t             reports = 1000;
+
+        bcast_rx_init();
+        stream_send(10, 500);
+        live = m_table;
+
+        TEST_CHECK_EQ(bcast_rx_bench(0, reports, RATE), NRF_ERROR_INVALID_PARAM);
+        TEST_CHECK_EQ(bcast_rx_bench(BCAST_RX_BENCH_SENSORS_MAX + 1, reports, RATE), NRF_ERROR_INVALID_PARAM);
+        TEST_CHECK_EQ(bcast_rx_bench(40, BCAST_RX_BENCH_REPORTS_MAX + 1, RATE), NRF_ERROR_INVALID_PARAM);
+        TEST_CHECK_EQ(bcast_rx_bench(40, reports, 0), NRF_ERROR_INVALID_PARAM);
+
+        m_sched_full = true;
+        TEST_CHECK_EQ(bcast_rx_bench(40, reports, RATE), NRF_ERROR_NO_MEM);
+        m_sched_full = false;
+
+        m_sched_puts = 0;
+        TEST_CHECK_EQ(bcast_rx_bench(40, reports, RATE), NRF_SUCCESS);
+        TEST_CHECK_EQ(bcast_rx_bench(40, reports, RATE), NRF_ERROR_BUSY);
+
+        // Nothing runs before the main loop, then one chunk per scheduler event.
+        TEST_CHECK_EQ(m_bench_table.stats.reports, 0);
+        app_sched_execute();
+        TEST_CHECK_EQ(m_sched_puts, CEIL_DIV(reports, BENCH_CHUNK));
+        TEST_CHECK(!m_bench.running);
+
+        TEST_CHECK(m_bench_table.stats.reports > reports * (100 - 2 * BENCH_LOSS_PERCENT) / 100);
+        TEST_CHECK(m_bench_table.stats.reports < reports);
+        TEST_CHECK_EQ(m_bench_table.count, 40);
+        table_check(&m_bench_table);
+
+        TEST_CHECK(memcmp(&live, &m_table, sizeof(live)) == 0);
+}
+
+
+/**@brief Function for timing the handling of a report, the stream generated beforehand. */
+static void bench(uint32_t sensors)
+{
+        hrs_bcast_enc_t enc;
+        uint32_t        rand = BENCH_SEED;
+        uint32_t        handled = 0;
+        uint32_t        now = 0;
+        uint32_t        sensor;
+        uint64_t        start;
+        uint64_t        ns;
+
+        memset(m_model, 0, sizeof(m_model));
+        hrs_bcast_enc_init(&enc);
+        for (uint32_t i = 0; i < BENCH_REPORTS; i++)
+        {
+                stream_report(&rand, sensors, &enc, &m_stream[i], &sensor);
+        }
+
+        table_clear(&m_bench_table);
+        start = test_ns();
+        for (uint32_t i = 0; i < BENCH_REPORTS; i++)
+        {
+                now = (now + STEP) & APP_TIMER_MAX_CNT_VAL;
+                if (!m_stream[i].lost)
+                {
+                        report_handle(&m_bench_table, &m_stream[i].addr, -60,
+                                      m_stream[i].adv, sizeof(m_stream[i].adv), now);
+                        handled++;
+                }
+        }
+        ns = test_ns() - start;
+
+        printf("  %3u sensors: %3u in the table, %5u refused, longest probe %2u, %4.0f ns per report\n",
+               sensors, m_bench_table.count, m_bench_table.stats.full,
+               m_bench_table.stats.probes_max, (double)ns / handled);
+
+        table_check(&m_bench_table);
+}
+
+
+static void test_bench(void)
+{
+        static uint32_t const sensors[] = {1, 8, 24, 40, PEERS_MAX, 64, 128, BCAST_RX_BENCH_SENSORS_MAX};
+
+        printf("Ingest benchmark, %u reports at %u/s, table of %lu:\n",
+               BENCH_REPORTS, RATE, TABLE_SIZE);
+        for (uint32_t i = 0; i < ARRAY_SIZE(sensors); i++)
+        {
+                bench(sensors[i]);
+        }
+}
+
+
+int main(void)
+{
+        TEST_RUN(test_counters);
+        TEST_RUN(test_full);
+        TEST_RUN(test_ageing);
+        TEST_RUN(test_bench_apart);
+        TEST_RUN(test_bench);
+        TEST_MAIN_END();
+}
@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test of the event handler profiler.
+ *
+ * @details The cycle counter is advanced by hand, so the cycles every handler is charged can be
+ *          checked exactly. Nested and preempting handlers must be charged once, to the handler
+ *          that spent them, and to its link. The report must close the window it covers.
+ *
+ *          The test checks the accounting only. What the handlers of the collector cost, and how
+ *          that changes with the number of links, can only be measured on the target.
+ */
+
+#include <string.h>
+
+#include "host_test.h"
+#include "link_ctx.h"
+
+#include "evt_prof.c"
+
+/**@brief Function for spending cycles in the running handler. */
+static void spend(uint32_t cycles)
+{
+        DWT->CYCCNT += cycles;
+}
+
+
+static void prof_reset(void)
+{
+        memset(m_src_stats, 0, sizeof(m_src_stats));
+        memset(m_link_stats, 0, sizeof(m_link_stats));
+        memset(m_host_links, 0, sizeof(m_host_links));
+        m_depth     = 0;
+        DWT->CYCCNT = 0xFFFFF000;       // Wraps during the test.
+}
+
+
+static uint64_t src_total(void)
+{
+        uint64_t total = 0;
+
+        for (uint32_t i = 0; i < EVT_PROF_SRC_COUNT; i++)
+        {
+                total += m_src_stats[i].total_cyc;
+        }
+
+        return total;
+}
+
+
+static void test_flat(void)
+{
+        prof_reset();
+
+        EVT_PROF_BEGIN();
+        spend(1234);
+        EVT_PROF_END(EVT_PROF_SRC_BLE, 3);
+
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].count, 1);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].total_cyc, 1234);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].hist[bucket_get(1234)], 1);
+        TEST_CHECK_EQ(m_link_stats[3].total_cyc, 1234);
+        TEST_CHECK_EQ(m_depth, 0);
+}
+
+
+/**@brief Handler called from db_disc_handler. */
+static void disc_complete(evt_prof_src_t src, uint8_t slot, uint32_t cycles)
+{
+        EVT_PROF_BEGIN();
+        spend(cycles);
+        EVT_PROF_END(src, slot);
+}
+
+
+static void test_nested(void)
+{
+        prof_reset();
+
+        {
+                EVT_PROF_BEGIN();
+                spend(50);
+                disc_complete(EVT_PROF_SRC_HRS_C, 1, 200);
+                spend(30);
+                disc_complete(EVT_PROF_SRC_BAS_C, 1, 70);
+                spend(10);
+                EVT_PROF_END(EVT_PROF_SRC_DB_DISC, 1);
+        }
+
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_DB_DISC].total_cyc, 90);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_DB_DISC].max_cyc, 90);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_HRS_C].total_cyc, 200);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BAS_C].total_cyc, 70);
+        TEST_CHECK_EQ(m_link_stats[1].total_cyc, 360);
+        TEST_CHECK_EQ(m_link_stats[1].count, 3);
+        TEST_CHECK_EQ(m_depth, 0);
+}
+
+
+/**@brief Handler nesting one level deeper until depth levels run. */
+static void nest(uint32_t depth)
+{
+        EVT_PROF_BEGIN();
+        spend(100);
+        if (depth > 1)
+        {
+                nest(depth - 1);
+        }
+        spend(10);
+        EVT_PROF_END(EVT_PROF_SRC_BLE, (uint8_t)(depth % LINK_CTX_MAX));
+}
+
+
+static void test_deep(void)
+{
+        // Every level of the stack is charged its own 110 cycles.
+        prof_reset();
+        nest(EVT_PROF_DEPTH_MAX);
+        TEST_CHECK_EQ(src_total(), 110 * EVT_PROF_DEPTH_MAX);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].max_cyc, 110);
+        TEST_CHECK_EQ(m_depth, 0);
+
+        // Past the stack, the deepest handler tracked is charged the handlers it calls.
+        prof_reset();
+        nest(EVT_PROF_DEPTH_MAX + 3);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].count, EVT_PROF_DEPTH_MAX + 3);
+        TEST_CHECK_EQ(m_depth, 0);
+
+        // And the stack is usable again.
+        prof_reset();
+        nest(3);
+        TEST_CHECK_EQ(src_total(), 330);
+}
+
+
+/**@brief Notification of one link, a UART line preempting it when asked. */
+static void notification(uint8_t slot, bool uart)
+{
+        {
+                EVT_PROF_BEGIN();
+                spend(200);
+                if (uart)
+                {
+                        EVT_PROF_BEGIN();
+                        spend(2000);
+                        EVT_PROF_END(EVT_PROF_SRC_UART, EVT_PROF_NO_LINK);
+                }
+                spend(200);
+                EVT_PROF_END(EVT_PROF_SRC_BLE, slot);
+        }
+        {
+                EVT_PROF_BEGIN();
+                spend(900);
+                EVT_PROF_END(EVT_PROF_SRC_HRS_C, slot);
+        }
+}
+
+
+static void test_preempt(void)
+{
+        uint32_t start;
+
+        prof_reset();
+        start = DWT->CYCCNT;
+
+        notification(0, false);
+        notification(1, true);
+        notification(1, false);
+
+        // Every cycle spent in a handler is charged once, the UART line to no link.
+        TEST_CHECK_EQ(src_total(), (uint32_t)(DWT->CYCCNT - start));
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].max_cyc, 400);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_UART].count, 1);
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_UART].total_cyc, 2000);
+        TEST_CHECK_EQ(m_link_stats[0].total_cyc, 1300);
+        TEST_CHECK_EQ(m_link_stats[1].total_cyc, 2600);
+        TEST_CHECK_EQ(m_link_stats[1].count, 4);
+        TEST_CHECK_EQ(m_link_stats[LINK_CTX_MAX].total_cyc, 2000);
+        TEST_CHECK_EQ(m_depth, 0);
+}
+
+
+static void test_report(void)
+{
+        prof_reset();
+        m_host_links[0].in_use = true;
+        m_window_start_cyc     = DWT->CYCCNT;
+
+        notification(0, true);
+        evt_prof_report();
+
+        // The report takes its window and starts a new one.
+        TEST_CHECK_EQ(m_src_stats[EVT_PROF_SRC_BLE].count, 0);
+        TEST_CHECK_EQ(m_link_stats[0].total_cyc, 0);
+        TEST_CHECK_EQ(m_window_start_cyc, DWT->CYCCNT);
+}
+
+
+int main(void)
+{
+        TEST_RUN(test_flat);
+        TEST_RUN(test_nested);
+        TEST_RUN(test_deep);
+        TEST_RUN(test_preempt);
+        TEST_RUN(test_report);
+
+        TEST_MAIN_END();
+}
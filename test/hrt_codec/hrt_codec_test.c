@@ -0,0 +1,526 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test of the heart rate telemetry block codec.
+ *
+ * @details Sample streams go through the encoder and every block it completes straight into the
+ *          decoder, the samples out are checked against the samples in. The streams cover
+ *          blocks completed on a skewed sample, on age, on a full block and on a smaller block
+ *          limit, and blocks of RR intervals only. Truncated and corrupted blocks must be
+ *          refused before any of their samples reaches the handler.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+
+#include "hrt_codec.c"
+
+#define DT_MS                   1000            /**< Spacing of the heart rate samples. */
+#define AGE_MAX_MS              30000           /**< Longest time covered by one block. */
+#define SAMPLES_MAX             20000           /**< Most samples of one stream. */
+#define BLOCKS_MAX              4000            /**< Most blocks of one stream. */
+
+/**@brief Sample as given to the encoder or as decoded. */
+typedef struct
+{
+        hrt_sample_type_t type;
+        uint32_t          t_ms;
+        uint16_t          value;
+} sample_t;
+
+/**@brief Samples and blocks of one stream. */
+typedef struct
+{
+        sample_t in[SAMPLES_MAX];               /**< Samples given to the encoder. */
+        uint32_t in_count;
+        sample_t out[SAMPLES_MAX];              /**< Samples passed to the decoder handler. */
+        uint32_t out_count;
+        uint16_t block_len[BLOCKS_MAX];         /**< Length of every block completed. */
+        uint16_t block_hr[BLOCKS_MAX];          /**< Heart rate samples of every block completed. */
+        uint32_t block_t0[BLOCKS_MAX];          /**< t0 of every block completed. */
+        uint32_t block_count;
+        uint16_t block_max;                     /**< Block limit last set. */
+        uint32_t oversize;                      /**< Blocks larger than the limit. */
+        uint8_t  last[HRT_BLOCK_MAX];           /**< Copy of the last block. */
+} stream_t;
+
+static stream_t  m_stream;
+static hrt_enc_t m_enc;
+static hrt_dec_t m_dec;
+
+
+static void sample_handler(void * p_context, hrt_sample_type_t type, uint32_t t_ms, uint16_t value)
+{
+        stream_t * p_stream = p_context;
+
+        if (p_stream->out_count < SAMPLES_MAX)
+        {
+                p_stream->out[p_stream->out_count++] = (sample_t){type, t_ms, value};
+        }
+}
+
+
+static void block_handler(void * p_context, uint8_t const * p_block, uint16_t len)
+{
+        stream_t * p_stream = p_context;
+        uint32_t   out      = p_stream->out_count;
+        uint16_t   hr       = 0;
+        ret_code_t err_code;
+
+        err_code = hrt_dec_block(&m_dec, p_block, len);
+        TEST_CHECK_EQ(err_code, NRF_SUCCESS);
+
+        for (uint32_t i = out; i < p_stream->out_count; i++)
+        {
+                hr += (p_stream->out[i].type == HRT_SAMPLE_HR);
+        }
+
+        if (len > p_stream->block_max)
+        {
+                p_stream->oversize++;
+        }
+        if (p_stream->block_count < BLOCKS_MAX)
+        {
+                p_stream->block_len[p_stream->block_count] = len;
+                p_stream->block_hr[p_stream->block_count]  = hr;
+                p_stream->block_t0[p_stream->block_count]  = (out < p_stream->out_count) ? p_stream->out[out].t_ms : 0;
+                p_stream->block_count++;
+        }
+        memcpy(p_stream->last, p_block, len);
+}
+
+
+/**@brief Function for starting a stream on a new encoder and decoder. */
+static void stream_start(void)
+{
+        memset(&m_stream, 0, sizeof(m_stream));
+        m_stream.block_max = HRT_BLOCK_MAX;
+
+        hrt_enc_init(&m_enc, block_handler, &m_stream, DT_MS, AGE_MAX_MS);
+        hrt_dec_init(&m_dec, sample_handler, &m_stream);
+}
+
+
+static void hr_add(uint32_t t_ms, uint16_t hr)
+{
+        m_stream.in[m_stream.in_count++] = (sample_t){HRT_SAMPLE_HR, t_ms, hr};
+        hrt_enc_hr_add(&m_enc, t_ms, hr);
+}
+
+
+static void rr_add(uint16_t rr)
+{
+        m_stream.in[m_stream.in_count++] = (sample_t){HRT_SAMPLE_RR, 0, rr};
+        hrt_enc_rr_add(&m_enc, rr);
+}
+
+
+static void block_max_set(uint16_t block_max)
+{
+        m_stream.block_max = MAX(MIN(block_max, HRT_BLOCK_MAX), HRT_BLOCK_MIN);
+        hrt_enc_block_max_set(&m_enc, block_max);
+}
+
+
+/**@brief Function for checking that the samples out are the samples in.
+ *
+ * @details Each series must come out whole and in order. A heart rate sample may come out at
+ *          its nominal time, no further than half a spacing from the time it went in.
+ */
+static void stream_check(void)
+{
+        uint32_t in_n[2]  = {0};
+        uint32_t out_n[2] = {0};
+        uint32_t bad      = 0;
+
+        TEST_CHECK_EQ(m_stream.oversize, 0);
+        TEST_CHECK_EQ(m_stream.out_count, m_stream.in_count);
+        TEST_CHECK_EQ(m_dec.stats.samples, m_stream.in_count);
+        TEST_CHECK_EQ(m_dec.stats.blocks, m_stream.block_count);
+        TEST_CHECK_EQ(m_dec.stats.lost, 0);
+        TEST_CHECK_EQ(m_dec.stats.errors, 0);
+
+        for (uint32_t type = HRT_SAMPLE_HR; type <= HRT_SAMPLE_RR; type++)
+        {
+                uint32_t i = 0;
+                uint32_t o = 0;
+
+                for (;;)
+                {
+                        while ((i < m_stream.in_count) && (m_stream.in[i].type != type))
+                        {
+                                i++;
+                        }
+                        while ((o < m_stream.out_count) && (m_stream.out[o].type != type))
+                        {
+                                o++;
+                        }
+                        if ((i == m_stream.in_count) || (o == m_stream.out_count))
+                        {
+                                break;
+                        }
+
+                        in_n[type]++;
+                        out_n[type]++;
+                        if (m_stream.in[i].value != m_stream.out[o].value)
+                        {
+                                bad++;
+                        }
+                        if ((type == HRT_SAMPLE_HR) &&
+                            (labs((int32_t)(m_stream.out[o].t_ms - m_stream.in[i].t_ms)) > DT_MS / 2))
+                        {
+                                bad++;
+                        }
+                        i++;
+                        o++;
+                }
+        }
+
+        TEST_CHECK_EQ(bad, 0);
+}
+
+
+/**@brief A heart rate sample more than half a spacing off starts a new block. */
+static void test_skew(void)
+{
+        stream_start();
+
+        hr_add(0, 60);
+        hr_add(1000, 61);
+        hr_add(2400, 62);               // 400 ms late, same block.
+        hr_add(3600, 63);               // 600 ms late, new block at 3600.
+        hr_add(4600, 64);
+        hr_add(5000, 65);               // 600 ms early, new block at 5000.
+        hrt_enc_flush(&m_enc, 6000);
+
+        TEST_CHECK_EQ(m_stream.block_count, 3);
+        TEST_CHECK_EQ(m_stream.block_hr[0], 3);
+        TEST_CHECK_EQ(m_stream.block_hr[1], 2);
+        TEST_CHECK_EQ(m_stream.block_hr[2], 1);
+        TEST_CHECK_EQ(m_stream.block_t0[1], 3600);
+        TEST_CHECK_EQ(m_stream.block_t0[2], 5000);
+        TEST_CHECK_EQ(m_stream.out[2].t_ms, 2000);
+        stream_check();
+}
+
+
+/**@brief A block covers at most AGE_MAX_MS. */
+static void test_age(void)
+{
+        stream_start();
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+                hr_add(i * DT_MS, 70);
+                rr_add(878);
+        }
+        hrt_enc_flush(&m_enc, 100 * DT_MS);
+
+        TEST_CHECK_EQ(m_stream.block_count, 4);
+        for (uint32_t b = 0; b < m_stream.block_count; b++)
+        {
+                TEST_CHECK_EQ(m_stream.block_hr[b], (b < 3) ? AGE_MAX_MS / DT_MS : 10);
+                TEST_CHECK_EQ(m_stream.block_t0[b], b * AGE_MAX_MS);
+        }
+        stream_check();
+}
+
+
+/**@brief A full block is completed and a series holds at most HRT_SERIES_MAX samples. */
+static void test_full(void)
+{
+        stream_start();
+        block_max_set(40);
+
+        // Alternating large steps take three bytes per sample.
+        for (uint32_t i = 0; i < 20; i++)
+        {
+                hr_add(i * DT_MS, (i & 1) ? 30000 : 10);
+        }
+        hrt_enc_flush(&m_enc, 20 * DT_MS);
+        TEST_CHECK(m_stream.block_count > 1);
+        stream_check();
+
+        stream_start();
+        for (uint32_t i = 0; i < 2 * HRT_SERIES_MAX + 1; i++)
+        {
+                rr_add(800);
+        }
+        hrt_enc_flush(&m_enc, 0);
+        TEST_CHECK_EQ(m_stream.block_count, 3);
+        stream_check();
+}
+
+
+/**@brief A smaller block limit splits the pending block into blocks no larger than the limit. */
+static void test_block_max_shrink(void)
+{
+        stream_start();
+
+        for (uint32_t i = 0; i < 25; i++)
+        {
+                hr_add(i * DT_MS, (i & 1) ? 4000 : 60);
+                rr_add((i & 1) ? 20000 : 700);
+        }
+        TEST_CHECK_EQ(m_stream.block_count, 0);
+
+        block_max_set(HRT_BLOCK_MIN);
+        TEST_CHECK(m_stream.block_count > 2);
+        TEST_CHECK(m_enc.size <= HRT_BLOCK_MIN);
+
+        // The heart rate samples keep their times across the split.
+        hrt_enc_flush(&m_enc, 25 * DT_MS);
+        for (uint32_t i = 0; i < m_stream.out_count; i++)
+        {
+                if (m_stream.out[i].type == HRT_SAMPLE_HR)
+                {
+                        TEST_CHECK_EQ(m_stream.out[i].t_ms % DT_MS, 0);
+                }
+        }
+        stream_check();
+
+        // A limit below a notification at the default ATT MTU is raised to it.
+        stream_start();
+        block_max_set(5);
+        TEST_CHECK_EQ(m_enc.block_max, HRT_BLOCK_MIN);
+        for (uint32_t i = 0; i < 10; i++)
+        {
+                hr_add(i * DT_MS, (i & 1) ? 65535 : 0);
+        }
+        hrt_enc_flush(&m_enc, 10 * DT_MS);
+        stream_check();
+}
+
+
+/**@brief A block of RR intervals only takes the time of the flush. */
+static void test_rr_only(void)
+{
+        stream_start();
+
+        rr_add(1000);
+        rr_add(990);
+        rr_add(1020);
+        hrt_enc_flush(&m_enc, 777);
+
+        TEST_CHECK_EQ(m_stream.block_count, 1);
+        TEST_CHECK_EQ(m_stream.block_hr[0], 0);
+        TEST_CHECK_EQ(m_stream.out_count, 3);
+        TEST_CHECK_EQ(m_stream.out[0].t_ms, 777);
+        stream_check();
+
+        // Nothing pending, nothing sent.
+        hrt_enc_flush(&m_enc, 800);
+        TEST_CHECK_EQ(m_stream.block_count, 1);
+}
+
+
+/**@brief Random streams with jitter, skews, gaps and limit changes. */
+static void test_random(void)
+{
+        srand(36);
+
+        for (uint32_t run = 0; run < 50; run++)
+        {
+                uint32_t t  = (uint32_t)rand();
+                uint16_t hr = 70;
+
+                stream_start();
+
+                while (m_stream.in_count < SAMPLES_MAX - 8)
+                {
+                        uint32_t r = (uint32_t)rand();
+
+                        switch (r % 64)
+                        {
+                        case 0:
+                                t += DT_MS / 2 + 1 + (r >> 8) % (5 * DT_MS);
+                                break;
+
+                        case 1:
+                                block_max_set((uint16_t)((r >> 8) % (HRT_BLOCK_MAX + 10)));
+                                break;
+
+                        case 2:
+                                hrt_enc_flush(&m_enc, t);
+                                break;
+
+                        case 3:
+                                hr = (uint16_t)(r >> 8);
+                                break;
+
+                        default:
+                                break;
+                        }
+
+                        t  += DT_MS;
+                        hr  = (uint16_t)(hr + (int32_t)((r >> 16) % 9) - 4);
+                        hr_add(t + (r >> 20) % DT_MS - DT_MS / 2, hr);
+
+                        for (uint32_t i = 0; i < (r >> 24) % 4; i++)
+                        {
+                                rr_add((uint16_t)(61440 / (hr | 1) + (int32_t)((r >> 4) % 64) - 32));
+                        }
+                }
+                hrt_enc_flush(&m_enc, t);
+
+                stream_check();
+        }
+}
+
+
+/**@brief Function for encoding a block of a few samples of each series into m_stream.last.
+ *
+ * @return Length of the block.
+ */
+static uint16_t block_make(void)
+{
+        stream_start();
+        hr_add(5000, 72);
+        hr_add(6000, 75);
+        hr_add(7000, 200);
+        rr_add(850);
+        rr_add(820);
+        hrt_enc_flush(&m_enc, 8000);
+
+        TEST_CHECK_EQ(m_stream.block_count, 1);
+
+        return m_stream.block_len[0];
+}
+
+
+/**@brief Function for decoding a damaged block, checking that no sample comes out of it. */
+static void block_refused(uint8_t const * p_block, uint16_t len)
+{
+        uint32_t   out    = m_stream.out_count;
+        uint32_t   errors = m_dec.stats.errors;
+        ret_code_t err_code;
+
+        err_code = hrt_dec_block(&m_dec, p_block, len);
+
+        TEST_CHECK_EQ(err_code, NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(m_stream.out_count, out);
+        TEST_CHECK_EQ(m_dec.stats.errors, errors + 1);
+}
+
+
+/**@brief Every prefix of a block is refused whole. */
+static void test_truncated(void)
+{
+        uint8_t  block[HRT_BLOCK_MAX];
+        uint16_t len = block_make();
+
+        memcpy(block, m_stream.last, len);
+        for (uint16_t n = 0; n < len; n++)
+        {
+                block_refused(block, n);
+        }
+        TEST_CHECK_EQ(m_dec.stats.samples, 5);
+        TEST_CHECK_EQ(m_dec.stats.blocks, 1);
+}
+
+
+/**@brief Corrupted blocks are refused whole and count as lost once the next block comes. */
+static void test_corrupt(void)
+{
+        uint8_t  block[HRT_BLOCK_MAX + 1];
+        uint8_t  next;
+        uint16_t len = block_make();
+        uint16_t hr_pos;
+
+        // seq, t0 (2 bytes), dt (2 bytes), HR count.
+        hr_pos = 1 + varint_len(5000) + varint_len(DT_MS);
+        TEST_CHECK_EQ(m_stream.last[hr_pos], 3);
+
+        // One more heart rate sample than written.
+        memcpy(block, m_stream.last, len);
+        block[hr_pos]++;
+        block_refused(block, len);
+
+        // One less: the RR series is misread and bytes are left over.
+        memcpy(block, m_stream.last, len);
+        block[hr_pos]--;
+        block_refused(block, len);
+
+        // A trailing byte.
+        memcpy(block, m_stream.last, len);
+        block[len] = 0;
+        block_refused(block, len + 1);
+
+        // A series longer than a block can hold.
+        memcpy(block, m_stream.last, len);
+        block[hr_pos] = HRT_SERIES_MAX + 1;
+        block_refused(block, len);
+
+        // A delta below zero on the last heart rate sample: 200 - 75 = 125, zz = 250, two bytes.
+        memcpy(block, m_stream.last, len);
+        TEST_CHECK_EQ(block[hr_pos + 3], 0xFA);
+        block[hr_pos + 3] = 0xFF;               // zz = 255, -128 from 75.
+        block_refused(block, len);
+
+        // A varint that never ends.
+        memset(block, 0xFF, sizeof(block));
+        block_refused(block, sizeof(block));
+
+        // The refused blocks leave the sequence open, the next good block counts them as lost.
+        next = m_stream.last[0] + 2;
+        memcpy(block, m_stream.last, len);
+        block[0] = next;
+        TEST_CHECK_EQ(hrt_dec_block(&m_dec, block, len), NRF_SUCCESS);
+        TEST_CHECK_EQ(m_dec.stats.lost, 1);
+        TEST_CHECK_EQ(m_dec.stats.samples, 10);
+}
+
+
+int main(void)
+{
+        TEST_RUN(test_skew);
+        TEST_RUN(test_age);
+        TEST_RUN(test_full);
+        TEST_RUN(test_block_max_shrink);
+        TEST_RUN(test_rr_only);
+        TEST_RUN(test_random);
+        TEST_RUN(test_truncated);
+        TEST_RUN(test_corrupt);
+
+        TEST_MAIN_END();
+}
@@ -0,0 +1,513 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test of the heart rate variability metrics against a double precision reference.
+ *
+ * @details Every stage of the fixed-point code is compared with the same computation in double:
+ *          - the Q15 FFT with its halving stages, against a DFT scaled by 1 / HRV_FFT_LEN,
+ *          - the resampling of the tachogram, against linear interpolation between the beats,
+ *          - the LF and HF powers out of spectrum_compute(), scaling included, against the
+ *            periodogram of the same samples,
+ *          - SDNN, RMSSD and pNN50 over the window, against the textbook definitions.
+ *          The RR series are synthetic tachograms with known LF and HF oscillations, so the band
+ *          powers are also checked against the power of the oscillations.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "host_test.h"
+
+#include "hrv.c"
+
+#define FFT_MAX_ERR             6       /**< Largest error of an FFT output, in Q15 LSB of the scaled result. */
+#define FFT_MAX_RMS_ERR         2.0     /**< Largest RMS error of the FFT outputs, in Q15 LSB. */
+#define TIME_MAX_ERR            0.55    /**< Largest error of SDNN and RMSSD in ms: the rounding, and that of the variance. */
+#define RESAMPLE_MAX_ERR        1       /**< Largest error of a resampled value, in 1/1024 s: the truncation. */
+#define BAND_MAX_ERR_PCT        2       /**< Largest error of a band power against the reference. */
+#define BAND_MAX_ERR_MS2        2       /**< Largest error of a small band power, in ms^2. */
+#define TONE_MAX_ERR_PCT        10      /**< Largest error of a band power against its oscillation, the window leaks. */
+#define SERIES_LEN              1200    /**< RR intervals in a series. */
+
+#define PI                      3.14159265358979323846
+
+/**@brief Synthetic tachogram. */
+typedef struct
+{
+        double   mean_ms;       /**< Mean RR interval. */
+        double   lf_ms;         /**< Amplitude of the oscillation at 0.1 Hz. */
+        double   hf_ms;         /**< Amplitude of the oscillation at 0.25 Hz. */
+        double   noise_ms;      /**< Standard deviation of the noise. */
+        uint32_t outliers;      /**< Every so many intervals, one out of range, 0 for none. */
+} series_t;
+
+static uint16_t m_series[SERIES_LEN];           /**< RR intervals in 1/1024 seconds. */
+static uint16_t m_kept[SERIES_LEN];             /**< The ones in range, as the window sees them. */
+static uint32_t m_kept_cnt;
+static double   m_ref_re[HRV_FFT_LEN];
+static double   m_ref_im[HRV_FFT_LEN];
+
+
+/**@brief Function for drawing a normal random number, Box-Muller. */
+static double gauss(void)
+{
+        double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+        double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+        return sqrt(-2 * log(u)) * cos(2 * PI * v);
+}
+
+
+/**@brief Function for generating a tachogram. */
+static void series_make(series_t const * p_series, uint32_t seed)
+{
+        double t = 0;
+
+        srand(seed);
+        m_kept_cnt = 0;
+
+        for (uint32_t i = 0; i < SERIES_LEN; i++)
+        {
+                double rr = p_series->mean_ms
+                            + p_series->lf_ms * sin(2 * PI * 0.1 * t)
+                            + p_series->hf_ms * sin(2 * PI * 0.25 * t)
+                            + p_series->noise_ms * gauss();
+
+                if ((p_series->outliers != 0) && (i % p_series->outliers == p_series->outliers - 1))
+                {
+                        rr = (i & 1) ? 250 : 2100;
+                }
+
+                m_series[i] = (uint16_t)lround(rr * 1024 / 1000);
+                if ((m_series[i] >= RR_MIN) && (m_series[i] <= RR_MAX))
+                {
+                        m_kept[m_kept_cnt++] = m_series[i];
+                        t += rr / 1000;
+                }
+        }
+}
+
+
+/**@brief Function for the DFT of the FFT buffer in double, scaled by 1 / HRV_FFT_LEN. */
+static void dft_ref(uint32_t const * p_in)
+{
+        for (uint32_t k = 0; k < HRV_FFT_LEN; k++)
+        {
+                double re = 0;
+                double im = 0;
+
+                for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+                {
+                        double a = -2 * PI * (double)((k * i) % HRV_FFT_LEN) / HRV_FFT_LEN;
+
+                        re += RE(p_in[i]) * cos(a) - IM(p_in[i]) * sin(a);
+                        im += RE(p_in[i]) * sin(a) + IM(p_in[i]) * cos(a);
+                }
+                m_ref_re[k] = re / HRV_FFT_LEN;
+                m_ref_im[k] = im / HRV_FFT_LEN;
+        }
+}
+
+
+/**@brief Function for comparing the FFT with the reference on the buffer as it is. */
+static void fft_check(char const * p_case)
+{
+        static uint32_t in[HRV_FFT_LEN];
+        double          err_max = 0;
+        double          err_sq  = 0;
+
+        memcpy(in, m_fft, sizeof(in));
+        dft_ref(in);
+        fft();
+
+        for (uint32_t k = 0; k < HRV_FFT_LEN; k++)
+        {
+                double e_re = RE(m_fft[k]) - m_ref_re[k];
+                double e_im = IM(m_fft[k]) - m_ref_im[k];
+
+                err_max = MAX(err_max, MAX(fabs(e_re), fabs(e_im)));
+                err_sq += e_re * e_re + e_im * e_im;
+        }
+
+        printf("  FFT %-24s error %4.2f LSB max, %4.2f LSB rms\n",
+               p_case, err_max, sqrt(err_sq / (2 * HRV_FFT_LEN)));
+        TEST_CHECK(err_max <= FFT_MAX_ERR);
+        TEST_CHECK(sqrt(err_sq / (2 * HRV_FFT_LEN)) <= FFT_MAX_RMS_ERR);
+}
+
+
+static void test_fft(void)
+{
+        // A tone on a bin, at the full input range.
+        for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+        {
+                m_fft[i] = PACK(lround(16383 * cos(2 * PI * 37 * i / HRV_FFT_LEN)), 0);
+        }
+        fft_check("tone on bin 37");
+        TEST_CHECK(abs(RE(m_fft[37]) - 8192) <= FFT_MAX_ERR);
+        TEST_CHECK(abs(RE(m_fft[HRV_FFT_LEN - 37]) - 8192) <= FFT_MAX_ERR);
+
+        // A tone between bins, complex.
+        for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+        {
+                double a = 2 * PI * 80.5 * i / HRV_FFT_LEN;
+
+                m_fft[i] = PACK(lround(12000 * cos(a)), lround(12000 * sin(a)));
+        }
+        fft_check("complex tone at bin 80.5");
+
+        // Noise over the full input range.
+        srand(1);
+        for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+        {
+                m_fft[i] = PACK((rand() % 32767) - 16383, (rand() % 32767) - 16383);
+        }
+        fft_check("full range noise");
+
+        // An impulse, every bin the same.
+        memset(m_fft, 0, sizeof(m_fft));
+        m_fft[0] = PACK(16384, 0);
+        fft_check("impulse");
+}
+
+
+/**@brief Function for the tachogram in double at a time before the newest beat.
+ *
+ * @details The tachogram takes the value of every RR interval at the beat ending it, and is
+ *          linear between beats.
+ *
+ * @param[in] p_rr   RR intervals in the window, oldest first, in 1/1024 seconds.
+ * @param[in] count  Number of RR intervals.
+ * @param[in] t      Time in 1/1024 seconds, 0 at the newest beat, negative before.
+ * @param[out] p_v   Value.
+ *
+ * @return False before the second oldest beat.
+ */
+static bool tachogram_ref(uint16_t const * p_rr, uint32_t count, double t, double * p_v)
+{
+        double t_b = 0;
+
+        for (uint32_t b = count - 1; b >= 1; b--)
+        {
+                double t_prev = t_b - p_rr[b];
+
+                if (t >= t_prev)
+                {
+                        *p_v = p_rr[b - 1] + (p_rr[b] - p_rr[b - 1]) * (t - t_prev) / p_rr[b];
+                        return true;
+                }
+                t_b = t_prev;
+        }
+        return false;
+}
+
+
+/**@brief Function for the band powers in double, from the RR intervals of the window.
+ *
+ * @param[in]  p_hrv  Link state, for its window.
+ * @param[out] p_n    Samples of the tachogram.
+ * @param[out] p_lf   LF power in ms^2.
+ * @param[out] p_hf   HF power in ms^2.
+ */
+static void spectrum_ref(hrv_t const * p_hrv, uint32_t * p_n, double * p_lf, double * p_hf)
+{
+        static uint16_t rr[HRV_WINDOW];
+        static double   x[HRV_FFT_LEN];
+        uint32_t        n    = 0;
+        double          mean = 0;
+        double          w_sq = 0;
+
+        for (uint32_t i = 0; i < p_hrv->count; i++)
+        {
+                rr[i] = (uint16_t)rr_back(p_hrv, p_hrv->count - 1 - i);
+        }
+
+        memset(x, 0, sizeof(x));
+        while ((n < HRV_FFT_LEN) &&
+               tachogram_ref(rr, p_hrv->count, -(double)n * STEP, &x[HRV_FFT_LEN - 1 - n]))
+        {
+                mean += x[HRV_FFT_LEN - 1 - n];
+                n++;
+        }
+        mean /= n;
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+                double w = 0.5 * (1 - cos(2 * PI * i / (n - 1)));
+
+                x[HRV_FFT_LEN - n + i] = (x[HRV_FFT_LEN - n + i] - mean) * w;
+                w_sq                  += w * w;
+        }
+
+        *p_lf = 0;
+        *p_hf = 0;
+        for (uint32_t k = LF_FIRST; k < HF_END; k++)
+        {
+                double re = 0;
+                double im = 0;
+                double p;
+
+                for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+                {
+                        re += x[i] * cos(2 * PI * k * i / HRV_FFT_LEN);
+                        im -= x[i] * sin(2 * PI * k * i / HRV_FFT_LEN);
+                }
+
+                // One-sided power of the windowed periodogram, from (1/1024 s)^2 to ms^2.
+                p = 2 * (re * re + im * im) / (HRV_FFT_LEN * w_sq) * (1000.0 / 1024) * (1000.0 / 1024);
+                if (k < HF_FIRST)
+                {
+                        *p_lf += p;
+                }
+                else
+                {
+                        *p_hf += p;
+                }
+        }
+        *p_n = n;
+}
+
+
+/**@brief Function for comparing the resampler with linear interpolation in double. */
+static void resample_check(hrv_t const * p_hrv)
+{
+        static uint16_t rr[HRV_WINDOW];
+        uint32_t        n       = resample(p_hrv);
+        uint32_t        n_ref   = 0;
+        double          err_max = 0;
+
+        for (uint32_t i = 0; i < p_hrv->count; i++)
+        {
+                rr[i] = (uint16_t)rr_back(p_hrv, p_hrv->count - 1 - i);
+        }
+
+        for (uint32_t i = 0; i < HRV_FFT_LEN; i++)
+        {
+                double v;
+
+                if (!tachogram_ref(rr, p_hrv->count, -(double)i * STEP, &v))
+                {
+                        break;
+                }
+                n_ref++;
+                if (i < n)
+                {
+                        err_max = MAX(err_max, fabs(RE(m_fft[HRV_FFT_LEN - 1 - i]) - v));
+                }
+        }
+
+        TEST_CHECK_EQ(n, n_ref);
+        TEST_CHECK(err_max <= RESAMPLE_MAX_ERR);
+        for (uint32_t i = n; i < HRV_FFT_LEN; i++)
+        {
+                TEST_CHECK_EQ(m_fft[HRV_FFT_LEN - 1 - i], 0);
+        }
+}
+
+
+/**@brief Function for the time domain metrics in double over the RR intervals of the window. */
+static void time_ref(hrv_t const * p_hrv, double * p_sdnn, double * p_rmssd, double * p_pnn50)
+{
+        uint32_t n      = p_hrv->count;
+        double   sum    = 0;
+        double   var    = 0;
+        double   d_sq   = 0;
+        uint32_t nn50   = 0;
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+                sum += rr_back(p_hrv, i) * 1000.0 / 1024;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+                double d = rr_back(p_hrv, i) * 1000.0 / 1024 - sum / n;
+
+                var += d * d;
+        }
+        for (uint32_t i = 0; i + 1 < n; i++)
+        {
+                double d = (rr_back(p_hrv, i) - rr_back(p_hrv, i + 1)) * 1000.0 / 1024;
+
+                d_sq += d * d;
+                nn50 += (fabs(d) > 50) ? 1 : 0;
+        }
+
+        *p_sdnn  = sqrt(var / (n - 1));
+        *p_rmssd = sqrt(d_sq / (n - 1));
+        *p_pnn50 = 1000.0 * nn50 / (n - 1);
+}
+
+
+/**@brief Function for the power of an oscillation of the RR intervals in the tachogram.
+ *
+ * @param[in] amp_ms   Amplitude of the oscillation.
+ * @param[in] f_hz     Frequency.
+ * @param[in] mean_ms  Mean RR interval, the sampling period of the oscillation.
+ *
+ * @return Power in ms^2.
+ */
+static double tone_power(double amp_ms, double f_hz, double mean_ms)
+{
+        double x    = PI * f_hz * mean_ms / 1000;
+        double sinc = sin(x) / x;
+
+        return amp_ms * amp_ms / 2 * pow(sinc, 4);
+}
+
+
+/**@brief Function for running a tachogram through a link and checking every metric. */
+static void series_check(char const * p_case, series_t const * p_series, uint32_t seed)
+{
+        static hrv_t  hrv;
+        hrv_metrics_t metrics;
+        uint32_t      spectra = 0;
+        double        lf_err  = 0;
+        double        hf_err  = 0;
+        double        lf      = 0;
+        double        hf      = 0;
+        double        sdnn    = 0;
+        double        rmssd   = 0;
+        double        pnn50   = 0;
+        uint32_t      n;
+
+        memset(&metrics, 0, sizeof(metrics));
+        series_make(p_series, seed);
+        hrv_reset(&hrv);
+
+        // In the chunks the HRS notifications bring them.
+        for (uint32_t i = 0; i < SERIES_LEN; i += 3)
+        {
+                uint16_t count = (uint16_t)MIN(3, SERIES_LEN - i);
+
+                if (!hrv_rr_add(&hrv, &m_series[i], count))
+                {
+                        continue;
+                }
+
+                hrv_metrics_get(&hrv, &metrics);
+                time_ref(&hrv, &sdnn, &rmssd, &pnn50);
+                TEST_CHECK(fabs(metrics.sdnn_ms - sdnn) <= TIME_MAX_ERR);
+                TEST_CHECK(fabs(metrics.rmssd_ms - rmssd) <= TIME_MAX_ERR);
+                TEST_CHECK(fabs(metrics.pnn50_pm - pnn50) <= 0.5);
+
+                spectrum_ref(&hrv, &n, &lf, &hf);
+                TEST_CHECK_EQ(metrics.spectrum_valid, n >= HRV_FFT_LEN / 2);
+                if (!metrics.spectrum_valid)
+                {
+                        continue;
+                }
+                spectra++;
+                lf_err = MAX(lf_err, fabs(metrics.lf_ms2 - lf) / MAX(lf, 1));
+                hf_err = MAX(hf_err, fabs(metrics.hf_ms2 - hf) / MAX(hf, 1));
+                TEST_CHECK(fabs(metrics.lf_ms2 - lf) <= MAX(lf * BAND_MAX_ERR_PCT / 100, BAND_MAX_ERR_MS2));
+                TEST_CHECK(fabs(metrics.hf_ms2 - hf) <= MAX(hf * BAND_MAX_ERR_PCT / 100, BAND_MAX_ERR_MS2));
+
+                resample_check(&hrv);
+        }
+
+        TEST_CHECK(spectra > 0);
+        TEST_CHECK_EQ(hrv.count, MIN(m_kept_cnt, HRV_WINDOW));
+        TEST_CHECK_EQ(hrv.rejected, SERIES_LEN - m_kept_cnt);
+
+        // A sine of amplitude A has the power A^2 / 2, the noise adds to both bands. Sampled on
+        // the beats and interpolated linearly, the sine at f is seen through sinc^2(f RR).
+        printf("  %-24s SDNN %3u/%5.1f RMSSD %3u/%5.1f pNN50 %3u/%5.1f, LF %5u/%7.1f (%4.0f) "
+               "HF %5u/%7.1f (%4.0f) ms2, band error %.2f/%.2f %%\n",
+               p_case, metrics.sdnn_ms, sdnn, metrics.rmssd_ms, rmssd, metrics.pnn50_pm, pnn50,
+               metrics.lf_ms2, lf, tone_power(p_series->lf_ms, 0.1, p_series->mean_ms),
+               metrics.hf_ms2, hf, tone_power(p_series->hf_ms, 0.25, p_series->mean_ms),
+               100 * lf_err, 100 * hf_err);
+
+        if (p_series->noise_ms == 0)
+        {
+                double lf_tone = tone_power(p_series->lf_ms, 0.1, p_series->mean_ms);
+                double hf_tone = tone_power(p_series->hf_ms, 0.25, p_series->mean_ms);
+
+                TEST_CHECK(fabs(lf - lf_tone) <= MAX(lf_tone * TONE_MAX_ERR_PCT / 100, BAND_MAX_ERR_MS2));
+                TEST_CHECK(fabs(hf - hf_tone) <= MAX(hf_tone * TONE_MAX_ERR_PCT / 100, BAND_MAX_ERR_MS2));
+        }
+}
+
+
+static void test_series(void)
+{
+        static series_t const rest     = {1000, 30, 20, 0, 0};
+        static series_t const noisy    = {850, 25, 40, 15, 0};
+        static series_t const steady   = {600, 3, 2, 0, 0};
+        static series_t const slow     = {1500, 60, 10, 0, 0};
+        static series_t const outliers = {900, 20, 20, 10, 50};
+
+        series_check("rest, 60 bpm", &rest, 1);
+        series_check("noisy, 70 bpm", &noisy, 2);
+        series_check("steady, 100 bpm", &steady, 3);
+        series_check("slow, 40 bpm", &slow, 4);
+        series_check("outliers, 67 bpm", &outliers, 5);
+}
+
+
+static void test_short(void)
+{
+        static hrv_t  hrv;
+        hrv_metrics_t metrics;
+        uint16_t      rr[2] = {1024, 1100};
+
+        hrv_reset(&hrv);
+        hrv_metrics_get(&hrv, &metrics);
+        TEST_CHECK_EQ(metrics.count, 0);
+        TEST_CHECK_EQ(metrics.sdnn_ms, 0);
+        TEST_CHECK(!metrics.spectrum_valid);
+
+        (void)hrv_rr_add(&hrv, rr, 2);
+        hrv_metrics_get(&hrv, &metrics);
+        TEST_CHECK_EQ(metrics.count, 2);
+        TEST_CHECK_EQ(metrics.rmssd_ms, 74);
+        TEST_CHECK_EQ(metrics.pnn50_pm, 1000);
+}
+
+
+int main(void)
+{
+        hrv_init();
+
+        TEST_RUN(test_fft);
+        TEST_RUN(test_series);
+        TEST_RUN(test_short);
+        TEST_MAIN_END();
+}
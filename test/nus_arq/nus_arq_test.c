@@ -0,0 +1,477 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test and benchmark of the reliable transfer over the NUS multiplexer.
+ *
+ * @details Two instances, each on its own multiplexer, talk over an in-memory link that stands
+ *          in for the Write Command and notification queues of the SoftDevice: every connection
+ *          event carries up to @ref PKTS_PER_EVT queued packets each way. The receiving
+ *          multiplexers lose messages, frames and acknowledgements, at random or in bursts. Both
+ *          directions stream a known byte sequence in messages of random length, the receivers
+ *          check that it arrives whole and in order. The benchmark streams full frames one way
+ *          and compares the payload delivered with what the link carries when every packet is
+ *          raw data.
+ *
+ *          Messages are lost whole, as with NUS_ARQ_LOSS_PERMILLE on the target. The link layer
+ *          does not lose packets, and the multiplexer could not tell that a chunk of a message
+ *          split over two packets is missing.
+ */
+
+#include "host_test.h"
+
+#include "nus_mux.c"
+#undef NRF_LOG_MODULE_NAME
+#include "nus_arq.c"
+
+#define CI_MS                   15                              /**< Connection interval. */
+#define CI_TICKS                APP_TIMER_TICKS(CI_MS)          /**< Connection interval in app_timer ticks. */
+#define PKTS_PER_EVT            4                               /**< Packets sent each way per connection event, the SoftDevice queue. */
+#define RAW_BYTES_PER_EVT       (PKTS_PER_EVT * NUS_MUX_PACKET_MAX) /**< Data carried per event when every packet is raw data. */
+#define RUN_EVENTS              20000                           /**< Connection events a run streams data for, 5 minutes. */
+#define DRAIN_EVENTS_MAX        1000                            /**< Connection events allowed to deliver what is left at the end of a run. */
+
+/**@brief Loss model of the link. */
+typedef struct
+{
+        char const * p_name;
+        uint32_t     loss_ppm;          /**< Loss probability in the good state, per million packets. */
+        uint32_t     to_bad_ppm;        /**< Probability of entering the bad state, per million packets. */
+        uint32_t     to_good_ppm;       /**< Probability of leaving the bad state, per million packets. */
+} loss_model_t;
+
+/**@brief One end of the link. */
+typedef struct
+{
+        nus_mux_t mux;
+        nus_arq_t arq;
+        uint8_t   queue[PKTS_PER_EVT][NUS_MUX_PACKET_MAX];      /**< Packets waiting for the next connection event. */
+        uint16_t  queue_len[PKTS_PER_EVT];
+        uint32_t  queue_count;
+        bool      full_frames;          /**< Send messages of one full frame, else of random length. */
+        bool      sending;              /**< Offer data to the reliable transfer. */
+        uint32_t  tx_pos;               /**< Bytes of the stream accepted by the reliable transfer. */
+        uint32_t  rx_pos;               /**< Bytes of the peer's stream received. */
+        uint32_t  rx_errors;            /**< Bytes received that do not match the stream. */
+        bool      rx_mid[NUS_MUX_CH_COUNT];  /**< A message of the channel is being received. */
+        bool      rx_drop[NUS_MUX_CH_COUNT]; /**< The message being received is lost. */
+} side_t;
+
+static side_t             m_sides[2];
+static loss_model_t const * mp_loss;
+static bool               m_bad;
+static uint32_t           m_rand = 0x6B8B4567;
+static uint32_t           m_msgs;
+static uint32_t           m_msgs_lost;
+
+
+/**@brief Function for drawing a pseudo-random number, xorshift32. */
+static uint32_t rand_next(void)
+{
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 17;
+        m_rand ^= m_rand << 5;
+        return m_rand;
+}
+
+
+/**@brief Function for deciding whether an event of the given probability happens. */
+static bool rand_ppm(uint32_t ppm)
+{
+        return (rand_next() % 1000000) < ppm;
+}
+
+
+/**@brief Function for getting byte k of the stream of a side. */
+static uint8_t stream_byte(uint32_t side, uint32_t k)
+{
+        return (uint8_t)(((k + 1) * 0x9E3779B1UL + side * 0x85EBCA6BUL) >> 24);
+}
+
+
+/**@brief Function for deciding whether the next message received is lost. */
+static bool msg_lost(void)
+{
+        m_bad = m_bad ? !rand_ppm(mp_loss->to_good_ppm) : rand_ppm(mp_loss->to_bad_ppm);
+        m_msgs++;
+
+        if (m_bad || rand_ppm(mp_loss->loss_ppm))
+        {
+                m_msgs_lost++;
+                return true;
+        }
+        return false;
+}
+
+
+static side_t * side_of_mux(nus_mux_t * p_mux)
+{
+        return (p_mux == &m_sides[0].mux) ? &m_sides[0] : &m_sides[1];
+}
+
+
+/**@brief Function for queueing a packet for the next connection event, the SoftDevice send. */
+static ret_code_t link_send(void * p_context, uint8_t * p_data, uint16_t length)
+{
+        side_t * p_side = (side_t *)p_context;
+
+        if (p_side->queue_count == PKTS_PER_EVT)
+        {
+                return NRF_ERROR_RESOURCES;
+        }
+
+        memcpy(p_side->queue[p_side->queue_count], p_data, length);
+        p_side->queue_len[p_side->queue_count] = length;
+        p_side->queue_count++;
+        return NRF_SUCCESS;
+}
+
+
+/**@brief Function for offering the stream to the reliable transfer until its window is full. */
+static void side_fill(side_t * p_side)
+{
+        uint32_t idx = (uint32_t)(p_side - m_sides);
+        uint8_t  msg[2 * NUS_ARQ_PAYLOAD_MAX];
+
+        while (p_side->sending)
+        {
+                uint16_t len = p_side->full_frames ? NUS_ARQ_PAYLOAD_MAX
+                               : (uint16_t)(1 + rand_next() % sizeof(msg));
+
+                for (uint16_t i = 0; i < len; i++)
+                {
+                        msg[i] = stream_byte(idx, p_side->tx_pos + i);
+                }
+
+                if (nus_arq_send(&p_side->arq, msg, len) != NRF_SUCCESS)
+                {
+                        break;
+                }
+                p_side->tx_pos += len;
+        }
+}
+
+
+static void arq_evt_handler(nus_arq_t * p_arq, nus_arq_evt_t const * p_evt)
+{
+        side_t * p_side = (p_arq == &m_sides[0].arq) ? &m_sides[0] : &m_sides[1];
+        uint32_t peer   = (p_side == &m_sides[0]) ? 1 : 0;
+
+        switch (p_evt->type)
+        {
+        case NUS_ARQ_EVT_RX_DATA:
+                for (uint16_t i = 0; i < p_evt->len; i++)
+                {
+                        if (p_evt->p_data[i] != stream_byte(peer, p_side->rx_pos))
+                        {
+                                p_side->rx_errors++;
+                        }
+                        p_side->rx_pos++;
+                }
+                break;
+
+        case NUS_ARQ_EVT_TX_RDY:
+                side_fill(p_side);
+                break;
+
+        default:
+                break;
+        }
+}
+
+
+/**@brief Function for dispatching multiplexer events, as the applications do. */
+static void mux_evt_handler(nus_mux_t * p_mux, nus_mux_evt_t const * p_evt)
+{
+        side_t * p_side = side_of_mux(p_mux);
+
+        if ((p_evt->type == NUS_MUX_EVT_TX_RDY) && (p_evt->ch == NUS_MUX_CH_DATA))
+        {
+                nus_arq_on_tx_rdy(&p_side->arq);
+        }
+
+        if (p_evt->type != NUS_MUX_EVT_RX_DATA)
+        {
+                return;
+        }
+
+        if (!p_side->rx_mid[p_evt->ch])
+        {
+                p_side->rx_drop[p_evt->ch] = msg_lost();
+        }
+        p_side->rx_mid[p_evt->ch] = !p_evt->eom;
+
+        if (p_side->rx_drop[p_evt->ch])
+        {
+                return;
+        }
+
+        if (p_evt->ch == NUS_MUX_CH_DATA)
+        {
+                nus_arq_on_data(&p_side->arq, p_evt->p_data, p_evt->len, p_evt->eom);
+        }
+        else if ((p_evt->ch == NUS_MUX_CH_CTRL) && (p_evt->len > 0) && (p_evt->p_data[0] == NUS_MUX_OP_ARQ_ACK))
+        {
+                nus_arq_on_ack(&p_side->arq, p_evt->p_data, p_evt->len);
+        }
+}
+
+
+/**@brief Function for carrying the packets queued by one side to the other. */
+static void link_carry(side_t * p_from, side_t * p_to)
+{
+        uint8_t  pkts[PKTS_PER_EVT][NUS_MUX_PACKET_MAX];
+        uint16_t lens[PKTS_PER_EVT];
+        uint32_t count = p_from->queue_count;
+
+        // The receiver may queue answers to the sender while the packets are handed over.
+        memcpy(pkts, p_from->queue, sizeof(pkts));
+        memcpy(lens, p_from->queue_len, sizeof(lens));
+        p_from->queue_count = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+                nus_mux_on_data(&p_to->mux, pkts[i], lens[i]);
+        }
+}
+
+
+/**@brief Function for running one connection event and the time up to the next one. */
+static void link_event(void)
+{
+        link_carry(&m_sides[0], &m_sides[1]);
+        link_carry(&m_sides[1], &m_sides[0]);
+
+        // Write Command and notification TX complete.
+        for (uint32_t i = 0; i < ARRAY_SIZE(m_sides); i++)
+        {
+                nus_mux_tx_process(&m_sides[i].mux);
+                side_fill(&m_sides[i]);
+        }
+
+        host_app_timer_advance(CI_TICKS);
+}
+
+
+static void link_init(loss_model_t const * p_loss)
+{
+        memset(m_sides, 0, sizeof(m_sides));
+        memset(m_host_app_timers, 0, sizeof(m_host_app_timers));
+        mp_loss     = p_loss;
+        m_bad       = false;
+        m_msgs      = 0;
+        m_msgs_lost = 0;
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(m_sides); i++)
+        {
+                nus_mux_init_t mux_init = {link_send, mux_evt_handler, &m_sides[i]};
+                nus_arq_init_t arq_init = {&m_sides[i].mux, arq_evt_handler};
+
+                TEST_CHECK_EQ(nus_mux_init(&m_sides[i].mux, &mux_init), NRF_SUCCESS);
+                nus_mux_payload_max_set(&m_sides[i].mux, NUS_MUX_PACKET_MAX);
+                TEST_CHECK_EQ(nus_arq_init(&m_sides[i].arq, &arq_init), NRF_SUCCESS);
+        }
+}
+
+
+/**@brief Function for stopping the streams and running the link until everything is delivered.
+ *
+ * @return True if both streams were delivered whole.
+ */
+static bool link_drain(void)
+{
+        m_sides[0].sending = false;
+        m_sides[1].sending = false;
+
+        for (uint32_t n = 0; n < DRAIN_EVENTS_MAX; n++)
+        {
+                if ((m_sides[1].rx_pos == m_sides[0].tx_pos) && (m_sides[0].rx_pos == m_sides[1].tx_pos) &&
+                    (m_sides[0].arq.tx_base == m_sides[0].arq.tx_next) &&
+                    (m_sides[1].arq.tx_base == m_sides[1].arq.tx_next))
+                {
+                        return true;
+                }
+                link_event();
+        }
+        return false;
+}
+
+
+static loss_model_t const m_lossless = {"no loss",            0,      0,      0};
+static loss_model_t const m_random1  = {"random 1 %",         10000,  0,      0};
+static loss_model_t const m_random5  = {"random 5 %",         50000,  0,      0};
+static loss_model_t const m_random20 = {"random 20 %",        200000, 0,      0};
+static loss_model_t const m_burst    = {"bursts of 4, 2 %",   0,      5000,   250000};
+static loss_model_t const m_burst16  = {"bursts of 16, 5 %",  0,      3300,   62500};
+
+
+/**@brief Function for streaming both ways in random messages and checking what arrives. */
+static void stream_check(loss_model_t const * p_loss)
+{
+        link_init(p_loss);
+        m_sides[0].sending = true;
+        m_sides[1].sending = true;
+
+        for (uint32_t n = 0; n < RUN_EVENTS / 4; n++)
+        {
+                side_fill(&m_sides[0]);
+                side_fill(&m_sides[1]);
+                link_event();
+        }
+
+        TEST_CHECK(link_drain());
+        TEST_CHECK_EQ(m_sides[0].rx_errors, 0);
+        TEST_CHECK_EQ(m_sides[1].rx_errors, 0);
+        TEST_CHECK_EQ(m_sides[1].rx_pos, m_sides[0].tx_pos);
+        TEST_CHECK_EQ(m_sides[0].rx_pos, m_sides[1].tx_pos);
+        TEST_CHECK(m_sides[0].tx_pos > 0);
+        TEST_CHECK_EQ(m_sides[0].arq.stats.tx_bytes, m_sides[0].tx_pos);
+        TEST_CHECK_EQ(m_sides[1].arq.stats.tx_bytes, m_sides[1].tx_pos);
+
+        if (p_loss->loss_ppm + p_loss->to_bad_ppm > 0)
+        {
+                // The losses went through both kinds of recovery.
+                TEST_CHECK(m_sides[0].arq.stats.retx_fast > 0);
+                TEST_CHECK(m_sides[0].arq.stats.retx_rto > 0);
+        }
+}
+
+
+static void test_lossless(void)
+{
+        stream_check(&m_lossless);
+        TEST_CHECK_EQ(m_msgs_lost, 0);
+        TEST_CHECK_EQ(m_sides[0].arq.stats.retx_fast + m_sides[0].arq.stats.retx_rto, 0);
+        TEST_CHECK_EQ(m_sides[0].arq.stats.rx_dup + m_sides[1].arq.stats.rx_dup, 0);
+}
+
+
+static void test_random_loss(void)
+{
+        stream_check(&m_random1);
+        stream_check(&m_random5);
+        stream_check(&m_random20);
+}
+
+
+static void test_burst_loss(void)
+{
+        stream_check(&m_burst);
+        stream_check(&m_burst16);
+}
+
+
+/**@brief Function for checking that a window that is full reports room again. */
+static void test_window_full(void)
+{
+        uint8_t msg[NUS_ARQ_PAYLOAD_MAX];
+
+        link_init(&m_lossless);
+        memset(msg, 0, sizeof(msg));
+
+        for (uint32_t i = 0; i < NUS_ARQ_WINDOW; i++)
+        {
+                TEST_CHECK_EQ(nus_arq_send(&m_sides[0].arq, msg, sizeof(msg)), NRF_SUCCESS);
+                m_sides[0].tx_pos += sizeof(msg);
+        }
+        TEST_CHECK_EQ(nus_arq_send(&m_sides[0].arq, msg, 1), NRF_ERROR_NO_MEM);
+        TEST_CHECK(m_sides[0].arq.tx_full);
+        TEST_CHECK_EQ(nus_arq_send(&m_sides[0].arq, msg, 0), NRF_ERROR_INVALID_LENGTH);
+
+        link_event();
+        link_event();
+        TEST_CHECK(!m_sides[0].arq.tx_full);
+        TEST_CHECK_EQ(m_sides[1].rx_pos, NUS_ARQ_WINDOW * sizeof(msg));
+}
+
+
+/**@brief Function for streaming full frames one way and reporting the efficiency. */
+static double bench(loss_model_t const * p_loss)
+{
+        link_init(p_loss);
+        m_sides[0].full_frames = true;
+        m_sides[0].sending     = true;
+
+        for (uint32_t n = 0; n < RUN_EVENTS; n++)
+        {
+                side_fill(&m_sides[0]);
+                link_event();
+        }
+
+        uint32_t delivered  = m_sides[1].rx_pos;
+        double   efficiency = 100.0 * delivered / ((double)RUN_EVENTS * RAW_BYTES_PER_EVT);
+
+        TEST_CHECK(link_drain());
+        TEST_CHECK_EQ(m_sides[1].rx_errors, 0);
+
+        printf("  %-20s %5.2f %% lost, %6.1f kB/s of %6.1f, efficiency %5.1f %%, %5u fast and %4u timeout retransmits\n",
+               p_loss->p_name, 100.0 * m_msgs_lost / m_msgs,
+               delivered / (RUN_EVENTS * CI_MS / 1000.0) / 1000.0,
+               RAW_BYTES_PER_EVT / (double)CI_MS,
+               efficiency,
+               m_sides[0].arq.stats.retx_fast, m_sides[0].arq.stats.retx_rto);
+
+        return efficiency;
+}
+
+
+static void test_bench(void)
+{
+        printf("Efficiency against raw Write Commands, %u packets of %u bytes per %u ms event:\n",
+               PKTS_PER_EVT, NUS_MUX_PACKET_MAX, CI_MS);
+
+        TEST_CHECK(bench(&m_lossless) >= 90.0);
+        TEST_CHECK(bench(&m_random1) >= 90.0);
+        bench(&m_random5);
+        bench(&m_random20);
+        bench(&m_burst);
+        bench(&m_burst16);
+}
+
+
+int main(void)
+{
+        TEST_RUN(test_lossless);
+        TEST_RUN(test_random_loss);
+        TEST_RUN(test_burst_loss);
+        TEST_RUN(test_window_full);
+        TEST_RUN(test_bench);
+        TEST_MAIN_END();
+}
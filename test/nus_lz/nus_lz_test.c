@@ -0,0 +1,492 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test and benchmark of the NUS stream compression.
+ *
+ * @details Generated corpora, log lines as the sensors print them, text and random bytes, are
+ *          cut into UART lines and sent one message at a time from an encoder to a decoder.
+ *          Every message must come out as it went in. The tests also cover the raw messages
+ *          sent before the peer's announcement and when compression does not pay, the history
+ *          shared across messages, messages that were encoded but not sent, and malformed
+ *          input. The benchmark prints the compression ratio and the time per byte of every
+ *          corpus.
+ */
+
+#include <stdlib.h>
+#include "host_test.h"
+
+#include "nus_lz.c"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEST_TSC()              __rdtsc()
+#else
+#define TEST_TSC()              0
+#endif
+
+#define LINE_MAX                244                     /**< Longest UART line, BLE_NUS_MAX_DATA_LEN. */
+#define CORPUS_SIZE             (256 * 1024)            /**< Bytes of every corpus. */
+
+/**@brief Result of sending a corpus through the compression. */
+typedef struct
+{
+        uint32_t msgs;          /**< Messages sent. */
+        uint32_t msgs_raw;      /**< Messages sent raw. */
+        uint32_t raw;           /**< Bytes before compression. */
+        uint32_t coded;         /**< Bytes of the encoded messages, headers included. */
+        uint32_t errors;        /**< Bytes that did not come out as they went in. */
+        uint64_t enc_ns;        /**< Time spent encoding. */
+        uint64_t dec_ns;        /**< Time spent decoding. */
+        uint64_t enc_tsc;       /**< TSC cycles spent encoding. */
+        uint64_t dec_tsc;       /**< TSC cycles spent decoding. */
+} result_t;
+
+typedef uint32_t (* corpus_gen_t)(uint8_t * p_buf, uint32_t size);
+
+static nus_lz_t m_enc;
+static nus_lz_t m_dec;
+static uint8_t  m_corpus[CORPUS_SIZE];
+static uint32_t m_rand = 0x2545F491;
+
+
+static uint32_t rand_next(void)
+{
+        m_rand ^= m_rand << 13;
+        m_rand ^= m_rand >> 17;
+        m_rand ^= m_rand << 5;
+        return m_rand;
+}
+
+
+/**@brief Function for generating the log of a sensor, lines with counters and readings. */
+static uint32_t corpus_log(uint8_t * p_buf, uint32_t size)
+{
+        static char const * const modules[] = {"app", "ble_hrs_c", "nus_arq", "link_ctx", "scan_sched"};
+        uint32_t len = 0;
+        uint32_t ms  = 1000;
+        char     line[LINE_MAX + 1];
+
+        while (true)
+        {
+                uint32_t r = rand_next();
+                int      n;
+
+                ms += 20 + r % 200;
+                switch (r % 4)
+                {
+                case 0:
+                        n = snprintf(line, sizeof(line), "%08u <info> %s: HR %u bpm, RR %u ms, energy %u kJ\r\n",
+                                     ms, modules[0], 55 + (r >> 8) % 60, 500 + (r >> 16) % 600, (r >> 4) % 900);
+                        break;
+                case 1:
+                        n = snprintf(line, sizeof(line), "%08u <info> %s: Battery level %u %% on link %u\r\n",
+                                     ms, modules[1], 60 + (r >> 8) % 40, (r >> 20) % 4);
+                        break;
+                case 2:
+                        n = snprintf(line, sizeof(line), "%08u <debug> %s: ARQ tx: %u frames, %u bytes acknowledged\r\n",
+                                     ms, modules[2], (r >> 8) % 5000, (r >> 12) % 1000000);
+                        break;
+                default:
+                        n = snprintf(line, sizeof(line), "%08u <warning> %s: Link %u interval %u.%02u ms, %u dBm\r\n",
+                                     ms, modules[3 + (r >> 30) % 2], (r >> 8) % 4, 7 + (r >> 12) % 40,
+                                     25 * ((r >> 18) % 4), (r >> 22) % 40);
+                        break;
+                }
+
+                if (len + (uint32_t)n > size)
+                {
+                        return len;
+                }
+                memcpy(&p_buf[len], line, (size_t)n);
+                len += (uint32_t)n;
+        }
+}
+
+
+/**@brief Function for generating text, sentences of common words. */
+static uint32_t corpus_text(uint8_t * p_buf, uint32_t size)
+{
+        static char const * const words[] =
+        {
+                "the", "heart", "rate", "of", "a", "sensor", "is", "sent", "to", "central", "over",
+                "link", "and", "every", "measurement", "carries", "RR", "intervals", "when", "beat",
+                "detection", "runs", "on", "peripheral", "which", "also", "reports", "battery",
+                "level", "in", "percent", "with", "notifications", "that", "are", "queued", "by",
+                "SoftDevice", "before", "each", "connection", "event", "starts",
+        };
+        uint32_t len  = 0;
+        uint32_t line = 0;
+
+        while (true)
+        {
+                char const * p_word = words[rand_next() % ARRAY_SIZE(words)];
+                uint32_t     n      = (uint32_t)strlen(p_word);
+
+                if (len + n + 2 > size)
+                {
+                        return len;
+                }
+
+                memcpy(&p_buf[len], p_word, n);
+                len  += n;
+                line += n + 1;
+
+                if ((line > 70) || (rand_next() % 12 == 0))
+                {
+                        p_buf[len++] = '.';
+                        p_buf[len++] = '\n';
+                        line         = 0;
+                }
+                else
+                {
+                        p_buf[len++] = ' ';
+                }
+        }
+}
+
+
+/**@brief Function for generating random bytes, which do not compress. */
+static uint32_t corpus_random(uint8_t * p_buf, uint32_t size)
+{
+        for (uint32_t i = 0; i < size; i++)
+        {
+                p_buf[i] = (uint8_t)(rand_next() >> 24);
+        }
+        return size;
+}
+
+
+/**@brief Function for getting the length of the next UART line of a corpus, as uart_event_handle cuts it. */
+static uint16_t line_len(uint8_t const * p_data, uint32_t left)
+{
+        uint16_t n = 0;
+
+        while ((n < left) && (n < LINE_MAX))
+        {
+                uint8_t c = p_data[n++];
+
+                if ((c == '\n') || (c == '\r'))
+                {
+                        break;
+                }
+        }
+        return n;
+}
+
+
+/**@brief Function for setting up both ends, the decoder announcing its window if asked. */
+static void ends_init(bool hello)
+{
+        uint8_t msg[NUS_LZ_HELLO_LEN];
+
+        nus_lz_init(&m_enc);
+        nus_lz_init(&m_dec);
+
+        if (hello)
+        {
+                nus_lz_hello_get(msg);
+                TEST_CHECK_EQ(msg[0], NUS_MUX_OP_LZ_HELLO);
+                TEST_CHECK_EQ(1UL << msg[1], NUS_LZ_WINDOW);
+                nus_lz_on_hello(&m_enc, msg, sizeof(msg));
+                TEST_CHECK_EQ(m_enc.dist_max, NUS_LZ_WINDOW);
+        }
+}
+
+
+/**@brief Function for sending one message from the encoder to the decoder.
+ *
+ * @return Length of the encoded message.
+ */
+static uint16_t msg_send(uint8_t const * p_data, uint16_t len, result_t * p_res)
+{
+        uint8_t         coded[NUS_LZ_ENC_MAX];
+        uint16_t        coded_len = 0;
+        uint8_t const * p_out     = NULL;
+        uint16_t        out_len   = 0;
+        uint64_t        t0        = test_ns();
+        uint64_t        c0        = TEST_TSC();
+
+        TEST_CHECK_EQ(nus_lz_encode(&m_enc, p_data, len, coded, &coded_len), NRF_SUCCESS);
+        nus_lz_encode_commit(&m_enc);
+
+        p_res->enc_tsc += TEST_TSC() - c0;
+        p_res->enc_ns  += test_ns() - t0;
+        t0              = test_ns();
+        c0              = TEST_TSC();
+
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, coded, coded_len, &p_out, &out_len), NRF_SUCCESS);
+
+        p_res->dec_tsc += TEST_TSC() - c0;
+        p_res->dec_ns  += test_ns() - t0;
+
+        // A message never grows by more than its header.
+        TEST_CHECK(coded_len <= NUS_LZ_HDR_LEN + len);
+        TEST_CHECK((coded[0] == NUS_LZ_HDR_RAW) ? (coded_len == NUS_LZ_HDR_LEN + len) : (coded_len < NUS_LZ_HDR_LEN + len));
+
+        if ((out_len != len) || (memcmp(p_out, p_data, len) != 0))
+        {
+                p_res->errors += len;
+        }
+
+        p_res->msgs++;
+        p_res->msgs_raw += (coded[0] == NUS_LZ_HDR_RAW);
+        p_res->raw      += len;
+        p_res->coded    += coded_len;
+
+        return coded_len;
+}
+
+
+/**@brief Function for sending a corpus line by line, skipping the lone line ends as the UART does. */
+static void corpus_send(uint8_t const * p_data, uint32_t size, result_t * p_res)
+{
+        memset(p_res, 0, sizeof(*p_res));
+
+        for (uint32_t pos = 0; pos < size; )
+        {
+                uint16_t len = line_len(&p_data[pos], size - pos);
+
+                if (len > 1)
+                {
+                        msg_send(&p_data[pos], len, p_res);
+                }
+                pos += len;
+        }
+
+        TEST_CHECK_EQ(p_res->errors, 0);
+        TEST_CHECK_EQ(m_dec.stats.rx_errors, 0);
+        TEST_CHECK_EQ(m_enc.stats.tx_raw, p_res->raw);
+        TEST_CHECK_EQ(m_dec.stats.rx_raw, p_res->raw);
+}
+
+
+static void test_round_trip(void)
+{
+        static corpus_gen_t const gens[] = {corpus_log, corpus_text, corpus_random};
+        result_t                  res;
+
+        for (uint32_t i = 0; i < ARRAY_SIZE(gens); i++)
+        {
+                uint32_t size = gens[i](m_corpus, sizeof(m_corpus));
+
+                ends_init(true);
+                corpus_send(m_corpus, size, &res);
+                TEST_CHECK(res.raw > 4 * NUS_LZ_WINDOW);
+        }
+}
+
+
+/**@brief Function for checking that nothing is compressed before the peer announced its window. */
+static void test_raw_before_hello(void)
+{
+        result_t res;
+        uint32_t size = corpus_log(m_corpus, 16 * 1024);
+
+        ends_init(false);
+        corpus_send(m_corpus, size, &res);
+        TEST_CHECK_EQ(res.msgs_raw, res.msgs);
+
+        // A malformed announcement leaves compression off.
+        uint8_t const bad[] = {NUS_MUX_OP_LZ_HELLO, 13};
+
+        nus_lz_on_hello(&m_enc, bad, sizeof(bad));
+        nus_lz_on_hello(&m_enc, bad, 1);
+        TEST_CHECK_EQ(m_enc.dist_max, 0);
+}
+
+
+/**@brief Function for checking that data that does not compress is sent raw. */
+static void test_raw_fallback(void)
+{
+        result_t res;
+        uint32_t size = corpus_random(m_corpus, 16 * 1024);
+
+        ends_init(true);
+        corpus_send(m_corpus, size, &res);
+        TEST_CHECK_EQ(res.msgs_raw, res.msgs);
+        TEST_CHECK_EQ(res.coded, res.raw + res.msgs * NUS_LZ_HDR_LEN);
+
+        // Short messages cannot get shorter.
+        uint8_t const one[] = "a";
+
+        ends_init(true);
+        memset(&res, 0, sizeof(res));
+        TEST_CHECK_EQ(msg_send(one, 1, &res), NUS_LZ_HDR_LEN + 1);
+        TEST_CHECK_EQ(msg_send(one, 1, &res), NUS_LZ_HDR_LEN + 1);
+        TEST_CHECK_EQ(res.errors, 0);
+}
+
+
+/**@brief Function for checking that a message compresses against the ones sent before it. */
+static void test_shared_history(void)
+{
+        static uint8_t const line[] = "00012345 <info> app: HR 72 bpm, RR 833 ms, energy 120 kJ\r\n";
+        uint16_t             len    = sizeof(line) - 1;
+        result_t             res;
+        uint16_t             first;
+        uint16_t             again;
+
+        ends_init(true);
+        memset(&res, 0, sizeof(res));
+
+        first = msg_send(line, len, &res);
+        again = msg_send(line, len, &res);
+
+        // On its own the line hardly repeats itself, sent again it is a few matches.
+        TEST_CHECK(first > len * 3 / 4);
+        TEST_CHECK(again < len / 4);
+        TEST_CHECK_EQ(res.errors, 0);
+
+        // Beyond the window the history no longer helps.
+        for (uint32_t i = 0; i < 2u * NUS_LZ_WINDOW / len + 1; i++)
+        {
+                uint8_t other[LINE_MAX];
+
+                for (uint16_t k = 0; k < len; k++)
+                {
+                        other[k] = (uint8_t)(rand_next() >> 24);
+                }
+                msg_send(other, len, &res);
+        }
+        TEST_CHECK(msg_send(line, len, &res) > len * 3 / 4);
+        TEST_CHECK_EQ(res.errors, 0);
+}
+
+
+/**@brief Function for checking that a message that was encoded but not sent leaves no trace. */
+static void test_uncommitted(void)
+{
+        static uint8_t const a[] = "link 0 connected, interval 7.50 ms\r\n";
+        static uint8_t const b[] = "link 1 connected, interval 30.00 ms, PHY 2M\r\n";
+        uint8_t              coded[NUS_LZ_ENC_MAX];
+        uint16_t             coded_len;
+        result_t             res;
+
+        ends_init(true);
+        memset(&res, 0, sizeof(res));
+
+        msg_send(a, sizeof(a) - 1, &res);
+        TEST_CHECK_EQ(nus_lz_encode(&m_enc, b, sizeof(b) - 1, coded, &coded_len), NRF_SUCCESS);
+        msg_send(a, sizeof(a) - 1, &res);
+        msg_send(b, sizeof(b) - 1, &res);
+        msg_send(b, sizeof(b) - 1, &res);
+        TEST_CHECK_EQ(res.errors, 0);
+
+        TEST_CHECK_EQ(nus_lz_encode(&m_enc, a, 0, coded, &coded_len), NRF_ERROR_INVALID_LENGTH);
+        TEST_CHECK_EQ(nus_lz_encode(&m_enc, m_corpus, NUS_LZ_MSG_MAX + 1, coded, &coded_len),
+                      NRF_ERROR_INVALID_LENGTH);
+}
+
+
+/**@brief Function for checking that malformed messages are refused and reset the history. */
+static void test_malformed(void)
+{
+        static uint8_t const a[]         = "abcabcabcabcabcabcabc\r\n";
+        static uint8_t const bad_hdr[]   = {0x02, 'x'};
+        static uint8_t const far[]       = {NUS_LZ_HDR_LZ, 0x01, 0xFF, 0xF0};
+        static uint8_t const cut_match[] = {NUS_LZ_HDR_LZ, 0x01, 0x00};
+        uint8_t              big[NUS_LZ_HDR_LEN + NUS_LZ_MSG_MAX + 1];
+        uint8_t const      * p_out;
+        uint16_t             out_len;
+        result_t             res;
+
+        ends_init(true);
+        memset(&res, 0, sizeof(res));
+        memset(big, 'z', sizeof(big));
+        big[0] = NUS_LZ_HDR_RAW;
+
+        msg_send(a, sizeof(a) - 1, &res);
+        TEST_CHECK(m_dec.dec_len > 0);
+
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, bad_hdr, sizeof(bad_hdr), &p_out, &out_len), NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(m_dec.dec_len, 0);
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, far, sizeof(far), &p_out, &out_len), NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, cut_match, sizeof(cut_match), &p_out, &out_len), NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, big, sizeof(big), &p_out, &out_len), NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(nus_lz_decode(&m_dec, big, 0, &p_out, &out_len), NRF_ERROR_INVALID_DATA);
+        TEST_CHECK_EQ(m_dec.stats.rx_errors, 5);
+
+        // Both ends start over after a reset, as on a new link.
+        nus_lz_reset(&m_enc);
+        nus_lz_reset(&m_dec);
+        m_enc.dist_max = NUS_LZ_WINDOW;
+        msg_send(a, sizeof(a) - 1, &res);
+        TEST_CHECK_EQ(res.errors, 0);
+}
+
+
+static void bench(char const * p_name, corpus_gen_t gen)
+{
+        result_t res;
+        uint32_t size = gen(m_corpus, sizeof(m_corpus));
+
+        ends_init(true);
+        corpus_send(m_corpus, size, &res);
+
+        printf("  %-8s %6u bytes in %5u messages, coded to %5.1f %%, %3u %% sent raw,"
+               " encode %4.1f ns %5.1f TSC cycles, decode %4.1f ns %5.1f TSC cycles per byte\n",
+               p_name, res.raw, res.msgs, 100.0 * res.coded / res.raw, 100 * res.msgs_raw / res.msgs,
+               (double)res.enc_ns / res.raw, (double)res.enc_tsc / res.raw,
+               (double)res.dec_ns / res.raw, (double)res.dec_tsc / res.raw);
+}
+
+
+static void test_bench(void)
+{
+        printf("Compression of UART lines, window %u bytes, match table of %u:\n",
+               NUS_LZ_WINDOW, 1 << NUS_LZ_HASH_BITS);
+        bench("log", corpus_log);
+        bench("text", corpus_text);
+        bench("random", corpus_random);
+}
+
+
+int main(void)
+{
+        TEST_RUN(test_round_trip);
+        TEST_RUN(test_raw_before_hello);
+        TEST_RUN(test_raw_fallback);
+        TEST_RUN(test_shared_history);
+        TEST_RUN(test_uncommitted);
+        TEST_RUN(test_malformed);
+        TEST_RUN(test_bench);
+        TEST_MAIN_END();
+}
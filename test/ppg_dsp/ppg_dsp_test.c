@@ -0,0 +1,390 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host test and benchmark of the PPG beat detector on recorded signals.
+ *
+ * @details Every vector given on the command line, see ppg_vectors.py for the format, goes
+ *          through the detector in blocks of PPG_BUFFER_SIZE samples, as the SAADC hands them
+ *          over. The RR intervals reported are matched against the annotated peaks:
+ *          - coverage: normal RR intervals of the recording reported, at least MIN_COVERAGE_PCT,
+ *          - false:    RR intervals reported that are not a normal interval of the recording, at
+ *                      most MAX_FALSE_PCT,
+ *          - error:    difference between a reported interval and the annotated one, at most
+ *                      MAX_ERR_MEAN_MS on average and MAX_ERR_MS for any.
+ *          Intervals overlapping the first WARMUP_MS or a motion artifact annotated in the
+ *          recording are not scored. The heart rate at the end must be within MAX_HR_ERR_BPM of
+ *          the annotated one, and the contact must be lost on a flat signal. The time taken per
+ *          sample is printed.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "host_test.h"
+
+#include "ppg_dsp.c"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEST_TSC()              __rdtsc()
+#else
+#define TEST_TSC()              0
+#endif
+
+#define SAMPLES_MAX             (PPG_DSP_FS_HZ * 600)   /**< Longest recording, 10 minutes. */
+#define BEATS_MAX               (SAMPLES_MAX / 10)      /**< Most beats in a recording. */
+#define WARMUP_MS               3000                    /**< Start of a recording not scored, the filters settle. */
+#define MATCH_MS                100                     /**< Largest distance between a beat and its annotation. */
+#define NORMAL_PCT              20                      /**< Largest deviation of a normal RR interval from the local median. */
+#define MIN_COVERAGE_PCT        90
+#define MAX_FALSE_PCT           3
+#define MAX_ERR_MEAN_MS         10
+#define MAX_ERR_MS              40
+#define MAX_HR_ERR_BPM          5
+#define ARTIFACTS_MAX           16                      /**< Most motion artifacts in a recording. */
+#define FLAT_MS                 (PPG_DSP_CONTACT_MS + 1000)     /**< Flat signal after a recording. */
+
+/**@brief A recording and what the detector made of it. */
+typedef struct
+{
+        int16_t    samples[SAMPLES_MAX];        /**< Samples. */
+        uint32_t   sample_cnt;
+        bool       invert;                      /**< The pulse is a dip of the samples. */
+        double     ref_ms[BEATS_MAX];           /**< Annotated peaks. */
+        uint32_t   ref_cnt;
+        bool       normal[BEATS_MAX];           /**< The RR interval ending at the peak is normal. */
+        double     artifact_ms[ARTIFACTS_MAX][2]; /**< Start and end of the motion artifacts. */
+        uint32_t   artifact_cnt;
+        double     end_ms[BEATS_MAX];           /**< End of every reported RR interval. */
+        double     rr_ms[BEATS_MAX];            /**< Reported RR intervals. */
+        uint32_t   rr_cnt;
+        ppg_dsp_t  dsp;
+} recording_t;
+
+static recording_t m_rec;
+
+
+/**@brief Function for reading a vector. */
+static bool vector_read(char const * p_path, recording_t * p_rec)
+{
+        FILE * p_file = fopen(p_path, "r");
+        char   line[128];
+
+        if (p_file == NULL)
+        {
+                printf("%s: cannot open\n", p_path);
+                return false;
+        }
+
+        p_rec->sample_cnt   = 0;
+        p_rec->ref_cnt      = 0;
+        p_rec->invert       = false;
+        p_rec->artifact_cnt = 0;
+
+        while (fgets(line, sizeof(line), p_file) != NULL)
+        {
+                char * p_comma;
+
+                if (line[0] == '#')
+                {
+                        int    invert;
+                        double start;
+                        double end;
+
+                        if (sscanf(line, "# invert=%d", &invert) == 1)
+                        {
+                                p_rec->invert = (invert != 0);
+                        }
+                        if ((sscanf(line, "# artifact=%lf,%lf", &start, &end) == 2) &&
+                            (p_rec->artifact_cnt < ARTIFACTS_MAX))
+                        {
+                                p_rec->artifact_ms[p_rec->artifact_cnt][0] = start;
+                                p_rec->artifact_ms[p_rec->artifact_cnt][1] = end;
+                                p_rec->artifact_cnt++;
+                        }
+                        continue;
+                }
+                if ((line[0] < '0') || (line[0] > '9') || (p_rec->sample_cnt == SAMPLES_MAX))
+                {
+                        continue;
+                }
+
+                p_rec->samples[p_rec->sample_cnt++] = (int16_t)strtol(line, &p_comma, 10);
+                if ((*p_comma == ',') && (p_comma[1] >= '0') && (p_comma[1] <= '9') &&
+                    (p_rec->ref_cnt < BEATS_MAX))
+                {
+                        p_rec->ref_ms[p_rec->ref_cnt++] = strtod(p_comma + 1, NULL);
+                }
+        }
+
+        fclose(p_file);
+        return p_rec->sample_cnt != 0;
+}
+
+
+static int double_cmp(void const * p_a, void const * p_b)
+{
+        double a = *(double const *)p_a;
+        double b = *(double const *)p_b;
+
+        return (a > b) - (a < b);
+}
+
+
+/**@brief Function for telling the normal RR intervals of the recording from the ectopic ones. */
+static void normal_mark(recording_t * p_rec)
+{
+        for (uint32_t k = 0; k < p_rec->ref_cnt; k++)
+        {
+                double   window[9];
+                uint32_t n = 0;
+                double   rr;
+
+                p_rec->normal[k] = false;
+                if (k == 0)
+                {
+                        continue;
+                }
+
+                for (int32_t j = (int32_t)k - 4; j <= (int32_t)k + 4; j++)
+                {
+                        if ((j >= 1) && (j < (int32_t)p_rec->ref_cnt))
+                        {
+                                window[n++] = p_rec->ref_ms[j] - p_rec->ref_ms[j - 1];
+                        }
+                }
+                qsort(window, n, sizeof(window[0]), double_cmp);
+
+                rr               = p_rec->ref_ms[k] - p_rec->ref_ms[k - 1];
+                p_rec->normal[k] = (fabs(rr - window[n / 2]) * 100 <= window[n / 2] * NORMAL_PCT);
+        }
+}
+
+
+/**@brief Function for telling whether an interval is scored. */
+static bool scored_is(recording_t const * p_rec, double start, double end)
+{
+        if (start < WARMUP_MS)
+        {
+                return false;
+        }
+        for (uint32_t i = 0; i < p_rec->artifact_cnt; i++)
+        {
+                if ((start - MATCH_MS < p_rec->artifact_ms[i][1]) &&
+                    (end + MATCH_MS > p_rec->artifact_ms[i][0]))
+                {
+                        return false;
+                }
+        }
+        return true;
+}
+
+
+/**@brief Function for finding the annotated peak nearest to a time. */
+static uint32_t ref_nearest(recording_t const * p_rec, double ms)
+{
+        uint32_t best = 0;
+
+        for (uint32_t k = 1; k < p_rec->ref_cnt; k++)
+        {
+                if (fabs(p_rec->ref_ms[k] - ms) < fabs(p_rec->ref_ms[best] - ms))
+                {
+                        best = k;
+                }
+        }
+        return best;
+}
+
+
+/**@brief Beat handler, keeps the end of the interval: the previous beat plus the interval. */
+static void beat_handler(void * p_context, uint16_t rr_interval)
+{
+        recording_t * p_rec = p_context;
+        double        prev  = ((double)p_rec->dsp.beat_n + p_rec->dsp.beat_frac / 256.0) * 1000 / PPG_DSP_FS_HZ;
+
+        if (p_rec->rr_cnt < BEATS_MAX)
+        {
+                p_rec->rr_ms[p_rec->rr_cnt]  = rr_interval * 1000.0 / 1024;
+                p_rec->end_ms[p_rec->rr_cnt] = prev + p_rec->rr_ms[p_rec->rr_cnt];
+                p_rec->rr_cnt++;
+        }
+}
+
+
+static void vector_run(char const * p_path)
+{
+        recording_t * p_rec = &m_rec;
+        static double delays[BEATS_MAX];
+        static bool   reported[BEATS_MAX];
+        double        delay;
+        double        err_sum = 0;
+        double        err_max = 0;
+        uint32_t      normals = 0;
+        uint32_t      covered = 0;
+        uint32_t      scored  = 0;
+        uint32_t      falses  = 0;
+        uint64_t      ns      = 0;
+        uint64_t      ns_max  = 0;
+        uint64_t      tsc     = 0;
+        uint16_t      hr;
+        double        hr_ref;
+        char const  * p_name  = strrchr(p_path, '/');
+
+        p_name = (p_name != NULL) ? p_name + 1 : p_path;
+
+        if (!vector_read(p_path, p_rec))
+        {
+                TEST_CHECK(false);
+                return;
+        }
+        normal_mark(p_rec);
+        p_rec->rr_cnt = 0;
+
+        ppg_dsp_init(&p_rec->dsp, beat_handler, p_rec, p_rec->invert);
+
+        for (uint32_t i = 0; i < p_rec->sample_cnt; i += PPG_BUFFER_SIZE)
+        {
+                uint16_t count = (uint16_t)MIN(PPG_BUFFER_SIZE, p_rec->sample_cnt - i);
+                uint64_t t0    = test_ns();
+                uint64_t c0    = TEST_TSC();
+
+                ppg_dsp_process(&p_rec->dsp, &p_rec->samples[i], count);
+
+                tsc   += TEST_TSC() - c0;
+                t0     = test_ns() - t0;
+                ns    += t0;
+                ns_max = MAX(ns_max, t0);
+        }
+
+        // The filters delay every beat by about the same time, take it out before matching.
+        for (uint32_t i = 0; i < p_rec->rr_cnt; i++)
+        {
+                delays[i] = p_rec->end_ms[i] - p_rec->ref_ms[ref_nearest(p_rec, p_rec->end_ms[i])];
+        }
+        qsort(delays, p_rec->rr_cnt, sizeof(delays[0]), double_cmp);
+        delay = (p_rec->rr_cnt != 0) ? delays[p_rec->rr_cnt / 2] : 0;
+
+        memset(reported, 0, sizeof(reported));
+        for (uint32_t i = 0; i < p_rec->rr_cnt; i++)
+        {
+                double   end   = p_rec->end_ms[i] - delay;
+                double   start = end - p_rec->rr_ms[i];
+                uint32_t k     = ref_nearest(p_rec, end);
+                double   err;
+
+                if (!scored_is(p_rec, start, end))
+                {
+                        continue;
+                }
+                scored++;
+
+                if ((k == 0) || !p_rec->normal[k] ||
+                    (fabs(p_rec->ref_ms[k] - end) > MATCH_MS) ||
+                    (fabs(p_rec->ref_ms[k - 1] - start) > MATCH_MS))
+                {
+                        falses++;
+                        continue;
+                }
+
+                err         = fabs(p_rec->rr_ms[i] - (p_rec->ref_ms[k] - p_rec->ref_ms[k - 1]));
+                err_sum    += err;
+                err_max     = MAX(err_max, err);
+                reported[k] = true;
+        }
+
+        for (uint32_t k = 1; k < p_rec->ref_cnt; k++)
+        {
+                if (p_rec->normal[k] && scored_is(p_rec, p_rec->ref_ms[k - 1], p_rec->ref_ms[k]))
+                {
+                        normals++;
+                        covered += reported[k] ? 1 : 0;
+                }
+        }
+
+        // Heart rate over the last RR intervals of the recording.
+        hr     = ppg_dsp_heart_rate_get(&p_rec->dsp);
+        hr_ref = 60000.0 * 8 / (p_rec->ref_ms[p_rec->ref_cnt - 1] - p_rec->ref_ms[p_rec->ref_cnt - 9]);
+
+        printf("  %-20s %3u beats, %3u RR reported, coverage %5.1f %%, false %4.1f %%, "
+               "error %4.1f ms avg %4.1f max, HR %3u/%3.0f, %3.0f ns per sample, %4.0f us worst buffer",
+               p_name, p_rec->ref_cnt, p_rec->rr_cnt,
+               (normals != 0) ? 100.0 * covered / normals : 0.0,
+               (scored != 0) ? 100.0 * falses / scored : 0.0,
+               (covered != 0) ? err_sum / covered : 0.0, err_max,
+               hr, hr_ref, (double)ns / p_rec->sample_cnt, ns_max / 1000.0);
+        if (tsc != 0)
+        {
+                printf(", %3.0f TSC cycles per sample", (double)tsc / p_rec->sample_cnt);
+        }
+        printf("\n");
+
+        TEST_CHECK(normals != 0);
+        TEST_CHECK(covered * 100 >= normals * MIN_COVERAGE_PCT);
+        TEST_CHECK(falses * 100 <= scored * MAX_FALSE_PCT);
+        TEST_CHECK(err_sum <= covered * MAX_ERR_MEAN_MS);
+        TEST_CHECK(err_max <= MAX_ERR_MS);
+        TEST_CHECK(fabs(hr - hr_ref) <= MAX_HR_ERR_BPM);
+        TEST_CHECK(ppg_dsp_contact_get(&p_rec->dsp));
+
+        // The sensor taken off: the DC level only.
+        for (uint32_t i = 0; i < FLAT_MS * PPG_DSP_FS_HZ / 1000; i++)
+        {
+                int16_t sample = p_rec->samples[p_rec->sample_cnt - 1];
+
+                ppg_dsp_process(&p_rec->dsp, &sample, 1);
+        }
+        TEST_CHECK(!ppg_dsp_contact_get(&p_rec->dsp));
+        TEST_CHECK_EQ(ppg_dsp_heart_rate_get(&p_rec->dsp), 0);
+}
+
+
+int main(int argc, char * argv[])
+{
+        TEST_CHECK(argc > 1);
+
+        printf("PPG detector on %d recordings, buffers of %d samples at %d Hz:\n",
+               argc - 1, PPG_BUFFER_SIZE, PPG_DSP_FS_HZ);
+        for (int i = 1; i < argc; i++)
+        {
+                vector_run(argv[i]);
+        }
+
+        TEST_MAIN_END();
+}
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# Generates the test vectors of the ppg_dsp host test.
+#
+# Each vector stands for a recording of the sensor front end: 12-bit samples of the SAADC at
+# 100 Hz, the pulse riding on the DC level of the photodiode, with respiration, drift, noise and
+# motion where the case calls for it. The systolic peak of every beat is annotated, in ms.
+#
+# Vector format, read by ppg_dsp_test.c:
+#   # <free text>                   comment lines
+#   # invert=<0|1>                  the pulse shows as a dip of the samples
+#   # artifact=<start ms>,<end ms>  motion, the beats within are not scored, as many as needed
+#   adc,beat_ms                     column header
+#   <sample>,[<peak time in ms>]    one line per sample, the peak on the sample it falls in
+#
+# Recordings of a real sensor in the same format can be dropped next to these ones.
+#
+#   python3 ppg_vectors.py [output directory]
+
+import math
+import os
+import random
+import sys
+
+FS_HZ = 100
+
+
+def pulse(t, amp, rr):
+    """Systolic wave rising faster than it falls, then the dicrotic wave."""
+    rise = 0.06 + 0.03 * rr
+    fall = 0.10 + 0.10 * rr
+    sigma = rise if t < 0 else fall
+    v = amp * math.exp(-0.5 * (t / sigma) ** 2)
+    dicrotic_t = 0.20 + 0.15 * rr
+    v += amp * PARAMS['dicrotic'] * math.exp(-0.5 * ((t - dicrotic_t) / 0.06) ** 2)
+    return v
+
+
+def beats(duration, rr_at, rng):
+    """Peak times in seconds, rr_at(t) giving the RR interval around t."""
+    t = 0.3 + rng.random() * 0.5
+    times = []
+    while t < duration:
+        times.append(t)
+        t += rr_at(t)
+    return times
+
+
+def motion(t, bursts, rng_state):
+    v = 0.0
+    for start, length, amp in bursts:
+        if start <= t < start + length:
+            w = math.sin(math.pi * (t - start) / length)
+            v += amp * w * (math.sin(2 * math.pi * 1.7 * t) + 0.6 * math.sin(2 * math.pi * 3.1 * t + 1.0))
+    return v
+
+
+PARAMS = {}
+
+
+def vector(name, text, duration, rr_at, amp_at, seed, invert=False, dc=2000, noise=2.0,
+           resp_amp=30.0, drift=0.0, dicrotic=0.35, bursts=(), out_dir='.'):
+    rng = random.Random(seed)
+    PARAMS['dicrotic'] = dicrotic
+    peaks = beats(duration, lambda t: rr_at(t, rng), rng)
+    amps = [amp_at(t) * (0.9 + 0.2 * rng.random()) for t in peaks]
+    rrs = [b - a for a, b in zip(peaks, peaks[1:])] + [rr_at(duration, rng)]
+
+    n = int(duration * FS_HZ)
+    marks = {}
+    for p in peaks:
+        marks.setdefault(int(round(p * FS_HZ)), p)
+
+    with open(os.path.join(out_dir, name + '.csv'), 'w') as f:
+        for line in text:
+            f.write('# ' + line + '\n')
+        f.write('# invert=%d\n' % (1 if invert else 0))
+        for start, length, amp in bursts:
+            f.write('# artifact=%d,%d\n' % (start * 1000, (start + length) * 1000))
+        f.write('adc,beat_ms\n')
+        k = 0
+        for i in range(n):
+            t = i / FS_HZ
+            while k + 1 < len(peaks) and peaks[k + 1] - 1.0 < t:
+                k += 1
+            v = 0.0
+            for j in range(max(0, k - 2), min(len(peaks), k + 3)):
+                v += pulse(t - peaks[j], amps[j], rrs[j])
+            # Respiration moves the baseline and the pulse amplitude, the drift is the contact.
+            v *= 1.0 + 0.1 * math.sin(2 * math.pi * 0.25 * t)
+            v += resp_amp * math.sin(2 * math.pi * 0.25 * t + 0.3)
+            v += drift * t / duration
+            v += motion(t, bursts, rng)
+            v += rng.gauss(0.0, noise)
+            adc = dc - v if invert else dc + v
+            adc = max(0, min(4095, int(round(adc))))
+            mark = marks.get(i)
+            f.write('%d,%s\n' % (adc, '' if mark is None else '%.1f' % (mark * 1000)))
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), 'vectors')
+
+    def rsa(mean, depth, jitter):
+        return lambda t, rng: mean + depth * math.sin(2 * math.pi * 0.25 * t) + rng.gauss(0, jitter)
+
+    vector('rest_60bpm', ['Rest, 60 bpm with respiratory sinus arrhythmia, clean contact.'],
+           45, rsa(1.0, 0.06, 0.015), lambda t: 80, seed=1, out_dir=out_dir)
+
+    vector('exercise_ramp', ['Exercise, 90 to 170 bpm over 45 s, smaller pulse and more noise.'],
+           45, lambda t, rng: 60.0 / (90 + 80 * t / 45) + rng.gauss(0, 0.005),
+           lambda t: 60 - 20 * t / 45, seed=2, noise=3.0, resp_amp=20.0, dicrotic=0.2, out_dir=out_dir)
+
+    vector('brady_42bpm', ['Bradycardia, 42 bpm with a strong dicrotic wave.'],
+           45, rsa(60.0 / 42, 0.04, 0.02), lambda t: 100, seed=3, dicrotic=0.5, out_dir=out_dir)
+
+    vector('wander_motion', ['80 bpm with strong respiration, contact drift and two short motion bursts.'],
+           45, rsa(0.75, 0.03, 0.01), lambda t: 70, seed=4, noise=3.0, resp_amp=80.0, drift=150.0,
+           bursts=((15.0, 1.5, 60.0), (32.0, 1.5, 60.0)), out_dir=out_dir)
+
+    def ectopic(t, rng, state={'n': 0, 'next': 0.0}):
+        # Every twelfth beat comes early, the next one late.
+        state['n'] += 1
+        base = 60.0 / 70 + rng.gauss(0, 0.01)
+        if state['n'] % 12 == 0:
+            return base * 0.65
+        if state['n'] % 12 == 1 and state['n'] > 1:
+            return base * 1.35
+        return base
+
+    vector('ectopic_70bpm', ['70 bpm with a premature beat every twelve, its RR intervals must be rejected.'],
+           45, ectopic, lambda t: 75, seed=5, out_dir=out_dir)
+
+    vector('inverted_65bpm', ['65 bpm on a photodiode whose output falls as the blood volume rises.'],
+           45, rsa(60.0 / 65, 0.04, 0.015), lambda t: 70, seed=6, invert=True, dc=2600, noise=2.5,
+           out_dir=out_dir)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host stand-in for app_scheduler.h, a small FIFO run by app_sched_execute().
+ */
+
+#ifndef APP_SCHEDULER_H__
+#define APP_SCHEDULER_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "sdk_errors.h"
+
+#define HOST_SCHED_QUEUE_SIZE           16
+#define HOST_SCHED_EVENT_DATA_SIZE      32
+
+typedef void (* app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+typedef struct
+{
+        app_sched_event_handler_t handler;
+        uint16_t                  size;
+        uint8_t                   data[HOST_SCHED_EVENT_DATA_SIZE];
+} host_sched_evt_t;
+
+static host_sched_evt_t m_host_sched_queue[HOST_SCHED_QUEUE_SIZE];
+static uint32_t         m_host_sched_head;
+static uint32_t         m_host_sched_tail;
+
+static inline ret_code_t app_sched_event_put(void const                * p_event_data,
+                                             uint16_t                    event_size,
+                                             app_sched_event_handler_t   handler)
+{
+        host_sched_evt_t * p_evt;
+
+        if ((m_host_sched_tail - m_host_sched_head == HOST_SCHED_QUEUE_SIZE) ||
+            (event_size > HOST_SCHED_EVENT_DATA_SIZE))
+        {
+                return NRF_ERROR_NO_MEM;
+        }
+
+        p_evt          = &m_host_sched_queue[m_host_sched_tail++ % HOST_SCHED_QUEUE_SIZE];
+        p_evt->handler = handler;
+        p_evt->size    = event_size;
+        if (event_size != 0)
+        {
+                memcpy(p_evt->data, p_event_data, event_size);
+        }
+        return NRF_SUCCESS;
+}
+
+static inline void app_sched_execute(void)
+{
+        while (m_host_sched_head != m_host_sched_tail)
+        {
+                host_sched_evt_t evt = m_host_sched_queue[m_host_sched_head++ % HOST_SCHED_QUEUE_SIZE];
+
+                evt.handler((evt.size != 0) ? evt.data : NULL, evt.size);
+        }
+}
+
+#endif // APP_SCHEDULER_H__
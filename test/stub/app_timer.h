@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host stand-in for app_timer.h.
+ *
+ * @details The counter is m_host_app_timer_cnt, moved by the test. Timers expire only when the
+ *          test moves the counter with host_app_timer_advance, which calls their handlers in
+ *          order of expiry.
+ */
+
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_common.h"
+
+#define APP_TIMER_CLOCK_FREQ            32768
+#define APP_TIMER_CONFIG_RTC_FREQUENCY  0
+#define APP_TIMER_MAX_CNT_VAL           0x00FFFFFF
+#define APP_TIMER_SCHED_EVENT_DATA_SIZE 8
+
+#define APP_TIMER_TICKS(MS)                                                     \
+        ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ,           \
+                               1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)))
+
+#define HOST_APP_TIMER_MAX              16
+
+typedef void (* app_timer_timeout_handler_t)(void * p_context);
+
+typedef enum
+{
+        APP_TIMER_MODE_SINGLE_SHOT,
+        APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct
+{
+        app_timer_timeout_handler_t handler;
+        app_timer_mode_t            mode;
+        void                      * p_context;
+        uint32_t                    left;       /**< Ticks until expiry, while active. */
+        uint32_t                    period;
+        bool                        active;
+} app_timer_t;
+
+typedef app_timer_t * app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)                                 \
+        static app_timer_t timer_id##_data;                     \
+        static app_timer_id_t const timer_id = &timer_id##_data
+
+static uint32_t       m_host_app_timer_cnt;
+static app_timer_t * m_host_app_timers[HOST_APP_TIMER_MAX];
+
+static inline ret_code_t app_timer_create(app_timer_id_t const     * p_timer_id,
+                                          app_timer_mode_t           mode,
+                                          app_timer_timeout_handler_t timeout_handler)
+{
+        app_timer_t * p_timer = *p_timer_id;
+        uint32_t      free    = HOST_APP_TIMER_MAX;
+
+        for (uint32_t i = 0; i < HOST_APP_TIMER_MAX; i++)
+        {
+                if (m_host_app_timers[i] == p_timer)
+                {
+                        free = i;
+                        break;
+                }
+                if ((m_host_app_timers[i] == NULL) && (free == HOST_APP_TIMER_MAX))
+                {
+                        free = i;
+                }
+        }
+
+        if (free == HOST_APP_TIMER_MAX)
+        {
+                return NRF_ERROR_NO_MEM;
+        }
+
+        m_host_app_timers[free] = p_timer;
+        p_timer->handler        = timeout_handler;
+        p_timer->mode           = mode;
+        p_timer->active         = false;
+        return NRF_SUCCESS;
+}
+
+static inline ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+        timer_id->p_context = p_context;
+        timer_id->left      = timeout_ticks;
+        timer_id->period    = timeout_ticks;
+        timer_id->active    = true;
+        return NRF_SUCCESS;
+}
+
+static inline ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+        timer_id->active = false;
+        return NRF_SUCCESS;
+}
+
+/**@brief Function for moving the counter, calling the handlers of the timers that expire. */
+static inline void host_app_timer_advance(uint32_t ticks)
+{
+        while (true)
+        {
+                app_timer_t * p_next = NULL;
+
+                for (uint32_t i = 0; i < HOST_APP_TIMER_MAX; i++)
+                {
+                        app_timer_t * p_timer = m_host_app_timers[i];
+
+                        if ((p_timer != NULL) && p_timer->active && (p_timer->left <= ticks) &&
+                            ((p_next == NULL) || (p_timer->left < p_next->left)))
+                        {
+                                p_next = p_timer;
+                        }
+                }
+
+                if (p_next == NULL)
+                {
+                        break;
+                }
+
+                uint32_t step = p_next->left;
+
+                for (uint32_t i = 0; i < HOST_APP_TIMER_MAX; i++)
+                {
+                        if ((m_host_app_timers[i] != NULL) && m_host_app_timers[i]->active)
+                        {
+                                m_host_app_timers[i]->left -= step;
+                        }
+                }
+                m_host_app_timer_cnt += step;
+                ticks                -= step;
+
+                p_next->active = (p_next->mode == APP_TIMER_MODE_REPEATED);
+                p_next->left   = p_next->period;
+                p_next->handler(p_next->p_context);
+        }
+
+        for (uint32_t i = 0; i < HOST_APP_TIMER_MAX; i++)
+        {
+                if ((m_host_app_timers[i] != NULL) && m_host_app_timers[i]->active)
+                {
+                        m_host_app_timers[i]->left -= ticks;
+                }
+        }
+        m_host_app_timer_cnt += ticks;
+}
+
+static inline uint32_t app_timer_cnt_get(void)
+{
+        return m_host_app_timer_cnt & APP_TIMER_MAX_CNT_VAL;
+}
+
+static inline uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+        return (ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL;
+}
+
+#endif // APP_TIMER_H__
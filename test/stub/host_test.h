@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Checks and timing shared by the host tests.
+ *
+ * @details A failed check is printed and counted, the test goes on. TEST_MAIN_END returns the
+ *          failures as the exit status.
+ */
+
+#ifndef HOST_TEST_H__
+#define HOST_TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static uint32_t m_test_checks;
+static uint32_t m_test_failures;
+
+#define TEST_CHECK(cond)                                                                \
+        do                                                                              \
+        {                                                                               \
+                m_test_checks++;                                                        \
+                if (!(cond))                                                            \
+                {                                                                       \
+                        m_test_failures++;                                              \
+                        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+                }                                                                       \
+        } while (0)
+
+#define TEST_CHECK_EQ(a, b)                                                             \
+        do                                                                              \
+        {                                                                               \
+                long long _a = (long long)(a);                                          \
+                long long _b = (long long)(b);                                          \
+                m_test_checks++;                                                        \
+                if (_a != _b)                                                           \
+                {                                                                       \
+                        m_test_failures++;                                              \
+                        printf("%s:%d: check failed: %s == %s (%lld != %lld)\n",        \
+                               __FILE__, __LINE__, #a, #b, _a, _b);                     \
+                }                                                                       \
+        } while (0)
+
+#define TEST_RUN(test)                                                                  \
+        do                                                                              \
+        {                                                                               \
+                uint32_t _failures = m_test_failures;                                   \
+                test();                                                                 \
+                printf("%-40s %s\n", #test, (m_test_failures == _failures) ? "ok" : "FAILED"); \
+        } while (0)
+
+#define TEST_MAIN_END()                                                                 \
+        do                                                                              \
+        {                                                                               \
+                printf("%u checks, %u failed.\n", m_test_checks, m_test_failures);      \
+                return (m_test_failures == 0) ? 0 : 1;                                  \
+        } while (0)
+
+
+/**@brief Function for reading a monotonic clock in nanoseconds. */
+static inline uint64_t test_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif // HOST_TEST_H__
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host stand-in for nrf_log.h, the log is discarded.
+ */
+
+#ifndef NRF_LOG_H__
+#define NRF_LOG_H__
+
+#include <stdint.h>
+
+static inline void host_log_discard(int unused, ...)
+{
+        (void)unused;
+}
+
+#define NRF_LOG_MODULE_REGISTER()       struct host_log_unused
+#define NRF_LOG_ERROR(...)              host_log_discard(0, __VA_ARGS__)
+#define NRF_LOG_WARNING(...)            host_log_discard(0, __VA_ARGS__)
+#define NRF_LOG_INFO(...)               host_log_discard(0, __VA_ARGS__)
+#define NRF_LOG_DEBUG(...)              host_log_discard(0, __VA_ARGS__)
+#define NRF_LOG_RAW_INFO(...)           host_log_discard(0, __VA_ARGS__)
+#define NRF_LOG_HEXDUMP_INFO(p, len)    host_log_discard(0, (p), (len))
+#define NRF_LOG_HEXDUMP_DEBUG(p, len)   host_log_discard(0, (p), (len))
+#define NRF_LOG_FLOAT_MARKER            "%s%d.%02d"
+#define NRF_LOG_FLOAT(val)              "", (int)(val), 0
+#define NRF_LOG_FLUSH()
+
+#endif // NRF_LOG_H__
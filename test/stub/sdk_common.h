@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2018, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/**@file
+ *
+ * @brief Host stand-in for sdk_common.h and the app_util.h macros the modules use.
+ *
+ * @details The configuration comes from the sdk_config.h of each test directory.
+ */
+
+#ifndef SDK_COMMON_H__
+#define SDK_COMMON_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "sdk_config.h"
+#include "sdk_errors.h"
+
+#define NRF_MODULE_ENABLED(module)  ((defined(module ## _ENABLED) && (module ## _ENABLED)) ? 1 : 0)
+
+#define STATIC_ASSERT(_cond)        _Static_assert(_cond, #_cond)
+#define ASSERT(_cond)               assert(_cond)
+
+#define MIN(a, b)                   ((a) < (b) ? (a) : (b))
+#define MAX(a, b)                   ((a) < (b) ? (b) : (a))
+#define ARRAY_SIZE(_arr)            (sizeof(_arr) / sizeof((_arr)[0]))
+#define CEIL_DIV(A, B)              (((A) + (B) - 1) / (B))
+#define ROUNDED_DIV(A, B)           (((A) + ((B) / 2)) / (B))
+#define IS_POWER_OF_TWO(A)          (((A) != 0) && ((((A) - 1) & (A)) == 0))
+#define ALIGN_NUM(alignment, number) (((number) - 1) + (alignment) - (((number) - 1) % (alignment)))
+#define BYTES_TO_WORDS(n_bytes)     (((n_bytes) + 3) >> 2)
+
+#define UNUSED_PARAMETER(X)         (void)(X)
+#define UNUSED_VARIABLE(X)          (void)(X)
+#define UNUSED_RETURN_VALUE(X)      (void)(X)
+
+#define __INLINE                    inline
+#define __ALIGN(n)                  __attribute__((aligned(n)))
+
+#define VERIFY_SUCCESS(err_code)                \
+        do                                      \
+        {                                       \
+                if ((err_code) != NRF_SUCCESS)  \
+                {                               \
+                        return (err_code);      \
+                }                               \
+        } while (0)
+
+#define VERIFY_PARAM_NOT_NULL(p_param)          \
+        do                                      \
+        {                                       \
+                if ((p_param) == NULL)          \
+                {                               \
+                        return NRF_ERROR_NULL;  \
+                }                               \
+        } while (0)
+
+#define VERIFY_TRUE(condition, err_code)        \
+        do                                      \
+        {                                       \
+                if (!(condition))               \
+                {                               \
+                        return (err_code);      \
+                }                               \
+        } while (0)
+
+#define VERIFY_FALSE(condition, err_code)       VERIFY_TRUE(!(condition), err_code)
+
+
+static inline uint8_t uint16_encode(uint16_t value, uint8_t * p_encoded_data)
+{
+        p_encoded_data[0] = (uint8_t)(value & 0xFF);
+        p_encoded_data[1] = (uint8_t)(value >> 8);
+        return sizeof(uint16_t);
+}
+
+
+static inline uint8_t uint32_encode(uint32_t value, uint8_t * p_encoded_data)
+{
+        p_encoded_data[0] = (uint8_t)(value & 0xFF);
+        p_encoded_data[1] = (uint8_t)((value >> 8) & 0xFF);
+        p_encoded_data[2] = (uint8_t)((value >> 16) & 0xFF);
+        p_encoded_data[3] = (uint8_t)(value >> 24);
+        return sizeof(uint32_t);
+}
+
+
+static inline uint16_t uint16_decode(uint8_t const * p_encoded_data)
+{
+        return (uint16_t)(p_encoded_data[0] | (p_encoded_data[1] << 8));
+}
+
+
+static inline uint32_t uint32_decode(uint8_t const * p_encoded_data)
+{
+        return ((uint32_t)p_encoded_data[0]) |
+               ((uint32_t)p_encoded_data[1] << 8) |
+               ((uint32_t)p_encoded_data[2] << 16) |
+               ((uint32_t)p_encoded_data[3] << 24);
+}
+
+#endif // SDK_COMMON_H__